@@ -0,0 +1,253 @@
+/*!
+ * \file AGING_strategy.c
+ *
+ * \brief Stratégie NUR à vieillissement (\b Aging) sans balayage complet.
+ *
+ * Chaque bloc a un âge sur AGE_BITS bits au lieu du seul bit R de NUR : un
+ * accès met à 1 son bit de poids fort, et le vieillissement divise l'âge par
+ * deux. Le bloc remplacé est celui de plus petit âge (accédé le moins
+ * récemment, à la période de vieillissement près) et, à âge égal, un bloc
+ * non modifié plutôt qu'un bloc modifié, puis le plus anciennement classé.
+ *
+ * Le vieillissement n'est pas un balayage de tous les blocs tous les nderef
+ * accès, payé par un seul accès comme dans NUR : une \b aiguille vieillit
+ * quelques blocs à chaque accès (nblocks / nderef, arrondi au-dessus, et au
+ * plus AGING_MAX_STEP), si bien que chaque bloc vieillit une fois tous les
+ * nderef accès environ. Pour un grand cache, la période s'allonge donc à
+ * nblocks / AGING_MAX_STEP accès : le coût d'un accès reste borné.
+ *
+ * Les blocs sont rangés dans une liste par clé (âge, M), et un masque de bits
+ * des listes non vides donne la plus petite clé en quelques ctz : le choix de
+ * la victime ne parcourt pas non plus les blocs. Le bit M d'une clé est celui
+ * du dernier accès ou du dernier passage de l'aiguille (Cache_Sync() le remet
+ * à 0 à l'insu de la stratégie).
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "strategy.h"
+#include "low_cache.h"
+
+//! Nombre de bits de l'âge d'un bloc
+#define AGE_BITS 8
+
+//! Bit mis à 1 par un accès
+#define AGE_TOP (1u << (AGE_BITS - 1))
+
+//! Nombre maximal de blocs vieillis à chaque accès
+#define AGING_MAX_STEP 8
+
+//! Nombre de clés (âge, M)
+#define NKEYS (2u << AGE_BITS)
+
+//! Nombre de mots du masque des clés
+#define NWORDS (NKEYS / 64)
+
+//! Maillon d'une liste circulaire à sentinelle (par indice)
+struct Aging_Link
+{
+    int prev;
+    int next;
+};
+
+/*!
+ * Données de la stratégie
+ *
+ * La clé d'un bloc est mise à 0 quand Get_Free_Block() le distribue pour la
+ * première fois depuis la création ou l'invalidation (\c ninit), son âge
+ * quand il est choisi : les blocs ne sont jamais parcourus, et l'aiguille
+ * saute ceux qui ne sont pas encore initialisés.
+ */
+struct Aging
+{
+    unsigned nblocks;           //!< Nombre de blocs du cache
+    struct Aging_Link *links;   //!< nblocks blocs, puis la sentinelle de chaque clé
+    unsigned char *age;         //!< Âge de chaque bloc
+    int *key;                   //!< Clé + 1 de chaque bloc (0 : aucune)
+    unsigned ninit;             //!< Blocs dont la clé est initialisée (les premiers)
+    uint64_t mask[NWORDS];      //!< Clés dont la liste n'est pas vide
+    unsigned step;              //!< Blocs vieillis à chaque accès (0 : pas de vieillissement)
+    unsigned hand;              //!< Prochain bloc vieilli
+};
+
+#define AGING(pcache) ((struct Aging *)(pcache)->pstrategy)
+
+//! Sentinelle de la liste de la clé k
+#define SENTINEL(pa, k) ((int)(pa)->nblocks + (k))
+
+//! Clé d'un bloc : son âge, puis son bit M
+#define KEY(age, flags) ((int)(age) << 1 | ((flags) & MODIF ? 1 : 0))
+
+//! Retrait du bloc i de sa liste
+static void Detach(struct Aging *pa, int i) {
+    struct Aging_Link *pk = &pa->links[i];
+    int k = pa->key[i] - 1, s;
+
+    if (k < 0)
+        return;
+    pa->links[pk->prev].next = pk->next;
+    pa->links[pk->next].prev = pk->prev;
+    pa->key[i] = 0;
+    s = SENTINEL(pa, k);
+    if (pa->links[s].next == s)
+        pa->mask[k / 64] &= ~((uint64_t)1 << (k % 64));
+}
+
+//! Ajout du bloc i à la fin de la liste de la clé k
+static void Attach(struct Aging *pa, int i, int k) {
+    struct Aging_Link *pk = &pa->links[i];
+    int s = SENTINEL(pa, k);
+
+    pk->prev = pa->links[s].prev;
+    pk->next = s;
+    pa->links[pk->prev].next = i;
+    pa->links[s].prev = i;
+    pa->key[i] = k + 1;
+    pa->mask[k / 64] |= (uint64_t)1 << (k % 64);
+}
+
+//! Reclassement du bloc pbh d'après son âge et ses flags actuels
+static void Rekey(struct Aging *pa, struct Cache_Block_Header *pbh) {
+    int i = pbh->ibcache, k = KEY(pa->age[i], pbh->flags);
+
+    if (pa->key[i] == k + 1)
+        return;
+    Detach(pa, i);
+    Attach(pa, i, k);
+}
+
+//! Avance de l'aiguille : vieillissement des step blocs suivants
+static void Tick(struct Cache *pcache, struct Aging *pa) {
+    unsigned n;
+
+    for (n = 0; n < pa->step; n++) {
+        int i = pa->hand;
+
+        if ((unsigned)i < pa->ninit && pa->key[i] > 0) {
+            pa->age[i] >>= 1;
+            Rekey(pa, &pcache->headers[i]);
+        }
+        if (++pa->hand == pa->nblocks) {
+            pa->hand = 0;
+            pcache->instrument.n_deref++;
+        }
+    }
+}
+
+//! Listes vides ; aucun bloc initialisé
+static void Init(struct Aging *pa) {
+    unsigned k;
+
+    for (k = 0; k < NKEYS; k++)
+        pa->links[SENTINEL(pa, k)].prev = pa->links[SENTINEL(pa, k)].next = SENTINEL(pa, k);
+    for (k = 0; k < NWORDS; k++)
+        pa->mask[k] = 0;
+    pa->hand = 0;
+    pa->ninit = 0;
+}
+
+/*!
+ * Le vieillissement suit la période de déréférençage de NUR (nderef), dans
+ * la limite de AGING_MAX_STEP blocs par accès.
+ */
+void *Strategy_Create(struct Cache *pcache)
+{
+    struct Aging *pa = malloc(sizeof(struct Aging));
+
+    pa->nblocks = pcache->nblocks;
+    pa->links = malloc((pa->nblocks + NKEYS) * sizeof(struct Aging_Link));
+    pa->age = malloc(pa->nblocks);
+    pa->key = malloc(pa->nblocks * sizeof(int));
+    pa->step = pcache->nderef > 0 ? (pa->nblocks + pcache->nderef - 1) / pcache->nderef : 0;
+    if (pa->step > AGING_MAX_STEP)
+        pa->step = AGING_MAX_STEP;
+    Init(pa);
+
+    return pa;
+}
+
+void Strategy_Close(struct Cache *pcache)
+{
+    struct Aging *pa = AGING(pcache);
+
+    free(pa->links);
+    free(pa->age);
+    free(pa->key);
+    free(pa);
+}
+
+void Strategy_Invalidate(struct Cache *pcache)
+{
+    Init(AGING(pcache));
+}
+
+/*!
+ * Un bloc libre s'il y en a, sinon le premier de la liste de plus petite clé.
+ * Le bloc choisi repart d'un âge nul.
+ */
+struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache)
+{
+    struct Aging *pa = AGING(pcache);
+    struct Cache_Block_Header *pbh = Get_Free_Block(pcache);
+    int i, w;
+
+    // Un bloc libéré par la fermeture d'un fichier est encore dans une liste ;
+    // un bloc jamais distribué depuis la création ou l'invalidation n'a pas
+    // de clé (Adapt_Switch() les redistribue dans le désordre)
+    if (pbh != NULL) {
+        i = pbh->ibcache;
+        for (; pa->ninit <= (unsigned)i; pa->ninit++)
+            pa->key[pa->ninit] = 0;
+    }
+    else {
+        for (w = 0; w < (int)NWORDS && pa->mask[w] == 0; w++)
+            ;
+        assert(w < (int)NWORDS);
+        i = pa->links[SENTINEL(pa, w * 64 + __builtin_ctzll(pa->mask[w]))].next;
+        pbh = &pcache->headers[i];
+    }
+    Detach(pa, i);
+    pa->age[i] = 0;
+    Attach(pa, i, KEY(0, 0));
+
+    return pbh;
+}
+
+static void Access(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    struct Aging *pa = AGING(pcache);
+
+    pa->age[pbh->ibcache] |= AGE_TOP;
+    Rekey(pa, pbh);
+    Tick(pcache, pa);
+}
+
+void Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    Access(pcache, pbh);
+}
+
+void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    Access(pcache, pbh);
+}
+
+/* Ordre de remplacement : clés croissantes, chaque liste dans l'ordre */
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order)
+{
+    struct Aging *pa = AGING(pcache);
+    int k, i, n = 0;
+
+    for (k = 0; k < (int)NKEYS; k++) {
+        for (i = pa->links[SENTINEL(pa, k)].next; i != SENTINEL(pa, k); i = pa->links[i].next)
+            order[n++] = &pcache->headers[i];
+    }
+    return n;
+}
+
+char *Strategy_Name()
+{
+    return "AGING";
+}
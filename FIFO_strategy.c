@@ -4,39 +4,37 @@
 #include "low_cache.h"
 #include "cache_list.h"
 
-#define C_LIST(pcache) ((struct Cache_List *)((pcache)->pstrategy))
+/* Une cellule par bloc (voir cache_list.h) */
+#define C_LIST(pcache) ((struct Cache_Block_List *)((pcache)->pstrategy))
 
 void *Strategy_Create(struct Cache *pcache) 
 {
-    return Cache_List_Create();
+    return Cache_Block_List_Create(pcache->nblocks);
 }
 
 void Strategy_Close(struct Cache *pcache)
 {
-    Cache_List_Delete(C_LIST(pcache));
+    Cache_Block_List_Delete(C_LIST(pcache));
 }
 
 void Strategy_Invalidate(struct Cache *pcache)
 {
-    Cache_List_Clear(C_LIST(pcache));
+    Cache_Block_List_Clear(C_LIST(pcache));
 }
 
 struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache) 
 {
     struct Cache_Block_Header *buffer;
-    struct Cache_List *c_list = C_LIST(pcache);
-
-    /* S'il existe un cache invalide, on va utiliser celui la */
-    if ((buffer = Get_Free_Block(pcache)) != NULL) {
-    	// Comme on va l'utiliser, on le met en fin de liste
-        Cache_List_Append(c_list, buffer);
-    } else {
-	    // On prend le premier de la liste que l'on va retourner
-	    buffer = Cache_List_Remove_First(c_list);
-
-	    // Comme on va l'utiliser, on le met en fin de liste
-	    Cache_List_Append(c_list, buffer);
-	}
+    struct Cache_Block_List *c_list = C_LIST(pcache);
+
+    /* S'il existe un cache invalide, on va utiliser celui la, sinon on
+     * prend le premier de la liste */
+    if ((buffer = Get_Free_Block(pcache)) == NULL)
+        buffer = Cache_Block_List_First(c_list);
+
+    // Comme on va l'utiliser, on le met en fin de liste (un bloc libéré
+    // par la fermeture d'un fichier y est déjà)
+    Cache_Block_List_Move_To_End(c_list, buffer);
     return buffer;    
 }
 
@@ -48,6 +46,12 @@ void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pbh)
 {
 } 
 
+/* Ordre de la file : du plus ancien au plus récent */
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order)
+{
+    return Cache_Block_List_To_Array(C_LIST(pcache), order);
+}
+
 char *Strategy_Name()
 {
     return "FIFO";
@@ -0,0 +1,285 @@
+/*!
+ * \file LFU_strategy.c
+ *
+ * \brief Stratégie LFU (Least Frequently Used) en temps constant.
+ *
+ * Chaque bloc a un compteur d'accès ; le bloc remplacé est le moins
+ * fréquemment accédé et, à fréquence égale, le moins récemment accédé.
+ *
+ * Les blocs de même compteur forment un \b seau (liste, du moins récent au
+ * plus récent) ; les seaux non vides sont chaînés par compteur croissant. Un
+ * accès fait passer le bloc dans le seau suivant (créé s'il n'existe pas) et
+ * le bloc remplacé est le premier du premier seau : aucun parcours des blocs.
+ *
+ * Sans vieillissement, un bloc très accédé autrefois ne serait jamais
+ * remplacé. Tous les \c AGING_FACTOR * nblocks accès, les compteurs sont donc
+ * divisés par deux, ce qui ne change pas l'ordre des seaux ; deux seaux
+ * devenus égaux sont fusionnés. Le vieillissement parcourt les seaux et
+ * les blocs des seaux fusionnés, au plus nblocks : rapporté aux accès de la
+ * période, son coût est constant.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "strategy.h"
+#include "low_cache.h"
+
+//! Période de vieillissement, en multiple du nombre de blocs
+#define AGING_FACTOR 2
+
+//! Maillon d'une liste circulaire à sentinelle (par indice)
+struct LFU_Link
+{
+    int prev;
+    int next;
+};
+
+//! Un seau : les blocs d'un même compteur
+struct LFU_Bucket
+{
+    unsigned freq;      //!< Compteur d'accès des blocs du seau
+    int prev;           //!< Seau précédent (compteur inférieur)
+    int next;           //!< Seau suivant (compteur supérieur)
+};
+
+/*!
+ * Données de la stratégie
+ *
+ * Le seau d'un bloc est mis à 0 quand Get_Free_Block() le distribue pour la
+ * première fois depuis la création ou l'invalidation (\c ninit) : les blocs
+ * ne sont jamais parcourus.
+ */
+struct LFU
+{
+    unsigned nblocks;   //!< Nombre de blocs du cache
+    struct LFU_Link *links; //!< nblocks blocs, puis la sentinelle de chaque seau
+    int *bucket;        //!< Seau + 1 de chaque bloc (0 : aucun)
+    unsigned ninit;     //!< Blocs dont le seau est initialisé (les premiers)
+    struct LFU_Bucket *buckets; //!< nblocks seaux, puis la sentinelle de leur liste
+    int head;           //!< Sentinelle de la liste des seaux
+    int free;           //!< Seaux libérés (chaînés par next ; -1 : aucun)
+    int fresh;          //!< Premier seau jamais utilisé (les suivants ne l'ont pas été non plus)
+    unsigned period;    //!< Nombre d'accès entre deux vieillissements
+    unsigned count;     //!< Accès depuis le dernier vieillissement
+};
+
+#define LFU(pcache) ((struct LFU *)(pcache)->pstrategy)
+
+//! Sentinelle de la liste des blocs du seau ib
+#define SENTINEL(pl, ib) ((int)(pl)->nblocks + (ib))
+
+static void Unlink(struct LFU *pl, int i) {
+    struct LFU_Link *pk = &pl->links[i];
+
+    pl->links[pk->prev].next = pk->next;
+    pl->links[pk->next].prev = pk->prev;
+    pk->prev = pk->next = i;
+}
+
+//! Ajout du bloc i à la fin de la liste de sentinelle s
+static void Link_Last(struct LFU *pl, int s, int i) {
+    struct LFU_Link *pk = &pl->links[i];
+
+    pk->prev = pl->links[s].prev;
+    pk->next = s;
+    pl->links[pk->prev].next = i;
+    pl->links[s].prev = i;
+}
+
+//! Nouveau seau de compteur freq, après le seau after
+static int New_Bucket(struct LFU *pl, int after, unsigned freq) {
+    struct LFU_Bucket *pb;
+    int ib;
+
+    // Un seau libéré, sinon le premier jamais utilisé
+    if ((ib = pl->free) >= 0)
+        pl->free = pl->buckets[ib].next;
+    else
+        ib = pl->fresh++;
+    assert(ib < (int)pl->nblocks);
+    pb = &pl->buckets[ib];
+    pb->freq = freq;
+    pb->prev = after;
+    pb->next = pl->buckets[after].next;
+    pl->buckets[pb->next].prev = ib;
+    pl->buckets[after].next = ib;
+    pl->links[SENTINEL(pl, ib)].prev = pl->links[SENTINEL(pl, ib)].next = SENTINEL(pl, ib);
+    return ib;
+}
+
+//! Retrait du bloc i de son seau (libéré s'il devient vide)
+static void Detach(struct LFU *pl, int i) {
+    int ib = pl->bucket[i] - 1;
+    struct LFU_Bucket *pb;
+
+    if (ib < 0)
+        return;
+    Unlink(pl, i);
+    pl->bucket[i] = 0;
+    if (pl->links[SENTINEL(pl, ib)].next != SENTINEL(pl, ib))
+        return;
+
+    pb = &pl->buckets[ib];
+    pl->buckets[pb->prev].next = pb->next;
+    pl->buckets[pb->next].prev = pb->prev;
+    pb->next = pl->free;
+    pl->free = ib;
+}
+
+//! Passage du bloc i (dans le seau ib) au seau de compteur freq, qui suit ib ou le remplace
+static void Move(struct LFU *pl, int i, int ib, unsigned freq) {
+    int nb = pl->buckets[ib].next;
+
+    // Le seau suivant convient ; sinon, s'il est seul, le bloc garde le sien
+    // (les compteurs des seaux sont strictement croissants)
+    if (nb != pl->head && pl->buckets[nb].freq == freq) {
+        Detach(pl, i);
+        Link_Last(pl, SENTINEL(pl, nb), i);
+        pl->bucket[i] = nb + 1;
+    }
+    else if (pl->links[SENTINEL(pl, ib)].next == i && pl->links[SENTINEL(pl, ib)].prev == i)
+        pl->buckets[ib].freq = freq;
+    else {
+        nb = New_Bucket(pl, ib, freq);
+        Detach(pl, i);
+        Link_Last(pl, SENTINEL(pl, nb), i);
+        pl->bucket[i] = nb + 1;
+    }
+}
+
+//! Division par deux de tous les compteurs ; deux seaux devenus égaux sont fusionnés
+static void Age(struct LFU *pl) {
+    int ib, nb, i;
+
+    for (ib = pl->buckets[pl->head].next; ib != pl->head; ib = nb) {
+        int prev = pl->buckets[ib].prev;
+
+        nb = pl->buckets[ib].next;
+        pl->buckets[ib].freq /= 2;
+        if (prev == pl->head || pl->buckets[prev].freq != pl->buckets[ib].freq)
+            continue;
+        // Les blocs du seau, plus accédés, passent après ceux du précédent
+        while ((i = pl->links[SENTINEL(pl, ib)].next) != SENTINEL(pl, ib)) {
+            Detach(pl, i);
+            Link_Last(pl, SENTINEL(pl, prev), i);
+            pl->bucket[i] = prev + 1;
+        }
+    }
+}
+
+//! Aucun seau ; aucun bloc initialisé
+static void Init(struct LFU *pl) {
+    pl->ninit = 0;
+    pl->free = -1;
+    pl->fresh = 0;
+    pl->buckets[pl->head].prev = pl->buckets[pl->head].next = pl->head;
+    pl->count = 0;
+}
+
+void *Strategy_Create(struct Cache *pcache)
+{
+    struct LFU *pl = malloc(sizeof(struct LFU));
+
+    // Il n'y a jamais plus de seaux non vides que de blocs
+    pl->nblocks = pcache->nblocks;
+    pl->links = malloc(2 * pl->nblocks * sizeof(struct LFU_Link));
+    pl->bucket = malloc(pl->nblocks * sizeof(int));
+    pl->buckets = malloc((pl->nblocks + 1) * sizeof(struct LFU_Bucket));
+    pl->head = pl->nblocks;
+    pl->period = AGING_FACTOR * pl->nblocks;
+    Init(pl);
+
+    return pl;
+}
+
+void Strategy_Close(struct Cache *pcache)
+{
+    struct LFU *pl = LFU(pcache);
+
+    free(pl->links);
+    free(pl->bucket);
+    free(pl->buckets);
+    free(pl);
+}
+
+void Strategy_Invalidate(struct Cache *pcache)
+{
+    Init(LFU(pcache));
+}
+
+/*!
+ * Un bloc libre s'il y en a, sinon le moins récent des blocs du premier seau.
+ * Le bloc choisi repart d'un compteur nul : son chargement n'est pas un accès.
+ */
+struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache)
+{
+    struct LFU *pl = LFU(pcache);
+    struct Cache_Block_Header *pbh = Get_Free_Block(pcache);
+    int i, first;
+
+    // Un bloc libéré par la fermeture d'un fichier est encore dans un seau ;
+    // un bloc jamais distribué depuis la création ou l'invalidation n'en a
+    // pas (Adapt_Switch() les redistribue dans le désordre)
+    if (pbh != NULL) {
+        i = pbh->ibcache;
+        for (; pl->ninit <= (unsigned)i; pl->ninit++)
+            pl->bucket[pl->ninit] = 0;
+    }
+    else {
+        first = pl->buckets[pl->head].next;
+        assert(first != pl->head);
+        i = pl->links[SENTINEL(pl, first)].next;
+        pbh = &pcache->headers[i];
+    }
+    Detach(pl, i);
+
+    first = pl->buckets[pl->head].next;
+    if (first == pl->head || pl->buckets[first].freq != 0)
+        first = New_Bucket(pl, pl->head, 0);
+    Link_Last(pl, SENTINEL(pl, first), i);
+    pl->bucket[i] = first + 1;
+
+    return pbh;
+}
+
+static void Access(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    struct LFU *pl = LFU(pcache);
+    int i = pbh->ibcache, ib = pl->bucket[i] - 1;
+
+    if (ib >= 0)
+        Move(pl, i, ib, pl->buckets[ib].freq + 1);
+    if (++pl->count >= pl->period) {
+        pl->count = 0;
+        Age(pl);
+    }
+}
+
+void Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    Access(pcache, pbh);
+}
+
+void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    Access(pcache, pbh);
+}
+
+/* Ordre de remplacement : seaux par compteur croissant, chacun du moins récent au plus récent */
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order)
+{
+    struct LFU *pl = LFU(pcache);
+    int ib, i, n = 0;
+
+    for (ib = pl->buckets[pl->head].next; ib != pl->head; ib = pl->buckets[ib].next) {
+        for (i = pl->links[SENTINEL(pl, ib)].next; i != SENTINEL(pl, ib); i = pl->links[i].next)
+            order[n++] = &pcache->headers[i];
+    }
+    return n;
+}
+
+char *Strategy_Name()
+{
+    return "LFU";
+}
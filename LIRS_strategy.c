@@ -0,0 +1,482 @@
+/*!
+ * \file LIRS_strategy.c
+ *
+ * \brief Stratégie LIRS (Low Inter-reference Recency Set).
+ *
+ * LRU classe les blocs par la date de leur dernier accès ; LIRS les classe par
+ * la distance entre leurs deux derniers accès (récence d'inter-référence). Une
+ * boucle un peu plus grande que le cache, qui fait tomber LRU à zéro, garde
+ * ainsi une partie de ses blocs dans le cache.
+ *
+ * Les blocs résidents sont de deux sortes :
+ * - les blocs \b LIR (au plus \c nlir), jamais remplacés tant qu'ils restent LIR ;
+ * - les blocs \b HIR résidents (au moins un), dans la file \c Q : le premier
+ *   de la file est le prochain remplacé.
+ *
+ * La pile \c S contient, du plus récent au plus ancien, les blocs accédés
+ * depuis l'accès au plus ancien bloc LIR (son fond est toujours un bloc LIR).
+ * Un bloc HIR accédé alors qu'il est encore dans \c S a une récence
+ * d'inter-référence plus petite que celle du bloc LIR du fond : il devient
+ * LIR et ce dernier devient HIR. Pour le savoir même quand un bloc HIR a
+ * été remplacé, \c S garde aussi des entrées HIR \b non \b résidentes,
+ * identifiées par (\c ifile, \c ibfile) et retrouvées par une table de
+ * hachage. Leur nombre est borné (\c NONRES_FACTOR fois la taille du cache) :
+ * au-delà, la plus ancienne est oubliée.
+ *
+ * Quand le fond de \c S change, les entrées HIR qui s'y trouvent sont
+ * retirées jusqu'au prochain bloc LIR (élagage) : chaque entrée n'est retirée
+ * qu'une fois, le coût est donc constant en moyenne.
+ *
+ * La stratégie ne voit pas le bloc chargé à la place de celui qu'elle a
+ * choisi : Strategy_Replace_Block() met le bloc choisi en attente, et le
+ * premier accès qui suit (Strategy_Read(), Strategy_Write()) le classe. Un
+ * bloc dont le fichier ou l'indice a changé sans passer par elle (quotas, voir
+ * Cache_File_Open()) est traité de même.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "strategy.h"
+#include "low_cache.h"
+
+//! Part des blocs résidents HIR (en pourcentage du cache, au moins un bloc)
+#define HIR_PERCENT 1
+
+//! Nombre maximal d'entrées non résidentes, en multiple du nombre de blocs
+#define NONRES_FACTOR 2
+
+//! État d'une entrée
+enum {
+    LIRS_NONE,      //!< bloc pas encore distribué, ou libéré
+    LIRS_LIR,       //!< bloc LIR (dans S)
+    LIRS_HIR,       //!< bloc HIR résident (dans Q, et peut-être dans S)
+    LIRS_NONRES,    //!< entrée HIR non résidente (dans S et dans la liste N)
+};
+
+//! Chaînages d'une entrée : S d'une part, Q (ou N, ou la liste libre) d'autre part
+enum { LINK_S, LINK_Q };
+
+//! Entrée : bloc du cache (indice ibcache) ou entrée non résidente (indice nblocks et au-delà)
+struct LIRS_Entry
+{
+    int link[2][2];     //!< Précédent ([0]) et suivant ([1]) dans S et dans Q (ou N)
+    int hnext;          //!< Suivante dans la classe de hachage (entrées non résidentes ; 0 : aucune)
+    int ifile;          //!< Fichier du bloc
+    Cache_Index ibfile; //!< Indice du bloc dans le fichier
+    unsigned char state; //!< LIRS_NONE, LIRS_LIR...
+    unsigned char in_s; //!< Vrai si l'entrée est dans S
+    unsigned char pending; //!< Vrai si le bloc vient d'être choisi et n'a pas encore été accédé
+};
+
+//! Liste doublement chaînée d'entrées (par leur indice ; -1 : aucune)
+struct LIRS_List
+{
+    int first;          //!< Première entrée (fond de S, tête de Q)
+    int last;           //!< Dernière entrée (sommet de S, queue de Q)
+};
+
+/*!
+ * Données de la stratégie
+ *
+ * Rien n'est parcouru, ni à la création ni à l'invalidation. L'entrée d'un
+ * bloc est mise à 0 quand Get_Free_Block() le distribue pour la première fois
+ * (\c ninit) : une entrée à 0 est dans l'état LIRS_NONE, hors de toute liste,
+ * et ses chaînages ne sont lus qu'une fois qu'elle est dans une liste. Une
+ * entrée non résidente est entièrement remplie à sa prise (\c fresh). La
+ * table de hachage est prise à 0, et une classe d'une génération passée est
+ * vide. Une entrée non résidente a un indice au moins égal à nblocks (donc
+ * non nul) : 0 marque la fin d'une classe de hachage.
+ */
+struct LIRS
+{
+    struct LIRS_Entry *entries; //!< nblocks blocs puis nnonres entrées non résidentes
+    unsigned nblocks;   //!< Nombre de blocs du cache
+    unsigned ninit;     //!< Entrées de blocs initialisées (les premières)
+    unsigned nnonres;   //!< Nombre maximal d'entrées non résidentes
+    unsigned nlir;      //!< Nombre maximal de blocs LIR
+    unsigned cur_lir;   //!< Nombre de blocs LIR
+    struct LIRS_List s; //!< Pile S (le sommet est \c last)
+    struct LIRS_List q; //!< File Q des blocs HIR résidents
+    struct LIRS_List n; //!< Entrées non résidentes, de la plus ancienne à la plus récente
+    int free;           //!< Entrées non résidentes libérées (chaînées par LINK_Q ; -1 : aucune)
+    unsigned fresh;     //!< Première entrée non résidente jamais utilisée (les suivantes non plus)
+    int *hash;          //!< Première entrée non résidente de chaque classe (0 : aucune)
+    unsigned *hgen;     //!< Génération de chaque classe
+    unsigned gen;       //!< Génération courante
+    unsigned hmask;     //!< Nombre de classes - 1 (puissance de 2)
+};
+
+#define LIRS(pcache) ((struct LIRS *)(pcache)->pstrategy)
+#define ENTRY(pl, i) (&(pl)->entries[i])
+
+/* ------------------------------------------------------------------------
+ * Listes
+ * ------------------------------------------------------------------------ */
+
+static void List_Remove(struct LIRS *pl, struct LIRS_List *plist, int i, int k) {
+    struct LIRS_Entry *pe = ENTRY(pl, i);
+    int prev = pe->link[k][0], next = pe->link[k][1];
+
+    if (prev >= 0) ENTRY(pl, prev)->link[k][1] = next;
+    else plist->first = next;
+    if (next >= 0) ENTRY(pl, next)->link[k][0] = prev;
+    else plist->last = prev;
+    pe->link[k][0] = pe->link[k][1] = -1;
+}
+
+static void List_Append(struct LIRS *pl, struct LIRS_List *plist, int i, int k) {
+    struct LIRS_Entry *pe = ENTRY(pl, i);
+
+    pe->link[k][0] = plist->last;
+    pe->link[k][1] = -1;
+    if (plist->last >= 0) ENTRY(pl, plist->last)->link[k][1] = i;
+    else plist->first = i;
+    plist->last = i;
+}
+
+//! L'entrée j prend la place de l'entrée i dans la liste
+static void List_Replace(struct LIRS *pl, struct LIRS_List *plist, int i, int j, int k) {
+    struct LIRS_Entry *pe = ENTRY(pl, i), *pn = ENTRY(pl, j);
+
+    pn->link[k][0] = pe->link[k][0];
+    pn->link[k][1] = pe->link[k][1];
+    if (pn->link[k][0] >= 0) ENTRY(pl, pn->link[k][0])->link[k][1] = j;
+    else plist->first = j;
+    if (pn->link[k][1] >= 0) ENTRY(pl, pn->link[k][1])->link[k][0] = j;
+    else plist->last = j;
+    pe->link[k][0] = pe->link[k][1] = -1;
+}
+
+/* ------------------------------------------------------------------------
+ * Entrées non résidentes
+ * ------------------------------------------------------------------------ */
+
+static unsigned Hash(struct LIRS *pl, int ifile, Cache_Index ibfile) {
+    return (((unsigned)ibfile ^ (unsigned)((uint64_t)ibfile >> 32)) * 2654435761u ^ (unsigned)ifile * 40503u) & pl->hmask;
+}
+
+//! Tête de la classe k, vidée si elle est d'une génération passée
+static int *Head(struct LIRS *pl, unsigned k) {
+    if (pl->hgen[k] != pl->gen) {
+        pl->hgen[k] = pl->gen;
+        pl->hash[k] = 0;
+    }
+    return &pl->hash[k];
+}
+
+static int Nonres_Find(struct LIRS *pl, int ifile, Cache_Index ibfile) {
+    int i;
+
+    for (i = *Head(pl, Hash(pl, ifile, ibfile)); i != 0; i = ENTRY(pl, i)->hnext) {
+        if (ENTRY(pl, i)->ifile == ifile && ENTRY(pl, i)->ibfile == ibfile)
+            return i;
+    }
+    return -1;
+}
+
+//! Oubli de l'entrée non résidente i, qui n'est plus dans S
+static void Nonres_Free(struct LIRS *pl, int i) {
+    struct LIRS_Entry *pe = ENTRY(pl, i);
+    int *pi = Head(pl, Hash(pl, pe->ifile, pe->ibfile));
+
+    while (*pi != i)
+        pi = &ENTRY(pl, *pi)->hnext;
+    *pi = pe->hnext;
+    List_Remove(pl, &pl->n, i, LINK_Q);
+    pe->state = LIRS_NONE;
+    pe->link[LINK_Q][1] = pl->free;
+    pl->free = i;
+}
+
+//! Une entrée non résidente remplace le bloc HIR i dans S
+static void Nonres_Replace(struct LIRS *pl, int i) {
+    struct LIRS_Entry *pe = ENTRY(pl, i), *pn;
+    int j, *ph;
+
+    // Une entrée libérée, sinon une jamais utilisée ; plus d'entrée disponible :
+    // la plus ancienne est oubliée (jamais le fond de S, qui est un bloc LIR)
+    if (pl->free < 0 && pl->fresh < pl->nblocks + pl->nnonres)
+        j = pl->fresh++;
+    else {
+        if (pl->free < 0) {
+            j = pl->n.first;
+            List_Remove(pl, &pl->s, j, LINK_S);
+            ENTRY(pl, j)->in_s = 0;
+            Nonres_Free(pl, j);
+        }
+        j = pl->free;
+        pl->free = ENTRY(pl, j)->link[LINK_Q][1];
+    }
+    pn = ENTRY(pl, j);
+
+    pn->ifile = pe->ifile;
+    pn->ibfile = pe->ibfile;
+    pn->state = LIRS_NONRES;
+    pn->in_s = 1;
+    List_Replace(pl, &pl->s, i, j, LINK_S);
+    pe->in_s = 0;
+    List_Append(pl, &pl->n, j, LINK_Q);
+    ph = Head(pl, Hash(pl, pn->ifile, pn->ibfile));
+    pn->hnext = *ph;
+    *ph = j;
+}
+
+/* ------------------------------------------------------------------------
+ * Pile S et file Q
+ * ------------------------------------------------------------------------ */
+
+//! Élagage : retrait des entrées HIR du fond de S
+static void Prune(struct LIRS *pl) {
+    int i;
+
+    while ((i = pl->s.first) >= 0 && ENTRY(pl, i)->state != LIRS_LIR) {
+        List_Remove(pl, &pl->s, i, LINK_S);
+        ENTRY(pl, i)->in_s = 0;
+        if (ENTRY(pl, i)->state == LIRS_NONRES)
+            Nonres_Free(pl, i);
+    }
+}
+
+//! Mise au sommet de S de l'entrée i
+static void Push(struct LIRS *pl, int i) {
+    if (ENTRY(pl, i)->in_s)
+        List_Remove(pl, &pl->s, i, LINK_S);
+    List_Append(pl, &pl->s, i, LINK_S);
+    ENTRY(pl, i)->in_s = 1;
+}
+
+//! Le bloc i devient LIR (au sommet de S) ; s'il y en a trop, celui du fond de S devient HIR
+static void Make_LIR(struct LIRS *pl, int i) {
+    struct LIRS_Entry *pe = ENTRY(pl, i);
+    int b;
+
+    if (pe->state == LIRS_HIR)
+        List_Remove(pl, &pl->q, i, LINK_Q);
+    pe->state = LIRS_LIR;
+    Push(pl, i);
+    if (++pl->cur_lir <= pl->nlir)
+        return;
+
+    b = pl->s.first;
+    List_Remove(pl, &pl->s, b, LINK_S);
+    ENTRY(pl, b)->in_s = 0;
+    ENTRY(pl, b)->state = LIRS_HIR;
+    List_Append(pl, &pl->q, b, LINK_Q);
+    pl->cur_lir--;
+    Prune(pl);
+}
+
+//! Retrait du bloc i de S et de Q
+static void Detach(struct LIRS *pl, int i) {
+    struct LIRS_Entry *pe = ENTRY(pl, i);
+
+    if (pe->in_s) {
+        List_Remove(pl, &pl->s, i, LINK_S);
+        pe->in_s = 0;
+    }
+    if (pe->state == LIRS_LIR)
+        pl->cur_lir--;
+    else if (pe->state == LIRS_HIR)
+        List_Remove(pl, &pl->q, i, LINK_Q);
+    pe->state = LIRS_NONE;
+    Prune(pl);
+}
+
+//! Premier accès au bloc i depuis son chargement
+static void Miss(struct LIRS *pl, int i, struct Cache_Block_Header *pbh) {
+    struct LIRS_Entry *pe = ENTRY(pl, i);
+    int j;
+
+    // Un bloc en attente est au bout de Q ; un bloc remplacé à l'insu de la
+    // stratégie peut être n'importe où
+    if (pe->pending) {
+        List_Remove(pl, &pl->q, i, LINK_Q);
+        pe->state = LIRS_NONE;
+        pe->pending = 0;
+    }
+    else
+        Detach(pl, i);
+    pe->ifile = pbh->ifile;
+    pe->ibfile = pbh->ibfile;
+
+    // Le bloc était encore dans S : sa récence d'inter-référence est petite
+    if ((j = Nonres_Find(pl, pe->ifile, pe->ibfile)) >= 0) {
+        List_Remove(pl, &pl->s, j, LINK_S);
+        ENTRY(pl, j)->in_s = 0;
+        Nonres_Free(pl, j);
+        Make_LIR(pl, i);
+    }
+    // Tant que l'ensemble LIR n'est pas plein, tout bloc y entre
+    else if (pl->cur_lir < pl->nlir)
+        Make_LIR(pl, i);
+    else {
+        pe->state = LIRS_HIR;
+        List_Append(pl, &pl->q, i, LINK_Q);
+        Push(pl, i);
+    }
+}
+
+//! Accès au bloc pbh
+static void Access(struct Cache *pcache, struct Cache_Block_Header *pbh) {
+    struct LIRS *pl = LIRS(pcache);
+    int i = pbh->ibcache;
+    struct LIRS_Entry *pe = ENTRY(pl, i);
+
+    if (pe->pending || pe->state == LIRS_NONE || pe->ifile != pbh->ifile || pe->ibfile != pbh->ibfile) {
+        Miss(pl, i, pbh);
+        return;
+    }
+
+    switch (pe->state) {
+    case LIRS_LIR:
+        Push(pl, i);
+        Prune(pl);
+        break;
+    case LIRS_HIR:
+        if (pe->in_s)
+            Make_LIR(pl, i);
+        else {
+            Push(pl, i);
+            List_Remove(pl, &pl->q, i, LINK_Q);
+            List_Append(pl, &pl->q, i, LINK_Q);
+        }
+        break;
+    }
+}
+
+/* ------------------------------------------------------------------------
+ * Stratégie
+ * ------------------------------------------------------------------------ */
+
+//! Listes vides ; aucune entrée initialisée
+static void Init(struct LIRS *pl) {
+    pl->ninit = 0;
+    pl->free = -1;
+    pl->fresh = pl->nblocks;
+    pl->s.first = pl->s.last = -1;
+    pl->q.first = pl->q.last = -1;
+    pl->n.first = pl->n.last = -1;
+    pl->cur_lir = 0;
+}
+
+//! Entrées non résidentes oubliées par changement de génération (vidées pour de bon au retour à 0)
+static void Reset(struct LIRS *pl) {
+    if (++pl->gen == 0)
+        memset(pl->hash, 0, (pl->hmask + 1) * sizeof(int));
+    Init(pl);
+}
+
+void *Strategy_Create(struct Cache *pcache)
+{
+    struct LIRS *pl = malloc(sizeof(struct LIRS));
+    unsigned nhir = pcache->nblocks * HIR_PERCENT / 100;
+
+    // Au moins un bloc HIR (sauf pour un cache d'un bloc) et un bloc LIR
+    if (nhir == 0)
+        nhir = 1;
+    pl->nblocks = pcache->nblocks;
+    pl->nlir = pcache->nblocks > nhir ? pcache->nblocks - nhir : 1;
+    pl->nnonres = NONRES_FACTOR * pcache->nblocks;
+    for (pl->hmask = 1; pl->hmask < pl->nnonres; pl->hmask <<= 1)
+        ;
+    pl->hmask--;
+    pl->entries = malloc((pl->nblocks + pl->nnonres) * sizeof(struct LIRS_Entry));
+    pl->hash = calloc(pl->hmask + 1, sizeof(int));
+    pl->hgen = calloc(pl->hmask + 1, sizeof(unsigned));
+    pl->gen = 0;
+    Init(pl);
+
+    return pl;
+}
+
+void Strategy_Close(struct Cache *pcache)
+{
+    struct LIRS *pl = LIRS(pcache);
+
+    free(pl->entries);
+    free(pl->hash);
+    free(pl->hgen);
+    free(pl);
+}
+
+void Strategy_Invalidate(struct Cache *pcache)
+{
+    Reset(LIRS(pcache));
+}
+
+/*!
+ * Un bloc libre s'il y en a, sinon le premier bloc HIR résident de Q (à
+ * défaut, le bloc LIR du fond de S). Le bloc choisi reste au bout de Q
+ * jusqu'à son premier accès.
+ */
+struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache)
+{
+    struct LIRS *pl = LIRS(pcache);
+    struct Cache_Block_Header *pbh = Get_Free_Block(pcache);
+    struct LIRS_Entry *pe;
+    int i;
+
+    if (pbh != NULL) {
+        // Un bloc libéré par la fermeture d'un fichier est encore connu ; un
+        // bloc jamais distribué depuis la création ou l'invalidation ne l'est
+        // pas (Adapt_Switch() les redistribue dans le désordre)
+        i = pbh->ibcache;
+        for (; pl->ninit <= (unsigned)i; pl->ninit++)
+            memset(ENTRY(pl, pl->ninit), 0, sizeof(struct LIRS_Entry));
+        Detach(pl, i);
+    }
+    else if ((i = pl->q.first) >= 0) {
+        pe = ENTRY(pl, i);
+        List_Remove(pl, &pl->q, i, LINK_Q);
+        // Un bloc encore dans S y laisse une entrée non résidente
+        if (pe->in_s)
+            Nonres_Replace(pl, i);
+        pe->state = LIRS_NONE;
+        pbh = &pcache->headers[i];
+    }
+    else {
+        i = pl->s.first;
+        assert(i >= 0);
+        Detach(pl, i);
+        pbh = &pcache->headers[i];
+    }
+
+    pe = ENTRY(pl, i);
+    pe->state = LIRS_HIR;
+    pe->pending = 1;
+    List_Append(pl, &pl->q, i, LINK_Q);
+
+    return pbh;
+}
+
+void Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    Access(pcache, pbh);
+}
+
+void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    Access(pcache, pbh);
+}
+
+/* Ordre de remplacement : les blocs HIR résidents de Q, puis les blocs LIR du fond au sommet de S */
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order)
+{
+    struct LIRS *pl = LIRS(pcache);
+    int i, n = 0;
+
+    for (i = pl->q.first; i >= 0; i = ENTRY(pl, i)->link[LINK_Q][1])
+        order[n++] = &pcache->headers[i];
+    for (i = pl->s.first; i >= 0; i = ENTRY(pl, i)->link[LINK_S][1]) {
+        if (ENTRY(pl, i)->state == LIRS_LIR)
+            order[n++] = &pcache->headers[i];
+    }
+    return n;
+}
+
+char *Strategy_Name()
+{
+    return "LIRS";
+}
@@ -0,0 +1,466 @@
+/*!
+ * \file LRU2_strategy.c
+ *
+ * \brief Stratégie LRU-2 (LRU-K avec K = 2) en temps constant.
+ *
+ * Le bloc remplacé est celui dont l'avant-dernier accès (\c hist2) est le plus
+ * ancien : un bloc accédé une seule fois, fût-ce récemment, part avant un
+ * bloc accédé régulièrement. Les blocs qui n'ont qu'un accès (\c hist2 nul)
+ * sont remplacés les premiers, du moins récent au plus récent.
+ *
+ * Le temps est le nombre d'accès au cache. Les accès à un bloc qui suivent
+ * le précédent de moins de \c crp (période de corrélation) forment une même
+ * rafale : seul le dernier compte. Un bloc dans sa période de corrélation
+ * n'est pas remplacé, sauf à défaut d'autre candidat.
+ *
+ * Pour garder un choix en temps constant, les blocs sont rangés par \b époque
+ * de \c hist2 (\c epoch accès) dans \c NEPOCHS listes circulaires ; un bloc
+ * dont \c hist2 est plus ancien que la plus ancienne époque y est rangé. Un
+ * masque des listes non vides donne la plus ancienne par une seule
+ * instruction. Dans une époque, les blocs sont dans l'ordre de leur
+ * classement : le choix est donc approché, à une époque près.
+ *
+ * Un bloc remplacé laisse son dernier accès dans un \b historique borné
+ * (\c HISTORY_FACTOR fois la taille du cache), indexé par (\c ifile,
+ * \c ibfile) : relu avant d'en sortir, il retrouve son rang. Au-delà, la plus
+ * ancienne entrée est écrasée.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "strategy.h"
+#include "low_cache.h"
+
+//! Nombre d'époques (bits du masque des listes non vides)
+#define NEPOCHS 64
+
+//! Les NEPOCHS époques couvrent EPOCHS_FACTOR fois le nombre de blocs en accès
+#define EPOCHS_FACTOR 16
+
+//! Période de corrélation, en fraction du nombre de blocs (1/CRP_DIVISOR)
+#define CRP_DIVISOR 16
+
+//! Taille de l'historique, en multiple du nombre de blocs
+#define HISTORY_FACTOR 2
+
+//! Entrée d'un bloc du cache (ou sentinelle d'une liste)
+struct LRU2_Entry
+{
+    int prev;           //!< Précédent dans sa liste
+    int next;           //!< Suivant dans sa liste
+    int ifile;          //!< Fichier du bloc
+    Cache_Index ibfile; //!< Indice du bloc dans le fichier
+    uint64_t last;      //!< Dernier accès (0 : bloc non classé)
+    uint64_t hist2;     //!< Dernier accès de la rafale précédente (0 : aucune)
+    int pending;        //!< Vrai si le bloc vient d'être choisi et n'a pas encore été accédé
+};
+
+//! Entrée de l'historique des blocs remplacés
+struct LRU2_History
+{
+    int ifile;          //!< Fichier du bloc (-1 : entrée reprise)
+    Cache_Index ibfile; //!< Indice du bloc dans le fichier
+    uint64_t last;      //!< Dernier accès au bloc
+    int hnext;          //!< Entrée suivante de la même classe, + 1 (0 : aucune)
+};
+
+/*!
+ * Données de la stratégie
+ *
+ * Rien n'est parcouru à la création : l'entrée d'un bloc est initialisée
+ * quand Get_Free_Block() le distribue pour la première fois (\c ninit), une
+ * entrée de l'historique quand le tampon circulaire l'atteint (\c nused), et
+ * la table de hachage, qui range les indices + 1, est prise à 0. Une
+ * invalidation ne parcourt rien non plus : elle change de génération, et une
+ * classe d'une génération passée est vide (elle est vidée à son premier
+ * usage).
+ */
+struct LRU2
+{
+    unsigned nblocks;   //!< Nombre de blocs du cache
+    struct LRU2_Entry *entries; //!< nblocks blocs, la liste des blocs d'un accès, puis NEPOCHS listes
+    unsigned ninit;     //!< Entrées de blocs initialisées (les premières)
+    int once;           //!< Sentinelle de la liste des blocs d'un seul accès
+    uint64_t mask;      //!< Listes d'époque non vides
+    uint64_t clock;     //!< Nombre d'accès
+    uint64_t epoch;     //!< Durée d'une époque
+    uint64_t cur;       //!< Époque courante
+    uint64_t crp;       //!< Période de corrélation
+    struct LRU2_History *history; //!< Historique (tampon circulaire)
+    unsigned nhistory;  //!< Taille de l'historique
+    unsigned nused;     //!< Entrées de l'historique déjà utilisées (les premières)
+    unsigned hnext;     //!< Prochaine entrée écrasée
+    int *hash;          //!< Première entrée de chaque classe, + 1 (0 : aucune)
+    unsigned *hgen;     //!< Génération de chaque classe
+    unsigned gen;       //!< Génération courante
+    unsigned hmask;     //!< Nombre de classes - 1 (puissance de 2)
+};
+
+#define LRU2(pcache) ((struct LRU2 *)(pcache)->pstrategy)
+
+//! Sentinelle de la liste de l'époque e
+#define EPOCH_LIST(pl, e) ((pl)->once + 1 + (int)((e) % NEPOCHS))
+
+/* ------------------------------------------------------------------------
+ * Listes
+ * ------------------------------------------------------------------------ */
+
+static void Unlink(struct LRU2 *pl, int i) {
+    struct LRU2_Entry *pe = &pl->entries[i];
+
+    pl->entries[pe->prev].next = pe->next;
+    pl->entries[pe->next].prev = pe->prev;
+    pe->prev = pe->next = i;
+}
+
+static void Link_Last(struct LRU2 *pl, int s, int i) {
+    struct LRU2_Entry *pe = &pl->entries[i];
+
+    pe->prev = pl->entries[s].prev;
+    pe->next = s;
+    pl->entries[pe->prev].next = i;
+    pl->entries[s].prev = i;
+}
+
+static void Link_First(struct LRU2 *pl, int s, int i) {
+    struct LRU2_Entry *pe = &pl->entries[i];
+
+    pe->prev = s;
+    pe->next = pl->entries[s].next;
+    pl->entries[pe->next].prev = i;
+    pl->entries[s].next = i;
+}
+
+static int Is_Empty(struct LRU2 *pl, int s) {
+    return pl->entries[s].next == s;
+}
+
+/* ------------------------------------------------------------------------
+ * Époques
+ * ------------------------------------------------------------------------ */
+
+//! Plus ancienne époque distinguée
+static uint64_t Oldest(struct LRU2 *pl) {
+    return pl->cur >= NEPOCHS - 1 ? pl->cur - (NEPOCHS - 1) : 0;
+}
+
+//! Rangement du bloc i d'après son hist2 (non nul)
+static void Rank(struct LRU2 *pl, int i) {
+    uint64_t e = pl->entries[i].hist2 / pl->epoch;
+    int s;
+
+    if (e < Oldest(pl)) {
+        s = EPOCH_LIST(pl, Oldest(pl));
+        Link_First(pl, s, i);
+    }
+    else {
+        s = EPOCH_LIST(pl, e);
+        Link_Last(pl, s, i);
+    }
+    pl->mask |= (uint64_t)1 << (s - pl->once - 1);
+}
+
+//! Retrait du bloc i de sa liste
+static void Detach(struct LRU2 *pl, int i) {
+    struct LRU2_Entry *pe = &pl->entries[i];
+    uint64_t e;
+    int s;
+
+    if (pe->prev == i)
+        return;
+    Unlink(pl, i);
+    if (pe->hist2 == 0)
+        return;
+    e = pe->hist2 / pl->epoch;
+    s = EPOCH_LIST(pl, e < Oldest(pl) ? Oldest(pl) : e);
+    if (Is_Empty(pl, s))
+        pl->mask &= ~((uint64_t)1 << (s - pl->once - 1));
+}
+
+//! Un accès de plus : à chaque nouvelle époque, la liste qui la recevra
+//! rejoint en tête celle de la nouvelle plus ancienne époque
+static void Tick(struct LRU2 *pl) {
+    int s, old, i;
+
+    if (++pl->clock / pl->epoch == pl->cur)
+        return;
+    pl->cur++;
+    s = EPOCH_LIST(pl, pl->cur);
+    if (Is_Empty(pl, s))
+        return;
+    old = EPOCH_LIST(pl, Oldest(pl));
+    while ((i = pl->entries[s].prev) != s) {
+        Unlink(pl, i);
+        Link_First(pl, old, i);
+    }
+    pl->mask &= ~((uint64_t)1 << (s - pl->once - 1));
+    pl->mask |= (uint64_t)1 << (old - pl->once - 1);
+}
+
+//! Premier bloc de la plus ancienne époque non vide (-1 : aucun)
+static int Oldest_Ranked(struct LRU2 *pl) {
+    unsigned r = Oldest(pl) % NEPOCHS;
+    uint64_t m;
+
+    if (pl->mask == 0)
+        return -1;
+    // Rotation : le bit de la plus ancienne époque devient le bit 0
+    m = r == 0 ? pl->mask : (pl->mask >> r) | (pl->mask << (NEPOCHS - r));
+    return pl->entries[pl->once + 1 + (int)((r + __builtin_ctzll(m)) % NEPOCHS)].next;
+}
+
+/* ------------------------------------------------------------------------
+ * Historique
+ * ------------------------------------------------------------------------ */
+
+static unsigned Hash(struct LRU2 *pl, int ifile, Cache_Index ibfile) {
+    return (((unsigned)ibfile ^ (unsigned)((uint64_t)ibfile >> 32)) * 2654435761u ^ (unsigned)ifile * 40503u) & pl->hmask;
+}
+
+//! Tête de la classe k, vidée si elle est d'une génération passée
+static int *Head(struct LRU2 *pl, unsigned k) {
+    if (pl->hgen[k] != pl->gen) {
+        pl->hgen[k] = pl->gen;
+        pl->hash[k] = 0;
+    }
+    return &pl->hash[k];
+}
+
+static void History_Unlink(struct LRU2 *pl, int h) {
+    struct LRU2_History *ph = &pl->history[h];
+    int *pi = Head(pl, Hash(pl, ph->ifile, ph->ibfile));
+
+    while (*pi != h + 1)
+        pi = &pl->history[*pi - 1].hnext;
+    *pi = ph->hnext;
+    ph->ifile = -1;
+}
+
+static void History_Add(struct LRU2 *pl, struct LRU2_Entry *pe) {
+    int h = pl->hnext;
+    struct LRU2_History *ph = &pl->history[h];
+    int *pk;
+
+    pl->hnext = (pl->hnext + 1) % pl->nhistory;
+    if ((unsigned)h >= pl->nused)
+        pl->nused = h + 1;
+    else if (ph->ifile >= 0)
+        History_Unlink(pl, h);
+    ph->ifile = pe->ifile;
+    ph->ibfile = pe->ibfile;
+    ph->last = pe->last;
+    pk = Head(pl, Hash(pl, ph->ifile, ph->ibfile));
+    ph->hnext = *pk;
+    *pk = h + 1;
+}
+
+//! Dernier accès au bloc (ifile, ibfile), retiré de l'historique (0 : inconnu)
+static uint64_t History_Take(struct LRU2 *pl, int ifile, Cache_Index ibfile) {
+    int h;
+
+    for (h = *Head(pl, Hash(pl, ifile, ibfile)) - 1; h >= 0; h = pl->history[h].hnext - 1) {
+        if (pl->history[h].ifile == ifile && pl->history[h].ibfile == ibfile) {
+            uint64_t last = pl->history[h].last;
+
+            History_Unlink(pl, h);
+            return last;
+        }
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Stratégie
+ * ------------------------------------------------------------------------ */
+
+//! Entrée i hors de toute liste, bloc non classé
+static void Init_Entry(struct LRU2 *pl, int i) {
+    pl->entries[i].prev = pl->entries[i].next = i;
+    pl->entries[i].last = pl->entries[i].hist2 = 0;
+    pl->entries[i].pending = 0;
+}
+
+//! Listes vides ; l'historique est vide
+static void Init(struct LRU2 *pl) {
+    int s;
+
+    for (s = pl->once; s <= pl->once + NEPOCHS; s++)
+        Init_Entry(pl, s);
+    pl->ninit = 0;
+    pl->nused = 0;
+    pl->hnext = 0;
+    pl->mask = 0;
+    pl->clock = 0;
+    pl->cur = 0;
+}
+
+//! Historique oublié par changement de génération (vidé pour de bon au retour à 0)
+static void Reset(struct LRU2 *pl) {
+    if (++pl->gen == 0)
+        memset(pl->hash, 0, (pl->hmask + 1) * sizeof(int));
+    Init(pl);
+}
+
+void *Strategy_Create(struct Cache *pcache)
+{
+    struct LRU2 *pl = malloc(sizeof(struct LRU2));
+
+    pl->nblocks = pcache->nblocks;
+    pl->entries = malloc((pl->nblocks + 1 + NEPOCHS) * sizeof(struct LRU2_Entry));
+    pl->once = pl->nblocks;
+    pl->epoch = EPOCHS_FACTOR * pl->nblocks / NEPOCHS;
+    if (pl->epoch == 0)
+        pl->epoch = 1;
+    pl->crp = pl->nblocks / CRP_DIVISOR;
+    pl->nhistory = HISTORY_FACTOR * pl->nblocks;
+    for (pl->hmask = 1; pl->hmask < pl->nhistory; pl->hmask <<= 1)
+        ;
+    pl->hmask--;
+    pl->history = malloc(pl->nhistory * sizeof(struct LRU2_History));
+    pl->hash = calloc(pl->hmask + 1, sizeof(int));
+    pl->hgen = calloc(pl->hmask + 1, sizeof(unsigned));
+    pl->gen = 0;
+    Init(pl);
+
+    return pl;
+}
+
+void Strategy_Close(struct Cache *pcache)
+{
+    struct LRU2 *pl = LRU2(pcache);
+
+    free(pl->entries);
+    free(pl->history);
+    free(pl->hash);
+    free(pl->hgen);
+    free(pl);
+}
+
+void Strategy_Invalidate(struct Cache *pcache)
+{
+    Reset(LRU2(pcache));
+}
+
+//! Vrai si le bloc i est hors de sa période de corrélation
+static int Eligible(struct LRU2 *pl, int i) {
+    return pl->clock - pl->entries[i].last > pl->crp;
+}
+
+/*!
+ * Un bloc libre s'il y en a, sinon le moins récent des blocs d'un seul
+ * accès, sinon le premier de la plus ancienne époque. Le bloc choisi est mis
+ * au bout de la liste des blocs d'un accès jusqu'à son premier accès.
+ */
+struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache)
+{
+    struct LRU2 *pl = LRU2(pcache);
+    struct Cache_Block_Header *pbh = Get_Free_Block(pcache);
+    struct LRU2_Entry *pe;
+    int i, once, ranked;
+
+    if (pbh != NULL) {
+        // Un bloc jamais distribué depuis la création ou l'invalidation
+        // (Adapt_Switch() les redistribue dans le désordre)
+        i = pbh->ibcache;
+        for (; pl->ninit <= (unsigned)i; pl->ninit++)
+            Init_Entry(pl, pl->ninit);
+    }
+    else {
+        once = Is_Empty(pl, pl->once) ? -1 : pl->entries[pl->once].next;
+        ranked = Oldest_Ranked(pl);
+        if (once >= 0 && (Eligible(pl, once) || ranked < 0 || !Eligible(pl, ranked)))
+            i = once;
+        else
+            i = ranked;
+        assert(i >= 0);
+        pbh = &pcache->headers[i];
+    }
+
+    // Un bloc remplacé (pas un bloc libéré) laisse une trace
+    pe = &pl->entries[i];
+    Detach(pl, i);
+    if (BLOCK_VALID(pcache, pbh) && pe->last != 0 && !pe->pending)
+        History_Add(pl, pe);
+
+    pe->last = pl->clock;
+    pe->hist2 = 0;
+    pe->pending = 1;
+    Link_Last(pl, pl->once, i);
+
+    return pbh;
+}
+
+static void Access(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    struct LRU2 *pl = LRU2(pcache);
+    int i = pbh->ibcache;
+    struct LRU2_Entry *pe = &pl->entries[i];
+    uint64_t prev;
+
+    Tick(pl);
+
+    // Premier accès depuis le chargement (ou bloc remplacé à l'insu de la stratégie)
+    if (pe->pending || pe->last == 0 || pe->ifile != pbh->ifile || pe->ibfile != pbh->ibfile) {
+        Detach(pl, i);
+        pe->pending = 0;
+        pe->ifile = pbh->ifile;
+        pe->ibfile = pbh->ibfile;
+        prev = History_Take(pl, pe->ifile, pe->ibfile);
+        pe->last = pl->clock;
+        if ((pe->hist2 = prev) != 0)
+            Rank(pl, i);
+        else
+            Link_Last(pl, pl->once, i);
+        return;
+    }
+
+    // Accès corrélé : seul le dernier accès de la rafale compte
+    if (pl->clock - pe->last <= pl->crp) {
+        pe->last = pl->clock;
+        if (pe->hist2 == 0) {
+            Unlink(pl, i);
+            Link_Last(pl, pl->once, i);
+        }
+        return;
+    }
+
+    Detach(pl, i);
+    pe->hist2 = pe->last;
+    pe->last = pl->clock;
+    Rank(pl, i);
+}
+
+void Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    Access(pcache, pbh);
+}
+
+void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    Access(pcache, pbh);
+}
+
+/* Ordre de remplacement : blocs d'un seul accès, puis époques de la plus ancienne à la plus récente */
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order)
+{
+    struct LRU2 *pl = LRU2(pcache);
+    uint64_t e;
+    int i, s, n = 0;
+
+    for (i = pl->entries[pl->once].next; i != pl->once; i = pl->entries[i].next)
+        order[n++] = &pcache->headers[i];
+    for (e = Oldest(pl); e <= pl->cur; e++) {
+        s = EPOCH_LIST(pl, e);
+        for (i = pl->entries[s].next; i != s; i = pl->entries[i].next)
+            order[n++] = &pcache->headers[i];
+    }
+    return n;
+}
+
+char *Strategy_Name()
+{
+    return "LRU2";
+}
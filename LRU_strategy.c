@@ -6,36 +6,35 @@
 #include "time.h"
 #include "cache_list.h"
 
-#define C_LIST(cpointer) ( (struct Cache_List *)((cpointer)->pstrategy) )
+/* Une cellule par bloc : chaque accès déplace le bloc en temps constant */
+#define C_LIST(cpointer) ( (struct Cache_Block_List *)((cpointer)->pstrategy) )
 
 
 void *Strategy_Create(struct Cache *pcache) 
 {
-	return Cache_List_Create();
+	return Cache_Block_List_Create(pcache->nblocks);
 }
 
 void Strategy_Close(struct Cache *pcache)
 {
-	Cache_List_Delete(C_LIST(pcache));
+	Cache_Block_List_Delete(C_LIST(pcache));
 }
 
 
 void Strategy_Invalidate(struct Cache *pcache)
 {
-	Cache_List_Clear(C_LIST(pcache));
+	Cache_Block_List_Clear(C_LIST(pcache));
 }
 
 
 struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache) 
 {
-    struct Cache_List *list = C_LIST(pcache);
+    struct Cache_Block_List *list = C_LIST(pcache);
     struct Cache_Block_Header *buffer = Get_Free_Block(pcache);
-    if(buffer != NULL)
-    	Cache_List_Append(list, buffer);
-    else{
-    	buffer = Cache_List_Remove_First(list);
-    	Cache_List_Append(list, buffer);
-    	}
+    // Un bloc libéré par la fermeture d'un fichier est encore dans la liste
+    if(buffer == NULL)
+    	buffer = Cache_Block_List_First(list);
+    Cache_Block_List_Move_To_End(list, buffer);
     
     return buffer;
 }
@@ -44,14 +43,20 @@ struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache)
 
 void Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *pbh) 
 {
-	Cache_List_Move_To_End(C_LIST(pcache), pbh);
+	Cache_Block_List_Move_To_End(C_LIST(pcache), pbh);
 }  
 
 void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pbh)
 {
-	 Cache_List_Move_To_End(C_LIST(pcache), pbh);
+	 Cache_Block_List_Move_To_End(C_LIST(pcache), pbh);
 } 
 
+/* Ordre de la liste : du moins récemment utilisé au plus récent */
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order)
+{
+	return Cache_Block_List_To_Array(C_LIST(pcache), order);
+}
+
 char *Strategy_Name()
 {
     return "LRU";
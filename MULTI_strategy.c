@@ -0,0 +1,503 @@
+/*!
+ * \file MULTI_strategy.c
+ *
+ * \brief Choix de la stratégie de remplacement à l'exécution.
+ *
+ * Les autres stratégies sont compilées une seconde fois avec
+ * -DSTRATEGY_PREFIX=<NOM> (voir strategy.h et le Makefile) : leurs fonctions
+ * s'appellent alors NUR_Strategy_Create, LRU_Strategy_Read, etc. Les
+ * fonctions Strategy_* définies ici se contentent de relayer l'appel à la
+ * stratégie choisie pour chaque cache (champ \c strategy de struct Cache,
+ * fixé par Cache_Create_Opt()). Plusieurs caches d'un même programme peuvent
+ * ainsi utiliser des stratégies différentes.
+ *
+ * La méta-stratégie ADAPT délègue le remplacement à l'une des autres (la
+ * stratégie \b vive) et rejoue un échantillon des blocs, choisis par hachage
+ * de (fichier, indice-fichier), sur un cache fantôme par stratégie candidate
+ * (méta-données seulement, voir CACHE_BACKEND_NULL). Chaque fantôme a la
+ * capacité du cache réduite dans le rapport de l'échantillonnage : ses succès
+ * estiment ceux qu'aurait le cache avec cette stratégie. Tous les
+ * ADAPT_PERIOD accès échantillonnés, la candidate au meilleur taux de succès
+ * sur la période remplace la stratégie vive si elle la devance de
+ * ADAPT_MARGIN pendant ADAPT_CONFIRM périodes de suite : deux candidates
+ * proches ne se succèdent donc pas à chaque période. Les blocs du cache sont
+ * alors redonnés à la nouvelle stratégie dans l'ordre de remplacement de
+ * l'ancienne, comme dans Cache_Resize().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "strategy.h"
+#include "low_cache.h"
+
+//! Déclaration des fonctions renommées d'une stratégie
+#define DECLARE_STRATEGY(P) \
+    void *P##_Strategy_Create(struct Cache *pcache); \
+    void P##_Strategy_Close(struct Cache *pcache); \
+    void P##_Strategy_Invalidate(struct Cache *pcache); \
+    struct Cache_Block_Header *P##_Strategy_Replace_Block(struct Cache *pcache); \
+    void P##_Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *pb); \
+    void P##_Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pb); \
+    int P##_Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order); \
+    unsigned P##_Strategy_Get_Flags(struct Cache *pcache, struct Cache_Block_Header *pb) __attribute__((weak)); \
+    void P##_Strategy_Set_Flags(struct Cache *pcache, struct Cache_Block_Header *pb, unsigned flags) __attribute__((weak));
+
+//! Entrée de la table des stratégies
+#define STRATEGY_OPS(P) \
+    { #P, P##_Strategy_Create, P##_Strategy_Close, P##_Strategy_Invalidate, \
+      P##_Strategy_Replace_Block, P##_Strategy_Read, P##_Strategy_Write, \
+      P##_Strategy_Order, P##_Strategy_Get_Flags, P##_Strategy_Set_Flags, NULL }
+
+DECLARE_STRATEGY(NUR)
+DECLARE_STRATEGY(LRU)
+DECLARE_STRATEGY(FIFO)
+DECLARE_STRATEGY(RAND)
+DECLARE_STRATEGY(LIRS)
+DECLARE_STRATEGY(LFU)
+DECLARE_STRATEGY(LRU2)
+DECLARE_STRATEGY(AGING)
+DECLARE_STRATEGY(ADAPT)
+
+static int ADAPT_Strategy_Instrument(struct Cache *pcache, struct Cache_Policy_Instrument *ppi,
+                                     int maxpolicies);
+
+//! Les stratégies disponibles ; la première est celle par défaut.
+static const struct Strategy_Ops Strategies[] = {
+    STRATEGY_OPS(NUR),
+    STRATEGY_OPS(LRU),
+    STRATEGY_OPS(FIFO),
+    STRATEGY_OPS(RAND),
+    STRATEGY_OPS(LIRS),
+    STRATEGY_OPS(LFU),
+    STRATEGY_OPS(LRU2),
+    STRATEGY_OPS(AGING),
+    { "ADAPT", ADAPT_Strategy_Create, ADAPT_Strategy_Close, ADAPT_Strategy_Invalidate,
+      ADAPT_Strategy_Replace_Block, ADAPT_Strategy_Read, ADAPT_Strategy_Write,
+      ADAPT_Strategy_Order, ADAPT_Strategy_Get_Flags, ADAPT_Strategy_Set_Flags,
+      ADAPT_Strategy_Instrument },
+};
+#define NSTRATEGIES ((int)(sizeof(Strategies)/sizeof(Strategies[0])))
+
+#define OPS(pcache) ((pcache)->pops)
+
+/*!
+ * \ingroup strategy_interface
+ *
+ * \param name nom de la stratégie (NULL : la stratégie par défaut)
+ * \return sa table de fonctions ou NULL si elle n'existe pas
+ */
+const struct Strategy_Ops *Strategy_Find(const char *name)
+{
+    int i;
+
+    if (name == NULL) return &Strategies[0];
+    for (i = 0; i < NSTRATEGIES; i++)
+        if (strcmp(Strategies[i].name, name) == 0) return &Strategies[i];
+    return NULL;
+}
+
+/*!
+ * MULTI : on retrouve la stratégie demandée et on lui délègue la création.
+ */
+void *Strategy_Create(struct Cache *pcache)
+{
+    if ((OPS(pcache) = Strategy_Find(pcache->strategy)) == NULL)
+    {
+        fprintf(stderr, "Stratégie inconnue : %s\n", pcache->strategy);
+        assert(OPS(pcache) != NULL);
+    }
+    return OPS(pcache)->create(pcache);
+}
+
+void Strategy_Close(struct Cache *pcache)
+{
+    OPS(pcache)->close(pcache);
+}
+
+void Strategy_Invalidate(struct Cache *pcache)
+{
+    OPS(pcache)->invalidate(pcache);
+}
+
+struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache)
+{
+    return OPS(pcache)->replace_block(pcache);
+}
+
+void Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    OPS(pcache)->read(pcache, pbh);
+}
+
+void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    OPS(pcache)->write(pcache, pbh);
+}
+
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order)
+{
+    return OPS(pcache)->order(pcache, order);
+}
+
+unsigned Strategy_Get_Flags(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    return OPS(pcache)->get_flags != NULL ? OPS(pcache)->get_flags(pcache, pbh) : 0;
+}
+
+void Strategy_Set_Flags(struct Cache *pcache, struct Cache_Block_Header *pbh, unsigned flags)
+{
+    if (OPS(pcache)->set_flags != NULL)
+        OPS(pcache)->set_flags(pcache, pbh, flags);
+}
+
+char *Strategy_Name()
+{
+    return "MULTI";
+}
+
+/*
+ * Méta-stratégie ADAPT
+ * --------------------
+ */
+
+//! Échantillonnage : un bloc sur 2^ADAPT_SHIFT (au plus)
+#define ADAPT_SHIFT 5
+
+//! Taille minimale d'un fantôme (l'échantillonnage est moindre pour un petit cache)
+#define ADAPT_MIN_BLOCKS 64
+
+//! Nombre d'accès échantillonnés entre deux examens des fantômes
+#define ADAPT_PERIOD 2048
+
+//! Avance minimale du taux de succès d'une candidate sur la stratégie vive
+#define ADAPT_MARGIN 0.02
+
+//! Nombre de périodes consécutives où une candidate doit mener avant d'être choisie
+#define ADAPT_CONFIRM 2
+
+//! Une stratégie candidate et son cache fantôme
+struct Adapt_Shadow
+{
+    const struct Strategy_Ops *pops;
+    struct Cache *pshadow;
+    struct Cache_File **files;  //!< Fichiers du fantôme, par indice de fichier réel
+    Cache_Count acc, hits;      //!< Accès et succès du fantôme au début de la période
+    Cache_Count api_acc, api_hits; //!< Les mêmes au dernier Cache_Get_Policy_Instrument()
+    Cache_Count n_switches_to;  //!< Choix de la candidate depuis le dernier appel
+};
+
+//! Données de la méta-stratégie
+struct Adapt
+{
+    int live;                   //!< Candidate vive
+    void *live_data;            //!< Ses données (pstrategy de la stratégie vive)
+    struct Adapt_Shadow shadows[NSTRATEGIES];
+    int nshadows;
+    int nfiles;                 //!< Taille des tableaux files des fantômes
+    unsigned shift;             //!< Un bloc sur 2^shift est échantillonné
+    unsigned count;             //!< Accès échantillonnés depuis le dernier examen
+    int lead;                   //!< Candidate qui devance la vive (-1 : aucune)
+    int nlead;                  //!< Nombre de périodes consécutives où elle mène
+};
+
+#define ADAPT(pcache) ((struct Adapt *)(pcache)->pstrategy)
+
+//! Appel d'une fonction de la stratégie vive, qui retrouve ses données dans pstrategy
+#define LIVE_CALL(pcache, pa, call) \
+    ((pcache)->pstrategy = (pa)->live_data, (call), (pcache)->pstrategy = (pa))
+
+//! Nombre d'accès et de succès d'un fantôme (son instrumentation n'est jamais remise à 0)
+static Cache_Count Shadow_Access(struct Cache *pshadow)
+{
+    return pshadow->instrument.n_reads + pshadow->instrument.n_writes;
+}
+
+//! Le bloc (ifile, ibfile) fait-il partie de l'échantillon ?
+static int Sampled(struct Adapt *pa, int ifile, Cache_Index ibfile)
+{
+    unsigned h = (((unsigned)ibfile ^ (unsigned)((uint64_t)ibfile >> 32)) + (unsigned)ifile * 0x9E3779B9u) * 2654435761u;
+
+    return pa->shift == 0 || (h >> (32 - pa->shift)) == 0;
+}
+
+//! Fichier fantôme du fichier réel ifile pour la candidate c (ouvert au premier accès)
+static struct Cache_File *Shadow_File(struct Adapt *pa, int c, int ifile)
+{
+    if (ifile >= pa->nfiles)
+    {
+        int n = pa->nfiles, k;
+
+        while (ifile >= pa->nfiles) pa->nfiles = pa->nfiles ? 2 * pa->nfiles : 4;
+        for (k = 0; k < pa->nshadows; k++)
+        {
+            pa->shadows[k].files = realloc(pa->shadows[k].files, pa->nfiles * sizeof(struct Cache_File *));
+            memset(pa->shadows[k].files + n, 0, (pa->nfiles - n) * sizeof(struct Cache_File *));
+        }
+    }
+    if (pa->shadows[c].files[ifile] == NULL)
+        pa->shadows[c].files[ifile] = Cache_File_Open(pa->shadows[c].pshadow, "", 0, 0);
+    return pa->shadows[c].files[ifile];
+}
+
+//! Début d'une nouvelle période d'observation
+static void Adapt_Restart(struct Adapt *pa)
+{
+    int c;
+
+    for (c = 0; c < pa->nshadows; c++)
+    {
+        pa->shadows[c].acc = Shadow_Access(pa->shadows[c].pshadow);
+        pa->shadows[c].hits = pa->shadows[c].pshadow->instrument.n_hits;
+    }
+    pa->count = 0;
+}
+
+/*!
+ * Création des fantômes ; la stratégie vive est d'abord celle par défaut.
+ */
+void *ADAPT_Strategy_Create(struct Cache *pcache)
+{
+    struct Adapt *pa = calloc(1, sizeof(struct Adapt));
+    struct Cache_Options opts = {0};
+    unsigned nblocks;
+    int k;
+
+    pa->shift = ADAPT_SHIFT;
+    while (pa->shift > 0 && (pcache->nblocks >> pa->shift) < ADAPT_MIN_BLOCKS)
+        pa->shift--;
+    nblocks = pcache->nblocks >> pa->shift;
+
+    opts.backend = CACHE_BACKEND_NULL;
+    for (k = 0; k < NSTRATEGIES; k++)
+    {
+        struct Adapt_Shadow *ps = &pa->shadows[pa->nshadows];
+        unsigned nderef = pcache->nderef >> pa->shift;
+
+        if (Strategies[k].instrument != NULL) continue;
+        if (&Strategies[k] == Strategy_Find(NULL)) pa->live = pa->nshadows;
+        ps->pops = &Strategies[k];
+        opts.strategy = Strategies[k].name;
+        ps->pshadow = Cache_Pool_Create(nblocks > 0 ? nblocks : 1, 1, 1, nderef > 0 ? nderef : 1, &opts);
+        pa->nshadows++;
+    }
+    pa->lead = -1;
+    Adapt_Restart(pa);
+
+    pa->live_data = pa->shadows[pa->live].pops->create(pcache);
+    return pa;
+}
+
+void ADAPT_Strategy_Close(struct Cache *pcache)
+{
+    struct Adapt *pa = ADAPT(pcache);
+    int c;
+
+    LIVE_CALL(pcache, pa, pa->shadows[pa->live].pops->close(pcache));
+    for (c = 0; c < pa->nshadows; c++)
+    {
+        Cache_Close(pa->shadows[c].pshadow);
+        free(pa->shadows[c].files);
+    }
+    free(pa);
+}
+
+/*!
+ * Les fantômes sont vidés eux aussi ; la stratégie vive est conservée.
+ */
+void ADAPT_Strategy_Invalidate(struct Cache *pcache)
+{
+    struct Adapt *pa = ADAPT(pcache);
+    int c;
+
+    LIVE_CALL(pcache, pa, pa->shadows[pa->live].pops->invalidate(pcache));
+    for (c = 0; c < pa->nshadows; c++)
+        Cache_Invalidate(pa->shadows[c].pshadow);
+    pa->lead = -1;
+    Adapt_Restart(pa);
+}
+
+struct Cache_Block_Header *ADAPT_Strategy_Replace_Block(struct Cache *pcache)
+{
+    struct Adapt *pa = ADAPT(pcache);
+    struct Cache_Block_Header *pbh;
+
+    LIVE_CALL(pcache, pa, pbh = pa->shadows[pa->live].pops->replace_block(pcache));
+    return pbh;
+}
+
+/*!
+ * Passage à la candidate c : les blocs valides sont redonnés un à un à la
+ * nouvelle stratégie, dans l'ordre de remplacement de l'ancienne. Ils sont
+ * empilés dans \c freed (sans bloc jamais distribué, pour que
+ * Get_Free_Block() les rende dans cet ordre), et leurs flags remis à 0 le
+ * temps de l'opération.
+ */
+static void Adapt_Switch(struct Cache *pcache, struct Adapt *pa, int c)
+{
+    struct Cache_Block_Header **order = malloc(pcache->nblocks * sizeof(struct Cache_Block_Header *));
+    unsigned *flags = malloc(pcache->nblocks * sizeof(unsigned));
+    struct Cache_Block_Header *pfree = pcache->pfree;
+    struct Cache_Node *nodes = pcache->nodes;
+    unsigned nfreed = pcache->nfreed;
+    int n, nvalid, i;
+
+    LIVE_CALL(pcache, pa, n = pa->shadows[pa->live].pops->order(pcache, order));
+    LIVE_CALL(pcache, pa, pa->shadows[pa->live].pops->close(pcache));
+    for (i = nvalid = 0; i < n; i++)
+    {
+        if (BLOCK_VALID(pcache, order[i]))
+            order[nvalid++] = order[i];
+    }
+
+    pcache->pfree = NULL;
+    pcache->nodes = NULL;
+    for (i = nvalid - 1; i >= 0; i--)
+    {
+        flags[i] = order[i]->flags;
+        PUBLISH(order[i]->flags, 0);
+        pcache->freed[pcache->nfreed++] = order[i]->ibcache;
+    }
+
+    pa->live = c;
+    pa->live_data = pa->shadows[c].pops->create(pcache);
+    for (i = 0; i < nvalid; i++)
+    {
+        struct Cache_Block_Header *pbh;
+
+        LIVE_CALL(pcache, pa, pbh = pa->shadows[c].pops->replace_block(pcache));
+        assert(pbh == order[i]);
+        PUBLISH(pbh->flags, flags[i]);
+    }
+    assert(pcache->nfreed == nfreed);
+    pcache->pfree = pfree;
+    pcache->nodes = nodes;
+
+    pa->shadows[c].n_switches_to++;
+    pcache->instrument.n_switches++;
+    free(order);
+    free(flags);
+}
+
+//! Examen des fantômes à la fin d'une période
+static void Adapt_Review(struct Cache *pcache, struct Adapt *pa)
+{
+    double rate[NSTRATEGIES];
+    int c, best = pa->live;
+
+    for (c = 0; c < pa->nshadows; c++)
+    {
+        struct Cache *pshadow = pa->shadows[c].pshadow;
+        Cache_Count acc = Shadow_Access(pshadow) - pa->shadows[c].acc;
+
+        rate[c] = acc > 0 ? (double)(pshadow->instrument.n_hits - pa->shadows[c].hits) / acc : 0.0;
+        if (rate[c] > rate[best]) best = c;
+    }
+    Adapt_Restart(pa);
+
+    if (rate[best] < rate[pa->live] + ADAPT_MARGIN)
+    {
+        pa->lead = -1;
+        return;
+    }
+    if (best != pa->lead)
+    {
+        pa->lead = best;
+        pa->nlead = 0;
+    }
+    if (++pa->nlead >= ADAPT_CONFIRM)
+    {
+        pa->lead = -1;
+        Adapt_Switch(pcache, pa, best);
+    }
+}
+
+//! Rejeu d'un accès au bloc pbh sur les fantômes, s'il est échantillonné
+static void Adapt_Sample(struct Cache *pcache, struct Adapt *pa, struct Cache_Block_Header *pbh, int write)
+{
+    int c;
+
+    if (!Sampled(pa, pbh->ifile, pbh->ibfile)) return;
+    for (c = 0; c < pa->nshadows; c++)
+    {
+        struct Cache_File *pf = Shadow_File(pa, c, pbh->ifile);
+
+        if (write) Cache_File_Write(pf, pbh->ibfile, NULL);
+        else Cache_File_Read(pf, pbh->ibfile, NULL);
+    }
+    if (++pa->count >= ADAPT_PERIOD)
+        Adapt_Review(pcache, pa);
+}
+
+void ADAPT_Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    struct Adapt *pa = ADAPT(pcache);
+
+    LIVE_CALL(pcache, pa, pa->shadows[pa->live].pops->read(pcache, pbh));
+    Adapt_Sample(pcache, pa, pbh, 0);
+}
+
+void ADAPT_Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    struct Adapt *pa = ADAPT(pcache);
+
+    LIVE_CALL(pcache, pa, pa->shadows[pa->live].pops->write(pcache, pbh));
+    Adapt_Sample(pcache, pa, pbh, 1);
+}
+
+int ADAPT_Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order)
+{
+    struct Adapt *pa = ADAPT(pcache);
+    int n;
+
+    LIVE_CALL(pcache, pa, n = pa->shadows[pa->live].pops->order(pcache, order));
+    return n;
+}
+
+unsigned ADAPT_Strategy_Get_Flags(struct Cache *pcache, struct Cache_Block_Header *pbh)
+{
+    struct Adapt *pa = ADAPT(pcache);
+    const struct Strategy_Ops *pops = pa->shadows[pa->live].pops;
+    unsigned flags = 0;
+
+    if (pops->get_flags != NULL)
+        LIVE_CALL(pcache, pa, flags = pops->get_flags(pcache, pbh));
+    return flags;
+}
+
+void ADAPT_Strategy_Set_Flags(struct Cache *pcache, struct Cache_Block_Header *pbh, unsigned flags)
+{
+    struct Adapt *pa = ADAPT(pcache);
+    const struct Strategy_Ops *pops = pa->shadows[pa->live].pops;
+
+    if (pops->set_flags != NULL)
+        LIVE_CALL(pcache, pa, pops->set_flags(pcache, pbh, flags));
+}
+
+/*!
+ * Compteurs des fantômes depuis le dernier appel (voir Cache_Get_Policy_Instrument()).
+ */
+static int ADAPT_Strategy_Instrument(struct Cache *pcache, struct Cache_Policy_Instrument *ppi,
+                                     int maxpolicies)
+{
+    struct Adapt *pa = ADAPT(pcache);
+    int c;
+
+    for (c = 0; c < pa->nshadows && c < maxpolicies; c++)
+    {
+        struct Adapt_Shadow *ps = &pa->shadows[c];
+        Cache_Count acc = Shadow_Access(ps->pshadow), hits = ps->pshadow->instrument.n_hits;
+
+        ppi[c].name = ps->pops->name;
+        ppi[c].n_access = acc - ps->api_acc;
+        ppi[c].n_hits = hits - ps->api_hits;
+        ppi[c].n_switches_to = ps->n_switches_to;
+        ppi[c].live = c == pa->live;
+        ps->api_acc = acc;
+        ps->api_hits = hits;
+        ps->n_switches_to = 0;
+    }
+    return pa->nshadows;
+}
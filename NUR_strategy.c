@@ -2,6 +2,7 @@
 
 #include "strategy.h"
 #include "low_cache.h"
+#include "flagscan.h"
 #include "random.h"
 #include "time.h"
 
@@ -16,13 +17,17 @@
 #define NDEREF 150
 
 static void reset_flag_R(struct Cache *pcache);
-static int EQUATION(struct Cache_Block_Header *block);
 
-/* Structure utilisée pour la stratégie NUR */
+/* Structure utilisée pour la stratégie NUR.
+ * Les bits R ne sont pas dans les flags des blocs mais dans un tableau d'un
+ * octet par bloc (R_FLAG ou 0) : avec fstate, qui a les bits M, les
+ * balayages de flagscan.h traitent 16 ou 32 blocs par instruction.
+ */
 struct Strategie_NUR
 {
 	unsigned nderef; 					/* période avant remiser des R à 0 */
 	unsigned compteur_dereferencement;	/* compteur pour le déréférencement */
+	unsigned char *ref;					/* bit R de chaque bloc, par ibcache */
 };
 
 /* Permet de récupérer la valeur de pstrategy
@@ -61,14 +66,16 @@ struct Strategie_NUR* STRATEGIE_NUR(struct Cache* pointeur_cache) {
 ***********************************************************/
 
 /* Pour initialiser la stratégie, on va allouer un espace mémoire pour la
- * structure, en initialisant nderef et le compteur_dereferencement à la 
- * valeur de nderef de la structure du Cache dans low_cache.c
+ * structure, en initialisant nderef à la valeur de nderef de la structure du
+ * Cache dans low_cache.c, et le compteur_dereferencement à 0 (une stratégie
+ * recréée par Cache_Resize() doit déréférencer tout de suite normalement)
  */
 void *Strategy_Create(struct Cache *pcache) {
 	struct Strategie_NUR *pointeur_struct = malloc(sizeof(struct Strategie_NUR));
 
     pointeur_struct->nderef = pcache->nderef;
-    pointeur_struct->compteur_dereferencement = pcache->nderef;
+    pointeur_struct->compteur_dereferencement = 0;
+    pointeur_struct->ref = calloc(pcache->nblocks, 1);
 
     return pointeur_struct;	
 }
@@ -77,50 +84,41 @@ void *Strategy_Create(struct Cache *pcache) {
 void Strategy_Close(struct Cache *pcache) {
     // On vide le pointeur sur la stratégie afin qu'il puisse
     // en excuter une autre quand il veut.
+	free(STRATEGIE_NUR(pcache)->ref);
 	free(pcache->pstrategy);
 }
 
-/* Remise à zéro de tout les bits de référence R */
+/* Oubli des bits de référence R, sans les parcourir */
 void Strategy_Invalidate(struct Cache *pcache) {
-    // Réinitialisation des R_FLAG et des compteur de chaque blocs
-    reset_flag_R(pcache);
+    // Les bits R ne sont pas parcourus : Replace_Block les remet à 0 bloc par
+    // bloc à leur distribution, et la recherche de Flag_Scan_Min n'a lieu
+    // qu'une fois tous les blocs redistribués. On repart d'une période entière
+    STRATEGIE_NUR(pcache)->compteur_dereferencement = 0;
 }
 
 /* Permet de remplacer un bloc déjà utilisé */
 struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache) {
 
-    int index_block;
-    int equation_max = 4;
-    struct Cache_Block_Header *cbh_final = NULL;
+    struct Strategie_NUR *strategy = STRATEGIE_NUR(pcache);
     struct Cache_Block_Header *cbh;
 
    /* On cherche d'abord un bloc libre, si on a NULL : 
     * ça veut dire qu'on a un bloc de libre 
     */
-    if ((cbh = Get_Free_Block(pcache)) != NULL) return cbh;
-
-    /* Si on a pas trouvé de bloc libre, on va parcourir tout les blocs,
-     * en partant de l'indice 0, jusqu'au nombre max de blocks dans le cache.
-     */
-    for (index_block = 0; index_block < pcache->nblocks; index_block++) {
-		cbh = &pcache->headers[index_block];
-	
-		/* On va faire l'équation 2*r + m afin de trouver le meilleur
-         * block à remplacer 
+    if ((cbh = Get_Free_Block(pcache)) == NULL) {
+        /* Si on a pas trouvé de bloc libre, on cherche le premier bloc qui a
+         * l'équation 2*r + m la plus petite (la recherche s'arrête au premier
+         * bloc non modifié et non référencé). Les bits R (0x4) et M (0x2)
+         * étant dans cet ordre, (R | M) est rangé comme 2*r + m.
          */
-		int equation = EQUATION(cbh);
-        
-        // Si on trouve un block non modifié et jamais utilisé, alors on prend celui là
-        if (equation == 0) return cbh;
-
-        // Sinon, on va chercher le bloc qui a l'équation rm la plus petite
-		else if (equation < equation_max) {
-	       equation_max = equation;
-	       cbh_final = cbh;
-		}	
+        int index_block = Flag_Scan_Min(strategy->ref, pcache->fstate, pcache->nblocks, R_FLAG | MODIF);
+
+        cbh = &pcache->headers[index_block];
     }
 
-    return cbh_final;
+    // Le bloc remplacé n'est pas encore référencé
+    strategy->ref[cbh->ibcache] = 0;
+    return cbh;
 }
 
 /* Méthode qui est utilisée si on veut lire */
@@ -132,7 +130,7 @@ void Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *cbh) {
     if((++strategy->compteur_dereferencement) == strategy->nderef)
         reset_flag_R(pcache);
     // On met le flag REFER à 1 (car accès en lecture)
-    cbh->flags |= R_FLAG;
+    strategy->ref[cbh->ibcache] = R_FLAG;
 }  
 
 /* Méthode qui est utilisée si on veut écrire */
@@ -144,9 +142,34 @@ void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *cbh) {
     if((++strategy->compteur_dereferencement) == strategy->nderef)
         reset_flag_R(pcache);
     // On met le flag REFER à 1 (car accès en écriture)
-    cbh->flags |= R_FLAG;
+    strategy->ref[cbh->ibcache] = R_FLAG;
 } 
 
+/* Ordre de remplacement : les blocs non référencés d'abord, puis les autres.
+ */
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order) {
+    struct Strategie_NUR *strategy = STRATEGIE_NUR(pcache);
+    int index_block, n = 0;
+    int r;
+
+    for (r = 0; r <= R_FLAG; r += R_FLAG)
+        for (index_block = 0; index_block < pcache->nblocks; index_block++) {
+            struct Cache_Block_Header *cbh = &pcache->headers[index_block];
+
+            if (BLOCK_VALID(pcache, cbh) && strategy->ref[index_block] == r) order[n++] = cbh;
+        }
+    return n;
+}
+
+/* Le bit R d'un bloc, pour les instantanés */
+unsigned Strategy_Get_Flags(struct Cache *pcache, struct Cache_Block_Header *cbh) {
+    return STRATEGIE_NUR(pcache)->ref[cbh->ibcache];
+}
+
+void Strategy_Set_Flags(struct Cache *pcache, struct Cache_Block_Header *cbh, unsigned flags) {
+    STRATEGIE_NUR(pcache)->ref[cbh->ibcache] = flags & R_FLAG;
+}
+
 /* Le nom de la stratégie */
 char *Strategy_Name() {
     return "NUR";
@@ -166,22 +189,11 @@ static void reset_flag_R(struct Cache *pcache){
 
     // Si on peut déréférencer
     if(strat->nderef != 0){
-        // On va parcourir tout les blocks du cache et remettre le R_FLAG à 0
-        for (int i = 0 ; i < pcache->nblocks ; i++)
-            pcache->headers[i].flags &= ~R_FLAG;
+        // On remet tout les bits R à 0 (balayage vectorisé, voir flagscan.h)
+        Flag_Scan_Clear(strat->ref, pcache->nblocks, R_FLAG);
         // On remet à 0 le compteur de déréférencement
         strat->compteur_dereferencement = 0;
         // Vu qu'on a déréférencé, on va incrémenter le n_deref de instrument pour les statistiques
             pcache->instrument.n_deref++;
     }
 }
-
-/* Fait l'équation n = 2*r + m. */
-static int EQUATION(struct Cache_Block_Header *block) {
-    int rm_equation = 0;
-
-    if ( (block->flags & R_FLAG) > 0 ) rm_equation += 2;
-    if ( (block->flags & MODIF) > 0 ) rm_equation += 1;
-    
-    return rm_equation;
-}
\ No newline at end of file
@@ -0,0 +1,8 @@
+set style data linespoints
+set xlabel "taille fichier / taille cache"
+set ylabel "Hit rate (%)" font "Helvetica-Oblique"
+set label "LIRS : taille du cache voisine de la fenêtre (test 4)" font "Helvetica-Bold,18" at 80,70 
+set encoding utf8
+set terminal postscript eps color
+set output "t4-lirs.eps"
+plot "t4-lirs" using 1:2 t "NUR", "t4-lirs" using 1:3 t "LRU", "t4-lirs" using 1:4 t "LIRS"
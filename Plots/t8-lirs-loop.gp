@@ -0,0 +1,8 @@
+set style data linespoints
+set xlabel "taille fichier / taille cache"
+set ylabel "Hit rate (%)" font "Helvetica-Oblique"
+set label "LIRS : boucle voisine de la taille du cache (test 8)" font "Helvetica-Bold,18" at 80,50 
+set encoding utf8
+set terminal postscript eps color
+set output "t8-lirs-loop.eps"
+plot "t8-lirs-loop" using 1:2 t "NUR", "t8-lirs-loop" using 1:3 t "LRU", "t8-lirs-loop" using 1:4 t "LIRS"
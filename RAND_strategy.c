@@ -12,27 +12,32 @@
 
 #include "strategy.h"
 #include "low_cache.h"
-#include "random.h"
+#include "rng.h"
 #include "time.h"
 
+#define RNG(pcache) ((struct Rng *)((pcache)->pstrategy))
+
 /*!
- * RAND : pas grand chose à faire ici. 
+ * RAND : chaque cache a son propre générateur aléatoire.
  *
- * En fait, nous initialisons le germe
- * (seed) du générateur aléatoire à quelque chose d'éminemment variable, pour
- * éviter d'avoir la même séquence à chque exécution...
+ * Il est initialisé à partir du germe global (voir Rng_Set_Seed()) : une
+ * simulation est reproductible, et des caches manipulés par des threads
+ * différents ne partagent aucun état.
  */
 void *Strategy_Create(struct Cache *pcache) 
 {
-    // srand((unsigned int)time(NULL));
-    return NULL;
+    struct Rng *prng = malloc(sizeof(struct Rng));
+
+    Rng_Seed(prng, Rng_Get_Seed() ^ 0x52414E44ULL);
+    return prng;
 }
 
 /*!
- * RAND : Rien à faire ici.
+ * RAND : libération du générateur.
  */
 void Strategy_Close(struct Cache *pcache)
 {
+    free(pcache->pstrategy);
 }
 
 /*!
@@ -54,7 +59,7 @@ struct Cache_Block_Header *Strategy_Replace_Block(struct Cache *pcache)
     if ((pbh = Get_Free_Block(pcache)) != NULL) return pbh;
 
     /* Sinon on tire un numéro de bloc au hasard */
-    ib = RANDOM(0, pcache->nblocks);
+    ib = Rng_Below(RNG(pcache), pcache->nblocks);
     return &pcache->headers[ib];
 }
 
@@ -73,6 +78,18 @@ void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pbh)
 {
 } 
 
+/*!
+ * RAND : pas d'ordre, les blocs valides dans l'ordre du cache.
+ */
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order)
+{
+    int ib, n = 0;
+
+    for (ib = 0; ib < pcache->nblocks; ib++)
+        if (BLOCK_VALID(pcache, &pcache->headers[ib])) order[n++] = &pcache->headers[ib];
+    return n;
+}
+
 char *Strategy_Name()
 {
     return "RAND";
@@ -0,0 +1,174 @@
+/*!
+ * \file advisor.c
+ *
+ * \brief Conseil sur la taille des blocs du cache (voir advisor.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "advisor.h"
+#include "low_cache.h"
+
+//! Écart maximal (en puissances de 2) entre les classes et la taille initiale
+#define ADVISOR_SPAN ((CACHE_ADVICE_CLASSES - 1) / 2)
+
+struct Advisor
+{
+    int nclasses;
+    size_t recordsz;
+    unsigned nrecords[CACHE_ADVICE_CLASSES];    /* enregistrements par bloc de chaque classe */
+    struct Cache *shadow[CACHE_ADVICE_CLASSES]; /* cache fantôme de chaque classe */
+    struct Cache_File **files[CACHE_ADVICE_CLASSES]; /* ses fichiers, par indice de fichier réel */
+    int nfiles;                                 /* taille des tableaux files[] */
+    Cache_Count base[CACHE_ADVICE_CLASSES];     /* défauts au dernier Advisor_Get(pa, padv, 0) */
+    Cache_Count wbase[CACHE_ADVICE_CLASSES];    /* défauts au dernier Advisor_Get(pa, padv, 1) */
+};
+
+/* Nombre total de défauts d'un cache fantôme (son instrumentation n'est jamais remise à 0) */
+static Cache_Count Shadow_Misses(struct Cache *pshadow)
+{
+    struct Cache_Instrument *pi = &pshadow->instrument;
+
+    return pi->n_reads + pi->n_writes - pi->n_hits;
+}
+
+/* Nombre de blocs d'un cache de bytes octets et de nrecords enregistrements par bloc */
+static unsigned Shadow_Blocks(size_t bytes, unsigned nrecords, size_t recordsz)
+{
+    size_t nblocks = bytes / (nrecords * recordsz);
+
+    return nblocks > 0 ? nblocks : 1;
+}
+
+/*!
+ * \ingroup advisor_interface
+ *
+ * Les classes vont de pcache->nrecords / 2^ADVISOR_SPAN à
+ * pcache->nrecords * 2^ADVISOR_SPAN.
+ */
+struct Advisor *Advisor_Create(struct Cache *pcache)
+{
+    struct Advisor *pa = calloc(1, sizeof(struct Advisor));
+    struct Cache_Options opts = {0};
+    size_t bytes = pcache->nblocks * pcache->blocksz;
+    int j;
+
+    opts.backend = CACHE_BACKEND_NULL;
+    opts.strategy = pcache->strategy;
+    pa->recordsz = pcache->recordsz;
+
+    for (j = -ADVISOR_SPAN; j <= ADVISOR_SPAN; j++)
+    {
+        unsigned nrecords = j < 0 ? pcache->nrecords >> -j : pcache->nrecords << j;
+        int c = pa->nclasses;
+
+        if (nrecords == 0 || (c > 0 && pa->nrecords[c - 1] == nrecords)) continue;
+        pa->nrecords[c] = nrecords;
+        pa->shadow[c] = Cache_Pool_Create(Shadow_Blocks(bytes, nrecords, pa->recordsz), nrecords,
+                                          pa->recordsz, pcache->nderef, &opts);
+        pa->nclasses++;
+    }
+    return pa;
+}
+
+/*!
+ * \ingroup advisor_interface
+ */
+void Advisor_Delete(struct Advisor *pa)
+{
+    int c;
+
+    for (c = 0; c < pa->nclasses; c++)
+    {
+        Cache_Close(pa->shadow[c]);
+        free(pa->files[c]);
+    }
+    free(pa);
+}
+
+/* Fichier fantôme du fichier réel ifile dans la classe c (ouvert au premier accès) */
+static struct Cache_File *Shadow_File(struct Advisor *pa, int c, int ifile)
+{
+    if (ifile >= pa->nfiles)
+    {
+        int n = pa->nfiles, k;
+
+        while (ifile >= pa->nfiles) pa->nfiles = pa->nfiles ? 2 * pa->nfiles : 4;
+        for (k = 0; k < pa->nclasses; k++)
+        {
+            pa->files[k] = realloc(pa->files[k], pa->nfiles * sizeof(struct Cache_File *));
+            memset(pa->files[k] + n, 0, (pa->nfiles - n) * sizeof(struct Cache_File *));
+        }
+    }
+    if (pa->files[c][ifile] == NULL)
+        pa->files[c][ifile] = Cache_File_Open(pa->shadow[c], "", 0, 0);
+    return pa->files[c][ifile];
+}
+
+/*!
+ * \ingroup advisor_interface
+ */
+void Advisor_Access(struct Advisor *pa, int ifile, Cache_Index irfile, int write)
+{
+    int c;
+
+    for (c = 0; c < pa->nclasses; c++)
+    {
+        struct Cache_File *pf = Shadow_File(pa, c, ifile);
+
+        if (write) Cache_File_Write(pf, irfile, NULL);
+        else Cache_File_Read(pf, irfile, NULL);
+    }
+}
+
+/*!
+ * \ingroup advisor_interface
+ */
+void Advisor_Close_File(struct Advisor *pa, int ifile)
+{
+    int c;
+
+    if (ifile >= pa->nfiles) return;
+    for (c = 0; c < pa->nclasses; c++)
+    {
+        if (pa->files[c][ifile] != NULL) Cache_File_Close(pa->files[c][ifile]);
+        pa->files[c][ifile] = NULL;
+    }
+}
+
+/*!
+ * \ingroup advisor_interface
+ */
+void Advisor_Resize(struct Advisor *pa, size_t bytes)
+{
+    int c;
+
+    for (c = 0; c < pa->nclasses; c++)
+        Cache_Resize(pa->shadow[c], Shadow_Blocks(bytes, pa->nrecords[c], pa->recordsz));
+}
+
+/*!
+ * \ingroup advisor_interface
+ *
+ * Le champ \c current de \a padv n'est pas rempli.
+ */
+void Advisor_Get(struct Advisor *pa, struct Cache_Advice *padv, int window)
+{
+    Cache_Count *base = window ? pa->wbase : pa->base;
+    int c, best = 0;
+
+    padv->nclasses = pa->nclasses;
+    for (c = 0; c < pa->nclasses; c++)
+    {
+        Cache_Count misses = Shadow_Misses(pa->shadow[c]);
+
+        padv->nrecords[c] = pa->nrecords[c];
+        padv->nblocks[c] = pa->shadow[c]->nblocks;
+        padv->n_misses[c] = misses - base[c];
+        padv->cost[c] = padv->n_misses[c] * (ADVISOR_IO_NS + pa->nrecords[c] * pa->recordsz * ADVISOR_BYTE_NS);
+        base[c] = misses;
+        if (padv->cost[c] < padv->cost[best]) best = c;
+    }
+    padv->best = pa->nrecords[best];
+}
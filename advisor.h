@@ -0,0 +1,73 @@
+#ifndef _ADVISOR_H_
+#define _ADVISOR_H_
+
+/*!
+ * \file advisor.h
+ *
+ * \brief Conseil sur la taille des blocs du cache.
+ *
+ * Le conseiller rejoue chaque accès au cache sur des caches "fantômes" (sans
+ * données, voir CACHE_BACKEND_NULL), un par classe de taille de bloc : le
+ * nombre d'enregistrements par bloc du cache multiplié ou divisé par 2, 4...
+ * Chaque fantôme a la même capacité en octets et la même stratégie que le
+ * cache réel. Le coût d'une classe est estimé par ses défauts :
+ *
+ *     défauts x (ADVISOR_IO_NS + taille de bloc x ADVISOR_BYTE_NS)
+ *
+ * ce qui favorise les grands blocs pour les accès séquentiels (moins de
+ * défauts) et les petits pour les accès dispersés (moins d'octets lus pour
+ * rien).
+ *
+ * En mode automatique (CACHE_ADVISOR_AUTO), le conseil est examiné tous les
+ * ADVISOR_PERIOD accès ; le cache change de taille de bloc, par
+ * Cache_Set_Records(), si la classe conseillée coûte moins de ADVISOR_GAIN
+ * fois la classe actuelle sur cette période.
+ */
+
+#include "cache.h"
+
+/*!
+ * \defgroup advisor_interface Conseil sur la taille des blocs
+ *
+ * \ingroup low_cache_interface
+ *
+ * @{
+ */
+
+//! Coût fixe estimé d'une entrée-sortie (ns)
+#define ADVISOR_IO_NS 100000.0
+
+//! Coût estimé du transfert d'un octet (ns)
+#define ADVISOR_BYTE_NS 2.0
+
+//! Nombre d'accès entre deux examens du conseil (mode automatique)
+#define ADVISOR_PERIOD 65536
+
+//! Rapport de coût en deçà duquel le mode automatique change de taille de bloc
+#define ADVISOR_GAIN 0.8
+
+struct Advisor;
+
+//! Création du conseiller du cache \a pcache.
+struct Advisor *Advisor_Create(struct Cache *pcache);
+
+//! Destruction du conseiller.
+void Advisor_Delete(struct Advisor *pa);
+
+//! Rejeu d'un accès à l'enregistrement \a irfile du fichier \a ifile.
+void Advisor_Access(struct Advisor *pa, int ifile, Cache_Index irfile, int write);
+
+//! Oubli des blocs du fichier \a ifile (fermé).
+void Advisor_Close_File(struct Advisor *pa, int ifile);
+
+//! Nouvelle capacité (en octets) du cache réel.
+void Advisor_Resize(struct Advisor *pa, size_t bytes);
+
+//! Conseil depuis le dernier appel (\a window faux) ou depuis la dernière fenêtre (vrai).
+void Advisor_Get(struct Advisor *pa, struct Cache_Advice *padv, int window);
+
+/*
+ * @}
+ */
+
+#endif /* _ADVISOR_H_ */
@@ -0,0 +1,522 @@
+/*!
+ * \file backend.c
+ *
+ * \brief Réalisations du stockage sous-jacent du cache : fichier, projection,
+ * mémoire et nul.
+ */
+
+// Pour madvise() : posix_madvise(POSIX_MADV_DONTNEED) ne fait rien sous Linux
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "backend.h"
+
+/* ------------------------------------------------------------------------------------
+ * Stockage fichier
+ * ------------------------------------------------------------------------------------
+ */
+
+struct File_Backend
+{
+    FILE *fp;       /* Flux du fichier (seul son descripteur sert aux entrées-sorties) */
+    off_t size;     /* Taille courante du fichier */
+};
+
+#define FILE_BE(pbe) ((struct File_Backend *)(pbe)->priv)
+
+// pread() et pwrite() n'ont pas de position courante ni de tampon : une
+// lecture peut se faire pendant une écriture d'un autre thread
+static Cache_Error File_Read(struct Cache_Backend *pbe, off_t addr, void *buf, size_t sz)
+{
+    struct File_Backend *pf = FILE_BE(pbe);
+    off_t size = __atomic_load_n(&pf->size, __ATOMIC_ACQUIRE);
+    size_t n = 0;
+
+    // La taille est mémorisée : plus besoin d'aller en fin de fichier à chaque lecture
+    if (addr < size)
+    {
+        size_t want = (size - addr < (off_t)sz) ? (size_t)(size - addr) : sz;
+
+        while (n < want)
+        {
+            ssize_t r = pread(fileno(pf->fp), (char *)buf + n, want - n, addr + n);
+
+            if (r <= 0) return CACHE_KO;
+            n += r;
+        }
+    }
+
+    // Ce qui est au-delà de la fin du fichier est lu comme des zéros
+    memset((char *)buf + n, '\0', sz - n);
+    return CACHE_OK;
+}
+
+static Cache_Error File_Write(struct Cache_Backend *pbe, off_t addr, const void *buf, size_t sz)
+{
+    struct File_Backend *pf = FILE_BE(pbe);
+    size_t n = 0;
+
+    while (n < sz)
+    {
+        ssize_t w = pwrite(fileno(pf->fp), (const char *)buf + n, sz - n, addr + n);
+
+        if (w <= 0) return CACHE_KO;
+        n += w;
+    }
+    if (addr + (off_t)sz > pf->size) __atomic_store_n(&pf->size, addr + (off_t)sz, __ATOMIC_RELEASE);
+    return CACHE_OK;
+}
+
+// Transmission au noyau (posix_fadvise) : il gère lui aussi un cache du fichier
+static void File_Advise(struct Cache_Backend *pbe, off_t addr, size_t sz, Cache_Hint hint)
+{
+    static const int advice[] = {
+        [CACHE_HINT_NORMAL] = POSIX_FADV_NORMAL,
+        [CACHE_HINT_SEQUENTIAL] = POSIX_FADV_SEQUENTIAL,
+        [CACHE_HINT_RANDOM] = POSIX_FADV_RANDOM,
+        [CACHE_HINT_WILLNEED] = POSIX_FADV_WILLNEED,
+        [CACHE_HINT_DONTNEED] = POSIX_FADV_DONTNEED,
+    };
+
+    posix_fadvise(fileno(FILE_BE(pbe)->fp), addr, sz, advice[hint]);
+}
+
+// pwrite() a déjà transmis les données au noyau : on lui demande de les
+// écrire sans attendre le prochain fdatasync()
+static Cache_Error File_Sync(struct Cache_Backend *pbe, off_t addr, size_t sz)
+{
+    return sync_file_range(fileno(FILE_BE(pbe)->fp), addr, sz, SYNC_FILE_RANGE_WRITE) == 0 ? CACHE_OK : CACHE_KO;
+}
+
+// Les écritures lancées par File_Sync() sont déjà en route : fdatasync()
+// attend leur fin et écrit le reste
+static Cache_Error File_Commit(struct Cache_Backend *pbe)
+{
+    return fdatasync(fileno(FILE_BE(pbe)->fp)) == 0 ? CACHE_OK : CACHE_KO;
+}
+
+static void File_Close(struct Cache_Backend *pbe)
+{
+    fclose(FILE_BE(pbe)->fp);
+    free(pbe->priv);
+}
+
+static int File_Open(struct Cache_Backend *pbe, const char *file)
+{
+    struct File_Backend *pf;
+    FILE *fp;
+
+    // Ouverture du fichier en mode "update"
+    if ((fp = fopen(file, "r+")) == NULL)
+        if ((fp = fopen(file, "w+")) == NULL)
+            return 0;
+
+    pf = malloc(sizeof(struct File_Backend));
+    pf->fp = fp;
+    fseeko(fp, 0, SEEK_END);
+    pf->size = ftello(fp);
+
+    pbe->name = "file";
+    pbe->payload = 1;
+    pbe->read = File_Read;
+    pbe->write = File_Write;
+    pbe->advise = File_Advise;
+    pbe->sync = File_Sync;
+    pbe->commit = File_Commit;
+    pbe->close = File_Close;
+    pbe->priv = pf;
+    return 1;
+}
+
+/* ------------------------------------------------------------------------------------
+ * Stockage projeté (mmap)
+ * ------------------------------------------------------------------------------------
+ * Le fichier est projeté en mémoire partagée (MAP_SHARED) : une lecture est
+ * une copie depuis la projection, bornée par la taille du fichier, une
+ * écriture une copie vers la projection que le noyau écrira dans le fichier.
+ * La projection est réservée plus grande que le fichier (taille doublée à
+ * chaque agrandissement) : seule une écriture au-delà de la réservation la
+ * déplace.
+ */
+
+struct Mmap_Backend
+{
+    int fd;         /* Descripteur du fichier */
+    char *map;      /* Projection (NULL tant que le fichier est vide) */
+    size_t size;    /* Taille courante du fichier */
+    size_t maplen;  /* Taille de la projection (multiple de la page) */
+    size_t page;    /* Taille d'une page */
+    pthread_rwlock_t lock; /* Une écriture peut déplacer map (voir Mmap_Grow()) */
+};
+
+#define MMAP_BE(pbe) ((struct Mmap_Backend *)(pbe)->priv)
+
+//! Agrandissement du fichier jusqu'à end octets, et au besoin de la projection (verrou en écriture)
+static int Mmap_Grow(struct Mmap_Backend *pm, size_t end)
+{
+    if (end > pm->maplen)
+    {
+        size_t len = pm->maplen ? pm->maplen : pm->page;
+        char *map;
+
+        while (len < end) len *= 2;
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, pm->fd, 0);
+        if (map == MAP_FAILED) return 0;
+        if (pm->map != NULL) munmap(pm->map, pm->maplen);
+        // Pas de lecture anticipée lors d'un défaut : le cache demande lui-même
+        // les pages de ses blocs (WILLNEED)
+        madvise(map, len, MADV_RANDOM);
+        pm->map = map;
+        pm->maplen = len;
+    }
+    if (ftruncate(pm->fd, end) != 0) return 0;
+    pm->size = end;
+    return 1;
+}
+
+static Cache_Error Mmap_Read(struct Cache_Backend *pbe, off_t addr, void *buf, size_t sz)
+{
+    struct Mmap_Backend *pm = MMAP_BE(pbe);
+    size_t n = 0;
+
+    pthread_rwlock_rdlock(&pm->lock);
+    if ((size_t)addr < pm->size)
+    {
+        n = (pm->size - addr < sz) ? pm->size - addr : sz;
+        memcpy(buf, pm->map + addr, n);
+    }
+    pthread_rwlock_unlock(&pm->lock);
+    memset((char *)buf + n, '\0', sz - n);
+    return CACHE_OK;
+}
+
+static Cache_Error Mmap_Write(struct Cache_Backend *pbe, off_t addr, const void *buf, size_t sz)
+{
+    struct Mmap_Backend *pm = MMAP_BE(pbe);
+    size_t end = addr + sz;
+
+    // Dans le fichier, le verrou en lecture suffit : la projection ne bouge pas
+    pthread_rwlock_rdlock(&pm->lock);
+    if (end > pm->size)
+    {
+        pthread_rwlock_unlock(&pm->lock);
+        pthread_rwlock_wrlock(&pm->lock);
+        if (end > pm->size && !Mmap_Grow(pm, end))
+        {
+            pthread_rwlock_unlock(&pm->lock);
+            return CACHE_KO;
+        }
+    }
+    memcpy(pm->map + addr, buf, sz);
+    pthread_rwlock_unlock(&pm->lock);
+    return CACHE_OK;
+}
+
+//! Plage [*paddr, *paddr + *psz[ étendue aux pages et bornée par le fichier (0 si elle est vide)
+static int Mmap_Pages(struct Mmap_Backend *pm, off_t *paddr, size_t *psz)
+{
+    size_t first = (size_t)*paddr & ~(pm->page - 1);
+    size_t end = (size_t)*paddr + *psz;
+
+    if (end > pm->size) end = pm->size;
+    if (end <= first) return 0;
+    *paddr = first;
+    *psz = end - first;
+    return 1;
+}
+
+// Transmission au noyau (madvise) : WILLNEED lance la lecture des pages,
+// DONTNEED les retire de l'espace du processus (pas du cache du noyau : les
+// pages modifiées d'une projection partagée restent à écrire)
+static void Mmap_Advise(struct Cache_Backend *pbe, off_t addr, size_t sz, Cache_Hint hint)
+{
+    static const int advice[] = {
+        [CACHE_HINT_NORMAL] = MADV_NORMAL,
+        [CACHE_HINT_SEQUENTIAL] = MADV_SEQUENTIAL,
+        [CACHE_HINT_RANDOM] = MADV_RANDOM,
+        [CACHE_HINT_WILLNEED] = MADV_WILLNEED,
+        [CACHE_HINT_DONTNEED] = MADV_DONTNEED,
+    };
+    struct Mmap_Backend *pm = MMAP_BE(pbe);
+
+    pthread_rwlock_rdlock(&pm->lock);
+    if (Mmap_Pages(pm, &addr, &sz))
+        madvise(pm->map + addr, sz, advice[hint]);
+    pthread_rwlock_unlock(&pm->lock);
+}
+
+// Écriture des pages modifiées lancée sans l'attendre (msync(MS_ASYNC)) :
+// l'équivalent d'un pwrite() du stockage fichier
+static Cache_Error Mmap_Sync(struct Cache_Backend *pbe, off_t addr, size_t sz)
+{
+    struct Mmap_Backend *pm = MMAP_BE(pbe);
+    int r = 0;
+
+    pthread_rwlock_rdlock(&pm->lock);
+    if (Mmap_Pages(pm, &addr, &sz))
+        r = msync(pm->map + addr, sz, MS_ASYNC);
+    pthread_rwlock_unlock(&pm->lock);
+    return r == 0 ? CACHE_OK : CACHE_KO;
+}
+
+// Les pages modifiées de la projection et la taille du fichier
+static Cache_Error Mmap_Commit(struct Cache_Backend *pbe)
+{
+    struct Mmap_Backend *pm = MMAP_BE(pbe);
+    int r = 0;
+
+    pthread_rwlock_rdlock(&pm->lock);
+    if (pm->map != NULL)
+        r = msync(pm->map, pm->size, MS_SYNC);
+    pthread_rwlock_unlock(&pm->lock);
+    return r == 0 ? CACHE_OK : CACHE_KO;
+}
+
+static void Mmap_Close(struct Cache_Backend *pbe)
+{
+    struct Mmap_Backend *pm = MMAP_BE(pbe);
+
+    if (pm->map != NULL) munmap(pm->map, pm->maplen);
+    close(pm->fd);
+    pthread_rwlock_destroy(&pm->lock);
+    free(pm);
+}
+
+static int Mmap_Open(struct Cache_Backend *pbe, const char *file)
+{
+    struct Mmap_Backend *pm;
+    struct stat st;
+    int fd;
+
+    if ((fd = open(file, O_RDWR | O_CREAT, 0666)) < 0)
+        return 0;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    pm = calloc(1, sizeof(struct Mmap_Backend));
+    pm->fd = fd;
+    pm->page = sysconf(_SC_PAGESIZE);
+    pthread_rwlock_init(&pm->lock, NULL);
+    if (st.st_size > 0 && !Mmap_Grow(pm, st.st_size))
+    {
+        close(fd);
+        pthread_rwlock_destroy(&pm->lock);
+        free(pm);
+        return 0;
+    }
+
+    pbe->name = "mmap";
+    pbe->payload = 1;
+    pbe->read = Mmap_Read;
+    pbe->write = Mmap_Write;
+    pbe->advise = Mmap_Advise;
+    pbe->sync = Mmap_Sync;
+    pbe->commit = Mmap_Commit;
+    pbe->close = Mmap_Close;
+    pbe->priv = pm;
+    return 1;
+}
+
+/* ------------------------------------------------------------------------------------
+ * Stockage mémoire
+ * ------------------------------------------------------------------------------------
+ */
+
+struct Mem_Backend
+{
+    char *data;     /* Contenu du "fichier" */
+    size_t size;    /* Taille courante */
+    size_t cap;     /* Taille allouée */
+    pthread_rwlock_t lock; /* Une écriture peut déplacer data (realloc) */
+};
+
+#define MEM_BE(pbe) ((struct Mem_Backend *)(pbe)->priv)
+
+static Cache_Error Mem_Read(struct Cache_Backend *pbe, off_t addr, void *buf, size_t sz)
+{
+    struct Mem_Backend *pm = MEM_BE(pbe);
+    size_t n = 0;
+
+    pthread_rwlock_rdlock(&pm->lock);
+    if ((size_t)addr < pm->size)
+    {
+        n = (pm->size - addr < sz) ? pm->size - addr : sz;
+        memcpy(buf, pm->data + addr, n);
+    }
+    pthread_rwlock_unlock(&pm->lock);
+    memset((char *)buf + n, '\0', sz - n);
+    return CACHE_OK;
+}
+
+static Cache_Error Mem_Write(struct Cache_Backend *pbe, off_t addr, const void *buf, size_t sz)
+{
+    struct Mem_Backend *pm = MEM_BE(pbe);
+    size_t end = addr + sz;
+
+    pthread_rwlock_wrlock(&pm->lock);
+    if (end > pm->cap)
+    {
+        size_t cap = pm->cap ? pm->cap : 4096;
+        char *data;
+
+        while (cap < end) cap *= 2;
+        if ((data = realloc(pm->data, cap)) == NULL)
+        {
+            pthread_rwlock_unlock(&pm->lock);
+            return CACHE_KO;
+        }
+        pm->data = data;
+        pm->cap = cap;
+    }
+    // Un "trou" entre l'ancienne fin et addr se lit comme des zéros
+    if ((size_t)addr > pm->size) memset(pm->data + pm->size, '\0', addr - pm->size);
+
+    memcpy(pm->data + addr, buf, sz);
+    if (end > pm->size) pm->size = end;
+    pthread_rwlock_unlock(&pm->lock);
+    return CACHE_OK;
+}
+
+static void Mem_Advise(struct Cache_Backend *pbe, off_t addr, size_t sz, Cache_Hint hint)
+{
+}
+
+static Cache_Error Mem_Sync(struct Cache_Backend *pbe, off_t addr, size_t sz)
+{
+    return CACHE_OK;
+}
+
+static Cache_Error Mem_Commit(struct Cache_Backend *pbe)
+{
+    return CACHE_OK;
+}
+
+static void Mem_Close(struct Cache_Backend *pbe)
+{
+    free(MEM_BE(pbe)->data);
+    pthread_rwlock_destroy(&MEM_BE(pbe)->lock);
+    free(pbe->priv);
+}
+
+static int Mem_Open(struct Cache_Backend *pbe)
+{
+    pbe->name = "mem";
+    pbe->payload = 1;
+    pbe->read = Mem_Read;
+    pbe->write = Mem_Write;
+    pbe->advise = Mem_Advise;
+    pbe->sync = Mem_Sync;
+    pbe->commit = Mem_Commit;
+    pbe->close = Mem_Close;
+    pbe->priv = calloc(1, sizeof(struct Mem_Backend));
+    pthread_rwlock_init(&MEM_BE(pbe)->lock, NULL);
+    return 1;
+}
+
+/* ------------------------------------------------------------------------------------
+ * Stockage nul (méta-données seulement)
+ * ------------------------------------------------------------------------------------
+ */
+
+static Cache_Error Null_Read(struct Cache_Backend *pbe, off_t addr, void *buf, size_t sz)
+{
+    return CACHE_OK;
+}
+
+static Cache_Error Null_Write(struct Cache_Backend *pbe, off_t addr, const void *buf, size_t sz)
+{
+    return CACHE_OK;
+}
+
+static void Null_Advise(struct Cache_Backend *pbe, off_t addr, size_t sz, Cache_Hint hint)
+{
+}
+
+static Cache_Error Null_Sync(struct Cache_Backend *pbe, off_t addr, size_t sz)
+{
+    return CACHE_OK;
+}
+
+static Cache_Error Null_Commit(struct Cache_Backend *pbe)
+{
+    return CACHE_OK;
+}
+
+static void Null_Close(struct Cache_Backend *pbe)
+{
+}
+
+static int Null_Open(struct Cache_Backend *pbe)
+{
+    pbe->name = "null";
+    pbe->payload = 0;
+    pbe->read = Null_Read;
+    pbe->write = Null_Write;
+    pbe->advise = Null_Advise;
+    pbe->sync = Null_Sync;
+    pbe->commit = Null_Commit;
+    pbe->close = Null_Close;
+    pbe->priv = NULL;
+    return 1;
+}
+
+/* ------------------------------------------------------------------------------------
+ * Interface
+ * ------------------------------------------------------------------------------------
+ */
+
+/*!
+ * \ingroup backend_interface
+ *
+ * \param kind type de stockage
+ * \param file nom du fichier (ignoré pour les stockages mémoire et nul)
+ * \return le stockage ouvert ou NULL en cas d'erreur
+ */
+struct Cache_Backend *Backend_Open(Cache_Backend_Kind kind, const char *file)
+{
+    struct Cache_Backend *pbe = malloc(sizeof(struct Cache_Backend));
+    int ok;
+
+    switch (kind)
+    {
+    case CACHE_BACKEND_MMAP:
+        ok = Mmap_Open(pbe, file);
+        break;
+    case CACHE_BACKEND_MEM:
+        ok = Mem_Open(pbe);
+        break;
+    case CACHE_BACKEND_NULL:
+        ok = Null_Open(pbe);
+        break;
+    case CACHE_BACKEND_FILE:
+    default:
+        ok = File_Open(pbe, file);
+        break;
+    }
+
+    if (!ok)
+    {
+        free(pbe);
+        return NULL;
+    }
+    return pbe;
+}
+
+/*!
+ * \ingroup backend_interface
+ */
+void Backend_Close(struct Cache_Backend *pbe)
+{
+    pbe->close(pbe);
+    free(pbe);
+}
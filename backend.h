@@ -0,0 +1,70 @@
+#ifndef _BACKEND_H_
+#define _BACKEND_H_
+
+/*!
+ * \file backend.h
+ *
+ * \brief Stockage sous-jacent du cache.
+ *
+ * Le cache ne manipule plus directement un \c FILE * : toutes ses
+ * entrées-sorties passent par un \c struct \c Cache_Backend, dont il existe
+ * quatre réalisations (voir \c Cache_Backend_Kind) :
+ *
+ * - \b fichier : le comportement historique, un fichier ouvert en mise à jour ;
+ * - \b projection : le fichier projeté en mémoire par mmap(). Les blocs du
+ *   cache n'ont alors pas de copie des données : ils ne décident que des pages
+ *   que le noyau garde dans l'espace du processus (voir cache.c) ;
+ * - \b mémoire : le "fichier" est un tableau en RAM, rien n'est écrit sur disque ;
+ * - \b nul : aucune donnée n'est stockée ni copiée. Le cache ne gère plus que
+ *   ses méta-données (entêtes, stratégie, instrumentation), ce qui suffit pour
+ *   mesurer les taux de succès des stratégies.
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "cache.h"
+
+/*!
+ * \defgroup backend_interface Interface du stockage sous-jacent
+ *
+ * \ingroup low_cache_interface
+ *
+ * @{
+ */
+
+//! Un stockage : une table de fonctions et les données propres à la réalisation.
+struct Cache_Backend
+{
+    const char *name;   //!< Nom de la réalisation
+    int payload;        //!< Faux si les données des blocs ne sont pas stockées
+
+    //! Lecture de \a sz octets à l'adresse \a addr (des zéros au-delà de la fin).
+    //! Peut être appelée pendant une écriture d'un autre thread (voir Cache_Read_Async()).
+    Cache_Error (*read)(struct Cache_Backend *pbe, off_t addr, void *buf, size_t sz);
+    //! Écriture de \a sz octets à l'adresse \a addr.
+    Cache_Error (*write)(struct Cache_Backend *pbe, off_t addr, const void *buf, size_t sz);
+    //! Indication sur les accès à venir aux \a sz octets à l'adresse \a addr.
+    void (*advise)(struct Cache_Backend *pbe, off_t addr, size_t sz, Cache_Hint hint);
+    //! Transmission au stockage des \a sz octets à l'adresse \a addr déjà
+    //! écrits : le noyau commence à les écrire, sans qu'on attende la fin.
+    Cache_Error (*sync)(struct Cache_Backend *pbe, off_t addr, size_t sz);
+    //! Attente de l'écriture sur disque de tout ce qui a été écrit (fdatasync).
+    Cache_Error (*commit)(struct Cache_Backend *pbe);
+    //! Fermeture et libération.
+    void (*close)(struct Cache_Backend *pbe);
+
+    void *priv;         //!< Données propres à la réalisation
+};
+
+//! Ouverture d'un stockage de type \a kind (NULL en cas d'erreur).
+struct Cache_Backend *Backend_Open(Cache_Backend_Kind kind, const char *file);
+
+//! Fermeture d'un stockage.
+void Backend_Close(struct Cache_Backend *pbe);
+
+/*
+ * @}
+ */
+
+#endif /* _BACKEND_H_ */
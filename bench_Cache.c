@@ -0,0 +1,488 @@
+/*!
+ * \file bench_Cache.c
+ *
+ * \brief Lanceur parallèle des balayages de paramètres du simulateur.
+ *
+ * Ce programme remplace les boucles séquentielles de plot.sh : il construit
+ * la liste de toutes les combinaisons (stratégie, test, valeur de paramètre)
+ * des courbes de Makefile.plots et les exécute en parallèle sur tous les
+ * processeurs. Chaque job est un processus tst_Cache_<stratégie> distinct
+ * qui travaille sur son propre stockage : un fichier privé ou, par défaut, un
+ * stockage en mémoire (option -B de tst_Cache), ce qui évite tout partage de
+ * \c foo.
+ *
+ * Les résultats (taux de succès, débit, percentiles de latence) sont écrits
+ * en CSV et/ou JSON ; les fichiers de données au format de plot.sh peuvent
+ * aussi être produits pour le tracé des courbes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/* ------------------------------------------------------------------------------------
+ * Description des balayages
+ * ------------------------------------------------------------------------------------
+ */
+
+/* Un balayage : une option de tst_Cache prenant successivement plusieurs
+ * valeurs, pour chacun des tests indiqués. Le nom du fichier de données est
+ * "t<test>-<name>", comme dans Makefile.plots.
+ */
+struct Sweep
+{
+    const char *name;   /* suffixe du fichier de données */
+    const char *tests;  /* numéros de tests */
+    const char *option; /* option de tst_Cache */
+    const char *values; /* valeurs successives de l'option */
+};
+
+/* Les balayages de "make plots" (voir Makefile.plots) */
+static const struct Sweep Default_Sweeps[] = {
+    {"cache_size", "1 2 3 4 5 6 7", "-r", "1000 750 500 400 300 200 100 50 10 5 1"},
+    {"cache_size-zoom", "1 2 3 4 5 6 7", "-r", "180 160 140 120 100 50 30 10 5 2 1"},
+    {"rw_ratio", "3 4 5", "-w", "1 2 5 10 30 50 80 100 150 200 300 400 500"},
+    {"seq_access", "3", "-s", "1 2 3 4 5 6 7 8 9 10 15 20 50 100 200 300 500"},
+    {"working_sets", "4 5", "-W", "1 2 5 10 30 50 80 100 150 200 300 400 500"},
+    {"working_sets-zoom", "4 5", "-W", "1 2 5 10 30 50 80 100"},
+    {"locality", "4 5", "-L", "5 10 20 50 100 150 200 250 300 350 400 500 600"},
+};
+#define NSWEEPS ((int)(sizeof(Default_Sweeps)/sizeof(Default_Sweeps[0])))
+
+#define MAX_WORDS 64
+
+/* Un job : une exécution de tst_Cache et ses résultats */
+struct Job
+{
+    const struct Sweep *sweep;
+    const char *strategy;
+    int test;
+    const char *value;
+    int done;           /* le job s'est terminé correctement */
+    double hits;        /* taux de succès (%) */
+    unsigned long ops;  /* nombre d'accès */
+    double time;        /* durée du test (s) */
+    double ops_per_s;   /* débit (accès/s) */
+    double lat50, lat90, lat99, latmax; /* latences (ns) */
+};
+
+/* ------------------------------------------------------------------------------------
+ * Paramètres
+ * ------------------------------------------------------------------------------------
+ */
+
+static int N_Jobs_Parallel = 0;             /* 0 : nombre de processeurs */
+static const char *Prog_Dir = ".";          /* répertoire des tst_Cache_* */
+static const char *Work_Dir = NULL;         /* répertoire des fichiers privés */
+static const char *Csv_File = NULL;
+static const char *Json_File = NULL;
+static const char *Data_Dir = NULL;         /* fichiers au format plot.sh */
+static const char *Backend = "mem";         /* stockage des jobs (file, mem, null) */
+static char Strategies_Buf[256] = "NUR LRU FIFO RAND";
+static char Extra_Args_Buf[1024] = "";
+static const char *Only = NULL;             /* filtre sur le nom des balayages */
+
+static const char *Strategies[MAX_WORDS];
+static int N_Strategies;
+static const char *Extra_Args[MAX_WORDS];
+static int N_Extra_Args;
+
+/* ------------------------------------------------------------------------------------
+ * Fonctions utilitaires
+ * ------------------------------------------------------------------------------------
+ */
+
+static void Error(const char *msg)
+{
+    fprintf(stderr, "ERROR *** %s\n", msg);
+    exit(1);
+}
+
+/* Découpage en mots (en place) d'une chaîne ; retourne le nombre de mots */
+static int Split(char *s, const char *words[], int max)
+{
+    int n = 0;
+    char *w;
+
+    for (w = strtok(s, " \t"); w != NULL && n < max; w = strtok(NULL, " \t"))
+        words[n++] = w;
+    return n;
+}
+
+/* Comme Split, mais sur une copie (les chaînes de Default_Sweeps sont constantes) */
+static int Split_Const(const char *s, const char *words[], int max)
+{
+    return Split(strdup(s), words, max);
+}
+
+/* ------------------------------------------------------------------------------------
+ * Construction et exécution des jobs
+ * ------------------------------------------------------------------------------------
+ */
+
+static struct Job *Build_Jobs(int *pnjobs)
+{
+    struct Job *jobs = NULL;
+    int njobs = 0, cap = 0;
+    int isw;
+
+    for (isw = 0; isw < NSWEEPS; isw++)
+    {
+        const struct Sweep *sw = &Default_Sweeps[isw];
+        const char *tests[MAX_WORDS], *values[MAX_WORDS];
+        int ntests, nvalues, it, iv, is;
+
+        if (Only != NULL && strstr(sw->name, Only) == NULL) continue;
+
+        ntests = Split_Const(sw->tests, tests, MAX_WORDS);
+        nvalues = Split_Const(sw->values, values, MAX_WORDS);
+        for (it = 0; it < ntests; it++)
+            for (iv = 0; iv < nvalues; iv++)
+                for (is = 0; is < N_Strategies; is++)
+                {
+                    if (njobs == cap)
+                    {
+                        cap = cap ? 2 * cap : 256;
+                        jobs = realloc(jobs, cap * sizeof(struct Job));
+                    }
+                    memset(&jobs[njobs], 0, sizeof(struct Job));
+                    jobs[njobs].sweep = sw;
+                    jobs[njobs].strategy = Strategies[is];
+                    jobs[njobs].test = atoi(tests[it]);
+                    jobs[njobs].value = values[iv];
+                    njobs++;
+                }
+    }
+
+    *pnjobs = njobs;
+    return jobs;
+}
+
+/* Noms des fichiers privés du job ij */
+static void Job_Paths(int ij, char *dat, char *out, size_t sz)
+{
+    snprintf(dat, sz, "%s/job%d.dat", Work_Dir, ij);
+    snprintf(out, sz, "%s/job%d.out", Work_Dir, ij);
+}
+
+/* Lancement (asynchrone) du job ij ; retourne le pid du fils */
+static pid_t Start_Job(struct Job *jobs, int ij)
+{
+    struct Job *pj = &jobs[ij];
+    char prog[1024], dat[1024], out[1024], test[16];
+    const char *argv[MAX_WORDS + 16];
+    int argc = 0, i;
+    pid_t pid;
+
+    snprintf(prog, sizeof(prog), "%s/tst_Cache_%s", Prog_Dir, pj->strategy);
+    snprintf(test, sizeof(test), "%d", pj->test);
+    Job_Paths(ij, dat, out, sizeof(dat));
+
+    argv[argc++] = prog;
+    argv[argc++] = "-S";
+    argv[argc++] = "-B";
+    argv[argc++] = Backend;
+    argv[argc++] = "-f";
+    argv[argc++] = dat;
+    argv[argc++] = "-t";
+    argv[argc++] = test;
+    for (i = 0; i < N_Extra_Args; i++) argv[argc++] = Extra_Args[i];
+    argv[argc++] = pj->sweep->option;
+    argv[argc++] = pj->value;
+    argv[argc] = NULL;
+
+    if ((pid = fork()) < 0) Error("fork");
+    if (pid == 0)
+    {
+        int fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0) _exit(127);
+        close(fd);
+        execv(prog, (char *const *)argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+/* Dépouillement de la sortie (format court, -S) du job ij */
+static void Collect_Job(struct Job *jobs, int ij)
+{
+    struct Job *pj = &jobs[ij];
+    char dat[1024], out[1024], key[64];
+    double val;
+    FILE *fp;
+
+    Job_Paths(ij, dat, out, sizeof(dat));
+    if ((fp = fopen(out, "r")) != NULL)
+    {
+        char line[256];
+
+        while (fgets(line, sizeof(line), fp) != NULL)
+        {
+            if (sscanf(line, "%63s %lf", key, &val) != 2) continue;
+            if (strcmp(key, "hits") == 0) pj->hits = val, pj->done = 1;
+            else if (strcmp(key, "ops") == 0) pj->ops = (unsigned long)val;
+            else if (strcmp(key, "time") == 0) pj->time = val;
+            else if (strcmp(key, "ops/s") == 0) pj->ops_per_s = val;
+            else if (strcmp(key, "lat50") == 0) pj->lat50 = val;
+            else if (strcmp(key, "lat90") == 0) pj->lat90 = val;
+            else if (strcmp(key, "lat99") == 0) pj->lat99 = val;
+            else if (strcmp(key, "latmax") == 0) pj->latmax = val;
+        }
+        fclose(fp);
+    }
+    unlink(out);
+    unlink(dat);
+}
+
+/* Exécution de tous les jobs, au plus N_Jobs_Parallel à la fois */
+static void Run_Jobs(struct Job *jobs, int njobs)
+{
+    pid_t *pids = calloc(njobs, sizeof(pid_t));
+    int next = 0, running = 0, finished = 0, failed = 0;
+
+    while (finished < njobs)
+    {
+        pid_t pid;
+        int status, ij;
+
+        while (running < N_Jobs_Parallel && next < njobs)
+        {
+            pids[next] = Start_Job(jobs, next);
+            next++;
+            running++;
+        }
+
+        if ((pid = wait(&status)) < 0) Error("wait");
+        for (ij = 0; ij < next && pids[ij] != pid; ij++) {}
+        if (ij == next) continue;
+
+        Collect_Job(jobs, ij);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !jobs[ij].done)
+        {
+            fprintf(stderr, "Échec : tst_Cache_%s -t %d %s %s\n", jobs[ij].strategy,
+                    jobs[ij].test, jobs[ij].sweep->option, jobs[ij].value);
+            failed++;
+        }
+        running--;
+        finished++;
+        fprintf(stderr, "\r%d/%d jobs", finished, njobs);
+    }
+    fprintf(stderr, "\n");
+    if (failed > 0) fprintf(stderr, "%d jobs en échec\n", failed);
+    free(pids);
+}
+
+/* ------------------------------------------------------------------------------------
+ * Écriture des résultats
+ * ------------------------------------------------------------------------------------
+ */
+
+static FILE *Open_Output(const char *name)
+{
+    FILE *fp;
+
+    if (strcmp(name, "-") == 0) return stdout;
+    if ((fp = fopen(name, "w")) == NULL) Error(name);
+    return fp;
+}
+
+static void Close_Output(FILE *fp)
+{
+    if (fp != stdout) fclose(fp);
+}
+
+static void Write_Csv(const struct Job *jobs, int njobs)
+{
+    FILE *fp = Open_Output(Csv_File);
+    int ij;
+
+    fprintf(fp, "sweep,strategy,test,option,value,hits,ops,time_s,ops_per_s,"
+            "lat_p50_ns,lat_p90_ns,lat_p99_ns,lat_max_ns\n");
+    for (ij = 0; ij < njobs; ij++)
+    {
+        const struct Job *pj = &jobs[ij];
+
+        if (!pj->done) continue;
+        fprintf(fp, "%s,%s,%d,%s,%s,%.2f,%lu,%.6f,%.0f,%.0f,%.0f,%.0f,%.0f\n",
+                pj->sweep->name, pj->strategy, pj->test, pj->sweep->option, pj->value,
+                pj->hits, pj->ops, pj->time, pj->ops_per_s,
+                pj->lat50, pj->lat90, pj->lat99, pj->latmax);
+    }
+    Close_Output(fp);
+}
+
+static void Write_Json(const struct Job *jobs, int njobs)
+{
+    FILE *fp = Open_Output(Json_File);
+    const char *sep = "";
+    int ij;
+
+    fprintf(fp, "[\n");
+    for (ij = 0; ij < njobs; ij++)
+    {
+        const struct Job *pj = &jobs[ij];
+
+        if (!pj->done) continue;
+        fprintf(fp, "%s  {\"sweep\": \"%s\", \"strategy\": \"%s\", \"test\": %d, "
+                "\"option\": \"%s\", \"value\": %s, \"hits\": %.2f, \"ops\": %lu, "
+                "\"time_s\": %.6f, \"ops_per_s\": %.0f, \"lat_p50_ns\": %.0f, "
+                "\"lat_p90_ns\": %.0f, \"lat_p99_ns\": %.0f, \"lat_max_ns\": %.0f}",
+                sep, pj->sweep->name, pj->strategy, pj->test, pj->sweep->option,
+                pj->value, pj->hits, pj->ops, pj->time, pj->ops_per_s,
+                pj->lat50, pj->lat90, pj->lat99, pj->latmax);
+        sep = ",\n";
+    }
+    fprintf(fp, "\n]\n");
+    Close_Output(fp);
+}
+
+/* Fichiers de données au format de plot.sh : une ligne par valeur, une
+ * colonne de taux de succès par stratégie. Les jobs d'un même fichier sont
+ * consécutifs dans le tableau (voir Build_Jobs).
+ */
+static void Write_Plot_Data(const struct Job *jobs, int njobs)
+{
+    int ij = 0;
+
+    while (ij < njobs)
+    {
+        const struct Sweep *sw = jobs[ij].sweep;
+        int test = jobs[ij].test;
+        char name[1024];
+        FILE *fp;
+
+        snprintf(name, sizeof(name), "%s/t%d-%s", Data_Dir, test, sw->name);
+        if ((fp = fopen(name, "w")) == NULL) Error(name);
+        while (ij < njobs && jobs[ij].sweep == sw && jobs[ij].test == test)
+        {
+            int is;
+
+            fprintf(fp, "%s", jobs[ij].value);
+            for (is = 0; is < N_Strategies; is++, ij++)
+                fprintf(fp, " %.2f ", jobs[ij].hits);
+            fprintf(fp, "\n");
+        }
+        fclose(fp);
+    }
+}
+
+/* ------------------------------------------------------------------------------------
+ * Programme principal
+ * ------------------------------------------------------------------------------------
+ */
+
+static void Usage(const char *execname)
+{
+    printf("\nUsage: %s [options]\n", execname);
+    printf("\nExécute en parallèle les balayages de paramètres de \"make plots\".\n"
+           "\nOptions\n"
+           "-------\n"
+           "-h\t\tce message\n"
+           "-j nj\t\tnombre de jobs simultanés (défaut : nombre de processeurs)\n"
+           "-p dir\t\trépertoire des programmes tst_Cache_* (défaut : .)\n"
+           "-b be\t\tstockage des jobs : file, mem (défaut) ou null\n"
+           "-d dir\t\trépertoire des fichiers privés des jobs (défaut : temporaire)\n"
+           "-s \"strat...\"\tstratégies à comparer (défaut : \"NUR LRU FIFO RAND\")\n"
+           "-a \"args...\"\toptions supplémentaires passées à tst_Cache\n"
+           "-o name\t\tne faire que les balayages dont le nom contient name\n"
+           "-c file\t\trésultats en CSV (- : sortie standard)\n"
+           "-J file\t\trésultats en JSON (- : sortie standard)\n"
+           "-D dir\t\tfichiers de données au format de plot.sh\n");
+}
+
+static void Scan_Args(int argc, char *argv[])
+{
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0'
+            || (argv[i][1] != 'h' && i + 1 >= argc))
+        {
+            Usage(argv[0]);
+            exit(1);
+        }
+        switch (argv[i][1])
+        {
+        case 'h':
+            Usage(argv[0]);
+            exit(0);
+        case 'j':
+            N_Jobs_Parallel = atoi(argv[++i]);
+            break;
+        case 'p':
+            Prog_Dir = argv[++i];
+            break;
+        case 'b':
+            Backend = argv[++i];
+            break;
+        case 'd':
+            Work_Dir = argv[++i];
+            break;
+        case 's':
+            snprintf(Strategies_Buf, sizeof(Strategies_Buf), "%s", argv[++i]);
+            break;
+        case 'a':
+            snprintf(Extra_Args_Buf, sizeof(Extra_Args_Buf), "%s", argv[++i]);
+            break;
+        case 'o':
+            Only = argv[++i];
+            break;
+        case 'c':
+            Csv_File = argv[++i];
+            break;
+        case 'J':
+            Json_File = argv[++i];
+            break;
+        case 'D':
+            Data_Dir = argv[++i];
+            break;
+        default:
+            fprintf(stderr, "Option inconnue : %s\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    N_Strategies = Split(Strategies_Buf, Strategies, MAX_WORDS);
+    N_Extra_Args = Split(Extra_Args_Buf, Extra_Args, MAX_WORDS - 16);
+    if (N_Strategies == 0) Error("aucune stratégie");
+
+    if (N_Jobs_Parallel <= 0)
+        N_Jobs_Parallel = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (N_Jobs_Parallel <= 0) N_Jobs_Parallel = 1;
+
+    if (Csv_File == NULL && Json_File == NULL && Data_Dir == NULL)
+        Csv_File = "-";
+}
+
+int main(int argc, char *argv[])
+{
+    static char tmpl[] = "/tmp/bench_Cache.XXXXXX";
+    struct Job *jobs;
+    int njobs;
+    int own_work_dir = 0;
+
+    Scan_Args(argc, argv);
+
+    if (Work_Dir == NULL)
+    {
+        if ((Work_Dir = mkdtemp(tmpl)) == NULL) Error("mkdtemp");
+        own_work_dir = 1;
+    }
+
+    jobs = Build_Jobs(&njobs);
+    Run_Jobs(jobs, njobs);
+
+    if (Csv_File != NULL) Write_Csv(jobs, njobs);
+    if (Json_File != NULL) Write_Json(jobs, njobs);
+    if (Data_Dir != NULL) Write_Plot_Data(jobs, njobs);
+
+    if (own_work_dir) rmdir(Work_Dir);
+    free(jobs);
+    return 0;
+}
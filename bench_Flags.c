@@ -0,0 +1,145 @@
+/*!
+ * \file bench_Flags.c
+ *
+ * \brief Mesure du coût des balayages de flags (voir flagscan.h).
+ *
+ * Pour un cache de nblocks blocs (1M par défaut), mesure la durée des trois
+ * balayages de NUR et de Cache_Sync() :
+ *
+ *  - \b min : choix de la victime de NUR (plus petite classe 2*R+M), dans le
+ *    pire cas où aucun bloc n'est de classe 0 (tout le tableau est lu) ;
+ *  - \b clear : remise à 0 des bits R ;
+ *  - \b collect : recherche des blocs valides et modifiés (1 % des blocs).
+ *
+ * La première ligne est la boucle d'origine sur les entêtes de bloc
+ * (struct Cache_Block_Header) ; les suivantes sont les versions de
+ * flagscan.c disponibles sur ce processeur, sur des tableaux d'un octet par
+ * bloc.
+ *
+ * Usage : bench_Flags [nblocks [nrepeat]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "low_cache.h"
+#include "flagscan.h"
+
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Boucles d'origine, sur les entêtes */
+
+static int Headers_Min(struct Cache_Block_Header *headers, int n)
+{
+    int i, best = -1, bestv = 4;
+
+    for (i = 0; i < n; i++) {
+        int v = ((headers[i].flags & R_FLAG) ? 2 : 0) + ((headers[i].flags & MODIF) ? 1 : 0);
+
+        if (v == 0) return i;
+        if (v < bestv) {
+            bestv = v;
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void Headers_Clear(struct Cache_Block_Header *headers, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        headers[i].flags &= ~R_FLAG;
+}
+
+static int Headers_Collect(struct Cache_Block_Header *headers, int n, int *out)
+{
+    int i, nout = 0;
+
+    for (i = 0; i < n; i++)
+        if ((headers[i].flags & (VALID | MODIF)) == (VALID | MODIF)) out[nout++] = i;
+    return nout;
+}
+
+/* Remise des flags dans l'état initial : tous valides et référencés, 1 % modifiés */
+static void Fill(struct Cache_Block_Header *headers, unsigned char *ref, unsigned char *fstate, int n)
+{
+    int i;
+
+    srand(1);
+    for (i = 0; i < n; i++) {
+        int modif = rand() % 100 == 0;
+
+        headers[i].flags = VALID | R_FLAG | (modif ? MODIF : 0);
+        ref[i] = R_FLAG;
+        fstate[i] = VALID | (modif ? MODIF : 0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *names[] = { "avx2", "sse2", "scalar" };
+    int n = argc > 1 ? atoi(argv[1]) : 1 << 20;
+    int nrepeat = argc > 2 ? atoi(argv[2]) : 20;
+    struct Cache_Block_Header *headers = calloc(n, sizeof(struct Cache_Block_Header));
+    unsigned char *ref = malloc(n), *fstate = malloc(n);
+    int *out = malloc(n * sizeof(int));
+    double t, tmin, tclear, tcollect;
+    int k, r, check = 0;
+
+    printf("%d blocs, %d répétitions (ns par balayage)\n", n, nrepeat);
+    printf("%-10s %12s %12s %12s\n", "version", "min", "clear", "collect");
+
+    Fill(headers, ref, fstate, n);
+    t = Now();
+    for (r = 0; r < nrepeat; r++) check += Headers_Min(headers, n);
+    tmin = Now() - t;
+    t = Now();
+    for (r = 0; r < nrepeat; r++) check += Headers_Collect(headers, n, out);
+    tcollect = Now() - t;
+    t = Now();
+    for (r = 0; r < nrepeat; r++) {
+        Headers_Clear(headers, n);
+        headers[r % n].flags |= R_FLAG;
+    }
+    tclear = Now() - t;
+    printf("%-10s %12.0f %12.0f %12.0f\n", "entêtes",
+           tmin / nrepeat * 1e9, tclear / nrepeat * 1e9, tcollect / nrepeat * 1e9);
+
+    for (k = 0; k < (int)(sizeof(names) / sizeof(names[0])); k++) {
+        if (!Flag_Scan_Select(names[k])) continue;
+
+        Fill(headers, ref, fstate, n);
+        t = Now();
+        for (r = 0; r < nrepeat; r++) check += Flag_Scan_Min(ref, fstate, n, R_FLAG | MODIF);
+        tmin = Now() - t;
+        t = Now();
+        for (r = 0; r < nrepeat; r++) check += Flag_Scan_Collect(fstate, n, VALID | MODIF, VALID | MODIF, out);
+        tcollect = Now() - t;
+        t = Now();
+        for (r = 0; r < nrepeat; r++) {
+            Flag_Scan_Clear(ref, n, R_FLAG);
+            ref[r % n] = R_FLAG;
+        }
+        tclear = Now() - t;
+        printf("%-10s %12.0f %12.0f %12.0f\n", names[k],
+               tmin / nrepeat * 1e9, tclear / nrepeat * 1e9, tcollect / nrepeat * 1e9);
+    }
+
+    // Empêche le compilateur d'ignorer les résultats
+    if (check == -1) printf("%d\n", check);
+
+    free(headers);
+    free(ref);
+    free(fstate);
+    free(out);
+    return 0;
+}
@@ -12,44 +12,588 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include "cache.h"
 #include "low_cache.h"
 #include "strategy.h"
+#include "advisor.h"
+#include "numa.h"
+#include "flagscan.h"
+
+//! Les blocs ont-ils une copie des données ?
+#define HAS_DATA(pcache) ((pcache)->backend != CACHE_BACKEND_NULL && (pcache)->backend != CACHE_BACKEND_MMAP)
+
+/*
+ * Fichiers projetés
+ * -----------------
+ * Avec CACHE_BACKEND_MMAP, les enregistrements sont lus et écrits dans la
+ * projection du fichier. Les blocs n'ont pas de données : charger un bloc
+ * demande ses pages au noyau (WILLNEED), le remplacer les retire de l'espace
+ * du processus (DONTNEED), et écrire un bloc modifié lance l'écriture de ses
+ * pages (msync). La stratégie décide ainsi des pages résidentes, au grain
+ * près des pages du noyau : un défaut projette toute une "folio" du cache de
+ * fichiers (64 Ko sous ext4 récent), si bien que des blocs plus petits
+ * laissent des pages voisines dans l'espace du processus. Les lectures
+ * se font sous le verrou : une copie depuis la projection n'est pas protégée
+ * par la version du bloc (voir Read_Lockless()).
+ */
+#define MAPPED(pcache) ((pcache)->backend == CACHE_BACKEND_MMAP)
+
+//! Stockage du fichier d'un bloc
+#define BACKEND(pcache, header) ((pcache)->files[(header)->ifile]->pbackend)
+
+/*
+ * Index des blocs valides
+ * -----------------------
+ * Table de hachage chaînée par indices : hash[h] est l'ibcache + 1 du premier
+ * bloc de la classe h (0 : aucun), hnext[ibcache] celui du bloc suivant. Une
+ * table à 0 est vide : celle d'un grand cache n'occupe de mémoire qu'au fur et
+ * à mesure de son remplissage (voir Alloc_Blocks()).
+ */
+
+//! Classe d'un bloc (fichier, indice-fichier) ; les 32 bits de poids fort de ibfile y sont repliés
+#define HASH(pcache, ifile, ibfile) \
+    ((((unsigned)(ibfile) ^ (unsigned)((uint64_t)(ibfile) >> 32)) + (unsigned)(ifile) * 0x9E3779B9u) \
+     * 2654435761u & (pcache)->hmask)
+
+//! Remise à vide de l'index
+static void Hash_Clear(struct Cache *pcache) {
+    unsigned h;
+
+    for (h = 0; h <= pcache->hmask; h++)
+        PUBLISH(pcache->hash[h], 0);
+}
+
+//! (Ré)allocation de l'index pour nblocks blocs : au moins autant de classes que de blocs
+static void Hash_Alloc(struct Cache *pcache) {
+    for (pcache->hmask = 1; pcache->hmask < pcache->nblocks; pcache->hmask <<= 1) {}
+    free(pcache->hash);
+    free(pcache->hnext);
+    pcache->hash = calloc(pcache->hmask, sizeof(int));
+    pcache->hnext = malloc(pcache->nblocks * sizeof(int));
+    pcache->hmask--;
+}
+
+//! Ajout d'un bloc (valide) dans l'index
+static void Hash_Insert(struct Cache *pcache, struct Cache_Block_Header *header) {
+    unsigned h = HASH(pcache, header->ifile, header->ibfile);
+
+    PUBLISH(pcache->hnext[header->ibcache], pcache->hash[h]);
+    PUBLISH(pcache->hash[h], header->ibcache + 1);
+}
+
+//! Retrait d'un bloc de l'index
+static void Hash_Remove(struct Cache *pcache, struct Cache_Block_Header *header) {
+    int *link = &pcache->hash[HASH(pcache, header->ifile, header->ibfile)];
+
+    while (*link > 0 && *link != header->ibcache + 1)
+        link = &pcache->hnext[*link - 1];
+    if (*link > 0)
+        PUBLISH(*link, pcache->hnext[header->ibcache]);
+}
+
+//! Recherche d'un bloc valide (ifile, ibfile) dans l'index
+static struct Cache_Block_Header *Hash_Find(struct Cache *pcache, int ifile, Cache_Index ibfile) {
+    int ib;
+
+    for (ib = pcache->hash[HASH(pcache, ifile, ibfile)] - 1; ib >= 0; ib = pcache->hnext[ib] - 1) {
+        struct Cache_Block_Header *header = &pcache->headers[ib];
+
+        if (BLOCK_VALID(pcache, header) && header->ibfile == ibfile && header->ifile == ifile)
+            return header;
+    }
+    return NULL;
+}
+
+/*
+ * Enregistrements accédés et modifiés
+ * -----------------------------------
+ * Pour chaque bloc (par ibcache), deux lignes de bits, un par enregistrement
+ * du bloc :
+ *
+ * - \c touched : mis à 1 au premier accès depuis le chargement du bloc. La
+ *   fraction n_touched / n_loaded de l'instrumentation mesure la part des
+ *   blocs chargés qui sert vraiment : une petite fraction indique des blocs
+ *   trop grands pour le motif d'accès ;
+ * - \c dirty : mis à 1 par une écriture, remis à 0 quand le bloc est sauvé.
+ *   Write_Block() n'écrit que les suites d'enregistrements modifiés (bit M
+ *   du bloc à 1) plutôt que tout le bloc.
+ */
+
+//! Ligne des enregistrements accédés du bloc d'indice ibcache
+#define TOUCHED(pcache, ibcache) ((pcache)->touched + (size_t)(ibcache) * (pcache)->tsz)
+
+//! Ligne des enregistrements modifiés du bloc d'indice ibcache
+#define DIRTY(pcache, ibcache) ((pcache)->dirty + (size_t)(ibcache) * (pcache)->tsz)
+
+//! Bit de l'enregistrement ir (indice dans le bloc) d'une ligne
+#define ROW_BIT(row, ir) ((row)[(ir) >> 3] & (1u << ((ir) & 7)))
+
+//! Mise à 1 du bit de l'enregistrement ir d'une ligne
+#define ROW_SET(row, ir) ((row)[(ir) >> 3] |= 1u << ((ir) & 7))
+
+//! Écart maximal (en octets) entre deux suites d'enregistrements modifiés
+//! écrites en une seule fois (l'écart est réécrit tel quel)
+#define DIRTY_MERGE 4096
+
+//! Tous les enregistrements d'une ligne sont-ils à 1 ?
+static int Row_Full(struct Cache *pcache, const unsigned char *row) {
+    unsigned ir;
+
+    for (ir = 0; ir + 8 <= pcache->nrecords; ir += 8) {
+        if (row[ir >> 3] != 0xff)
+            return 0;
+    }
+    for (; ir < pcache->nrecords; ir++) {
+        if (!ROW_BIT(row, ir))
+            return 0;
+    }
+    return 1;
+}
+
+//! Chargement d'un bloc : aucun de ses enregistrements n'a encore été accédé ni modifié
+static void Block_Loaded(struct Cache *pcache, struct Cache_Block_Header *header) {
+    unsigned char *row = TOUCHED(pcache, header->ibcache);
+    size_t i;
+
+    for (i = 0; i < pcache->tsz; i++)
+        PUBLISH(row[i], 0);
+    memset(DIRTY(pcache, header->ibcache), 0, pcache->tsz);
+    pcache->instrument.n_loaded += pcache->nrecords;
+}
+
+//! Accès à l'enregistrement irfile du bloc header
+static void Touch_Record(struct Cache *pcache, struct Cache_Block_Header *header, Cache_Index irfile) {
+    unsigned char *row = TOUCHED(pcache, header->ibcache);
+    unsigned ir = irfile % pcache->nrecords;
+
+    if (!ROW_BIT(row, ir)) {
+        PUBLISH(row[ir >> 3], row[ir >> 3] | 1u << (ir & 7));
+        pcache->instrument.n_touched++;
+    }
+}
+
+/*
+ * Placement NUMA
+ * --------------
+ * En mode NUMA, les blocs sont partagés en nnodes tranches contiguës ; les
+ * données de chaque tranche sont dans une zone liée à son nœud (voir
+ * numa.h), et non dans un malloc() par bloc.
+ */
+
+//! Nœud du thread appelant.
+int Cache_Thread_Node(struct Cache *pcache) {
+    if (pcache->nodes == NULL)
+        return 0;
+    return Numa_Thread_Node(pcache->nnodes, pcache->numa == CACHE_NUMA_SIMULATED);
+}
+
+//! Instrumentation par nœud d'un accès du thread appelant (header : bloc trouvé, NULL : défaut)
+static void Node_Access(struct Cache *pcache, struct Cache_Block_Header *header) {
+    struct Cache_Node *pn = &pcache->nodes[Cache_Thread_Node(pcache)];
+
+    __atomic_fetch_add(&pn->n_access, 1, __ATOMIC_RELAXED);
+    if (header != NULL) {
+        __atomic_fetch_add(&pn->n_hits, 1, __ATOMIC_RELAXED);
+        if (header->ibcache >= pn->first && header->ibcache < pn->first + pn->count)
+            __atomic_fetch_add(&pn->n_local, 1, __ATOMIC_RELAXED);
+    }
+}
+
+//! Tranches des nœuds et données des blocs (mode NUMA)
+static void Alloc_Node_Blocks(struct Cache *pcache) {
+    int k;
+
+    for (k = 0; k < pcache->nnodes; k++) {
+        struct Cache_Node *pn = &pcache->nodes[k];
+
+        pn->first = (unsigned)((uint64_t)pcache->nblocks * k / pcache->nnodes);
+        pn->count = (unsigned)((uint64_t)pcache->nblocks * (k + 1) / pcache->nnodes) - pn->first;
+        pn->next = pn->first;
+        pn->arena_size = HAS_DATA(pcache) ? pn->count * pcache->blocksz : 0;
+        pn->arena = Numa_Alloc(pn->arena_size, k, pcache->numa == CACHE_NUMA_ON);
+    }
+}
+
+//! Libération des données de tous les blocs
+static void Free_Blocks_Data(struct Cache *pcache) {
+    int tmp;
+
+    for (tmp = 0; tmp < pcache->nnodes; tmp++)
+        Numa_Free(pcache->nodes[tmp].arena, pcache->nodes[tmp].arena_size);
+    Numa_Free(pcache->arena, pcache->arena_size);
+    pcache->arena = NULL;
+}
+
+/*
+ * Accès concurrents
+ * -----------------
+ * Dans les modes multi-threads, chaque point d'entrée prend le verrou du
+ * cache (récursif : les fonctions de l'API s'appellent entre elles). En mode
+ * CACHE_CONCURRENT, une lecture d'un enregistrement présent se fait sans
+ * verrou :
+ *
+ * - chaque bloc a une version (seqlock), rendue impaire par le détenteur du
+ *   verrou pendant qu'il change l'identité, les données ou la validité du
+ *   bloc (Seq_Begin(), Seq_End()) ; le lecteur copie l'enregistrement puis
+ *   vérifie que la version n'a pas bougé, sinon il reprend avec le verrou ;
+ * - la récence n'est pas mise à jour par le lecteur (Strategy_Read() modifie
+ *   la structure de la stratégie) : il dépose le bloc lu dans un tampon
+ *   (struct Cache_Read_Buffer), que le prochain détenteur du verrou applique
+ *   à la stratégie d'un seul coup (Drain_Reads()).
+ *
+ * Les blocs partiellement lus (NOREAD), les premiers accès à un
+ * enregistrement (instrumentation des enregistrements accédés) et les caches
+ * avec conseiller passent toujours par le verrou.
+ */
+
+//! Début d'une modification du bloc header (verrou pris)
+static void Seq_Begin(struct Cache_Block_Header *header) {
+    __atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+//! Fin d'une modification du bloc header
+static void Seq_End(struct Cache_Block_Header *header) {
+    __atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELEASE);
+}
+
+//! Prise du verrou du cache ; en mode concurrent, application des lectures faites sans verrou
+static void Lock(struct Cache *pcache);
+
+//! Libération du verrou du cache
+static void Unlock(struct Cache *pcache) {
+    if (pcache->concurrency != CACHE_SINGLE)
+        pthread_mutex_unlock(&pcache->lock);
+}
+
+//! Tampon de lectures du thread appelant
+static struct Cache_Read_Buffer *Read_Buffer(struct Cache *pcache) {
+    static unsigned nthreads;
+    static __thread unsigned stripe;
+
+    if (stripe == 0)
+        stripe = __atomic_add_fetch(&nthreads, 1, __ATOMIC_RELAXED);
+    return &pcache->rbufs[stripe % READ_STRIPES];
+}
+
+//! Application à la stratégie des lectures faites sans verrou (verrou pris)
+static void Drain_Reads(struct Cache *pcache) {
+    int k;
+
+    for (k = 0; k < READ_STRIPES; k++) {
+        struct Cache_Read_Buffer *prb = &pcache->rbufs[k];
+        unsigned h, t = __atomic_load_n(&prb->tail, __ATOMIC_ACQUIRE);
+
+        for (h = prb->head; h != t; h++) {
+            uint64_t v = __atomic_exchange_n(&prb->slots[h & (READ_BUFFER - 1)], 0, __ATOMIC_ACQUIRE);
+            unsigned ib = (unsigned)(v & 0xffffffffu) - 1;
+
+            // Entrée réservée mais pas encore remplie : la suite attendra
+            if (v == 0)
+                break;
+            // Le bloc a pu changer depuis la lecture : sa version le dit
+            if (ib < pcache->nblocks && pcache->headers[ib].seq == (unsigned)(v >> 32)
+                && BLOCK_VALID(pcache, &pcache->headers[ib]))
+                Strategy_Read(pcache, &pcache->headers[ib]);
+        }
+        __atomic_store_n(&prb->head, h, __ATOMIC_RELEASE);
+    }
+}
+
+static void Lock(struct Cache *pcache) {
+    if (pcache->concurrency == CACHE_SINGLE)
+        return;
+    pthread_mutex_lock(&pcache->lock);
+    if (pcache->rbufs != NULL)
+        Drain_Reads(pcache);
+}
+
+//! Dépôt d'une lecture sans verrou du bloc header, de version seq
+static void Buffer_Read(struct Cache *pcache, struct Cache_Block_Header *header, unsigned seq) {
+    struct Cache_Read_Buffer *prb = Read_Buffer(pcache);
+    unsigned t = __atomic_load_n(&prb->tail, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&prb->n_reads, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&prb->n_hits, 1, __ATOMIC_RELAXED);
+
+    // Tampon plein : on le vide si le verrou est libre, sinon la lecture est perdue
+    if (t - __atomic_load_n(&prb->head, __ATOMIC_ACQUIRE) >= READ_BUFFER) {
+        if (pthread_mutex_trylock(&pcache->lock) != 0)
+            return;
+        Drain_Reads(pcache);
+        pthread_mutex_unlock(&pcache->lock);
+        t = __atomic_load_n(&prb->tail, __ATOMIC_RELAXED);
+    }
+    // Un autre thread du même tampon a pris l'entrée : la lecture est perdue
+    if (!__atomic_compare_exchange_n(&prb->tail, &t, t + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return;
+    __atomic_store_n(&prb->slots[t & (READ_BUFFER - 1)],
+                     ((uint64_t)seq << 32) | (unsigned)(header->ibcache + 1), __ATOMIC_RELEASE);
+}
+
+//! Lecture sans verrou de l'enregistrement irfile du fichier ifile : faux si
+//! le bloc est absent, en cours de modification, ou demande le verrou
+static int Read_Lockless(struct Cache *pcache, int ifile, Cache_Index irfile, void *precord) {
+    Cache_Index ibfile = irfile / pcache->nrecords;
+    unsigned ir = irfile % pcache->nrecords;
+    unsigned steps = 0, seq;
+    int ib;
+
+    // Les chaînes de l'index peuvent changer pendant le parcours : il est borné,
+    // et le bloc trouvé est vérifié sous sa version
+    for (ib = __atomic_load_n(&pcache->hash[HASH(pcache, ifile, ibfile)], __ATOMIC_RELAXED) - 1;
+         ib >= 0 && steps < pcache->nblocks;
+         ib = __atomic_load_n(&pcache->hnext[ib], __ATOMIC_RELAXED) - 1, steps++) {
+        struct Cache_Block_Header *header = &pcache->headers[ib];
+        const unsigned char *row = pcache->touched + (size_t)ib * pcache->tsz;
+        Cache_Flag flags;
+
+        seq = __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+        flags = __atomic_load_n(&header->flags, __ATOMIC_RELAXED);
+        // Un bloc d'une génération passée reste dans l'index (voir BLOCK_VALID())
+        if (__atomic_load_n(&header->ibfile, __ATOMIC_RELAXED) != ibfile
+            || __atomic_load_n(&header->ifile, __ATOMIC_RELAXED) != ifile
+            || __atomic_load_n(&header->gen, __ATOMIC_RELAXED) != __atomic_load_n(&pcache->gen, __ATOMIC_ACQUIRE))
+            continue;
+        if ((seq & 1) || !(flags & VALID) || (flags & NOREAD) || MAPPED(pcache)
+            || !(__atomic_load_n(&row[ir >> 3], __ATOMIC_RELAXED) & (1u << (ir & 7))))
+            return 0;
+
+        if (HAS_DATA(pcache))
+            memcpy(precord, header->data + ir * pcache->recordsz, pcache->recordsz);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&header->seq, __ATOMIC_RELAXED) != seq)
+            return 0;
+
+        Buffer_Read(pcache, header, seq);
+        if (pcache->nodes != NULL)
+            Node_Access(pcache, header);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Écritures durables groupées
+ * ---------------------------
+ * En mode CACHE_SYNC_DURABLE, chaque Cache_Sync() prend un numéro une fois
+ * ses blocs écrits, puis relâche le verrou du cache. Le premier thread qui
+ * trouve libre le verrou des écritures durables fait les fdatasync() de tous
+ * les fichiers : ils couvrent tous les numéros pris avant qu'il ne commence.
+ * Les threads arrivés entre-temps attendent ce verrou, puis n'ont plus rien à
+ * faire si leur numéro est couvert. Le tableau des fichiers ne change que
+ * sous ce verrou (voir Commit_Lock()).
+ */
+struct Cache_Commit
+{
+    pthread_mutex_t lock;       //!< Un seul groupe d'écritures durables à la fois
+    unsigned long issued;       //!< Dernier numéro pris
+    unsigned long done;         //!< Dernier numéro couvert par un groupe terminé
+    Cache_Error err;            //!< Résultat du dernier groupe
+    Cache_Count n_commits;      //!< Nombre de groupes (voir Cache_Get_Instrument())
+};
+
+//! Exclusion des écritures durables pendant un changement du tableau des fichiers
+static void Commit_Lock(struct Cache *pcache) {
+    if (pcache->pcommit != NULL)
+        pthread_mutex_lock(&pcache->pcommit->lock);
+}
+
+static void Commit_Unlock(struct Cache *pcache) {
+    if (pcache->pcommit != NULL)
+        pthread_mutex_unlock(&pcache->pcommit->lock);
+}
+
+//! Écriture durable des fichiers, sauf si le numéro ticket est déjà couvert (sans le verrou du cache)
+static Cache_Error Commit(struct Cache *pcache, unsigned long ticket) {
+    struct Cache_Commit *pc = pcache->pcommit;
+    Cache_Error err;
+    int ifile;
+
+    pthread_mutex_lock(&pc->lock);
+    if (pc->done < ticket) {
+        unsigned long last = __atomic_load_n(&pc->issued, __ATOMIC_ACQUIRE);
+
+        pc->err = CACHE_OK;
+        for (ifile = 0; ifile < pcache->nfiles; ifile++) {
+            struct Cache_File *pf = pcache->files[ifile];
+
+            if (pf != NULL && pf->pbackend->commit(pf->pbackend) != CACHE_OK)
+                pc->err = CACHE_KO;
+        }
+        pc->done = last;
+        __atomic_fetch_add(&pc->n_commits, 1, __ATOMIC_RELAXED);
+    }
+    err = pc->err;
+    pthread_mutex_unlock(&pc->lock);
+    return err;
+}
 
 //! Création du cache.
 struct Cache *Cache_Create(const char *file, unsigned nblocks, unsigned nrecords, size_t recordsz, unsigned nderef) {
-    int tmp;
+    return Cache_Create_Opt(file, nblocks, nrecords, recordsz, nderef, NULL);
+}
+
+//! Création du cache avec options.
+struct Cache *Cache_Create_Opt(const char *file, unsigned nblocks, unsigned nrecords, size_t recordsz, unsigned nderef,
+                               const struct Cache_Options *popts) {
+    struct Cache *pcache = Cache_Pool_Create(nblocks, nrecords, recordsz, nderef, popts);
+
+    if (pcache == NULL)
+        return NULL;
+
+    // Le fichier du cache est le fichier d'indice 0, sans quota
+    if (Cache_File_Open(pcache, file, 0, 0) == NULL) {
+        Cache_Close(pcache);
+        return NULL;
+    }
+
+    // Rechargement de l'instantané : s'il n'existe pas encore, le cache
+    // démarre simplement vide
+    if (popts != NULL && popts->snapshot != NULL) {
+        pcache->snapshot = (char *)malloc(strlen(popts->snapshot) + 1);
+        strcpy(pcache->snapshot, popts->snapshot);
+        Cache_Load_Snapshot(pcache, pcache->snapshot);
+    }
+
+    // Retour du cache
+    return pcache;
+}
+
+/*
+ * Mémoire des blocs
+ * -----------------
+ * Rien n'est initialisé bloc par bloc à la création : la mémoire d'un grand
+ * cache est réservée, pas remplie, et n'est occupée qu'au fur et à mesure que
+ * les blocs servent.
+ *
+ * - Les données de tous les blocs forment une seule zone anonyme (ou une par
+ *   nœud en mode NUMA, voir Numa_Alloc()) ; ses pages ne sont allouées par le
+ *   noyau qu'au premier accès.
+ * - Les tableaux indexés par bloc (entêtes, fstate, index) sont pris à 0 par
+ *   calloc(), dont les grandes zones viennent elles aussi directement du
+ *   noyau : 0 y est l'état initial (bloc invalide, classe vide). Les autres
+ *   (touched, dirty, hnext, freed) sont écrits avant d'être lus.
+ * - Get_Free_Block() complète l'entête d'un bloc (ibcache, données) quand il
+ *   le distribue depuis \c pfree : les blocs sont ainsi pris dans l'ordre,
+ *   comme par un pointeur qui avance dans la réserve.
+ */
+
+//! (Ré)allocation des blocs selon nblocks et blocksz (anciennes données libérées)
+static void Alloc_Blocks(struct Cache *pcache) {
+    // Allocation des entetes de bloc, et des blocs eux-memes (sauf si le
+    // stockage ne conserve pas les données)
+    free(pcache->headers);
+    free(pcache->fstate);
+    pcache->headers = calloc(pcache->nblocks, sizeof(struct Cache_Block_Header));
+    pcache->fstate = calloc(pcache->nblocks, 1);
+    pcache->arena_size = HAS_DATA(pcache) && pcache->nodes == NULL ? (size_t)pcache->nblocks * pcache->blocksz : 0;
+    pcache->arena = Numa_Alloc(pcache->arena_size, 0, 0);
+    if (pcache->nodes != NULL)
+        Alloc_Node_Blocks(pcache);
+
+    // Allocation de l'index et des enregistrements accédés et modifiés
+    Hash_Alloc(pcache);
+    pcache->tsz = (pcache->nrecords + 7) / 8;
+    free(pcache->touched);
+    free(pcache->dirty);
+    pcache->touched = malloc(pcache->nblocks * pcache->tsz);
+    pcache->dirty = malloc(pcache->nblocks * pcache->tsz);
+
+    // Initialisation du pointeur sur le premier bloc libre, cad ici le premier
+    // bloc, et de la pile des blocs libérés
+    pcache->pfree = pcache->headers;
+    pcache->freed = realloc(pcache->freed, pcache->nblocks * sizeof(int));
+    pcache->nfreed = 0;
+}
+
+//! Création d'un cache partagé entre plusieurs fichiers.
+struct Cache *Cache_Pool_Create(unsigned nblocks, unsigned nrecords, size_t recordsz, unsigned nderef,
+                                const struct Cache_Options *popts) {
+    static const struct Cache_Options defaults;
+
+    if (popts == NULL)
+        popts = &defaults;
 
-    // Allocation de la structure du cache
+    // Allocation de la structure du cache, sans fichier ouvert
     struct Cache *pcache = (struct Cache *)malloc(sizeof(struct Cache));
 
-    // Sauvegarde du nom de fichier
-    pcache->file = (char *)malloc(strlen(file) + 1);
-    strcpy(pcache->file, file);
+    pcache->files = NULL;
+    pcache->nfiles = 0;
+    pcache->backend = popts->backend;
 
-    // Ouverture du fichier en mode "update"
-    if ((pcache->fp = fopen(file, "r+")) == NULL)
-		if ((pcache->fp = fopen(file, "w+")) == NULL)
-			return CACHE_KO;
+    // Nœuds NUMA : ceux de la machine, ou simulés
+    pcache->numa = popts->numa;
+    pcache->nodes = NULL;
+    pcache->nnodes = 0;
+    if (pcache->numa != CACHE_NUMA_OFF) {
+        pcache->nnodes = pcache->numa == CACHE_NUMA_ON ? Numa_Machine_Nodes() : (int)popts->numa_nodes;
+        if (pcache->nnodes <= 0 || pcache->nnodes > NUMA_MAX_NODES
+            || posix_memalign((void **)&pcache->nodes, 64, pcache->nnodes * sizeof(struct Cache_Node)) != 0) {
+            free(pcache);
+            return NULL;
+        }
+        memset(pcache->nodes, 0, pcache->nnodes * sizeof(struct Cache_Node));
+    }
+
+    // Ouverture du second niveau éventuel
+    pcache->pspill = NULL;
+    pcache->spill_buf = NULL;
+    if (popts->spill_blocks > 0
+        && ((pcache->pspill = Spill_Open(popts->spill, popts->spill_blocks, nrecords*recordsz,
+                                         HAS_DATA(pcache))) == NULL
+            || (HAS_DATA(pcache) && (pcache->spill_buf = malloc(nrecords*recordsz)) == NULL))) {
+        if (pcache->pspill != NULL)
+            Spill_Close(pcache->pspill);
+        free(pcache->nodes);
+        free(pcache);
+        return NULL;
+    }
 
     pcache->nblocks = nblocks;
     pcache->nrecords = nrecords;
     pcache->recordsz = recordsz;
     pcache->nderef = nderef;
     pcache->blocksz = nrecords*recordsz;
+    pcache->strategy = popts->strategy;
+    pcache->pops = NULL;
+    pcache->write_policy = popts->write_policy;
+    pcache->nhints = 0;
 
-    // Allocation des entetes de bloc, et des blocs eux-memes
-    pcache->headers = malloc(nblocks*sizeof(struct Cache_Block_Header));
-    for (tmp = 0; tmp < nblocks; tmp++) {
-    	pcache->headers[tmp].data = (char *)malloc(pcache->blocksz);
-		pcache->headers[tmp].ibcache = tmp;
-		pcache->headers[tmp].flags = 0;
+    // Verrou (récursif) et tampons de lectures des modes multi-threads
+    pcache->concurrency = popts->concurrency;
+    pcache->rbufs = NULL;
+    if (pcache->concurrency != CACHE_SINGLE) {
+        pthread_mutexattr_t attr;
+
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&pcache->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+    if (pcache->concurrency == CACHE_CONCURRENT && posix_memalign((void **)&pcache->rbufs, 64,
+                                                                  READ_STRIPES * sizeof(struct Cache_Read_Buffer)) == 0)
+        memset(pcache->rbufs, 0, READ_STRIPES * sizeof(struct Cache_Read_Buffer));
+    pcache->sync_count = NSYNC;
+    pcache->snapshot = NULL;
+    pcache->pasync = NULL;
+    pcache->pcommit = NULL;
+    if (popts->sync_mode == CACHE_SYNC_DURABLE) {
+        pcache->pcommit = calloc(1, sizeof(struct Cache_Commit));
+        pthread_mutex_init(&pcache->pcommit->lock, NULL);
     }
 
-    // Initialisation du pointeur sur le premier bloc ltmpre, cad ici le premier bloc
-    pcache->pfree = pcache->headers;
+    pcache->headers = NULL;
+    pcache->hash = pcache->hnext = NULL;
+    pcache->freed = NULL;
+    pcache->touched = pcache->dirty = NULL;
+    pcache->fstate = NULL;
+    pcache->arena = NULL;
+    pcache->gen = 0;
+    Alloc_Blocks(pcache);
 
     // Mise à 0 des données d'instrumentation
     Cache_Get_Instrument(pcache);
@@ -57,60 +601,191 @@ struct Cache *Cache_Create(const char *file, unsigned nblocks, unsigned nrecords
     // Initialisation de la stratégie
     pcache->pstrategy = Strategy_Create(pcache);
 
+    // Conseiller de taille de bloc : ses caches fantômes ont la même stratégie
+    pcache->advisor = popts->advisor;
+    pcache->advisor_count = 0;
+    pcache->padvisor = popts->advisor != CACHE_ADVISOR_OFF ? Advisor_Create(pcache) : NULL;
+
+    // La réservation des données peut échouer (espace d'adressage limité)
+    if (pcache->arena_size > 0 && pcache->arena == NULL) {
+        Cache_Close(pcache);
+        return NULL;
+    }
+
     // Retour du cache
     return pcache;
 }
 
 //! Fermeture (destruction) du cache.
+//! Attente de la fin des lectures asynchrones en cours (voir plus loin)
+static void Async_Drain(struct Cache *pcache);
+
+//! Fin des lectures asynchrones et arrêt de leurs threads
+static void Async_Stop(struct Cache *pcache);
+
+//! Le bloc ibfile du fichier ifile vient d'être écrit dans le fichier : une lecture asynchrone en cours est périmée
+static void Async_Stale(struct Cache *pcache, int ifile, Cache_Index ibfile);
+
 Cache_Error Cache_Close(struct Cache *pcache) {
     int tmp;
 
-    // Synchronisation et fermeture de la stratégie
+    if (pcache->pasync != NULL)
+        Async_Stop(pcache);
+
+    // Synchronisation, instantané éventuel et fermeture de la stratégie
     Cache_Sync(pcache);
+    if (pcache->snapshot != NULL)
+        Cache_Save_Snapshot(pcache, pcache->snapshot);
     Strategy_Close(pcache);
+    if (pcache->padvisor != NULL)
+        Advisor_Delete(pcache->padvisor);
 
-    // Libération des blocs 
-    for (tmp = 0; tmp < pcache->nblocks; tmp++) {
-        free(pcache->headers[tmp].data);   
+    // Libération des blocs
+    Free_Blocks_Data(pcache);
+
+    // Fermeture du second niveau et des fichiers encore ouverts
+    if (pcache->pspill != NULL)
+        Spill_Close(pcache->pspill);
+    free(pcache->spill_buf);
+    for (tmp = 0; tmp < pcache->nfiles; tmp++) {
+        struct Cache_File *pf = pcache->files[tmp];
+
+        if (pf != NULL) {
+            Backend_Close(pf->pbackend);
+            free(pf->file);
+            free(pf);
+        }
     }
 
     // Déallocation des structs
+    free(pcache->files);
+    free(pcache->hash);
+    free(pcache->hnext);
+    free(pcache->freed);
+    free(pcache->touched);
+    free(pcache->dirty);
+    free(pcache->fstate);
     free(pcache->headers);
-    free(pcache->file);
+    free(pcache->snapshot);
+    free(pcache->rbufs);
+    free(pcache->nodes);
+    if (pcache->pcommit != NULL) {
+        pthread_mutex_destroy(&pcache->pcommit->lock);
+        free(pcache->pcommit);
+    }
+    if (pcache->concurrency != CACHE_SINGLE)
+        pthread_mutex_destroy(&pcache->lock);
     free(pcache);
 
     return CACHE_OK;
 }
 
+//! Ouverture d'un fichier dans un cache partagé.
+struct Cache_File *Cache_File_Open(struct Cache *pcache, const char *file, unsigned min, unsigned max) {
+    struct Cache_File *pf = (struct Cache_File *)malloc(sizeof(struct Cache_File));
+    int ifile;
+
+    // Le tableau des fichiers peut être réalloué : les lectures asynchrones s'en servent
+    if (pcache->pasync != NULL)
+        Async_Drain(pcache);
+
+    // Ouverture du stockage sous-jacent
+    if ((pf->pbackend = Backend_Open(pcache->backend, file)) == NULL) {
+        free(pf);
+        return NULL;
+    }
+
+    // Premier indice libre (le tableau des fichiers grandit au besoin)
+    Commit_Lock(pcache);
+    for (ifile = 0; ifile < pcache->nfiles && pcache->files[ifile] != NULL; ifile++) {}
+    if (ifile == pcache->nfiles) {
+        pcache->nfiles = pcache->nfiles ? 2 * pcache->nfiles : 4;
+        pcache->files = realloc(pcache->files, pcache->nfiles * sizeof(struct Cache_File *));
+        memset(pcache->files + ifile, 0, (pcache->nfiles - ifile) * sizeof(struct Cache_File *));
+    }
+    pcache->files[ifile] = pf;
+    Commit_Unlock(pcache);
+
+    pf->pcache = pcache;
+    pf->ifile = ifile;
+    pf->file = (char *)malloc(strlen(file) + 1);
+    strcpy(pf->file, file);
+    pf->min = min;
+    pf->max = max;
+    pf->nres = 0;
+
+    return pf;
+}
+
 //! Ecriture sur le Block
 static Cache_Error Write_Block(struct Cache *pcache, struct Cache_Block_Header *header) {
-    // On positionne le pointeur à l'adresse du block cherché
-    fseek(pcache->fp, DADDR(pcache, header->ibfile), SEEK_SET);
+    unsigned char *row = DIRTY(pcache, header->ibcache);
+    // Les enregistrements d'un bloc non lu ne sont pas tous à jour : pas de fusion
+    unsigned gap = (header->flags & NOREAD) ? 0 : DIRTY_MERGE / pcache->recordsz;
+    unsigned ir, first, last;
 
-    // Ecriture des données du Block
-    if (fwrite(header->data, 1, pcache->blocksz, pcache->fp) != pcache->blocksz)
-    	return CACHE_KO;
+    // Ecriture des suites d'enregistrements modifiés à leur adresse dans le
+    // fichier ; deux suites assez proches sont écrites d'un seul coup
+    for (ir = 0; ir < pcache->nrecords; ) {
+        if (row[ir >> 3] == 0) {
+            ir = (ir | 7) + 1;
+            continue;
+        }
+        if (!ROW_BIT(row, ir)) {
+            ir++;
+            continue;
+        }
+        for (first = last = ir++; ir < pcache->nrecords; ir++) {
+            if (ROW_BIT(row, ir)) {
+                if (ir - last > gap + 1)
+                    break;
+                last = ir;
+            }
+        }
+        if (pcache->pasync != NULL)
+            Async_Stale(pcache, header->ifile, header->ibfile);
+        if (HAS_DATA(pcache)
+            && BACKEND(pcache, header)->write(BACKEND(pcache, header),
+                                              DADDR(pcache, header->ibfile) + first * pcache->recordsz,
+                                              header->data + first * pcache->recordsz,
+                                              (last - first + 1) * pcache->recordsz) != CACHE_OK)
+            return CACHE_KO;
+        // Projeté ou en mode durable, le noyau commence tout de suite l'écriture
+        if ((MAPPED(pcache) || pcache->pcommit != NULL)
+            && BACKEND(pcache, header)->sync(BACKEND(pcache, header),
+                                             DADDR(pcache, header->ibfile) + first * pcache->recordsz,
+                                             (last - first + 1) * pcache->recordsz) != CACHE_OK)
+            return CACHE_KO;
+        pcache->instrument.n_written += last - first + 1;
+    }
 
-    // On efface le bit M
-    header->flags &= ~MODIF;
+    // On efface le bit M et les enregistrements modifiés
+    PUBLISH(header->flags, header->flags & ~MODIF);
+    FLAGS_COPY(pcache, header);
+    memset(row, 0, pcache->tsz);
 
     return CACHE_OK;
 }
 
-//! Synchronisation du cache.
-Cache_Error Cache_Sync(struct Cache *pcache) {
-    int tmp;
+//! Nombre de blocs examinés à la fois par Cache_Sync()
+#define SYNC_CHUNK 1024
 
-    //visite des blocks
-    for (tmp = 0; tmp < pcache->nblocks; tmp++) {
-		struct Cache_Block_Header *header = &pcache->headers[tmp];
+//! Écriture des blocs modifiés (verrou pris)
+static Cache_Error Sync_Blocks(struct Cache *pcache) {
+    int dirty[SYNC_CHUNK];
+    int first, n, k;
 
-		//si le bloc a V et M à 1 :
-		if (header->flags & (VALID | MODIF)) {
-	 	   if (Write_Block(pcache, header) == CACHE_KO)
-	 	   	return CACHE_KO;
-	 	}
-    }    
+    //visite des blocks par tranches : les blocs qui ont V et M à 1 sont
+    //repérés dans fstate (voir flagscan.h), puis sauvés
+    for (first = 0; first < pcache->nblocks; first += SYNC_CHUNK) {
+        n = Flag_Scan_Collect(pcache->fstate + first,
+                              pcache->nblocks - first < SYNC_CHUNK ? pcache->nblocks - first : SYNC_CHUNK,
+                              VALID | MODIF, VALID | MODIF, dirty);
+        for (k = 0; k < n; k++) {
+            if (Write_Block(pcache, &pcache->headers[first + dirty[k]]) == CACHE_KO)
+                return CACHE_KO;
+        }
+    }
 
     //On incrémente le nombre de synchronisations
     pcache->instrument.n_syncs++;
@@ -118,188 +793,1479 @@ Cache_Error Cache_Sync(struct Cache *pcache) {
     return CACHE_OK;
 }
 
+//! Synchronisation du cache.
+Cache_Error Cache_Sync(struct Cache *pcache) {
+    unsigned long ticket = 0;
+    Cache_Error err;
+
+    Lock(pcache);
+    err = Sync_Blocks(pcache);
+    if (err == CACHE_OK && pcache->pcommit != NULL)
+        ticket = __atomic_add_fetch(&pcache->pcommit->issued, 1, __ATOMIC_RELEASE);
+    Unlock(pcache);
+
+    // Les fdatasync() se font sans le verrou du cache (sauf s'il est pris
+    // par l'appelant, comme Cache_Invalidate())
+    if (ticket != 0)
+        err = Commit(pcache, ticket);
+    return err;
+}
+
 //! Invalidation du cache.
 Cache_Error Cache_Invalidate(struct Cache *pcache) {
     int tmp;
     int c_err;
 
+    Lock(pcache);
+
     // Synchronisation du cache
     c_err = Cache_Sync(pcache);
     if (c_err != CACHE_OK) {
+    	Unlock(pcache);
     	return c_err;
     }
 
-    struct Cache_Block_Header *header;
-    // On met V à 0 dans tout les blocks
-    for (tmp = 0; tmp < pcache->nblocks; tmp++) {
-    	header = &pcache->headers[tmp];
-    	header->flags &= ~VALID; 
+    // Les blocs ne sont pas parcourus : ils deviennent tous invalides en
+    // changeant de génération (voir BLOCK_VALID()), et quittent l'index un à un
+    // quand ils sont redistribués. Au retour à 0 de la génération (après 2^32
+    // invalidations), un bloc resté libre depuis pourrait redevenir valide : on
+    // met alors V à 0 dans tous les blocs
+    if (__atomic_add_fetch(&pcache->gen, 1, __ATOMIC_RELEASE) == 0) {
+        for (tmp = 0; tmp < pcache->nblocks; tmp++) {
+            struct Cache_Block_Header *header = &pcache->headers[tmp];
+
+            Seq_Begin(header);
+            PUBLISH(header->flags, header->flags & ~VALID);
+            Seq_End(header);
+        }
+        Flag_Scan_Clear(pcache->fstate, pcache->nblocks, VALID);
+        Hash_Clear(pcache);
+    }
+    for (tmp = 0; tmp < pcache->nfiles; tmp++) {
+        if (pcache->files[tmp] != NULL)
+            pcache->files[tmp]->nres = 0;
     }
 
-    // Initialisation du pointeur sur le premier bloc
+    // Initialisation du pointeur sur le premier bloc et de la pile des blocs
+    // libérés
     pcache->pfree = pcache->headers;
+    pcache->nfreed = 0;
+    for (tmp = 0; tmp < pcache->nnodes; tmp++)
+        pcache->nodes[tmp].next = pcache->nodes[tmp].first;
+
+    // Le second niveau est oublié lui aussi
+    if (pcache->pspill != NULL)
+        Spill_Clear(pcache->pspill);
 
-    //on appéle le Invalidate de la stratégie
+    // La stratégie oublie ses blocs elle aussi sans les parcourir
     Strategy_Invalidate(pcache);
 
+    Unlock(pcache);
     return CACHE_OK;
 }
 
-//!lecture du Block
-static Cache_Error Read_Block(struct Cache *pcache, struct Cache_Block_Header *header) {
-    long cur_bloc_addr, end_of_file;
+//! Redimensionnement du cache sans invalidation.
+Cache_Error Cache_Resize(struct Cache *pcache, unsigned nblocks) {
+    struct Cache_Block_Header **order, *kept;
+    size_t arena_size = HAS_DATA(pcache) ? (size_t)nblocks * pcache->blocksz : 0;
+    char *arena;
+    unsigned char *touched, *dirty;
+    int n, nvalid, first, nkept, i;
 
-    // On cherche la longueur actuelle du fichier
-    int length = fseek(pcache->fp, 0, SEEK_END);
-    if (length < 0) {
-    	return CACHE_KO;
+    if (nblocks == 0 || pcache->nodes != NULL)
+        return CACHE_KO;
+    // Réserve des données du cache redimensionné
+    if ((arena = Numa_Alloc(arena_size, 0, 0)) == NULL && arena_size > 0)
+        return CACHE_KO;
+    if (pcache->pasync != NULL)
+        Async_Drain(pcache);
+
+    // Les lectures faites sans verrou désignent les blocs par leur ibcache, qui va changer
+    if (pcache->rbufs != NULL)
+        Drain_Reads(pcache);
+
+    // Blocs valides, dans l'ordre de remplacement de la stratégie
+    order = malloc(pcache->nblocks * sizeof(struct Cache_Block_Header *));
+    n = Strategy_Order(pcache, order);
+    for (i = nvalid = 0; i < n; i++) {
+        if (BLOCK_VALID(pcache, order[i]))
+            order[nvalid++] = order[i];
+    }
+
+    // Les premiers sont ceux que la stratégie remplacerait : ils sont évincés
+    // (sauvés si besoin, puis rétrogradés dans le second niveau)
+    first = nvalid > nblocks ? nvalid - nblocks : 0;
+    for (i = 0; i < first; i++) {
+        if ((order[i]->flags & MODIF) && Write_Block(pcache, order[i]) != CACHE_OK) {
+            free(order);
+            Numa_Free(arena, arena_size);
+            return CACHE_KO;
+        }
+    }
+    for (i = 0; i < first; i++) {
+        pcache->files[order[i]->ifile]->nres--;
+        if (pcache->pspill != NULL && !(order[i]->flags & NOREAD))
+            Spill_Demote(pcache->pspill, order[i]->ifile, order[i]->ibfile, order[i]->data);
+        PUBLISH(order[i]->flags, 0);
     }
 
-    //on réccupère la position actuelle du pointeur sur le flux fp
-    end_of_file = ftell(pcache->fp);
+    // Copie des entêtes conservés ; leurs données passent en tête de la
+    // nouvelle réserve, dans l'ordre de la stratégie (les seules recopiées)
+    nkept = nvalid - first;
+    kept = malloc((nkept > 0 ? nkept : 1) * sizeof(struct Cache_Block_Header));
+    for (i = 0; i < nkept; i++) {
+        kept[i] = *order[first + i];
+        if (arena != NULL)
+            memcpy(arena + (size_t)i * pcache->blocksz, kept[i].data, pcache->blocksz);
+    }
+    free(order);
+    Free_Blocks_Data(pcache);
+    pcache->arena = arena;
+    pcache->arena_size = arena_size;
 
-    // Adresse en octets du bloc dans le fichier
-    cur_bloc_addr = DADDR(pcache, header->ibfile);
+    // Les enregistrements accédés et modifiés suivent les blocs conservés
+    touched = malloc(nblocks * pcache->tsz);
+    dirty = malloc(nblocks * pcache->tsz);
+    for (i = 0; i < nkept; i++) {
+        memcpy(touched + (size_t)i * pcache->tsz, TOUCHED(pcache, kept[i].ibcache), pcache->tsz);
+        memcpy(dirty + (size_t)i * pcache->tsz, DIRTY(pcache, kept[i].ibcache), pcache->tsz);
+    }
+    free(pcache->touched);
+    free(pcache->dirty);
+    pcache->touched = touched;
+    pcache->dirty = dirty;
 
-    // Si le bloc cherché est au dela de la fin de fichier on n'effectue aucune entrée-sortie
-    if (cur_bloc_addr >= end_of_file) {
-        // On met le bloc à 0
-        memset(header->data, '\0', pcache->blocksz); 
-    } else {		//Si le bloc existe, on s'y rend puis on le lis
-    	if (fseek(pcache->fp, cur_bloc_addr, SEEK_SET) != 0) {
-    		return CACHE_KO;
-    	}
-    	if (fread(header->data, 1, pcache->blocksz, pcache->fp) != pcache->blocksz) {
-    		return CACHE_KO;
-    	}
-    } 
+    // Nouveau tableau des blocs, à 0 : les blocs conservés seront les premiers
+    // distribués (voir Alloc_Blocks())
+    Strategy_Close(pcache);
+    free(pcache->headers);
+    free(pcache->fstate);
+    pcache->headers = calloc(nblocks, sizeof(struct Cache_Block_Header));
+    pcache->fstate = calloc(nblocks, 1);
 
-    // On met à 1 V
-    header->flags |= VALID;
+    pcache->nblocks = nblocks;
+    Hash_Alloc(pcache);
+    pcache->freed = realloc(pcache->freed, nblocks * sizeof(int));
+    pcache->nfreed = 0;
+    pcache->pfree = pcache->headers;
+
+    // Les blocs conservés sont redonnés un à un à une nouvelle stratégie, ce
+    // qui reconstruit son ordre (liste LRU, file FIFO ; bits R de NUR)
+    pcache->pstrategy = Strategy_Create(pcache);
+    for (i = 0; i < nkept; i++) {
+        struct Cache_Block_Header *header = Strategy_Replace_Block(pcache);
+
+        assert(header == &pcache->headers[i]);
+        PUBLISH(header->ifile, kept[i].ifile);
+        PUBLISH(header->ibfile, kept[i].ibfile);
+        PUBLISH(header->flags, kept[i].flags);
+        PUBLISH(header->gen, pcache->gen);
+        FLAGS_COPY(pcache, header);
+        Hash_Insert(pcache, header);
+    }
+    free(kept);
+
+    // Les caches fantômes du conseiller gardent la capacité du cache
+    if (pcache->padvisor != NULL)
+        Advisor_Resize(pcache->padvisor, (size_t)nblocks * pcache->blocksz);
 
     return CACHE_OK;
 }
 
-//! Recherche d'un Block
-static struct Cache_Block_Header *Find_Block(struct Cache *pcache, int irfile) {
+//! Changement du nombre d'enregistrements par bloc.
+Cache_Error Cache_Set_Records(struct Cache *pcache, unsigned nrecords) {
+    size_t bytes = (size_t)pcache->nblocks * pcache->blocksz;
+
+    if (nrecords == 0 || pcache->pspill != NULL)
+        return CACHE_KO;
+    if (nrecords == pcache->nrecords)
+        return CACHE_OK;
+
+    // Les blocs actuels sont sauvés puis oubliés
+    if (pcache->pasync != NULL)
+        Async_Drain(pcache);
+    if (pcache->rbufs != NULL)
+        Drain_Reads(pcache);
+    if (Cache_Invalidate(pcache) != CACHE_OK)
+        return CACHE_KO;
+    Strategy_Close(pcache);
+    Free_Blocks_Data(pcache);
+
+    // Même capacité en octets, avec des blocs d'une autre taille
+    pcache->nrecords = nrecords;
+    pcache->blocksz = nrecords*pcache->recordsz;
+    pcache->nblocks = bytes / pcache->blocksz > 0 ? bytes / pcache->blocksz : 1;
+    Alloc_Blocks(pcache);
+    pcache->pstrategy = Strategy_Create(pcache);
+
+    return CACHE_OK;
+}
+
+//! Libération d'un bloc valide (déjà sauvé) : il reste connu de la stratégie
+//! mais Get_Free_Block() le distribuera en priorité
+static void Free_Block(struct Cache *pcache, struct Cache_Block_Header *header) {
+    Hash_Remove(pcache, header);
+    pcache->files[header->ifile]->nres--;
+    Seq_Begin(header);
+    PUBLISH(header->flags, 0);
+    FLAGS_COPY(pcache, header);
+    Seq_End(header);
+    pcache->freed[pcache->nfreed++] = header->ibcache;
+}
+
+//! Oubli des indications d'accès du fichier ifile
+static void Forget_Hints(struct Cache *pcache, int ifile) {
+    int k, n;
+
+    for (k = n = 0; k < pcache->nhints; k++) {
+        if (pcache->hints[k].ifile != ifile)
+            pcache->hints[n++] = pcache->hints[k];
+    }
+    pcache->nhints = n;
+}
+
+//! Fermeture d'un fichier d'un cache partagé.
+Cache_Error Cache_File_Close(struct Cache_File *pf) {
+    struct Cache *pcache = pf->pcache;
+    Cache_Error err = CACHE_OK;
     int tmp;
-    int ibfile = irfile / pcache->nrecords;
 
-    //On parcourt les block
+    if (pcache->pasync != NULL)
+        Async_Drain(pcache);
+
+    // Les blocs du fichier sont sauvés si besoin puis libérés : ils restent
+    // connus de la stratégie mais Get_Free_Block() les distribuera en priorité
     for (tmp = 0; tmp < pcache->nblocks; tmp++) {
-		struct Cache_Block_Header *header = &pcache->headers[tmp];
+        struct Cache_Block_Header *header = &pcache->headers[tmp];
+
+        if (BLOCK_VALID(pcache, header) && header->ifile == pf->ifile) {
+            if ((header->flags & MODIF) && Write_Block(pcache, header) != CACHE_OK)
+                err = CACHE_KO;
+            Free_Block(pcache, header);
+        }
+    }
+    Forget_Hints(pcache, pf->ifile);
+    if (pcache->pspill != NULL)
+        Spill_Forget_File(pcache->pspill, pf->ifile);
+    if (pcache->padvisor != NULL)
+        Advisor_Close_File(pcache->padvisor, pf->ifile);
+
+    Commit_Lock(pcache);
+    pcache->files[pf->ifile] = NULL;
+    Backend_Close(pf->pbackend);
+    Commit_Unlock(pcache);
+    free(pf->file);
+    free(pf);
+
+    return err;
+}
+
+//! Nombre de blocs d'un fichier présents dans le cache.
+unsigned Cache_File_Blocks(struct Cache_File *pf) {
+    return pf->nres;
+}
+
+//!lecture du Block
+static Cache_Error Read_Block(struct Cache *pcache, struct Cache_Block_Header *header) {
+    // Lecture du bloc à son adresse dans son fichier. Au dela de la fin du
+    // fichier le stockage rend des zéros sans effectuer d'entrée-sortie
+    if (HAS_DATA(pcache)
+        && BACKEND(pcache, header)->read(BACKEND(pcache, header), DADDR(pcache, header->ibfile),
+                                         header->data, pcache->blocksz) != CACHE_OK)
+        return CACHE_KO;
+    if (MAPPED(pcache))
+        BACKEND(pcache, header)->advise(BACKEND(pcache, header), DADDR(pcache, header->ibfile),
+                                        pcache->blocksz, CACHE_HINT_WILLNEED);
+    pcache->instrument.n_read += pcache->nrecords;
+
+    // On met à 1 V
+    PUBLISH(header->flags, header->flags | VALID);
+    FLAGS_COPY(pcache, header);
+
+    return CACHE_OK;
+}
+
+//! Recherche d'un Block
+static struct Cache_Block_Header *Find_Block(struct Cache *pcache, int ifile, Cache_Index irfile) {
+    struct Cache_Block_Header *header = Hash_Find(pcache, ifile, irfile / pcache->nrecords);
+
+    if (header != NULL)
+        pcache->instrument.n_hits++;
+    if (pcache->nodes != NULL)
+        Node_Access(pcache, header);
+    return header;
+}
+
+//! Le bloc header peut-il être remplacé par un bloc du fichier ifile (quotas) ?
+static int Victim_Allowed(struct Cache *pcache, struct Cache_Block_Header *header, int ifile) {
+    struct Cache_File *pf = pcache->files[ifile];
+    struct Cache_File *pvf;
+
+    if (!BLOCK_VALID(pcache, header))
+        return 1;
+    pvf = pcache->files[header->ifile];
+
+    // Un fichier à son maximum ne remplace que ses propres blocs...
+    if (pf->max > 0 && pf->nres >= pf->max)
+        return pvf == pf;
+    // ... et ne prend pas ses blocs à un fichier qui n'a pas plus que son minimum
+    return pvf == pf || pvf->nres > pvf->min;
+}
 
-		//S'ils sont valides et qu'ils on le même ibfile que celui cherché, on le retourne
-		if (header->flags & VALID && header->ibfile == ibfile) {
-		    pcache->instrument.n_hits++;
-		    return header;
-		}
+//! Choix du bloc à remplacer pour un bloc du fichier ifile, autre que keep
+static struct Cache_Block_Header *Replace_Block(struct Cache *pcache, int ifile, struct Cache_Block_Header *keep) {
+    struct Cache_Block_Header *header = Strategy_Replace_Block(pcache);
+    struct Cache_Block_Header **order;
+    int n, i;
+
+    // Keep vient d'être chargé (voir Read_Ahead()) : le choisir de nouveau ne
+    // change pas son état dans la stratégie, qui le compte déjà comme chargé.
+    // Elle choisit une seconde fois ; si c'est encore keep, il est rendu et
+    // Load_Block() renonce
+    if (header != NULL && header == keep)
+        header = Strategy_Replace_Block(pcache);
+    if (header == NULL || header == keep || Victim_Allowed(pcache, header, ifile))
+        return header;
+
+    // Le choix de la stratégie viole un quota : on prend le premier bloc
+    // autorisé dans son ordre de remplacement (à défaut, on garde son choix)
+    order = malloc(pcache->nblocks * sizeof(struct Cache_Block_Header *));
+    n = Strategy_Order(pcache, order);
+    for (i = 0; i < n; i++) {
+        if (order[i] != keep && Victim_Allowed(pcache, order[i], ifile)) {
+            header = order[i];
+            break;
+        }
     }
+    free(order);
+    return header;
+}
+
+//! Accès demandé à Get_Block()
+enum {
+    GET_READ,       //!< lecture
+    GET_WRITE,      //!< écriture d'un enregistrement
+    GET_OVERWRITE,  //!< écriture d'un enregistrement, tout le bloc sera récrit
+};
+
+//! Chargement du bloc ibfile du fichier ifile à la place du bloc choisi par la
+//! stratégie, autre que keep, bloc qui vient d'être chargé (NULL en cas d'erreur,
+//! ou si la stratégie ne propose que keep)
+static struct Cache_Block_Header *Load_Block(struct Cache *pcache, int ifile, Cache_Index ibfile, int access,
+                                             struct Cache_Block_Header *keep) {
+    struct Cache_Block_Header *header;
+    int demote, promoted;
 
+    // On fait appel à Replace_Block et retourne NULL si ce dernier n'existe pas
+    header = Replace_Block(pcache, ifile, keep);
+    if (header == NULL || header == keep) {
+        return NULL;
+    }
+    // Si V et M sont à 1, on le sauve sur le fichier
+    if ((header->flags & VALID) && (header->flags & MODIF)
+        && Write_Block(pcache, header) != CACHE_OK) {
+        return NULL;
+    }
+
+    // Le bloc demandé quitte le second niveau avant que l'ancien contenu n'y
+    // soit rétrogradé : la rétrogradation chasse le plus ancien bloc du second
+    // niveau, qui est justement le bloc demandé dans un parcours cyclique
+    if (access == GET_WRITE && pcache->write_policy == CACHE_WRITE_STREAM)
+        access = GET_OVERWRITE;
+    demote = pcache->pspill != NULL && BLOCK_VALID(pcache, header) && !(header->flags & NOREAD);
+    promoted = pcache->pspill != NULL && access != GET_OVERWRITE
+        && Spill_Promote(pcache->pspill, ifile, ibfile, demote ? pcache->spill_buf : header->data);
+
+    // L'ancien contenu du bloc quitte l'index ; désormais propre, il est
+    // rétrogradé dans le second niveau (sauf s'il est incomplet, ou d'une
+    // génération passée). Le bloc change d'identité : sa version reste impaire
+    // jusqu'à la fin du chargement
+    Seq_Begin(header);
+    if (header->flags & VALID)
+        Hash_Remove(pcache, header);
+    if (BLOCK_VALID(pcache, header)) {
+        pcache->files[header->ifile]->nres--;
+        if (demote)
+            Spill_Demote(pcache->pspill, header->ifile, header->ibfile, header->data);
+        if (MAPPED(pcache))
+            BACKEND(pcache, header)->advise(BACKEND(pcache, header), DADDR(pcache, header->ibfile),
+                                            pcache->blocksz, CACHE_HINT_DONTNEED);
+    }
+
+    //On rempli header, depuis le second niveau si le bloc s'y trouve
+    PUBLISH(header->flags, 0);
+    FLAGS_COPY(pcache, header);
+    PUBLISH(header->gen, pcache->gen);
+    PUBLISH(header->ifile, ifile);
+    PUBLISH(header->ibfile, ibfile);
+    if (access == GET_OVERWRITE) {
+        // Bloc qui va être récrit : alloué sans être lu (voir NOREAD). Projeté,
+        // il n'y a rien à compléter : les enregistrements sont dans le fichier
+        if (pcache->pspill != NULL)
+            Spill_Forget(pcache->pspill, ifile, header->ibfile);
+        PUBLISH(header->flags, header->flags | (MAPPED(pcache) ? VALID : VALID | NOREAD));
+        FLAGS_COPY(pcache, header);
+    }
+    else if (promoted) {
+        if (demote && HAS_DATA(pcache))
+            memcpy(header->data, pcache->spill_buf, pcache->blocksz);
+        PUBLISH(header->flags, header->flags | VALID);
+        FLAGS_COPY(pcache, header);
+        pcache->instrument.n_hits2++;
+    }
+    else {
+        if (pcache->pspill != NULL)
+            pcache->instrument.n_misses2++;
+        if (Read_Block(pcache, header) != CACHE_OK) {
+            Seq_End(header);
+            return NULL;
+        }
+    }
+    Hash_Insert(pcache, header);
+    Block_Loaded(pcache, header);
+    pcache->files[ifile]->nres++;
+    Seq_End(header);
+
+    return header;
+}
+
+/*
+ * Indications d'accès
+ * -------------------
+ * Les plages marquées séquentielles par Cache_Advise() déclenchent, à chaque
+ * défaut, la lecture anticipée des READAHEAD blocs suivants (au plus un quart
+ * du cache) et la libération de ceux qui sont loin derrière le parcours. Les
+ * plages aléatoires (ou normales) n'ont pas de lecture anticipée.
+ */
+
+//! Nombre maximal de blocs lus d'avance dans une plage séquentielle
+#define READAHEAD 8
+
+//! Indication de la plage la plus récente contenant l'enregistrement irfile du fichier ifile (ou NULL)
+static struct Cache_Hint_Range *Hint_Of(struct Cache *pcache, int ifile, Cache_Index irfile) {
+    int k;
+
+    for (k = pcache->nhints - 1; k >= 0; k--) {
+        struct Cache_Hint_Range *pr = &pcache->hints[k];
+
+        if (pr->ifile == ifile && irfile >= pr->first && irfile - pr->first < pr->count)
+            return pr;
+    }
     return NULL;
 }
 
+//! Ajout d'une plage : celles qu'elle recouvre entièrement sont oubliées
+static void Set_Hint(struct Cache *pcache, int ifile, Cache_Index first, Cache_Index count, Cache_Hint hint) {
+    struct Cache_Hint_Range *pr;
+    int k, n;
+
+    for (k = n = 0; k < pcache->nhints; k++) {
+        pr = &pcache->hints[k];
+        if (pr->ifile != ifile || pr->first < first || pr->first + pr->count > first + count)
+            pcache->hints[n++] = *pr;
+    }
+    if ((pcache->nhints = n) == CACHE_MAX_HINTS) {
+        memmove(pcache->hints, pcache->hints + 1, (CACHE_MAX_HINTS - 1) * sizeof(struct Cache_Hint_Range));
+        pcache->nhints--;
+    }
+    pr = &pcache->hints[pcache->nhints++];
+    pr->ifile = ifile;
+    pr->first = first;
+    pr->count = count;
+    pr->hint = hint;
+}
+
+//! Libération du bloc header, sauvé si besoin ; les modifications de ses
+//! enregistrements dfirst à dfirst + dcount - 1 (indices-fichier) sont abandonnées
+static Cache_Error Drop_Block(struct Cache *pcache, struct Cache_Block_Header *header,
+                              Cache_Index dfirst, Cache_Index dcount) {
+    Cache_Index base = header->ibfile * pcache->nrecords;
+    unsigned char *row = DIRTY(pcache, header->ibcache);
+    Cache_Index ir;
+
+    // Les enregistrements abandonnés ne sont plus à jour : comme ceux d'un
+    // bloc non lu, ils ne doivent pas être écrits avec leurs voisins
+    if ((header->flags & MODIF) && dcount > 0) {
+        for (ir = dfirst > base ? dfirst - base : 0; ir < pcache->nrecords && base + ir < dfirst + dcount; ir++)
+            row[ir >> 3] &= ~(1u << (ir & 7));
+        PUBLISH(header->flags, header->flags | NOREAD);
+    }
+    if ((header->flags & MODIF) && Write_Block(pcache, header) != CACHE_OK)
+        return CACHE_KO;
+    Free_Block(pcache, header);
+    return CACHE_OK;
+}
+
+//! Libération des blocs firstb à lastb du fichier ifile présents dans le cache (sauf keep),
+//! en abandonnant les modifications des enregistrements dfirst à dfirst + dcount - 1
+static Cache_Error Drop_Blocks(struct Cache *pcache, int ifile, Cache_Index firstb, Cache_Index lastb,
+                               struct Cache_Block_Header *keep, Cache_Index dfirst, Cache_Index dcount) {
+    struct Cache_Block_Header *header;
+    Cache_Index b;
+
+    // Une grande plage est parcourue par les blocs du cache, une petite par l'index
+    if (lastb - firstb >= (Cache_Index)pcache->nblocks) {
+        for (b = 0; b < pcache->nblocks; b++) {
+            header = &pcache->headers[b];
+            if (BLOCK_VALID(pcache, header) && header->ifile == ifile && header != keep
+                && header->ibfile >= firstb && header->ibfile <= lastb
+                && Drop_Block(pcache, header, dfirst, dcount) != CACHE_OK)
+                return CACHE_KO;
+        }
+        return CACHE_OK;
+    }
+    for (b = firstb; b <= lastb; b++) {
+        if ((header = Hash_Find(pcache, ifile, b)) != NULL && header != keep
+            && Drop_Block(pcache, header, dfirst, dcount) != CACHE_OK)
+            return CACHE_KO;
+    }
+    return CACHE_OK;
+}
+
+//! Chargement des blocs firstb à lastb du fichier ifile absents du cache (sauf si keep serait
+//! remplacé) ; s'ils sont annoncés (will), ils sont aussi signalés à la stratégie comme accédés
+static void Prefetch_Blocks(struct Cache *pcache, int ifile, Cache_Index firstb, Cache_Index lastb,
+                            struct Cache_Block_Header *keep, int will) {
+    struct Cache_Block_Header *header;
+    Cache_Index b;
+
+    for (b = firstb; b <= lastb; b++) {
+        if ((header = Hash_Find(pcache, ifile, b)) == NULL
+            && (header = Load_Block(pcache, ifile, b, GET_READ, keep)) == NULL)
+            break;
+        if (will)
+            Strategy_Read(pcache, header);
+    }
+}
+
+//! Défaut sur le bloc header d'une plage séquentielle : libération derrière, lecture devant
+static void Read_Ahead(struct Cache *pcache, struct Cache_Block_Header *header, struct Cache_Hint_Range *pr) {
+    int ra = pcache->nblocks / 4 < READAHEAD ? pcache->nblocks / 4 : READAHEAD;
+    Cache_Index firstb = pr->first / pcache->nrecords;
+    Cache_Index lastb = (pr->first + pr->count - 1) / pcache->nrecords;
+    Cache_Index ib = header->ibfile;
+    int ifile = header->ifile;
+
+    if (ra == 0)
+        return;
+    if (ib - 2 * ra > firstb)
+        Drop_Blocks(pcache, ifile, ib - 3 * ra > firstb ? ib - 3 * ra : firstb, ib - 2 * ra - 1, header, 0, 0);
+    Prefetch_Blocks(pcache, ifile, ib + 1, ib + ra < lastb ? ib + ra : lastb, header, 0);
+}
+
 //! Réccupère un Block grace à son irfile
-struct Cache_Block_Header *Get_Block(struct Cache *pcache, int irfile) {
+static struct Cache_Block_Header *Get_Block(struct Cache *pcache, int ifile, Cache_Index irfile, int access) {
     struct Cache_Block_Header *header;
+    struct Cache_Hint_Range *pr;
 
     //Si le Block est nul l'enregistrement n'est pas dans le cache
-    header = Find_Block(pcache, irfile);
+    header = Find_Block(pcache, ifile, irfile);
     if (header == NULL) {
-        
-        // On fait appel à Strategy_Replace_Block et retourne NULL si ce dernier n'existe pas
-		header = Strategy_Replace_Block(pcache);
-		if (header == NULL) {
-			return NULL;
-		}
-		// Si V et M sont à 1, on le sauve sur le fichier
-		Cache_Error c_err = Write_Block(pcache, header);
-		if ((header->flags & VALID) && (header->flags & MODIF) && (c_err != CACHE_OK)) {
-	    	return NULL;
-		}
-	
-        //On rempli header
-        header->flags = 0;
-        header->ibfile = irfile / pcache->nrecords; /* indice du bloc dans le fichier */
-        if (Read_Block(pcache, header) != CACHE_OK) {
-        	return NULL;
-        }
+        header = Load_Block(pcache, ifile, irfile / pcache->nrecords, access, NULL);
+        if (header != NULL && pcache->nhints > 0
+            && (pr = Hint_Of(pcache, ifile, irfile)) != NULL && pr->hint == CACHE_HINT_SEQUENTIAL)
+            Read_Ahead(pcache, header, pr);
     }
 
     //On retourne le header
     return header;
 }
 
-//! Vérification de la nécessité de synchroniser
-static Cache_Error Verify_Sync_Need(struct Cache *pcache) {
-    static int sync_freq = NSYNC;
+//! Indication sur les accès à venir aux enregistrements first à first + count - 1 du fichier ifile
+static Cache_Error Hint_Records(struct Cache *pcache, int ifile, Cache_Index first, Cache_Index count, Cache_Hint hint) {
+    struct Cache_Backend *pbe = pcache->files[ifile]->pbackend;
+    int nr = pcache->nrecords;
+    Cache_Index firstb = first / nr, lastb = (first + count - 1) / nr;
+    Cache_Error err = CACHE_OK;
+
+    if (first < 0 || count <= 0)
+        return CACHE_KO;
+
+    switch (hint) {
+    case CACHE_HINT_WILLNEED:
+        // Pas plus de blocs que le cache n'en contient
+        if (lastb - firstb >= (Cache_Index)pcache->nblocks)
+            lastb = firstb + pcache->nblocks - 1;
+        Prefetch_Blocks(pcache, ifile, firstb, lastb, NULL, 1);
+        break;
+    case CACHE_HINT_DONTNEED:
+        // Seuls les blocs entièrement dans la plage sont libérés
+        err = Drop_Blocks(pcache, ifile, (first + nr - 1) / nr, (first + count) / nr - 1, NULL, 0, 0);
+        break;
+    default:
+        Set_Hint(pcache, ifile, first, count, hint);
+        break;
+    }
+
+    // Le noyau gère lui aussi un cache du fichier
+    pbe->advise(pbe, (off_t)first * pcache->recordsz, (size_t)count * pcache->recordsz, hint);
+    return err;
+}
+
+//! Invalidation des enregistrements first à first + count - 1 du fichier ifile
+static Cache_Error Invalidate_Records(struct Cache *pcache, int ifile, Cache_Index first, Cache_Index count,
+                                      int discard) {
+    int nr = pcache->nrecords;
+    Cache_Index firstb = first / nr, lastb = (first + count - 1) / nr;
+    Cache_Error err;
 
-    if (--sync_freq == 0) {
-		sync_freq = NSYNC;
-		return Cache_Sync(pcache);
+    if (first < 0 || count <= 0)
+        return CACHE_KO;
+    // Les enregistrements d'un fichier projeté sont déjà dans le fichier dès
+    // leur écriture : leurs modifications ne peuvent plus être abandonnées
+    if (discard && MAPPED(pcache))
+        return CACHE_KO;
+
+    // Tous les blocs touchés par la plage sont libérés, même en partie : le
+    // second niveau ne doit pas non plus en garder une copie
+    err = Drop_Blocks(pcache, ifile, firstb, lastb, NULL, first, discard ? count : 0);
+    if (pcache->pspill != NULL)
+        Spill_Forget_Range(pcache->pspill, ifile, firstb, lastb);
+    return err;
+}
+
+//! Vérification de la nécessité de synchroniser (compteur propre à chaque cache)
+static Cache_Error Verify_Sync_Need(struct Cache *pcache) {
+    if (--pcache->sync_count == 0) {
+		pcache->sync_count = NSYNC;
+		return Sync_Blocks(pcache);
     }
     
     else return CACHE_OK;
 }
 
-//! Lecture  (à travers le cache).
-Cache_Error Cache_Read(struct Cache *pcache, int irfile, void *precord) {
+//! Rejeu d'un accès par le conseiller ; en mode automatique, examen périodique du conseil
+static void Advise(struct Cache *pcache, int ifile, Cache_Index irfile, int write) {
+    struct Cache_Advice adv;
+    int c, cur = -1, best = -1;
+
+    Advisor_Access(pcache->padvisor, ifile, irfile, write);
+    if (pcache->advisor != CACHE_ADVISOR_AUTO || ++pcache->advisor_count < ADVISOR_PERIOD)
+        return;
+    pcache->advisor_count = 0;
+
+    // On ne change de taille de bloc que pour un gain net : sinon deux classes
+    // proches se succéderaient à chaque période
+    Advisor_Get(pcache->padvisor, &adv, 1);
+    for (c = 0; c < adv.nclasses; c++) {
+        if (adv.nrecords[c] == pcache->nrecords)
+            cur = c;
+        if (adv.nrecords[c] == adv.best)
+            best = c;
+    }
+    if (cur >= 0 && best != cur && adv.cost[best] < ADVISOR_GAIN * adv.cost[cur])
+        Cache_Set_Records(pcache, adv.best);
+}
+
+//! Lecture des enregistrements d'un bloc non lu qui n'ont pas encore été écrits
+static Cache_Error Fill_Block(struct Cache *pcache, struct Cache_Block_Header *header) {
+    const unsigned char *row = TOUCHED(pcache, header->ibcache);
+    char *buf;
+    unsigned ir;
+
+    if (HAS_DATA(pcache)) {
+        buf = malloc(pcache->blocksz);
+        if (BACKEND(pcache, header)->read(BACKEND(pcache, header), DADDR(pcache, header->ibfile),
+                                          buf, pcache->blocksz) != CACHE_OK) {
+            free(buf);
+            return CACHE_KO;
+        }
+        for (ir = 0; ir < pcache->nrecords; ir++) {
+            if (!ROW_BIT(row, ir))
+                memcpy(header->data + ir * pcache->recordsz, buf + ir * pcache->recordsz, pcache->recordsz);
+        }
+        free(buf);
+    }
+    pcache->instrument.n_read += pcache->nrecords;
+    PUBLISH(header->flags, header->flags & ~NOREAD);
+
+    return CACHE_OK;
+}
+
+//! Écriture directe dans le fichier d'un enregistrement absent du cache (CACHE_WRITE_AROUND)
+static Cache_Error Write_Around(struct Cache *pcache, int ifile, Cache_Index irfile, const void *precord) {
+    struct Cache_Backend *pbe = pcache->files[ifile]->pbackend;
+
+    if (pcache->nodes != NULL)
+        Node_Access(pcache, NULL);
+    if (pcache->pasync != NULL)
+        Async_Stale(pcache, ifile, irfile / pcache->nrecords);
+
+    // Une éventuelle copie du bloc dans le second niveau devient périmée
+    if (pcache->pspill != NULL)
+        Spill_Forget(pcache->pspill, ifile, irfile / pcache->nrecords);
+    if ((HAS_DATA(pcache) || MAPPED(pcache))
+        && pbe->write(pbe, (off_t)irfile * pcache->recordsz, precord, pcache->recordsz) != CACHE_OK)
+        return CACHE_KO;
+    pcache->instrument.n_written++;
+
+    return Verify_Sync_Need(pcache);
+}
+
+//! Lecture d'un enregistrement du fichier ifile
+static Cache_Error Copy_Record(struct Cache *pcache, struct Cache_Block_Header *header,
+                               int ifile, Cache_Index irfile, void *precord);
+
+static Cache_Error Read_Record(struct Cache *pcache, int ifile, Cache_Index irfile, void *precord) {
 	struct Cache_Block_Header *header;
 
 	//On incrémente le nombre de lectures
     pcache->instrument.n_reads++;
 
     //Si le header est NULL on retourne CACHE_KO
-    header = Get_Block(pcache, irfile);
+    header = Get_Block(pcache, ifile, irfile, GET_READ);
     if (header == NULL) {
     	return CACHE_KO;
     }
+    return Copy_Record(pcache, header, ifile, irfile, precord);
+}
+
+//! Lecture de l'enregistrement irfile du fichier ifile dans son bloc header, présent dans le cache
+static Cache_Error Copy_Record(struct Cache *pcache, struct Cache_Block_Header *header,
+                               int ifile, Cache_Index irfile, void *precord) {
+    //Un bloc non lu est complété avant d'y lire un enregistrement qui n'a pas été écrit
+    if ((header->flags & NOREAD) && !ROW_BIT(TOUCHED(pcache, header->ibcache), irfile % pcache->nrecords)) {
+        Cache_Error err;
+
+        Seq_Begin(header);
+        err = Fill_Block(pcache, header);
+        Seq_End(header);
+        if (err != CACHE_OK)
+            return CACHE_KO;
+    }
 
     //On copie la mémoire
-    memcpy(precord, ADDR(pcache, irfile, header), pcache->recordsz);
+    if (HAS_DATA(pcache))
+        memcpy(precord, ADDR(pcache, irfile, header), pcache->recordsz);
+    else if (MAPPED(pcache)
+             && BACKEND(pcache, header)->read(BACKEND(pcache, header), (off_t)irfile * pcache->recordsz,
+                                              precord, pcache->recordsz) != CACHE_OK)
+        return CACHE_KO;
 
     //La stratégie lis
     Strategy_Read(pcache, header);
+    Touch_Record(pcache, header, irfile);
+    if (pcache->padvisor != NULL)
+        Advise(pcache, ifile, irfile, 0);
 
     //on vérifie s'il est nécéssaire de synchroniser
     return Verify_Sync_Need(pcache);
 }
 
-//! Écriture (à travers le cache).
-Cache_Error Cache_Write(struct Cache *pcache, int irfile, const void *precord) {
+//! Écriture d'un enregistrement du fichier ifile (overwrite : tout son bloc sera récrit)
+static Cache_Error Write_Record(struct Cache *pcache, int ifile, Cache_Index irfile, const void *precord, int overwrite) {
     struct Cache_Block_Header *header;
 
     //On incrémente le nombre d'écritures
     pcache->instrument.n_writes++;
 
-    //Si le bloc n'existe pas, on retourne CACHE_KO
-    header = Get_Block(pcache, irfile);
+    //Sans allocation sur écriture, un bloc absent n'est pas chargé
+    if (pcache->write_policy == CACHE_WRITE_AROUND
+        && Hash_Find(pcache, ifile, irfile / pcache->nrecords) == NULL)
+        return Write_Around(pcache, ifile, irfile, precord);
+
+    //Si le bloc n'existe pas, on retourne CACHE_KO ; un bloc d'un seul
+    //enregistrement est entièrement récrit
+    header = Get_Block(pcache, ifile, irfile,
+                       overwrite || pcache->nrecords == 1 ? GET_OVERWRITE : GET_WRITE);
     if (header == NULL)
     	return CACHE_KO;
     
     //On copie les données du buffer dans le cache
-    memcpy(ADDR(pcache, irfile, header), precord, pcache->recordsz);
+    Seq_Begin(header);
+    if (HAS_DATA(pcache))
+        memcpy(ADDR(pcache, irfile, header), precord, pcache->recordsz);
+    else if (MAPPED(pcache)
+             && BACKEND(pcache, header)->write(BACKEND(pcache, header), (off_t)irfile * pcache->recordsz,
+                                               precord, pcache->recordsz) != CACHE_OK) {
+        Seq_End(header);
+        return CACHE_KO;
+    }
 
-    //On ajoute M aux flags
-    header->flags |= MODIF;
+    //On ajoute M aux flags, et l'enregistrement aux enregistrements modifiés
+    PUBLISH(header->flags, header->flags | MODIF);
+    FLAGS_COPY(pcache, header);
+    ROW_SET(DIRTY(pcache, header->ibcache), irfile % pcache->nrecords);
+    Seq_End(header);
 
     //On fait appel au Write de la stratégie
     Strategy_Write(pcache, header);
+    Touch_Record(pcache, header, irfile);
+    if ((header->flags & NOREAD) && Row_Full(pcache, TOUCHED(pcache, header->ibcache)))
+        PUBLISH(header->flags, header->flags & ~NOREAD);
+    if (pcache->padvisor != NULL)
+        Advise(pcache, ifile, irfile, 1);
 
     //On vérifie s'il faut synchroniser
     return Verify_Sync_Need(pcache);
 }
 
-//! Résultat de l'instrumentation.
-struct Cache_Instrument *Cache_Get_Instrument(struct Cache *pcache) {
-    //Copie du Cache_Instrument
-    struct Cache_Instrument copy = pcache->instrument;
+//! Lecture depuis l'API : sans verrou si l'enregistrement est présent (mode concurrent)
+static Cache_Error Shared_Read(struct Cache *pcache, int ifile, Cache_Index irfile, void *precord) {
+    Cache_Error err;
+
+    if (pcache->rbufs != NULL && pcache->padvisor == NULL
+        && Read_Lockless(pcache, ifile, irfile, precord))
+        return CACHE_OK;
+    Lock(pcache);
+    err = Read_Record(pcache, ifile, irfile, precord);
+    Unlock(pcache);
+    return err;
+}
+
+//! Écriture depuis l'API
+static Cache_Error Shared_Write(struct Cache *pcache, int ifile, Cache_Index irfile, const void *precord) {
+    Cache_Error err;
+
+    Lock(pcache);
+    err = Write_Record(pcache, ifile, irfile, precord, 0);
+    Unlock(pcache);
+    return err;
+}
+
+//! Indication depuis l'API
+static Cache_Error Shared_Hint(struct Cache *pcache, int ifile, Cache_Index first_irfile, Cache_Index count, Cache_Hint hint) {
+    Cache_Error err;
+
+    Lock(pcache);
+    err = Hint_Records(pcache, ifile, first_irfile, count, hint);
+    Unlock(pcache);
+    return err;
+}
+
+//! Invalidation d'une plage depuis l'API
+static Cache_Error Shared_Invalidate(struct Cache *pcache, int ifile, Cache_Index first_irfile, Cache_Index count,
+                                     int discard) {
+    Cache_Error err;
+
+    // Une lecture asynchrone en cours pourrait installer l'ancien contenu
+    if (pcache->pasync != NULL)
+        Async_Drain(pcache);
+    Lock(pcache);
+    err = Invalidate_Records(pcache, ifile, first_irfile, count, discard);
+    Unlock(pcache);
+    return err;
+}
+
+//! Lecture  (à travers le cache).
+Cache_Error Cache_Read(struct Cache *pcache, Cache_Index irfile, void *precord) {
+    if (pcache->nfiles == 0 || pcache->files[0] == NULL)
+        return CACHE_KO;
+    return Shared_Read(pcache, 0, irfile, precord);
+}
+
+//! Écriture (à travers le cache).
+Cache_Error Cache_Write(struct Cache *pcache, Cache_Index irfile, const void *precord) {
+    if (pcache->nfiles == 0 || pcache->files[0] == NULL)
+        return CACHE_KO;
+    return Shared_Write(pcache, 0, irfile, precord);
+}
+
+//! Indication sur les accès à venir.
+Cache_Error Cache_Advise(struct Cache *pcache, Cache_Index first_irfile, Cache_Index count, Cache_Hint hint) {
+    if (pcache->nfiles == 0 || pcache->files[0] == NULL)
+        return CACHE_KO;
+    return Shared_Hint(pcache, 0, first_irfile, count, hint);
+}
+
+//! Indication sur les accès à venir dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Advise(struct Cache_File *pf, Cache_Index first_irfile, Cache_Index count, Cache_Hint hint) {
+    return Shared_Hint(pf->pcache, pf->ifile, first_irfile, count, hint);
+}
+
+//! Invalidation d'une plage d'enregistrements.
+Cache_Error Cache_Invalidate_Range(struct Cache *pcache, Cache_Index first_irfile, Cache_Index count, int discard) {
+    if (pcache->nfiles == 0 || pcache->files[0] == NULL)
+        return CACHE_KO;
+    return Shared_Invalidate(pcache, 0, first_irfile, count, discard);
+}
+
+//! Invalidation d'une plage d'enregistrements d'un fichier d'un cache partagé.
+Cache_Error Cache_File_Invalidate_Range(struct Cache_File *pf, Cache_Index first_irfile, Cache_Index count,
+                                        int discard) {
+    return Shared_Invalidate(pf->pcache, pf->ifile, first_irfile, count, discard);
+}
+
+//! Écriture de count enregistrements consécutifs depuis l'API
+static Cache_Error Shared_Write_Many(struct Cache *pcache, int ifile, Cache_Index first_irfile, Cache_Index count,
+                                     const void *precords) {
+    const char *precord = precords;
+    Cache_Index irfile, last = first_irfile + count;
+    Cache_Error err = CACHE_OK;
+
+    Lock(pcache);
+    for (irfile = first_irfile; irfile < last && err == CACHE_OK; irfile++, precord += pcache->recordsz) {
+        // Le bloc est-il entièrement couvert par les enregistrements écrits ?
+        Cache_Index first = irfile - irfile % pcache->nrecords;
+        int overwrite = first >= first_irfile && first + pcache->nrecords <= last;
+
+        err = Write_Record(pcache, ifile, irfile, precord, overwrite);
+    }
+    Unlock(pcache);
+    return err;
+}
+
+//! Écriture de count enregistrements consécutifs (à travers le cache).
+Cache_Error Cache_Write_Many(struct Cache *pcache, Cache_Index first_irfile, Cache_Index count, const void *precords) {
+    if (pcache->nfiles == 0 || pcache->files[0] == NULL)
+        return CACHE_KO;
+    return Shared_Write_Many(pcache, 0, first_irfile, count, precords);
+}
+
+//! Écriture de count enregistrements consécutifs dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Write_Many(struct Cache_File *pf, Cache_Index first_irfile, Cache_Index count,
+                                  const void *precords) {
+    return Shared_Write_Many(pf->pcache, pf->ifile, first_irfile, count, precords);
+}
+
+//! Lecture dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Read(struct Cache_File *pf, Cache_Index irfile, void *precord) {
+    return Shared_Read(pf->pcache, pf->ifile, irfile, precord);
+}
+
+//! Écriture dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Write(struct Cache_File *pf, Cache_Index irfile, const void *precord) {
+    return Shared_Write(pf->pcache, pf->ifile, irfile, precord);
+}
+
+/*
+ * Lectures asynchrones
+ * --------------------
+ * Un défaut de Cache_Read_Async() crée une lecture en cours du bloc (struct
+ * Async_Block), à laquelle s'ajoutent les défauts suivants sur le même bloc
+ * (struct Async_Waiter), puis la met dans la file des threads
+ * d'entrées-sorties. Un de ces threads lit le bloc dans un tampon privé, sans
+ * le verrou du cache ; il prend ensuite le verrou pour installer le bloc
+ * (Load_Block() sans lecture, puis copie du tampon), sert chaque demande et
+ * appelle les fonctions de fin, verrou relâché.
+ *
+ * Si le bloc est écrit dans le fichier pendant sa lecture (Write_Block(),
+ * Write_Around()), le tampon est périmé (stale) : le bloc est alors relu
+ * normalement, verrou pris. Les lectures en cours sont protégées par le
+ * verrou du cache, la file et le compteur par celui de struct Cache_Async.
+ */
+
+//! Nombre de threads d'entrées-sorties
+#define ASYNC_THREADS 4
+
+struct Async_Waiter {
+    Cache_Index irfile;
+    void *precord;
+    Cache_Callback cb;
+    void *arg;
+    Cache_Error err;
+    struct Async_Waiter *next;
+};
+
+struct Async_Block {
+    int ifile;
+    Cache_Index ibfile;
+    int stale;                      /* écrit dans le fichier pendant la lecture */
+    char *buf;                      /* contenu lu (ou NULL sans données) */
+    struct Async_Waiter *waiters;
+    struct Async_Block *next;       /* lecture en cours suivante */
+    struct Async_Block *qnext;      /* suivante dans la file */
+};
+
+struct Cache_Async {
+    pthread_mutex_t lock;
+    pthread_cond_t work;            /* nouvelle lecture dans la file, ou arrêt */
+    pthread_cond_t idle;            /* plus aucune lecture en cours */
+    struct Async_Block *head, *tail; /* file des lectures à faire */
+    struct Async_Block *pending;    /* lectures en cours (verrou du cache) */
+    unsigned npending;              /* lectures pas encore installées */
+    int stop;
+    pthread_t threads[ASYNC_THREADS];
+};
+
+static void Async_Stale(struct Cache *pcache, int ifile, Cache_Index ibfile) {
+    struct Async_Block *pab;
+
+    for (pab = pcache->pasync->pending; pab != NULL; pab = pab->next) {
+        if (pab->ifile == ifile && pab->ibfile == ibfile)
+            pab->stale = 1;
+    }
+}
+
+//! Installation du bloc lu par pab (verrou pris) et copie des enregistrements demandés
+static void Async_Install(struct Cache *pcache, struct Async_Block *pab, Cache_Error err) {
+    struct Async_Block **pp;
+    struct Cache_Block_Header *header;
+    struct Async_Waiter *pw;
+
+    for (pp = &pcache->pasync->pending; *pp != pab; pp = &(*pp)->next) {}
+    *pp = pab->next;
+
+    // Le bloc a pu être chargé entre-temps par une lecture synchrone
+    header = Hash_Find(pcache, pab->ifile, pab->ibfile);
+    if (header == NULL && err == CACHE_OK && !pab->stale) {
+        header = Load_Block(pcache, pab->ifile, pab->ibfile, GET_OVERWRITE, NULL);
+        if (header != NULL) {
+            Seq_Begin(header);
+            if (HAS_DATA(pcache))
+                memcpy(header->data, pab->buf, pcache->blocksz);
+            PUBLISH(header->flags, header->flags & ~NOREAD);
+            pcache->instrument.n_read += pcache->nrecords;
+            Seq_End(header);
+        }
+    }
+    else if (header == NULL)
+        header = Load_Block(pcache, pab->ifile, pab->ibfile, GET_READ, NULL);
+
+    for (pw = pab->waiters; pw != NULL; pw = pw->next)
+        pw->err = header != NULL ? Copy_Record(pcache, header, pab->ifile, pw->irfile, pw->precord) : CACHE_KO;
+}
+
+//! Thread d'entrées-sorties
+static void *Async_Thread(void *arg) {
+    struct Cache *pcache = arg;
+    struct Cache_Async *pa = pcache->pasync;
+
+    for (;;) {
+        struct Async_Block *pab;
+        struct Async_Waiter *pw;
+        Cache_Error err = CACHE_OK;
+
+        pthread_mutex_lock(&pa->lock);
+        while (pa->head == NULL && !pa->stop)
+            pthread_cond_wait(&pa->work, &pa->lock);
+        if ((pab = pa->head) == NULL) {
+            pthread_mutex_unlock(&pa->lock);
+            return NULL;
+        }
+        if ((pa->head = pab->qnext) == NULL)
+            pa->tail = NULL;
+        pthread_mutex_unlock(&pa->lock);
+
+        // Lecture sans le verrou du cache : les fichiers ne sont pas fermés
+        // tant que la lecture n'est pas installée (Async_Drain())
+        if (pab->buf != NULL) {
+            struct Cache_Backend *pbe = pcache->files[pab->ifile]->pbackend;
+
+            err = pbe->read(pbe, DADDR(pcache, pab->ibfile), pab->buf, pcache->blocksz);
+        }
+        else if (MAPPED(pcache)) {
+            struct Cache_Backend *pbe = pcache->files[pab->ifile]->pbackend;
+
+            // Le noyau lit les pages du bloc pendant que l'appelant continue
+            pbe->advise(pbe, DADDR(pcache, pab->ibfile), pcache->blocksz, CACHE_HINT_WILLNEED);
+        }
+
+        Lock(pcache);
+        Async_Install(pcache, pab, err);
+        Unlock(pcache);
+
+        pthread_mutex_lock(&pa->lock);
+        if (--pa->npending == 0)
+            pthread_cond_broadcast(&pa->idle);
+        pthread_mutex_unlock(&pa->lock);
+
+        // Fonctions de fin, verrou relâché
+        while ((pw = pab->waiters) != NULL) {
+            pab->waiters = pw->next;
+            pw->cb(pw->arg, pw->irfile, pw->precord, pw->err);
+            free(pw);
+        }
+        free(pab->buf);
+        free(pab);
+    }
+}
+
+//! Création des threads d'entrées-sorties (verrou pris)
+static struct Cache_Async *Async_Start(struct Cache *pcache) {
+    struct Cache_Async *pa = calloc(1, sizeof(struct Cache_Async));
+    int k;
+
+    pthread_mutex_init(&pa->lock, NULL);
+    pthread_cond_init(&pa->work, NULL);
+    pthread_cond_init(&pa->idle, NULL);
+    pcache->pasync = pa;
+    for (k = 0; k < ASYNC_THREADS; k++)
+        pthread_create(&pa->threads[k], NULL, Async_Thread, pcache);
+    return pa;
+}
+
+static void Async_Drain(struct Cache *pcache) {
+    struct Cache_Async *pa = pcache->pasync;
+
+    pthread_mutex_lock(&pa->lock);
+    while (pa->npending > 0)
+        pthread_cond_wait(&pa->idle, &pa->lock);
+    pthread_mutex_unlock(&pa->lock);
+}
+
+static void Async_Stop(struct Cache *pcache) {
+    struct Cache_Async *pa = pcache->pasync;
+    int k;
+
+    Async_Drain(pcache);
+    pthread_mutex_lock(&pa->lock);
+    pa->stop = 1;
+    pthread_cond_broadcast(&pa->work);
+    pthread_mutex_unlock(&pa->lock);
+    for (k = 0; k < ASYNC_THREADS; k++)
+        pthread_join(pa->threads[k], NULL);
+
+    pthread_cond_destroy(&pa->idle);
+    pthread_cond_destroy(&pa->work);
+    pthread_mutex_destroy(&pa->lock);
+    free(pa);
+    pcache->pasync = NULL;
+}
+
+//! Lecture sans attente de l'enregistrement irfile du fichier ifile
+static Cache_Error Async_Read(struct Cache *pcache, int ifile, Cache_Index irfile, void *precord,
+                              Cache_Callback cb, void *arg) {
+    Cache_Index ibfile = irfile / pcache->nrecords;
+    struct Cache_Async *pa;
+    struct Async_Block *pab;
+    struct Async_Waiter *pw;
+    Cache_Error err;
+
+    if (pcache->concurrency == CACHE_SINGLE)
+        return CACHE_KO;
+    if (pcache->padvisor != NULL)
+        return Shared_Read(pcache, ifile, irfile, precord);
+    if (pcache->rbufs != NULL && Read_Lockless(pcache, ifile, irfile, precord))
+        return CACHE_OK;
+
+    // Succès : lecture ordinaire
+    Lock(pcache);
+    if (Hash_Find(pcache, ifile, ibfile) != NULL) {
+        err = Read_Record(pcache, ifile, irfile, precord);
+        Unlock(pcache);
+        return err;
+    }
+    pcache->instrument.n_reads++;
+    if (pcache->nodes != NULL)
+        Node_Access(pcache, NULL);
+
+    // Défaut : ajout à la lecture en cours du bloc, ou nouvelle lecture
+    pa = pcache->pasync != NULL ? pcache->pasync : Async_Start(pcache);
+    for (pab = pa->pending; pab != NULL && (pab->ifile != ifile || pab->ibfile != ibfile); pab = pab->next) {}
+    if (pab == NULL) {
+        pab = calloc(1, sizeof(struct Async_Block));
+        pab->ifile = ifile;
+        pab->ibfile = ibfile;
+        pab->buf = HAS_DATA(pcache) ? malloc(pcache->blocksz) : NULL;
+        pab->next = pa->pending;
+        pa->pending = pab;
+
+        pthread_mutex_lock(&pa->lock);
+        if (pa->tail != NULL)
+            pa->tail->qnext = pab;
+        else
+            pa->head = pab;
+        pa->tail = pab;
+        pa->npending++;
+        pthread_cond_signal(&pa->work);
+        pthread_mutex_unlock(&pa->lock);
+    }
+    pw = malloc(sizeof(struct Async_Waiter));
+    pw->irfile = irfile;
+    pw->precord = precord;
+    pw->cb = cb;
+    pw->arg = arg;
+    pw->next = pab->waiters;
+    pab->waiters = pw;
+
+    Unlock(pcache);
+    return CACHE_PENDING;
+}
+
+//! Lecture sans attente.
+Cache_Error Cache_Read_Async(struct Cache *pcache, Cache_Index irfile, void *precord, Cache_Callback cb, void *arg) {
+    if (pcache->nfiles == 0 || pcache->files[0] == NULL)
+        return CACHE_KO;
+    return Async_Read(pcache, 0, irfile, precord, cb, arg);
+}
+
+//! Lecture sans attente dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Read_Async(struct Cache_File *pf, Cache_Index irfile, void *precord, Cache_Callback cb, void *arg) {
+    return Async_Read(pf->pcache, pf->ifile, irfile, precord, cb, arg);
+}
+
+/*
+ * Instantanés
+ * -----------
+ * Un instantané contient un en-tête puis, pour chaque bloc valide, son
+ * indice-fichier et ses flags propres à la stratégie, que celle-ci garde hors
+ * des entêtes (bit R de NUR, voir Strategy_Get_Flags()), dans l'ordre de
+ * remplacement donné par Strategy_Order() : le premier est le prochain bloc
+ * remplacé. Les données ne sont pas sauvegardées, elles sont relues dans le
+ * fichier au rechargement.
+ *
+ * Dans un cache partagé, seuls les blocs du fichier d'indice 0 (celui de
+ * Cache_Create()) sont concernés : les indices des autres fichiers n'ont
+ * pas de sens d'une exécution à l'autre.
+ *
+ * La version 2 range les indices-fichier sur 64 bits ; les instantanés de
+ * la version 1 (32 bits) sont encore rechargés.
+ */
+
+#define SNAPSHOT_MAGIC 0x504E5343u	/* "CSNP" */
+#define SNAPSHOT_VERSION 2
+
+//! Taille maximale d'une lecture groupée au rechargement
+#define SNAPSHOT_RUN (1 << 20)
+
+struct Snapshot_Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t blocksz;		/* un instantané ne vaut que pour une taille de bloc */
+    uint32_t nentries;
+    uint32_t pad;
+};
+
+struct Snapshot_Entry {
+    int64_t ibfile;
+    uint32_t flags;
+    uint32_t pad;
+};
+
+//! Entrée de la version 1
+struct Snapshot_Entry_V1 {
+    int32_t ibfile;
+    uint32_t flags;
+};
+
+//! Sauvegarde des blocs présents dans le cache et de leur ordre de remplacement.
+Cache_Error Cache_Save_Snapshot(struct Cache *pcache, const char *path) {
+    struct Cache_Block_Header **order = malloc(pcache->nblocks * sizeof(struct Cache_Block_Header *));
+    struct Snapshot_Entry *entries = malloc(pcache->nblocks * sizeof(struct Snapshot_Entry));
+    struct Snapshot_Header sh = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, pcache->blocksz, 0, 0 };
+    char *tmp = malloc(strlen(path) + 5);
+    Cache_Error err = CACHE_KO;
+    FILE *fp;
+    int n, i;
+
+    n = Strategy_Order(pcache, order);
+    for (i = 0; i < n; i++) {
+        if (BLOCK_VALID(pcache, order[i]) && order[i]->ifile == 0) {
+            entries[sh.nentries].ibfile = order[i]->ibfile;
+            entries[sh.nentries].flags = Strategy_Get_Flags != NULL ? Strategy_Get_Flags(pcache, order[i]) : 0;
+            entries[sh.nentries].pad = 0;
+            sh.nentries++;
+        }
+    }
+
+    // Écriture dans un fichier temporaire puis renommage : un arrêt pendant la
+    // sauvegarde laisse l'instantané précédent intact
+    sprintf(tmp, "%s.tmp", path);
+    if ((fp = fopen(tmp, "w")) != NULL) {
+        if (fwrite(&sh, sizeof(sh), 1, fp) == 1
+            && fwrite(entries, sizeof(struct Snapshot_Entry), sh.nentries, fp) == sh.nentries)
+            err = CACHE_OK;
+        if (fclose(fp) != 0)
+            err = CACHE_KO;
+        if (err == CACHE_OK && rename(tmp, path) != 0)
+            err = CACHE_KO;
+        if (err != CACHE_OK)
+            remove(tmp);
+    }
+
+    free(tmp);
+    free(entries);
+    free(order);
+    return err;
+}
+
+//! Comparaison de deux blocs par indice-fichier (pour qsort)
+static int Compare_Ibfile(const void *a, const void *b) {
+    Cache_Index ia = (*(struct Cache_Block_Header * const *)a)->ibfile;
+    Cache_Index ib = (*(struct Cache_Block_Header * const *)b)->ibfile;
+
+    return (ia > ib) - (ia < ib);
+}
+
+//! Lecture de blocs triés par indice-fichier : une seule entrée-sortie par suite de blocs contigus
+static Cache_Error Read_Sorted_Blocks(struct Cache *pcache, struct Cache_Block_Header **blocks, int n) {
+    int maxrun = SNAPSHOT_RUN / pcache->blocksz > 0 ? SNAPSHOT_RUN / pcache->blocksz : 1;
+    char *buf = malloc(maxrun * pcache->blocksz);
+    int i, j, k;
+
+    for (i = 0; i < n; i = j) {
+        for (j = i + 1; j < n && j - i < maxrun && blocks[j]->ibfile == blocks[j - 1]->ibfile + 1; j++) {}
+
+        struct Cache_Backend *pbe = BACKEND(pcache, blocks[i]);
+
+        if (pbe->read(pbe, DADDR(pcache, blocks[i]->ibfile), buf, (j - i) * pcache->blocksz) != CACHE_OK) {
+            free(buf);
+            return CACHE_KO;
+        }
+        pcache->instrument.n_read += (j - i) * pcache->nrecords;
+        for (k = i; k < j; k++)
+            memcpy(blocks[k]->data, buf + (k - i) * pcache->blocksz, pcache->blocksz);
+    }
+
+    free(buf);
+    return CACHE_OK;
+}
+
+//! Lecture des entrées d'un instantané de la version 1 ou 2
+static struct Snapshot_Entry *Read_Entries(FILE *fp, uint32_t version, uint32_t nentries) {
+    struct Snapshot_Entry *entries = malloc(nentries * sizeof(struct Snapshot_Entry));
+    struct Snapshot_Entry_V1 *old;
+    uint32_t i;
+
+    if (version == SNAPSHOT_VERSION) {
+        if (fread(entries, sizeof(struct Snapshot_Entry), nentries, fp) == nentries)
+            return entries;
+    }
+    else {
+        old = malloc(nentries * sizeof(struct Snapshot_Entry_V1));
+        if (fread(old, sizeof(struct Snapshot_Entry_V1), nentries, fp) == nentries) {
+            for (i = 0; i < nentries; i++) {
+                entries[i].ibfile = old[i].ibfile;
+                entries[i].flags = old[i].flags;
+            }
+            free(old);
+            return entries;
+        }
+        free(old);
+    }
+    free(entries);
+    return NULL;
+}
+
+//! Rechargement d'un instantané (le cache est d'abord invalidé).
+Cache_Error Cache_Load_Snapshot(struct Cache *pcache, const char *path) {
+    struct Snapshot_Header sh;
+    struct Snapshot_Entry *entries;
+    struct Cache_Block_Header **blocks;
+    Cache_Error err = CACHE_OK;
+    unsigned i, first;
+    int n = 0;
+    FILE *fp;
+
+    // L'instantané doit avoir été pris avec la même taille de bloc
+    if (pcache->nfiles == 0 || pcache->files[0] == NULL || (fp = fopen(path, "r")) == NULL)
+        return CACHE_KO;
+    if (fread(&sh, sizeof(sh), 1, fp) != 1 || sh.magic != SNAPSHOT_MAGIC
+        || (sh.version != 1 && sh.version != SNAPSHOT_VERSION) || sh.blocksz != pcache->blocksz) {
+        fclose(fp);
+        return CACHE_KO;
+    }
+    entries = Read_Entries(fp, sh.version, sh.nentries);
+    fclose(fp);
+    if (entries == NULL)
+        return CACHE_KO;
+
+    if (Cache_Invalidate(pcache) != CACHE_OK) {
+        free(entries);
+        return CACHE_KO;
+    }
+
+    // Les blocs sont attribués dans l'ordre de l'instantané, ce qui reconstruit
+    // l'ordre propre à la stratégie (liste LRU, file FIFO). Si le cache est plus
+    // petit qu'à la sauvegarde, on garde les blocs remplacés en dernier.
+    first = sh.nentries > pcache->nblocks ? sh.nentries - pcache->nblocks : 0;
+    blocks = malloc(pcache->nblocks * sizeof(struct Cache_Block_Header *));
+    for (i = first; i < sh.nentries; i++) {
+        struct Cache_Block_Header *header;
+
+        if (entries[i].ibfile < 0 || Hash_Find(pcache, 0, entries[i].ibfile) != NULL)
+            continue;
+        if ((header = Strategy_Replace_Block(pcache)) == NULL)
+            break;
+        // Bloc d'une génération passée : il quitte l'index avant d'y revenir
+        if (header->flags & VALID)
+            Hash_Remove(pcache, header);
+        PUBLISH(header->gen, pcache->gen);
+        PUBLISH(header->ifile, 0);
+        PUBLISH(header->ibfile, entries[i].ibfile);
+        PUBLISH(header->flags, VALID);
+        FLAGS_COPY(pcache, header);
+        if (Strategy_Set_Flags != NULL)
+            Strategy_Set_Flags(pcache, header, entries[i].flags & ~(VALID | MODIF | NOREAD));
+        Hash_Insert(pcache, header);
+        Block_Loaded(pcache, header);
+        pcache->files[0]->nres++;
+        blocks[n++] = header;
+    }
+
+    // Relecture des données par adresses croissantes dans le fichier
+    if (HAS_DATA(pcache)) {
+        qsort(blocks, n, sizeof(struct Cache_Block_Header *), Compare_Ibfile);
+        if ((err = Read_Sorted_Blocks(pcache, blocks, n)) != CACHE_OK)
+            Cache_Invalidate(pcache);
+    }
+
+    free(blocks);
+    free(entries);
+    return err;
+}
+
+//! Conseil sur la taille des blocs depuis le dernier appel.
+Cache_Error Cache_Get_Advice(struct Cache *pcache, struct Cache_Advice *padv) {
+    if (pcache->padvisor == NULL)
+        return CACHE_KO;
+    Lock(pcache);
+    Advisor_Get(pcache->padvisor, padv, 0);
+    padv->current = pcache->nrecords;
+    Unlock(pcache);
+    return CACHE_OK;
+}
+
+//! Instrumentation des nœuds NUMA.
+int Cache_Get_Node_Instrument(struct Cache *pcache, struct Cache_Node_Instrument *pni, int maxnodes) {
+    int k;
+
+    for (k = 0; k < pcache->nnodes && k < maxnodes; k++) {
+        struct Cache_Node *pn = &pcache->nodes[k];
+
+        //Lecture et remise à 0 de chaque compteur d'un seul coup (lectures sans verrou)
+        pni[k].nblocks = pn->count;
+        pni[k].n_access = __atomic_exchange_n(&pn->n_access, 0, __ATOMIC_RELAXED);
+        pni[k].n_hits = __atomic_exchange_n(&pn->n_hits, 0, __ATOMIC_RELAXED);
+        pni[k].n_local = __atomic_exchange_n(&pn->n_local, 0, __ATOMIC_RELAXED);
+    }
+    return pcache->nnodes;
+}
+
+//! Instrumentation des stratégies candidates (stratégie ADAPT seulement).
+int Cache_Get_Policy_Instrument(struct Cache *pcache, struct Cache_Policy_Instrument *ppi, int maxpolicies) {
+    int n = 0;
+
+    Lock(pcache);
+    if (pcache->pops != NULL && pcache->pops->instrument != NULL)
+        n = pcache->pops->instrument(pcache, ppi, maxpolicies);
+    Unlock(pcache);
+    return n;
+}
+
+//! Résultat de l'instrumentation dans pinstr.
+struct Cache_Instrument *Cache_Get_Instrument_R(struct Cache *pcache, struct Cache_Instrument *pinstr) {
+    int k;
+
+    Lock(pcache);
+
+    //Les lectures faites sans verrou sont comptées par tampon
+    for (k = 0; pcache->rbufs != NULL && k < READ_STRIPES; k++) {
+        pcache->instrument.n_reads += __atomic_exchange_n(&pcache->rbufs[k].n_reads, 0, __ATOMIC_RELAXED);
+        pcache->instrument.n_hits += __atomic_exchange_n(&pcache->rbufs[k].n_hits, 0, __ATOMIC_RELAXED);
+    }
+    if (pcache->pcommit != NULL)
+        pcache->instrument.n_commits += __atomic_exchange_n(&pcache->pcommit->n_commits, 0, __ATOMIC_RELAXED);
+    *pinstr = pcache->instrument;
 
     //On réinitialise le Cache_Instrument
     pcache->instrument.n_reads = pcache->instrument.n_writes = 0;
-    pcache->instrument.n_hits = pcache->instrument.n_syncs = 0;
-    pcache->instrument.n_deref = 0;
+    pcache->instrument.n_hits = pcache->instrument.n_syncs = pcache->instrument.n_commits = 0;
+    pcache->instrument.n_hits2 = pcache->instrument.n_misses2 = 0;
+    pcache->instrument.n_deref = pcache->instrument.n_switches = 0;
+    pcache->instrument.n_loaded = pcache->instrument.n_touched = 0;
+    pcache->instrument.n_read = pcache->instrument.n_written = 0;
+
+    Unlock(pcache);
+
+    return pinstr;
+}
+
+//! Résultat de l'instrumentation.
+struct Cache_Instrument *Cache_Get_Instrument(struct Cache *pcache) {
+    //Copie du Cache_Instrument (statique : elle doit survivre au retour)
+    static struct Cache_Instrument copy;
 
-    //On retourne la copie
-    return &copy;
+    return Cache_Get_Instrument_R(pcache, &copy);
 }
\ No newline at end of file
@@ -21,6 +21,7 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 
 //! Code d'erreur
 /*!
@@ -29,26 +30,330 @@
 typedef enum {
     CACHE_KO = 0, //!< Ça va pas
     CACHE_OK,     //!< Tout va bien
+    CACHE_PENDING, //!< Lecture en cours (voir Cache_Read_Async())
 } Cache_Error;
 
+//! Indice d'un enregistrement (ou d'un bloc) dans un fichier.
+/*!
+ * \ingroup cache_interface
+ *
+ * Sur 64 bits : un fichier peut avoir plus de 2^31 enregistrements. Les
+ * appelants qui passent un \c int n'ont rien à changer (voir aussi
+ * cache_compat.h pour les fonctions de rappel et l'instrumentation).
+ */
+typedef int64_t Cache_Index;
+
+//! Compteur de l'instrumentation.
+/*!
+ * \ingroup cache_interface
+ */
+typedef unsigned long long Cache_Count;
+
+//! Stockage sous-jacent du cache.
+/*!
+ * \ingroup cache_interface
+ */
+typedef enum {
+    CACHE_BACKEND_FILE = 0, //!< Le fichier lui-même (défaut)
+    CACHE_BACKEND_MEM,      //!< Un "fichier" en mémoire, sans entrée-sortie
+    CACHE_BACKEND_NULL,     //!< Rien : méta-données seulement, aucune copie de données
+    CACHE_BACKEND_MMAP,     //!< Le fichier projeté en mémoire (mmap), sans copie dans les blocs
+} Cache_Backend_Kind;
+
+//! Durabilité de Cache_Sync().
+/*!
+ * \ingroup cache_interface
+ */
+typedef enum {
+    CACHE_SYNC_BUFFERED = 0, //!< Les blocs modifiés sont transmis au système, qui les écrira (défaut)
+    CACHE_SYNC_DURABLE,      //!< ... et sont sur disque au retour (fdatasync, groupé entre threads)
+} Cache_Sync_Mode;
+
+//! Mode du conseiller de taille de bloc (voir advisor.h).
+/*!
+ * \ingroup cache_interface
+ */
+typedef enum {
+    CACHE_ADVISOR_OFF = 0, //!< Pas de conseiller (défaut)
+    CACHE_ADVISOR_SHOW,    //!< Conseil seulement (voir Cache_Get_Advice())
+    CACHE_ADVISOR_AUTO,    //!< Changement automatique du nombre d'enregistrements par bloc
+} Cache_Advisor_Mode;
+
+//! Allocation d'un bloc sur un défaut en écriture.
+/*!
+ * \ingroup cache_interface
+ */
+typedef enum {
+    CACHE_WRITE_ALLOCATE = 0, //!< Le bloc est lu puis modifié dans le cache (défaut)
+    CACHE_WRITE_STREAM,       //!< Flux d'écriture : le bloc est alloué sans être lu
+    CACHE_WRITE_AROUND,       //!< Pas d'allocation : l'enregistrement est écrit directement dans le fichier
+} Cache_Write_Policy;
+
+//! Indication sur les accès à venir (voir Cache_Advise()).
+/*!
+ * \ingroup cache_interface
+ */
+typedef enum {
+    CACHE_HINT_NORMAL = 0, //!< Aucune indication (annule les précédentes sur la plage)
+    CACHE_HINT_SEQUENTIAL, //!< Accès séquentiels : lecture anticipée, libération derrière le parcours
+    CACHE_HINT_RANDOM,     //!< Accès aléatoires : pas de lecture anticipée
+    CACHE_HINT_WILLNEED,   //!< Accès prochains : les blocs sont chargés tout de suite
+    CACHE_HINT_DONTNEED,   //!< Plus d'accès : les blocs sont sauvés puis libérés
+} Cache_Hint;
+
+//! Accès au cache par plusieurs threads.
+/*!
+ * \ingroup cache_interface
+ *
+ * Dans les deux modes multi-threads, les lectures, écritures, indications,
+ * synchronisations, invalidations et l'instrumentation peuvent être
+ * concurrentes ; l'ouverture et la fermeture des fichiers, le
+ * redimensionnement, les instantanés et la fermeture du cache ne le peuvent
+ * pas (ces dernières attendent la fin des lectures asynchrones en cours).
+ * Les lectures asynchrones (Cache_Read_Async()) demandent l'un de ces modes.
+ */
+typedef enum {
+    CACHE_SINGLE = 0,  //!< Un seul thread (défaut) : aucun verrou
+    CACHE_LOCKED,      //!< Chaque accès prend le verrou du cache
+    CACHE_CONCURRENT,  //!< Les lectures de blocs présents se font sans verrou
+} Cache_Concurrency;
+
+//! Placement des blocs sur les nœuds NUMA (voir numa.h).
+typedef enum {
+    CACHE_NUMA_OFF = 0,    //!< Blocs alloués par malloc() (défaut)
+    CACHE_NUMA_ON,         //!< Une tranche de blocs par nœud de la machine, liée au nœud
+    CACHE_NUMA_SIMULATED,  //!< \c numa_nodes nœuds simulés, mémoire non liée
+} Cache_Numa_Mode;
+
+//! Options de création du cache.
+/*!
+ * \ingroup cache_interface
+ *
+ * Une structure mise à zéro correspond au comportement par défaut.
+ *
+ * \note Avec \c CACHE_BACKEND_NULL, le cache ne stocke aucune donnée : 
+ * Cache_Read() ne modifie pas l'enregistrement de l'appelant. Ce mode ne sert
+ * qu'à mesurer le comportement des stratégies.
+ *
+ * \note Avec \c CACHE_BACKEND_MMAP, les enregistrements sont copiés depuis et
+ * vers la projection du fichier ; les blocs du cache n'en ont pas de copie et
+ * ne servent qu'à dire au noyau quelles pages garder (madvise). Ce mode vise
+ * les fichiers surtout lus.
+ */
+struct Cache_Options
+{
+    Cache_Backend_Kind backend; //!< Stockage sous-jacent
+    const char *strategy;       //!< Stratégie (exécutables MULTI seulement ; NULL : défaut)
+    const char *snapshot;       //!< Instantané rechargé à la création et réécrit à la fermeture (NULL : aucun)
+    const char *spill;          //!< Fichier du second niveau (voir spill.h)
+    unsigned spill_blocks;      //!< Nombre de blocs du second niveau (0 : pas de second niveau)
+    Cache_Advisor_Mode advisor; //!< Conseiller de taille de bloc
+    Cache_Write_Policy write_policy; //!< Allocation sur défaut en écriture
+    Cache_Sync_Mode sync_mode;  //!< Durabilité de Cache_Sync()
+    Cache_Concurrency concurrency; //!< Accès par plusieurs threads
+    Cache_Numa_Mode numa;       //!< Placement NUMA des blocs
+    unsigned numa_nodes;        //!< Nombre de nœuds (\c CACHE_NUMA_SIMULATED seulement)
+};
+
 //! Création du cache.
 struct Cache *Cache_Create(const char *fic, unsigned nblocks, unsigned nrecords,
                            size_t recordsz, unsigned nderef);
 
-//! Fermeture (destruction) du cache.
+//! Création du cache avec options.
+struct Cache *Cache_Create_Opt(const char *fic, unsigned nblocks, unsigned nrecords,
+                               size_t recordsz, unsigned nderef,
+                               const struct Cache_Options *popts);
+
+/*!
+ * \defgroup cache_pool Cache partagé entre plusieurs fichiers
+ *
+ * \ingroup cache_interface
+ *
+ * Un cache créé par Cache_Pool_Create() n'a pas de fichier : ses blocs et sa
+ * stratégie de remplacement sont partagés par tous les fichiers qu'on y ouvre
+ * avec Cache_File_Open(). La mémoire du cache suit donc la demande : un fichier
+ * inactif perd ses blocs au profit des fichiers actifs. Des quotas optionnels
+ * réservent un minimum de blocs à un fichier, ou l'empêchent d'en occuper plus
+ * qu'un maximum.
+ *
+ * Cache_Create() est un cache partagé où est ouvert un seul fichier, sans
+ * quota ; Cache_Read() et Cache_Write() accèdent au fichier d'indice 0, le
+ * premier ouvert. Cache_Sync(), Cache_Invalidate() et l'instrumentation
+ * portent sur tous les fichiers.
+ *
+ * @{
+ */
+
+//! Fichier ouvert dans un cache partagé.
+struct Cache_File;
+
+//! Création d'un cache partagé, sans fichier.
+struct Cache *Cache_Pool_Create(unsigned nblocks, unsigned nrecords, size_t recordsz, unsigned nderef,
+                                const struct Cache_Options *popts);
+
+//! Ouverture d'un fichier dans un cache partagé (quotas de blocs ; \a max nul : pas de maximum).
+struct Cache_File *Cache_File_Open(struct Cache *pcache, const char *file, unsigned min, unsigned max);
+
+//! Fermeture d'un fichier : ses blocs sont sauvés puis libérés.
+Cache_Error Cache_File_Close(struct Cache_File *pf);
+
+//! Lecture dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Read(struct Cache_File *pf, Cache_Index irfile, void *precord);
+
+//! Écriture dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Write(struct Cache_File *pf, Cache_Index irfile, const void *precord);
+
+//! Nombre de blocs d'un fichier présents dans le cache.
+unsigned Cache_File_Blocks(struct Cache_File *pf);
+
+/*
+ * @}
+ */
+
+//! Fermeture (destruction) du cache (et de tous ses fichiers).
 Cache_Error Cache_Close(struct Cache *pcache);
 
 //! Synchronisation du cache.
+/*!
+ * \ingroup cache_interface
+ *
+ * Les blocs modifiés sont écrits dans leurs fichiers. En mode
+ * \c CACHE_SYNC_DURABLE, ils sont de plus sur disque au retour : chaque
+ * écriture de bloc lance déjà celle du noyau (sync_file_range), puis un seul
+ * fdatasync() par fichier termine le tout. Les appels simultanés de plusieurs
+ * threads sont groupés : un seul d'entre eux fait les fdatasync(), qui valent
+ * pour tous ceux dont les blocs étaient écrits avant qu'il ne commence.
+ *
+ * Les synchronisations périodiques (tous les \c NSYNC accès) écrivent les
+ * blocs sans attendre le disque.
+ */
 Cache_Error Cache_Sync(struct Cache *pcache);
 
 //! Invalidation du cache.
+/*!
+ * \ingroup cache_interface
+ *
+ * Le cache est synchronisé, puis tous ses blocs sont invalidés d'un coup :
+ * ils appartiennent désormais à une génération passée, et seront réutilisés
+ * comme des blocs libres. La stratégie les oublie de la même façon (sa
+ * donnée d'un bloc est initialisée quand il est redistribué, ses tables de
+ * hachage changent de génération) : ni les entêtes ni les structures de la
+ * stratégie ne sont parcourus.
+ *
+ * Le coût n'est pas pour autant indépendant de la taille du cache :
+ * - la synchronisation cherche les blocs modifiés dans les flags compacts (un
+ *   octet par bloc, balayage vectorisé), puis écrit ceux qu'elle trouve ;
+ * - le second niveau (option \c spill) est vidé case par case ;
+ * - une fois tous les 2^32 appels, au retour à 0 de la génération, le bit V
+ *   est remis à 0 dans tous les blocs.
+ */
 Cache_Error Cache_Invalidate(struct Cache *pcache);
 
+//! Invalidation des enregistrements \a first_irfile à \a first_irfile + \a count - 1.
+/*!
+ * \ingroup cache_interface
+ *
+ * Les blocs qui contiennent au moins un enregistrement de la plage quittent
+ * le cache (et son second niveau) : les accès suivants les reliront dans le
+ * fichier. Les enregistrements modifiés hors de la plage sont écrits ; ceux
+ * de la plage aussi, sauf si \a discard est vrai : leurs modifications sont
+ * alors perdues. Les autres blocs ne sont pas touchés.
+ *
+ * Avec le backend CACHE_BACKEND_MMAP, un enregistrement est copié dans la
+ * projection du fichier dès son écriture : \a discard vrai y est refusé
+ * (CACHE_KO, rien n'est invalidé).
+ */
+Cache_Error Cache_Invalidate_Range(struct Cache *pcache, Cache_Index first_irfile, Cache_Index count, int discard);
+
+//! Invalidation d'une plage d'enregistrements d'un fichier d'un cache partagé.
+Cache_Error Cache_File_Invalidate_Range(struct Cache_File *pf, Cache_Index first_irfile, Cache_Index count,
+                                        int discard);
+
+//! Redimensionnement du cache sans invalidation.
+/*!
+ * \ingroup cache_interface
+ *
+ * Les blocs conservés gardent leur contenu et leur rang dans la stratégie de
+ * remplacement. Pour réduire le cache, les blocs évincés sont ceux que la
+ * stratégie aurait remplacés les premiers. Les quotas d'un cache partagé ne
+ * sont pas pris en compte. Impossible en mode NUMA, où chaque nœud a sa
+ * tranche de blocs.
+ */
+Cache_Error Cache_Resize(struct Cache *pcache, unsigned nblocks);
+
+//! Indication sur les accès à venir aux enregistrements \a first_irfile à \a first_irfile + \a count - 1.
+/*!
+ * \ingroup cache_interface
+ *
+ * Comme posix_fadvise(), auquel l'indication est aussi transmise pour le
+ * cache du noyau. \c CACHE_HINT_SEQUENTIAL et \c CACHE_HINT_RANDOM restent
+ * attachés à la plage (la plus récente l'emporte là où elles se recouvrent) ;
+ * \c CACHE_HINT_WILLNEED et \c CACHE_HINT_DONTNEED agissent immédiatement.
+ */
+Cache_Error Cache_Advise(struct Cache *pcache, Cache_Index first_irfile, Cache_Index count, Cache_Hint hint);
+
+//! Indication sur les accès à venir dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Advise(struct Cache_File *pf, Cache_Index first_irfile, Cache_Index count, Cache_Hint hint);
+
+//! Changement du nombre d'enregistrements par bloc.
+/*!
+ * \ingroup cache_interface
+ *
+ * Le cache est invalidé ; sa capacité en octets est conservée (le nombre de
+ * blocs change en proportion). Impossible avec un second niveau, dont les
+ * cases ont la taille des blocs.
+ */
+Cache_Error Cache_Set_Records(struct Cache *pcache, unsigned nrecords);
+
+//! Sauvegarde des blocs présents dans le cache et de leur ordre de remplacement.
+Cache_Error Cache_Save_Snapshot(struct Cache *pcache, const char *path);
+
+//! Rechargement d'un instantané (le cache est d'abord invalidé).
+Cache_Error Cache_Load_Snapshot(struct Cache *pcache, const char *path);
+
 //! Lecture  (à travers le cache).
-Cache_Error Cache_Read(struct Cache *pcache, int irfile, void *precord);
+Cache_Error Cache_Read(struct Cache *pcache, Cache_Index irfile, void *precord);
 
 //! Écriture (à travers le cache).
-Cache_Error Cache_Write(struct Cache *pcache, int irfile, const void *precord);
+Cache_Error Cache_Write(struct Cache *pcache, Cache_Index irfile, const void *precord);
+
+//! Fonction appelée à la fin d'une lecture asynchrone (voir Cache_Read_Async()).
+typedef void (*Cache_Callback)(void *arg, Cache_Index irfile, void *precord, Cache_Error err);
+
+//! Lecture sans attente.
+/*!
+ * \ingroup cache_interface
+ *
+ * Si l'enregistrement est dans le cache, il est copié dans \a precord et la
+ * fonction retourne \c CACHE_OK sans appeler \a cb. Sinon, elle retourne
+ * \c CACHE_PENDING tout de suite : le bloc est lu par un thread
+ * d'entrées-sorties du cache, qui copie ensuite l'enregistrement et appelle
+ * \a cb(\a arg, \a irfile, \a precord, err) ; \a precord doit rester valide
+ * jusque-là. Les défauts simultanés sur un même bloc ne donnent qu'une
+ * lecture.
+ *
+ * Le cache doit être dans un mode multi-threads (voir \c Cache_Concurrency),
+ * sinon la fonction retourne \c CACHE_KO. Avec un conseiller de taille de
+ * bloc, la lecture est toujours synchrone. \a cb est appelée sans le verrou
+ * du cache : elle peut utiliser le cache, mais doit être brève.
+ */
+Cache_Error Cache_Read_Async(struct Cache *pcache, Cache_Index irfile, void *precord, Cache_Callback cb, void *arg);
+
+//! Lecture sans attente dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Read_Async(struct Cache_File *pf, Cache_Index irfile, void *precord, Cache_Callback cb, void *arg);
+
+//! Écriture de \a count enregistrements consécutifs (à travers le cache).
+/*!
+ * \ingroup cache_interface
+ *
+ * Les blocs entièrement couverts par les enregistrements écrits sont alloués
+ * dans le cache sans être lus dans le fichier.
+ */
+Cache_Error Cache_Write_Many(struct Cache *pcache, Cache_Index first_irfile, Cache_Index count, const void *precords);
+
+//! Écriture d'enregistrements consécutifs dans un fichier d'un cache partagé.
+Cache_Error Cache_File_Write_Many(struct Cache_File *pf, Cache_Index first_irfile, Cache_Index count,
+                                  const void *precords);
 
 //! Instrumentation du cache.
 /*!
@@ -56,14 +361,97 @@ Cache_Error Cache_Write(struct Cache *pcache, int irfile, const void *precord);
  */
 struct Cache_Instrument
 {
-    unsigned n_reads; 	//!< Nombre de lectures.
-    unsigned n_writes;	//!< Nombre d'écritures.
-    unsigned n_hits;	//!< Nombre de fois où l'élément était déjà dans le cache.
-    unsigned n_syncs;	//<! Nombre d'appels à Cache_Sync().
-    unsigned n_deref;	//!< Nombre de déréférençage (stratégie NUR).
+    Cache_Count n_reads; 	//!< Nombre de lectures.
+    Cache_Count n_writes;	//!< Nombre d'écritures.
+    Cache_Count n_hits;	//!< Nombre de fois où l'élément était déjà dans le cache.
+    Cache_Count n_hits2;	//!< Blocs absents de la mémoire trouvés dans le second niveau.
+    Cache_Count n_misses2;	//!< Blocs absents des deux niveaux (relus dans le fichier).
+    Cache_Count n_syncs;	//<! Nombre d'appels à Cache_Sync().
+    Cache_Count n_commits;	//!< Nombre d'écritures durables groupées (CACHE_SYNC_DURABLE).
+    Cache_Count n_loaded;	//!< Nombre d'enregistrements chargés dans le cache (par blocs entiers).
+    Cache_Count n_touched;	//!< Nombre d'entre eux effectivement accédés.
+    Cache_Count n_read;	//!< Nombre d'enregistrements lus dans les fichiers.
+    Cache_Count n_written;	//!< Nombre d'enregistrements écrits dans les fichiers.
+    Cache_Count n_deref;	//!< Nombre de déréférençage (stratégie NUR).
+    Cache_Count n_switches;	//!< Nombre de changements de stratégie (stratégie ADAPT).
 };
 
 //! Résultat de l'instrumentation.
+/*!
+ * \ingroup cache_interface
+ *
+ * Les compteurs sont remis à 0. Le résultat est une copie statique, commune
+ * à tous les threads et écrasée par l'appel suivant : un programme dont
+ * plusieurs threads lisent l'instrumentation utilise Cache_Get_Instrument_R().
+ */
 struct Cache_Instrument *Cache_Get_Instrument(struct Cache *pcache);
 
+//! Résultat de l'instrumentation dans \a pinstr (retourné), remise à 0 comme Cache_Get_Instrument().
+struct Cache_Instrument *Cache_Get_Instrument_R(struct Cache *pcache, struct Cache_Instrument *pinstr);
+
+//! Nombre maximal de classes de taille de bloc du conseiller.
+#define CACHE_ADVICE_CLASSES 7
+
+//! Conseil sur la taille des blocs.
+/*!
+ * \ingroup cache_interface
+ *
+ * Les classes ont toutes la capacité en octets du cache ; le coût est
+ * estimé en ns (voir advisor.h).
+ */
+struct Cache_Advice
+{
+    int nclasses;                                //!< Nombre de classes évaluées.
+    unsigned nrecords[CACHE_ADVICE_CLASSES];     //!< Enregistrements par bloc de chaque classe.
+    unsigned nblocks[CACHE_ADVICE_CLASSES];      //!< Nombre de blocs de chaque classe.
+    Cache_Count n_misses[CACHE_ADVICE_CLASSES];  //!< Défauts de chaque classe.
+    double cost[CACHE_ADVICE_CLASSES];           //!< Coût estimé de ces défauts.
+    unsigned best;                               //!< Nombre d'enregistrements par bloc conseillé.
+    unsigned current;                            //!< Nombre d'enregistrements par bloc actuel.
+};
+
+//! Conseil depuis le dernier appel (KO si le cache n'a pas de conseiller).
+Cache_Error Cache_Get_Advice(struct Cache *pcache, struct Cache_Advice *padv);
+
+//! Instrumentation d'un nœud NUMA.
+/*!
+ * \ingroup cache_interface
+ *
+ * Les accès sont attribués au nœud du thread qui les fait ; un succès est
+ * local si le bloc trouvé est dans la tranche de ce nœud.
+ */
+struct Cache_Node_Instrument
+{
+    unsigned nblocks;       //!< Nombre de blocs du nœud.
+    Cache_Count n_access;   //!< Nombre d'accès des threads du nœud.
+    Cache_Count n_hits;     //!< Nombre de succès parmi eux.
+    Cache_Count n_local;    //!< Nombre de succès sur un bloc du nœud.
+};
+
+//! Instrumentation des nœuds (au plus \a maxnodes) : retourne leur nombre (0 hors mode NUMA).
+int Cache_Get_Node_Instrument(struct Cache *pcache, struct Cache_Node_Instrument *pni, int maxnodes);
+
+//! Instrumentation d'une stratégie candidate de la stratégie adaptative.
+/*!
+ * \ingroup cache_interface
+ *
+ * La stratégie ADAPT (tst_Cache_MULTI seulement) rejoue un échantillon des
+ * blocs sur un cache fantôme par stratégie candidate ; les compteurs sont ceux
+ * de ce fantôme depuis le dernier appel.
+ */
+struct Cache_Policy_Instrument
+{
+    const char *name;       //!< Nom de la stratégie.
+    Cache_Count n_access;   //!< Nombre d'accès échantillonnés.
+    Cache_Count n_hits;     //!< Nombre de succès du fantôme parmi eux.
+    Cache_Count n_switches_to; //!< Nombre de fois où elle est devenue la stratégie du cache.
+    int live;               //!< Vrai si c'est la stratégie actuelle du cache.
+};
+
+//! Instrumentation des candidates (au plus \a maxpolicies) : retourne leur nombre (0 hors stratégie ADAPT).
+int Cache_Get_Policy_Instrument(struct Cache *pcache, struct Cache_Policy_Instrument *ppi, int maxpolicies);
+
+//! Nœud NUMA du thread appelant (0 hors mode NUMA).
+int Cache_Thread_Node(struct Cache *pcache);
+
 #endif /* _CACHE_H_ */
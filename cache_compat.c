@@ -0,0 +1,155 @@
+/*!
+ * \file cache_compat.c
+ *
+ * \brief Compatibilité avec l'interface sur 32 bits (voir cache_compat.h).
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+
+#include "cache_compat.h"
+
+//! Fonction de rappel sur 32 bits d'une lecture en cours
+struct Compat_Call
+{
+    Cache_Callback32 cb;
+    void *arg;
+};
+
+//! Fonction de rappel transmise au cache : appelle celle de l'ancienne interface
+static void Compat_Done(void *arg, Cache_Index irfile, void *precord, Cache_Error err)
+{
+    struct Compat_Call *pc = arg;
+
+    pc->cb(pc->arg, (int)irfile, precord, err);
+    free(pc);
+}
+
+/* La fonction de rappel n'est appelée que si la lecture est mise en attente :
+ * sinon, la case est libérée tout de suite */
+static Cache_Error Compat_Read_Async(struct Cache *pcache, struct Cache_File *pf, int irfile, void *precord,
+                                     Cache_Callback32 cb, void *arg)
+{
+    struct Compat_Call *pc = malloc(sizeof(struct Compat_Call));
+    Cache_Error err;
+
+    pc->cb = cb;
+    pc->arg = arg;
+    if (pf != NULL) err = Cache_File_Read_Async(pf, irfile, precord, Compat_Done, pc);
+    else err = Cache_Read_Async(pcache, irfile, precord, Compat_Done, pc);
+    if (err != CACHE_PENDING) free(pc);
+    return err;
+}
+
+/*!
+ * \ingroup cache_compat_interface
+ */
+Cache_Error Cache_Read_Async32(struct Cache *pcache, int irfile, void *precord, Cache_Callback32 cb, void *arg)
+{
+    return Compat_Read_Async(pcache, NULL, irfile, precord, cb, arg);
+}
+
+/*!
+ * \ingroup cache_compat_interface
+ */
+Cache_Error Cache_File_Read_Async32(struct Cache_File *pf, int irfile, void *precord, Cache_Callback32 cb,
+                                    void *arg)
+{
+    return Compat_Read_Async(NULL, pf, irfile, precord, cb, arg);
+}
+
+static unsigned Saturate(Cache_Count n)
+{
+    return n > UINT_MAX ? UINT_MAX : (unsigned)n;
+}
+
+/*!
+ * \ingroup cache_compat_interface
+ *
+ * Le résultat est propre au thread appelant : il reste valable jusqu'à son
+ * prochain appel.
+ */
+struct Cache_Instrument32 *Cache_Get_Instrument32(struct Cache *pcache)
+{
+    static __thread struct Cache_Instrument32 instr;
+    struct Cache_Instrument *pi = Cache_Get_Instrument(pcache);
+
+    instr.n_reads = Saturate(pi->n_reads);
+    instr.n_writes = Saturate(pi->n_writes);
+    instr.n_hits = Saturate(pi->n_hits);
+    instr.n_hits2 = Saturate(pi->n_hits2);
+    instr.n_misses2 = Saturate(pi->n_misses2);
+    instr.n_syncs = Saturate(pi->n_syncs);
+    instr.n_commits = Saturate(pi->n_commits);
+    instr.n_loaded = Saturate(pi->n_loaded);
+    instr.n_touched = Saturate(pi->n_touched);
+    instr.n_read = Saturate(pi->n_read);
+    instr.n_written = Saturate(pi->n_written);
+    instr.n_deref = Saturate(pi->n_deref);
+    instr.n_switches = Saturate(pi->n_switches);
+    return &instr;
+}
+
+/*!
+ * \ingroup cache_compat_interface
+ */
+Cache_Error Cache_Get_Advice32(struct Cache *pcache, struct Cache_Advice32 *padv)
+{
+    struct Cache_Advice adv;
+    Cache_Error err;
+    int c;
+
+    if ((err = Cache_Get_Advice(pcache, &adv)) != CACHE_OK)
+        return err;
+    padv->nclasses = adv.nclasses;
+    for (c = 0; c < adv.nclasses; c++)
+    {
+        padv->nrecords[c] = adv.nrecords[c];
+        padv->nblocks[c] = adv.nblocks[c];
+        padv->n_misses[c] = Saturate(adv.n_misses[c]);
+        padv->cost[c] = adv.cost[c];
+    }
+    padv->best = adv.best;
+    padv->current = adv.current;
+    return CACHE_OK;
+}
+
+/*!
+ * \ingroup cache_compat_interface
+ */
+int Cache_Get_Node_Instrument32(struct Cache *pcache, struct Cache_Node_Instrument32 *pni, int maxnodes)
+{
+    struct Cache_Node_Instrument *nodes = malloc((maxnodes > 0 ? maxnodes : 1) * sizeof(struct Cache_Node_Instrument));
+    int n = Cache_Get_Node_Instrument(pcache, nodes, maxnodes), k;
+
+    for (k = 0; k < n && k < maxnodes; k++)
+    {
+        pni[k].nblocks = nodes[k].nblocks;
+        pni[k].n_access = Saturate(nodes[k].n_access);
+        pni[k].n_hits = Saturate(nodes[k].n_hits);
+        pni[k].n_local = Saturate(nodes[k].n_local);
+    }
+    free(nodes);
+    return n;
+}
+
+/*!
+ * \ingroup cache_compat_interface
+ */
+int Cache_Get_Policy_Instrument32(struct Cache *pcache, struct Cache_Policy_Instrument32 *ppi, int maxpolicies)
+{
+    struct Cache_Policy_Instrument *policies =
+        malloc((maxpolicies > 0 ? maxpolicies : 1) * sizeof(struct Cache_Policy_Instrument));
+    int n = Cache_Get_Policy_Instrument(pcache, policies, maxpolicies), k;
+
+    for (k = 0; k < n && k < maxpolicies; k++)
+    {
+        ppi[k].name = policies[k].name;
+        ppi[k].n_access = Saturate(policies[k].n_access);
+        ppi[k].n_hits = Saturate(policies[k].n_hits);
+        ppi[k].n_switches_to = Saturate(policies[k].n_switches_to);
+        ppi[k].live = policies[k].live;
+    }
+    free(policies);
+    return n;
+}
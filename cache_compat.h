@@ -0,0 +1,109 @@
+#ifndef _CACHE_COMPAT_H_
+#define _CACHE_COMPAT_H_
+
+/*!
+ * \file cache_compat.h
+ *
+ * \brief Compatibilité avec l'interface à indices et compteurs sur 32 bits.
+ *
+ * Les indices d'enregistrement (Cache_Index) et les compteurs de
+ * l'instrumentation (Cache_Count) sont maintenant sur 64 bits. Un appelant
+ * qui passe des \c int aux fonctions de cache.h n'a rien à changer ; seuls
+ * les types qu'il reçoit ont changé : la fonction de rappel des lectures
+ * asynchrones, les structures d'instrumentation (du cache, des nœuds et des
+ * candidates de la stratégie adaptative) et le conseil sur la taille des
+ * blocs. Ce module en garde les anciennes versions, le temps d'adapter le
+ * code appelant.
+ *
+ * Les compteurs sont saturés à UINT_MAX plutôt que tronqués, et un indice
+ * supérieur à INT_MAX ne peut pas être transmis à un Cache_Callback32 :
+ * ces fonctions ne conviennent qu'aux fichiers de moins de 2^31
+ * enregistrements.
+ */
+
+#include "cache.h"
+
+/*!
+ * \defgroup cache_compat_interface Interface sur 32 bits
+ *
+ * \ingroup cache_interface
+ *
+ * @{
+ */
+
+//! Ancienne fonction de rappel des lectures asynchrones (indice sur 32 bits).
+typedef void (*Cache_Callback32)(void *arg, int irfile, void *precord, Cache_Error err);
+
+//! Lecture sans attente avec une fonction de rappel de l'ancienne interface.
+Cache_Error Cache_Read_Async32(struct Cache *pcache, int irfile, void *precord, Cache_Callback32 cb, void *arg);
+
+//! Lecture sans attente dans un fichier d'un cache partagé, ancienne interface.
+Cache_Error Cache_File_Read_Async32(struct Cache_File *pf, int irfile, void *precord, Cache_Callback32 cb,
+                                    void *arg);
+
+//! Ancienne instrumentation du cache (compteurs sur 32 bits).
+struct Cache_Instrument32
+{
+    unsigned n_reads;
+    unsigned n_writes;
+    unsigned n_hits;
+    unsigned n_hits2;
+    unsigned n_misses2;
+    unsigned n_syncs;
+    unsigned n_commits;
+    unsigned n_loaded;
+    unsigned n_touched;
+    unsigned n_read;
+    unsigned n_written;
+    unsigned n_deref;
+    unsigned n_switches;
+};
+
+//! Résultat de l'instrumentation (remise à 0 comme Cache_Get_Instrument()), ancienne interface.
+struct Cache_Instrument32 *Cache_Get_Instrument32(struct Cache *pcache);
+
+//! Ancien conseil sur la taille des blocs (défauts sur 32 bits).
+struct Cache_Advice32
+{
+    int nclasses;
+    unsigned nrecords[CACHE_ADVICE_CLASSES];
+    unsigned nblocks[CACHE_ADVICE_CLASSES];
+    unsigned n_misses[CACHE_ADVICE_CLASSES];
+    double cost[CACHE_ADVICE_CLASSES];
+    unsigned best;
+    unsigned current;
+};
+
+//! Conseil depuis le dernier appel (comme Cache_Get_Advice()), ancienne interface.
+Cache_Error Cache_Get_Advice32(struct Cache *pcache, struct Cache_Advice32 *padv);
+
+//! Ancienne instrumentation d'un nœud NUMA (compteurs sur 32 bits).
+struct Cache_Node_Instrument32
+{
+    unsigned nblocks;
+    unsigned n_access;
+    unsigned n_hits;
+    unsigned n_local;
+};
+
+//! Instrumentation des nœuds (comme Cache_Get_Node_Instrument()), ancienne interface.
+int Cache_Get_Node_Instrument32(struct Cache *pcache, struct Cache_Node_Instrument32 *pni, int maxnodes);
+
+//! Ancienne instrumentation d'une candidate de la stratégie adaptative (compteurs sur 32 bits).
+struct Cache_Policy_Instrument32
+{
+    const char *name;
+    unsigned n_access;
+    unsigned n_hits;
+    unsigned n_switches_to;
+    int live;
+};
+
+//! Instrumentation des candidates (comme Cache_Get_Policy_Instrument()), ancienne interface.
+int Cache_Get_Policy_Instrument32(struct Cache *pcache, struct Cache_Policy_Instrument32 *ppi, int maxpolicies);
+
+/*
+ * @}
+ */
+
+#endif /* _CACHE_COMPAT_H_ */
@@ -1,174 +1,87 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "cache_list.h"
 #include "low_cache.h"
 
-/*! Création d'une liste de blocs */
-struct Cache_List *Cache_List_Create()
+/* Insertion de la cellule new avant la cellule pos */
+static void Insert_Before(struct Cache_List *pos, struct Cache_List *new)
 {
-	struct Cache_List *c = malloc(sizeof(struct Cache_List));
-
-	c->pheader = NULL;
-	c->next = c;
-	c->prev = c;
-	return c;
-}
-/*! Destruction d'une liste de blocs */
-void Cache_List_Delete(struct Cache_List *list)
-{
-	Cache_List_Clear(list);
-	free(list);
+	new->next = pos;
+	new->prev = pos->prev;
+	pos->prev->next = new;
+	pos->prev = new;
 }
 
-/*! Insertion d'un élément à la fin */
-void Cache_List_Append(struct Cache_List *list, struct Cache_Block_Header *pbh)
+/* Décrochage d'une cellule (qui n'est pas détruite) */
+static void Unlink(struct Cache_List *cell)
 {
-	struct Cache_List *counter = malloc(sizeof(struct Cache_List));
-	if(list == NULL)
-		list = Cache_List_Create();
-	counter = list->prev;
-	struct Cache_List *new = malloc(sizeof(struct Cache_List));
-	if(list != NULL)
-		for(counter = counter->next; counter !=list && counter->pheader !=pbh; counter=counter->next){}
-	
-	new->pheader = pbh;
-	new->next=counter;
-	new->prev=counter->prev;
-	counter->prev->next=new;
-	counter->prev=new;
-	
-}
-/*! Insertion d'un élément au début */
-void Cache_List_Prepend(struct Cache_List *list, struct Cache_Block_Header *pbh)
-{
-	if(list == NULL)
-		list = Cache_List_Create();
-	
-	struct Cache_List *counter = list->next;
-	struct Cache_List *new = malloc(sizeof(struct Cache_List));
-	
-	new->pheader = pbh;
-	new->next=counter;
-	new->prev=counter->prev;
-	counter->prev->next=new;
-	counter->prev=new;
-	list = new;
+	cell->prev->next = cell->next;
+	cell->next->prev = cell->prev;
 }
 
-/*! Retrait du premier élément */
-struct Cache_Block_Header *Cache_List_Remove_First(struct Cache_List *list)
+/*! Création d'une liste vide pour nblocks blocs : les cellules ne sont
+ * initialisées qu'à leur première insertion */
+struct Cache_Block_List *Cache_Block_List_Create(unsigned nblocks)
 {
-	if(list == NULL)
-		list = Cache_List_Create();
-	struct Cache_List *slave = list->next;
-	slave->prev->next=slave->next;
-	slave->next->prev=slave->prev;
-	struct Cache_Block_Header *pbh = malloc(sizeof(struct Cache_Block_Header));
-	pbh = slave->pheader;
-	free(slave);
-	return pbh;
+	struct Cache_Block_List *list = malloc(sizeof(struct Cache_Block_List));
+
+	list->head.pheader = NULL;
+	list->head.next = list->head.prev = &list->head;
+	list->cells = malloc(nblocks * sizeof(struct Cache_List));
+	list->gen = calloc(nblocks, sizeof(unsigned));
+	list->cur = 1;
+	list->ncells = nblocks;
+	return list;
 }
-/*! Retrait du dernier élément */
-struct Cache_Block_Header *Cache_List_Remove_Last(struct Cache_List *list)
+
+/*! Destruction */
+void Cache_Block_List_Delete(struct Cache_Block_List *list)
 {
-	if(list == NULL)
-		list = Cache_List_Create();
-	struct Cache_List *slave;
-	for(slave=list->next; slave !=list; slave=slave->next){}
-	
-	slave->prev->next=slave->next;
-	slave->next->prev=slave->prev;
-	struct Cache_Block_Header *pbh = malloc(sizeof(struct Cache_Block_Header));
-	pbh = slave->pheader;
-	free(slave);
-	return pbh;
+	free(list->cells);
+	free(list->gen);
+	free(list);
 }
 
-/*! Retrait d'un élément quelconque */
-struct Cache_Block_Header *Cache_List_Remove(struct Cache_List *list, struct Cache_Block_Header *pbh)
+/*! Remise en l'état de liste vide : les cellules appartiennent désormais à
+ * une génération passée (elles ne sont remises à 0 qu'au retour à 0 du
+ * compteur) */
+void Cache_Block_List_Clear(struct Cache_Block_List *list)
 {
-	if(list == NULL)
-		list = Cache_List_Create();
-	struct Cache_List *slave;
-
-	for (slave=list->next; slave != list; slave=slave->next) {
-		if (slave->pheader == pbh) {
-			slave->prev->next = slave->next;
-			slave->next->prev = slave->prev;
-		}
+	list->head.next = list->head.prev = &list->head;
+	if (++list->cur == 0) {
+		memset(list->gen, 0, list->ncells * sizeof(unsigned));
+		list->cur = 1;
 	}
-	return pbh;
-	// struct Cache_List *slave;
-	// for(slave=list->next; slave !=list && slave->pheader != pbh; slave=slave->next){}
-	// int i;
-	// struct Cache_Block_Header *hhh = malloc(sizeof(struct Cache_Block_Header));
-	// //printf(":(\n");
-	// hhh = slave->pheader;
-	// //printf("OUIIII\n");
-	// i = hhh->ibcache;
-	// printf("hhh %d\n", i);
-	// //printf("%d == \n", pbh->ibcache);
-	// if(slave->pheader == pbh){
-	// 	//printf("TROUVE\n");
-	// 	slave->prev->next = slave->next; 
-	// 	slave->next->prev = slave->prev; 
-	// }
-	// else
-	// 	//printf("PAS TROUVE\n");
-	// return slave->pheader; 
 }
 
-/*! Remise en l'état de liste vide */
-void Cache_List_Clear(struct Cache_List *list)
+/*! Premier élément (NULL si la liste est vide) */
+struct Cache_Block_Header *Cache_Block_List_First(struct Cache_Block_List *list)
 {
-  struct Cache_List *count;
-  for(count=list->next; count!=list; count=count->next)
-			Cache_List_Remove_First(list); 
+	return list->head.next->pheader;
 }
 
-/*! Test de liste vide */
-bool Cache_List_Is_Empty(struct Cache_List *list)
+/*! Transférer un élément à la fin (il y est ajouté s'il n'est pas dans la liste) */
+void Cache_Block_List_Move_To_End(struct Cache_Block_List *list, struct Cache_Block_Header *pbh)
 {
-	return list->next == list->prev || list == NULL;
-}
+	struct Cache_List *cell = &list->cells[pbh->ibcache];
 
-/*! Transférer un élément à la fin */
-void Cache_List_Move_To_End(struct Cache_List *list, struct Cache_Block_Header *pbh)
-{
-	if(list == NULL)
-		list = Cache_List_Create();
-	struct Cache_Block_Header *header = Cache_List_Remove(list, pbh);
-	if(header!=NULL)
-		Cache_List_Append(list,header); 
-	else
-		Cache_List_Append(list,pbh); 
+	if (list->gen[pbh->ibcache] == list->cur)
+		Unlink(cell);
+	else {
+		list->gen[pbh->ibcache] = list->cur;
+		cell->pheader = pbh;
+	}
+	Insert_Before(&list->head, cell);
 }
-/*! Transférer un élément  au début */
-void Cache_List_Move_To_Begin(struct Cache_List *list, struct Cache_Block_Header *pbh)
+
+/*! Copie des éléments, du premier au dernier, dans un tableau : retourne leur nombre */
+int Cache_Block_List_To_Array(struct Cache_Block_List *list, struct Cache_Block_Header **array)
 {
-	if(list == NULL)
-		list = Cache_List_Create();
-	//On trouve l'element
-	struct Cache_List *counter = list->next;
-	for(counter=list->next; counter !=list && counter->pheader !=pbh; counter=counter->next){}
-	//On enlève l'element de son emplacement courant en recollant ses voisins entre eux.
-	counter->prev->next=counter->next;
-	counter->next->prev=counter->prev;
-	
-	//On colle l'element au bon endroit
-	list->prev->next = counter;
-	list->prev = counter;
-	counter->prev = list->prev;
-	counter->next = list;
-	//On passe le pointeur sur le nouveau premier element
-	list = counter;
-}
+	struct Cache_List *cell;
+	int n = 0;
 
-void print(struct Cache_List *list){
-	struct Cache_List *counter;
-	int i  = 0;
-	for(counter = list->next; counter !=list; counter = counter->next){
-		i++;
-		printf("%d, %d, %d\n",counter->pheader->ibfile, counter->pheader->ibcache, i);
-	}
+	for (cell = list->head.next; cell != &list->head; cell = cell->next)
+		array[n++] = cell->pheader;
+	return n;
 }
@@ -9,8 +9,6 @@
  *
  */
 
-#include <stdbool.h>
-
 /*! La cellule de liste doublement chainée */
 struct Cache_List
 {
@@ -19,35 +17,34 @@ struct Cache_List
     struct Cache_List *prev;		/* chainage arrière */
 
 };
-/*! Création d'une liste de blocs */
-struct Cache_List *Cache_List_Create();
-/*! Destruction d'une liste de blocs */
-void Cache_List_Delete(struct Cache_List *list);
-
-/*! Insertion d'un élément à la fin */
-void Cache_List_Append(struct Cache_List *list, struct Cache_Block_Header *pbh);
-/*! Insertion d'un élément au début*/
-void Cache_List_Prepend(struct Cache_List *list, struct Cache_Block_Header *pbh);
-
-/*! Retrait du premier élément */
-struct Cache_Block_Header *Cache_List_Remove_First(struct Cache_List *list);
-/*! Retrait du dernier élément */
-struct Cache_Block_Header *Cache_List_Remove_Last(struct Cache_List *list);
-/*! Retrait d'un élément quelconque */
-struct Cache_Block_Header *Cache_List_Remove(struct Cache_List *list,
-                                             struct Cache_Block_Header *pbh);
-
-/*! Remise en l'état de liste vide */
-void Cache_List_Clear(struct Cache_List *list);
 
-/*! Test de liste vide */
-bool Cache_List_Is_Empty(struct Cache_List *list);
+/*! Liste des blocs d'un cache, avec une cellule par bloc
+ *
+ * Les cellules sont dans un tableau indexé par ibcache : un bloc est
+ * retrouvé, déplacé ou ajouté en temps constant, sans allocation. Une
+ * cellule n'est dans la liste que si sa génération est la génération
+ * courante : vider la liste ne parcourt pas les cellules.
+ */
+struct Cache_Block_List
+{
+    struct Cache_List head;	/* sentinelle */
+    struct Cache_List *cells;	/* cellule de chaque bloc, par ibcache */
+    unsigned *gen;		/* génération de la liste qui contient chaque cellule (0 : aucune) */
+    unsigned cur;		/* génération courante */
+    unsigned ncells;		/* nombre de blocs */
+};
 
-/*! Transférer un élément à la fin */
-void Cache_List_Move_To_End(struct Cache_List *list,
-                            struct Cache_Block_Header *pbh);
-/*! Transférer un élément  au début */
-void Cache_List_Move_To_Begin(struct Cache_List *list,
-                              struct Cache_Block_Header *pbh);
+/*! Création d'une liste vide pour nblocks blocs */
+struct Cache_Block_List *Cache_Block_List_Create(unsigned nblocks);
+/*! Destruction */
+void Cache_Block_List_Delete(struct Cache_Block_List *list);
+/*! Remise en l'état de liste vide (en temps constant) */
+void Cache_Block_List_Clear(struct Cache_Block_List *list);
+/*! Premier élément (NULL si la liste est vide) */
+struct Cache_Block_Header *Cache_Block_List_First(struct Cache_Block_List *list);
+/*! Transférer un élément à la fin (il y est ajouté s'il n'est pas dans la liste) */
+void Cache_Block_List_Move_To_End(struct Cache_Block_List *list, struct Cache_Block_Header *pbh);
+/*! Copie des éléments, du premier au dernier, dans un tableau */
+int Cache_Block_List_To_Array(struct Cache_Block_List *list, struct Cache_Block_Header **array);
 
 #endif /* CACHE_LIST_ */
@@ -0,0 +1,317 @@
+/*!
+ * \file flagscan.c
+ *
+ * \brief Balayages vectorisés de tableaux de flags (voir flagscan.h).
+ *
+ * Chaque version traite les blocs par paquets de la largeur de ses
+ * registres, puis les derniers un à un. Les versions SSE2 et AVX2 sont
+ * compilées avec l'attribut \c target : le reste du programme n'a pas besoin
+ * de -mavx2, et elles ne sont appelées que si le processeur les a.
+ */
+
+#include <string.h>
+
+#include "flagscan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FLAGSCAN_X86
+#endif
+
+//! Une version des balayages
+struct Flag_Scan_Impl
+{
+    const char *name;
+    int (*available)(void);
+    int (*min)(const unsigned char *a, const unsigned char *b, int n, unsigned char mask);
+    void (*clear)(unsigned char *a, int n, unsigned char bits);
+    int (*collect)(const unsigned char *a, int n, unsigned char mask, unsigned char value, int *out);
+};
+
+/*
+ * Version C simple
+ * ----------------
+ * Elle finit aussi le travail des autres (blocs au-delà du dernier paquet).
+ */
+
+//! Premier indice de plus petite valeur à partir de first (best, de valeur bestv, sinon)
+static int Scalar_Min_From(const unsigned char *a, const unsigned char *b, int first, int n,
+                           unsigned char mask, int best, unsigned bestv)
+{
+    int i;
+
+    for (i = first; i < n && bestv > 0; i++) {
+        unsigned v = (a[i] | b[i]) & mask;
+
+        if (v < bestv) {
+            bestv = v;
+            best = i;
+        }
+    }
+    return best;
+}
+
+static int Scalar_Collect_From(const unsigned char *a, int first, int n, unsigned char mask,
+                               unsigned char value, int *out, int nout)
+{
+    int i;
+
+    for (i = first; i < n; i++)
+        if ((a[i] & mask) == value) out[nout++] = i;
+    return nout;
+}
+
+static int Scalar_Available(void)
+{
+    return 1;
+}
+
+static int Scalar_Min(const unsigned char *a, const unsigned char *b, int n, unsigned char mask)
+{
+    return Scalar_Min_From(a, b, 0, n, mask, -1, 256);
+}
+
+static void Scalar_Clear(unsigned char *a, int n, unsigned char bits)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        a[i] &= (unsigned char)~bits;
+}
+
+static int Scalar_Collect(const unsigned char *a, int n, unsigned char mask, unsigned char value, int *out)
+{
+    return Scalar_Collect_From(a, 0, n, mask, value, out, 0);
+}
+
+#ifdef FLAGSCAN_X86
+
+/*
+ * Version SSE2 : 16 blocs par instruction
+ * ---------------------------------------
+ * Le minimum se fait en deux passes : la plus petite valeur (la première
+ * passe s'arrête au premier 0, qui est alors la réponse), puis son premier
+ * indice.
+ */
+
+static int Sse2_Available(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+__attribute__((target("sse2")))
+static int Sse2_Min(const unsigned char *a, const unsigned char *b, int n, unsigned char mask)
+{
+    const __m128i vmask = _mm_set1_epi8((char)mask), zero = _mm_setzero_si128();
+    __m128i vmin = _mm_set1_epi8((char)0xff);
+    unsigned char lanes[16];
+    unsigned m = 256;
+    int i, k, last = n & ~15;
+
+    for (i = 0; i < last; i += 16) {
+        __m128i v = _mm_and_si128(_mm_or_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+                                               _mm_loadu_si128((const __m128i *)(b + i))), vmask);
+        unsigned z = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+
+        if (z != 0) return i + __builtin_ctz(z);
+        vmin = _mm_min_epu8(vmin, v);
+    }
+    if (last > 0) {
+        _mm_storeu_si128((__m128i *)lanes, vmin);
+        for (k = 0; k < 16; k++)
+            if (lanes[k] < m) m = lanes[k];
+    }
+
+    // Premier indice de la plus petite valeur des paquets, puis les derniers blocs
+    for (i = 0; i < last; i += 16) {
+        __m128i v = _mm_and_si128(_mm_or_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+                                               _mm_loadu_si128((const __m128i *)(b + i))), vmask);
+        unsigned e = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)m)));
+
+        if (e != 0) return Scalar_Min_From(a, b, last, n, mask, i + __builtin_ctz(e), m);
+    }
+    return Scalar_Min_From(a, b, last, n, mask, -1, 256);
+}
+
+__attribute__((target("sse2")))
+static void Sse2_Clear(unsigned char *a, int n, unsigned char bits)
+{
+    const __m128i vbits = _mm_set1_epi8((char)bits);
+    int i, last = n & ~15;
+
+    for (i = 0; i < last; i += 16)
+        _mm_storeu_si128((__m128i *)(a + i),
+                         _mm_andnot_si128(vbits, _mm_loadu_si128((const __m128i *)(a + i))));
+    Scalar_Clear(a + last, n - last, bits);
+}
+
+__attribute__((target("sse2")))
+static int Sse2_Collect(const unsigned char *a, int n, unsigned char mask, unsigned char value, int *out)
+{
+    const __m128i vmask = _mm_set1_epi8((char)mask), vvalue = _mm_set1_epi8((char)value);
+    int i, nout = 0, last = n & ~15;
+
+    for (i = 0; i < last; i += 16) {
+        __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(a + i)), vmask);
+        unsigned e = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vvalue));
+
+        for (; e != 0; e &= e - 1)
+            out[nout++] = i + __builtin_ctz(e);
+    }
+    return Scalar_Collect_From(a, last, n, mask, value, out, nout);
+}
+
+/*
+ * Version AVX2 : 32 blocs par instruction
+ * ---------------------------------------
+ */
+
+static int Avx2_Available(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static int Avx2_Min(const unsigned char *a, const unsigned char *b, int n, unsigned char mask)
+{
+    const __m256i vmask = _mm256_set1_epi8((char)mask), zero = _mm256_setzero_si256();
+    __m256i vmin = _mm256_set1_epi8((char)0xff);
+    unsigned char lanes[32];
+    unsigned m = 256;
+    int i, k, last = n & ~31;
+
+    for (i = 0; i < last; i += 32) {
+        __m256i v = _mm256_and_si256(_mm256_or_si256(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                                     _mm256_loadu_si256((const __m256i *)(b + i))), vmask);
+        unsigned z = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+
+        if (z != 0) return i + __builtin_ctz(z);
+        vmin = _mm256_min_epu8(vmin, v);
+    }
+    if (last > 0) {
+        _mm256_storeu_si256((__m256i *)lanes, vmin);
+        for (k = 0; k < 32; k++)
+            if (lanes[k] < m) m = lanes[k];
+    }
+
+    for (i = 0; i < last; i += 32) {
+        __m256i v = _mm256_and_si256(_mm256_or_si256(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                                     _mm256_loadu_si256((const __m256i *)(b + i))), vmask);
+        unsigned e = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)m)));
+
+        if (e != 0) return Scalar_Min_From(a, b, last, n, mask, i + __builtin_ctz(e), m);
+    }
+    return Scalar_Min_From(a, b, last, n, mask, -1, 256);
+}
+
+__attribute__((target("avx2")))
+static void Avx2_Clear(unsigned char *a, int n, unsigned char bits)
+{
+    const __m256i vbits = _mm256_set1_epi8((char)bits);
+    int i, last = n & ~31;
+
+    for (i = 0; i < last; i += 32)
+        _mm256_storeu_si256((__m256i *)(a + i),
+                            _mm256_andnot_si256(vbits, _mm256_loadu_si256((const __m256i *)(a + i))));
+    Scalar_Clear(a + last, n - last, bits);
+}
+
+__attribute__((target("avx2")))
+static int Avx2_Collect(const unsigned char *a, int n, unsigned char mask, unsigned char value, int *out)
+{
+    const __m256i vmask = _mm256_set1_epi8((char)mask), vvalue = _mm256_set1_epi8((char)value);
+    int i, nout = 0, last = n & ~31;
+
+    for (i = 0; i < last; i += 32) {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(a + i)), vmask);
+        unsigned e = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vvalue));
+
+        for (; e != 0; e &= e - 1)
+            out[nout++] = i + __builtin_ctz(e);
+    }
+    return Scalar_Collect_From(a, last, n, mask, value, out, nout);
+}
+
+#endif /* FLAGSCAN_X86 */
+
+//! Les versions, de la plus rapide à la plus lente
+static const struct Flag_Scan_Impl Impls[] = {
+#ifdef FLAGSCAN_X86
+    { "avx2", Avx2_Available, Avx2_Min, Avx2_Clear, Avx2_Collect },
+    { "sse2", Sse2_Available, Sse2_Min, Sse2_Clear, Sse2_Collect },
+#endif
+    { "scalar", Scalar_Available, Scalar_Min, Scalar_Clear, Scalar_Collect },
+};
+#define NIMPLS ((int)(sizeof(Impls)/sizeof(Impls[0])))
+
+//! Version utilisée (NULL : pas encore choisie)
+static const struct Flag_Scan_Impl *Impl = NULL;
+
+static const struct Flag_Scan_Impl *Current(void)
+{
+    const struct Flag_Scan_Impl *pimpl = __atomic_load_n(&Impl, __ATOMIC_ACQUIRE);
+
+    if (pimpl == NULL) {
+        Flag_Scan_Select(NULL);
+        pimpl = __atomic_load_n(&Impl, __ATOMIC_ACQUIRE);
+    }
+    return pimpl;
+}
+
+/*!
+ * \ingroup flagscan_interface
+ *
+ * Plusieurs threads peuvent faire le premier choix en même temps : ils
+ * choisissent la même version.
+ */
+int Flag_Scan_Select(const char *name)
+{
+    int k;
+
+    for (k = 0; k < NIMPLS; k++) {
+        if ((name == NULL || strcmp(Impls[k].name, name) == 0) && Impls[k].available()) {
+            __atomic_store_n(&Impl, &Impls[k], __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*!
+ * \ingroup flagscan_interface
+ */
+const char *Flag_Scan_Name(void)
+{
+    return Current()->name;
+}
+
+/*!
+ * \ingroup flagscan_interface
+ *
+ * Comme le choix de la victime de NUR : le premier bloc de la plus petite
+ * classe, la recherche s'arrêtant au premier bloc de classe 0.
+ */
+int Flag_Scan_Min(const unsigned char *a, const unsigned char *b, int n, unsigned char mask)
+{
+    return Current()->min(a, b, n, mask);
+}
+
+/*!
+ * \ingroup flagscan_interface
+ */
+void Flag_Scan_Clear(unsigned char *a, int n, unsigned char bits)
+{
+    Current()->clear(a, n, bits);
+}
+
+/*!
+ * \ingroup flagscan_interface
+ *
+ * \a out doit pouvoir recevoir \a n indices.
+ */
+int Flag_Scan_Collect(const unsigned char *a, int n, unsigned char mask, unsigned char value, int *out)
+{
+    return Current()->collect(a, n, mask, value, out);
+}
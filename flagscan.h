@@ -0,0 +1,48 @@
+#ifndef _FLAGSCAN_H_
+#define _FLAGSCAN_H_
+
+/*!
+ * \file flagscan.h
+ *
+ * \brief Balayages vectorisés de tableaux de flags (un octet par bloc).
+ *
+ * Les balayages de tous les blocs (choix de la victime de NUR, remise à 0
+ * de ses bits R, recherche des blocs modifiés par Cache_Sync()) ne lisent
+ * pas les entêtes de bloc, de 32 octets chacun, mais des tableaux d'un octet
+ * par bloc (\c fstate du cache, bits R de NUR). Un même balayage traite
+ * alors 16 blocs par instruction en SSE2, 32 en AVX2.
+ *
+ * La version est choisie au premier appel d'après le processeur (cpuid, par
+ * __builtin_cpu_supports()) : AVX2, sinon SSE2, sinon C simple (hors x86).
+ * Flag_Scan_Select() permet d'en imposer une, pour les mesures (voir
+ * bench_Flags.c).
+ */
+
+/*!
+ * \defgroup flagscan_interface Balayages de flags
+ *
+ * \ingroup low_cache_interface
+ *
+ * @{
+ */
+
+//! Premier indice i de plus petite valeur de (a[i] | b[i]) & mask (-1 si n est nul).
+int Flag_Scan_Min(const unsigned char *a, const unsigned char *b, int n, unsigned char mask);
+
+//! Remise à 0 des bits \a bits de a[0] à a[n - 1].
+void Flag_Scan_Clear(unsigned char *a, int n, unsigned char bits);
+
+//! Indices i tels que (a[i] & mask) == value, rangés dans out : retourne leur nombre.
+int Flag_Scan_Collect(const unsigned char *a, int n, unsigned char mask, unsigned char value, int *out);
+
+//! Choix de la version ("avx2", "sse2", "scalar" ; NULL : la meilleure) : 0 si elle n'est pas disponible.
+int Flag_Scan_Select(const char *name);
+
+//! Nom de la version utilisée.
+const char *Flag_Scan_Name(void);
+
+/*
+ * @}
+ */
+
+#endif /* _FLAGSCAN_H_ */
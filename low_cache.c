@@ -0,0 +1,67 @@
+/*!
+ * \file low_cache.c
+ *
+ * \brief Fonctions internes du cache indépendantes de la stratégie.
+ */
+
+#include <assert.h>
+
+#include "low_cache.h"
+
+/*!
+ * \ingroup low_cache_interface
+ *
+ * Les blocs libres (invalides) sont pris dans l'ordre du tableau des
+ * entêtes à partir de \c pfree. Lorsque le dernier bloc a été distribué,
+ * \c pfree vaut NULL : il ne reste que les blocs libérés par la fermeture
+ * d'un fichier (pile \c freed), jusqu'à la prochaine invalidation. Un bloc
+ * libre peut être un bloc valide d'une génération passée (voir BLOCK_VALID()).
+ *
+ * En mode NUMA, les blocs jamais distribués sont pris dans la tranche du
+ * nœud du thread appelant, puis dans celles des autres nœuds.
+ *
+ * Les entêtes sont à 0 à l'allocation des blocs : un bloc pris dans la
+ * réserve (\c pfree ou tranche d'un nœud) reçoit ici son indice et l'adresse
+ * de ses données (voir Alloc_Blocks() dans cache.c). Il peut l'avoir déjà
+ * été, avant une invalidation : ce sont alors les mêmes valeurs.
+ *
+ * \param pcache pointeur sur le cache
+ * \return le premier bloc libre ou NULL s'il n'y en a plus
+ */
+struct Cache_Block_Header *Get_Free_Block(struct Cache *pcache)
+{
+    struct Cache_Block_Header *pbh = pcache->pfree;
+
+    if (pcache->nodes != NULL) {
+        int node = Cache_Thread_Node(pcache), k;
+
+        for (k = 0; k < pcache->nnodes; k++) {
+            struct Cache_Node *pn = &pcache->nodes[(node + k) % pcache->nnodes];
+
+            if (pn->next < pn->first + pn->count) {
+                pbh = &pcache->headers[pn->next];
+                assert(!BLOCK_VALID(pcache, pbh));
+                pbh->ibcache = pn->next;
+                pbh->data = BLOCK_DATA(pcache, pn->arena, pn->first, pn->next);
+                pn->next++;
+                return pbh;
+            }
+        }
+        pbh = NULL;
+    }
+
+    if (pbh == NULL) {
+        if (pcache->nfreed == 0) return NULL;
+        pbh = &pcache->headers[pcache->freed[--pcache->nfreed]];
+        assert(!BLOCK_VALID(pcache, pbh));
+        return pbh;
+    }
+    assert(!BLOCK_VALID(pcache, pbh));
+    pbh->ibcache = pbh - pcache->headers;
+    pbh->data = BLOCK_DATA(pcache, pcache->arena, 0, pbh->ibcache);
+
+    if (++pcache->pfree >= pcache->headers + pcache->nblocks)
+        pcache->pfree = NULL;
+
+    return pbh;
+}
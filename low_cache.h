@@ -8,13 +8,17 @@
  * $Id: low_cache.h,v 1.3 2008/03/04 16:52:49 jpr Exp $
  */
 
-#ifndef _LOW__CACHE_H_
+#ifndef _LOW_CACHE_H_
 #define _LOW_CACHE_H_
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "cache.h"
+#include "backend.h"
+#include "spill.h"
 
 /*!
  * \defgroup low_cache_interface Interface de réalisation interne du cache
@@ -35,6 +39,7 @@ typedef enum  {
     VALID = 0x1, //!< le bloc est valide
     MODIF = 0x2, //!< le bloc a été modifié
     R_FLAG = 0x4,
+    NOREAD = 0x8, //!< le bloc n'a pas été lu : seuls ses enregistrements accédés sont à jour
 } Cache_Flag;
 
 //! Entête de chaque bloc.
@@ -48,23 +53,110 @@ typedef enum  {
 struct Cache_Block_Header
 {
     Cache_Flag flags; 	        //!< Indicateurs d'état.
-    int ibfile;			//!< Index de ce block dans le fichier.
+    int ifile;			//!< Fichier de ce block (indice dans le cache partagé).
+    Cache_Index ibfile;		//!< Index de ce block dans le fichier.
     int ibcache;		//!< Index de ce block dans le cache.
+    unsigned seq;		//!< Version (seqlock) : impaire pendant une modification du bloc.
+    unsigned gen;		//!< Génération du cache au chargement du bloc (voir BLOCK_VALID()).
     char *data; 		//!< Les données de l'utilisateur.
 };
 
 
+/*! Un fichier ouvert dans le cache.
+ *
+ * \ingroup low_cache_interface
+ *
+ * Un cache peut être partagé par plusieurs fichiers (voir Cache_Pool_Create()) :
+ * ses blocs sont alors identifiés par le couple (\c ifile, \c ibfile). Les
+ * quotas bornent le nombre de blocs valides du fichier : un fichier qui a
+ * atteint \c max ne peut que remplacer ses propres blocs, et un fichier qui
+ * n'a pas plus de \c min blocs ne se les fait pas prendre par les autres.
+ */
+struct Cache_File
+{
+    struct Cache *pcache;	//!< Le cache partagé
+    int ifile;			//!< Indice du fichier dans le cache
+    char *file;			//!< Nom du fichier
+    struct Cache_Backend *pbackend; //!< Stockage sous-jacent (fichier, mémoire...)
+    unsigned int min;		//!< Quota minimal de blocs
+    unsigned int max;		//!< Quota maximal de blocs (0 : pas de limite)
+    unsigned int nres;		//!< Nombre de blocs valides du fichier
+};
+
+//! Plage d'enregistrements d'un fichier et son indication d'accès (voir Cache_Advise()).
+/*!
+ * \ingroup low_cache_interface
+ */
+struct Cache_Hint_Range
+{
+    int ifile;                  //!< Indice du fichier
+    Cache_Index first;          //!< Premier enregistrement de la plage
+    Cache_Index count;          //!< Nombre d'enregistrements
+    Cache_Hint hint;            //!< \c CACHE_HINT_SEQUENTIAL ou \c CACHE_HINT_RANDOM
+};
+
+//! Nombre maximal de plages d'indication d'un cache (les plus anciennes sont oubliées).
+#define CACHE_MAX_HINTS 16
+
+//! Nombre de tampons de lectures du mode concurrent (un thread écrit toujours dans le même)
+#define READ_STRIPES 16
+
+//! Capacité d'un tampon de lectures (puissance de 2)
+#define READ_BUFFER 64
+
+//! Tampon des lectures faites sans verrou (mode \c CACHE_CONCURRENT).
+/*!
+ * \ingroup low_cache_interface
+ *
+ * Les threads y déposent les blocs lus ; le détenteur du verrou du cache les
+ * signale ensuite à la stratégie, par lots. Un tampon plein perd les lectures
+ * suivantes : la stratégie n'a besoin que d'une image approchée de la
+ * récence.
+ */
+struct Cache_Read_Buffer
+{
+    unsigned head;              //!< Prochaine entrée à signaler (détenteur du verrou)
+    unsigned tail;              //!< Prochaine entrée à remplir (threads lecteurs)
+    uint64_t slots[READ_BUFFER]; //!< (version << 32) | (ibcache + 1) ; 0 : vide
+    Cache_Count n_reads;        //!< Lectures sans verrou
+    Cache_Count n_hits;         //!< Succès parmi elles
+} __attribute__((aligned(64)));
+
+//! Tranche de blocs d'un nœud NUMA (voir numa.h).
+/*!
+ * \ingroup low_cache_interface
+ *
+ * Les compteurs sont incrémentés par des opérations atomiques : les
+ * lectures sans verrou du mode \c CACHE_CONCURRENT les mettent aussi à jour.
+ */
+struct Cache_Node
+{
+    char *arena;                //!< Données des blocs du nœud (ou NULL)
+    size_t arena_size;          //!< Taille de \c arena
+    unsigned first;             //!< Premier bloc du nœud (ibcache)
+    unsigned count;             //!< Nombre de blocs du nœud
+    unsigned next;              //!< Prochain bloc libre jamais distribué
+    Cache_Count n_access;       //!< Accès des threads du nœud
+    Cache_Count n_hits;         //!< Succès parmi eux
+    Cache_Count n_local;        //!< Succès sur un bloc du nœud
+} __attribute__((aligned(64)));
+
 /*! Le cache lui-même.
  *
  * \ingroup low_cache_interface
  *
- * Cette structure contient les paramètres de configuration (nom et flux du
- * fichier) ainsi que les paramètres de dimensionnement. La stratégie courante
+ * Cette structure contient les paramètres de configuration (fichiers ouverts et
+ * type de stockage sous-jacent) ainsi que les paramètres de dimensionnement. La stratégie courante
  * n'est connue qu'à travers un pointeur \b opaque (\c pstrategy). 
  * 
  * On trouve aussi des données dynamiques de gestion comme celles liées à
  * l'instrumentation, le début de la liste libre (\c pfree) ainsi qu'un
- * pointeurs sur le tableau des blocs du cache (\c pheaders).
+ * pointeurs sur le tableau des blocs du cache (\c pheaders). Les blocs libérés
+ * par la fermeture d'un fichier sont empilés dans \c freed.
+ *
+ * Les blocs valides sont indexés par leur fichier et leur indice-fichier dans une table de
+ * hachage chaînée (\c hash, \c hnext), ce qui rend la recherche d'un bloc
+ * indépendante de la taille du cache.
  *
  * \note Nous avons fait un petit coup de canif dans la moduularité (et
  * l'opacité) de la stratégie) en prévoyant ici un champ spécifique à une
@@ -72,22 +164,87 @@ struct Cache_Block_Header
  * en effet d'un paramètre de configuration du cache, passé lors de la création
  * de ce dernier. mais c'est un artefact du simulateur. Dans un cache réel,
  * cette période serait définie temporellement et non par un nombre d'accès.
+ * De même, \c strategy et \c pops ne servent qu'aux exécutables où la
+ * stratégie est choisie à l'exécution (voir MULTI_strategy.c).
  */
 struct Cache
 {
-    char *file;		    	//!< Nom du fichier   
-    FILE *fp;			//!< Pointeur sur fichier 
+    struct Cache_File **files;	//!< Fichiers ouverts, par indice (NULL : indice libre)
+    int nfiles;			//!< Taille de \c files
+    Cache_Backend_Kind backend;	//!< Type de stockage des fichiers
+    struct Spill *pspill;	//!< Second niveau (ou NULL)
+    char *spill_buf;		//!< Bloc promu du second niveau avant la rétrogradation de celui qu'il remplace
     unsigned int nblocks;	//!< Nb de blocs dans le cache
     unsigned int nrecords;	//!< Nombre d'enregistrements dans chaque bloc
     size_t recordsz;		//!< Taille d'un enregistrement
     size_t blocksz;		//!< Taille d'un bloc 
-    unsigned int nderef;	//!< période de déréférençage pour NUR 
+    unsigned int nderef;	//!< période de déréférençage pour NUR (de vieillissement pour AGING)
     void *pstrategy;		//!< Structure de données dépendant de la stratégie 
+    const char *strategy;	//!< Nom de la stratégie demandée (MULTI seulement)
+    const struct Strategy_Ops *pops; //!< Stratégie choisie à l'exécution (MULTI seulement)
+    int sync_count;		//!< Nombre d'accès avant la prochaine synchronisation
+    char *snapshot;		//!< Instantané réécrit à la fermeture (ou NULL)
     struct Cache_Instrument instrument; //!< Instrumentation du cache 
+    unsigned gen;               //!< Génération : Cache_Invalidate() l'incrémente (voir BLOCK_VALID())
     struct Cache_Block_Header *pfree;   //!< Premier bloc libre (invalide) 
     struct Cache_Block_Header *headers; //!< Les données elles-mêmes 
+    char *arena;                //!< Données de tous les blocs (ou NULL : sans données, ou mode NUMA)
+    size_t arena_size;          //!< Taille de \c arena
+    unsigned char *fstate;      //!< Bits V et M de chaque bloc, un octet par ibcache (balayages, voir flagscan.h)
+    int *freed;                 //!< Pile des blocs libérés (par ibcache)
+    unsigned int nfreed;        //!< Nombre de blocs dans \c freed
+    int *hash;                  //!< Index : premier bloc de chaque classe de (ifile, ibfile)
+    int *hnext;                 //!< Index : bloc suivant de la même classe (par ibcache)
+    unsigned int hmask;         //!< Index : nombre de classes - 1 (puissance de 2)
+    unsigned char *touched;     //!< Enregistrements accédés de chaque bloc (\c tsz octets par ibcache)
+    unsigned char *dirty;       //!< Enregistrements modifiés de chaque bloc (\c tsz octets par ibcache)
+    size_t tsz;                 //!< Taille d'une ligne de \c touched et \c dirty
+    struct Advisor *padvisor;   //!< Conseiller de taille de bloc (ou NULL)
+    Cache_Write_Policy write_policy; //!< Allocation des blocs sur défaut en écriture
+    struct Cache_Hint_Range hints[CACHE_MAX_HINTS]; //!< Plages d'indication, de la plus ancienne à la plus récente
+    int nhints;                 //!< Nombre de plages dans \c hints
+    Cache_Concurrency concurrency; //!< Accès par plusieurs threads
+    pthread_mutex_t lock;       //!< Verrou du cache (récursif ; modes multi-threads)
+    struct Cache_Read_Buffer *rbufs; //!< Tampons des lectures sans verrou (\c READ_STRIPES, ou NULL)
+    struct Cache_Async *pasync; //!< Lectures asynchrones (NULL : aucune encore)
+    struct Cache_Commit *pcommit; //!< Écritures durables groupées (NULL : \c CACHE_SYNC_BUFFERED)
+    Cache_Numa_Mode numa;       //!< Placement NUMA des blocs
+    struct Cache_Node *nodes;   //!< Tranches des nœuds (\c nnodes, ou NULL hors mode NUMA)
+    int nnodes;                 //!< Nombre de nœuds
+    Cache_Advisor_Mode advisor; //!< Mode du conseiller
+    unsigned int advisor_count; //!< Nombre d'accès depuis le dernier examen du conseil (mode automatique)
 };
 
+//! Le bloc est-il valide ?
+/*!
+ * \ingroup low_cache_interface
+ *
+ * Cache_Invalidate() ne parcourt pas les blocs : elle change la génération du
+ * cache, et les blocs chargés avant, qui gardent leur bit V, sont invalides.
+ * Un tel bloc reste dans l'index (où Hash_Find() l'ignore) et dans \c fstate
+ * jusqu'à ce que Get_Free_Block() le redistribue. Seul ce qui peut voir des
+ * blocs d'une génération passée (balayage des entêtes, blocs libres) a besoin
+ * de ce test ; les structures des stratégies sont remises à 0 par
+ * Strategy_Invalidate().
+ */
+#define BLOCK_VALID(pcache, header) \
+    (((header)->flags & VALID) && (header)->gen == (pcache)->gen)
+
+//! Recopie des bits V et M d'un bloc dans \c fstate (après chaque modification de ces bits)
+#define FLAGS_COPY(pcache, header) \
+    ((pcache)->fstate[(header)->ibcache] = (unsigned char)((header)->flags & (VALID | MODIF)))
+
+//! Écriture (verrou pris) d'un champ que les lectures sans verrou peuvent voir
+/*!
+ * \ingroup low_cache_interface
+ *
+ * Read_Lockless() (cache.c) lit sans verrou l'index, les bits des blocs
+ * (\c flags, \c ifile, \c ibfile, \c gen) et leurs enregistrements accédés ;
+ * ces champs sont écrits par des stores atomiques "relaxed", que la version du
+ * bloc (\c seq, voir Seq_Begin()) ordonne.
+ */
+#define PUBLISH(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+
 //! Fréquence de synchronisation
 /*!
  * \ingroup low_cache_interface
@@ -101,6 +258,10 @@ struct Cache
 //! Recherche d'un bloc libre.
 struct Cache_Block_Header *Get_Free_Block(struct Cache *pcache);
 
+//! Adresse des données du bloc \a ib dans la zone \a arena, qui commence au bloc \a first
+#define BLOCK_DATA(pcache, arena, first, ib) \
+    ((arena) != NULL ? (arena) + (size_t)((ib) - (first)) * (pcache)->blocksz : NULL)
+
 //! Adresse de l'enregistrement d'indice-fichier \a ind dans le bloc pointé par \a pb
 /*!
  * \ingroup low_cache_interface
@@ -121,6 +282,6 @@ struct Cache_Block_Header *Get_Free_Block(struct Cache *pcache);
  * \param ibfile indice du bloc le fichier
  * \return l'adresse en octet de l'enregistrement dans le fichier
  */
-#define DADDR(pcache, ibfile) ((ibfile) * (pcache)->blocksz) 
+#define DADDR(pcache, ibfile) ((off_t)(ibfile) * (off_t)(pcache)->blocksz)
 
 #endif /* _LOW_CACHE_H_ */
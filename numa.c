@@ -0,0 +1,102 @@
+/*!
+ * \file numa.c
+ *
+ * \brief Placement de la mémoire du cache sur les nœuds NUMA (voir numa.h).
+ *
+ * Les appels système mbind() et getcpu() sont faits directement, sans
+ * libnuma : ils échouent sans dommage sur un noyau qui ne les connaît pas.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "numa.h"
+
+//! Politique « nœud préféré » de mbind() (voir <linux/mempolicy.h>)
+#define NUMA_MPOL_PREFERRED 1
+
+/*!
+ * \ingroup numa_interface
+ *
+ * Le fichier /sys/devices/system/node/online liste les nœuds ("0-1,3") ;
+ * le nombre retourné est le plus grand numéro plus un.
+ */
+int Numa_Machine_Nodes(void)
+{
+    FILE *fp = fopen("/sys/devices/system/node/online", "r");
+    char line[256], *p;
+    int nnodes = 1;
+
+    if (fp == NULL) return 1;
+    if (fgets(line, sizeof(line), fp) != NULL)
+    {
+        for (p = line; *p != '\0'; p++)
+        {
+            if ((p == line || p[-1] == '-' || p[-1] == ',') && *p >= '0' && *p <= '9'
+                && atoi(p) + 1 > nnodes)
+                nnodes = atoi(p) + 1;
+        }
+    }
+    fclose(fp);
+    return nnodes < NUMA_MAX_NODES ? nnodes : NUMA_MAX_NODES;
+}
+
+/*!
+ * \ingroup numa_interface
+ *
+ * La zone est anonyme (mise à zéro) ; ses pages ne sont pas encore
+ * allouées : elles le seront au premier accès, sur le nœud demandé si
+ * mbind() a réussi, sinon selon la politique par défaut du processus. Elle
+ * est réservée sans être comptée d'avance dans la mémoire engagée du système
+ * (MAP_NORESERVE) : seules ses pages touchées comptent. Sans \a bind, c'est
+ * une simple réservation, qui sert aussi hors mode NUMA.
+ */
+void *Numa_Alloc(size_t size, int node, int bind)
+{
+    void *p;
+
+    if (size == 0) return NULL;
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    if (bind)
+    {
+        unsigned long mask = 1UL << node;
+
+        syscall(SYS_mbind, p, size, NUMA_MPOL_PREFERRED, &mask, (unsigned long)NUMA_MAX_NODES, 0);
+    }
+    return p;
+}
+
+/*!
+ * \ingroup numa_interface
+ */
+void Numa_Free(void *p, size_t size)
+{
+    if (p != NULL) munmap(p, size);
+}
+
+/*!
+ * \ingroup numa_interface
+ *
+ * Le nœud réel est redemandé à chaque appel (le thread a pu migrer) ; le
+ * rang d'un thread simulé est fixé à son premier appel.
+ */
+int Numa_Thread_Node(int nnodes, int simulated)
+{
+    static unsigned nthreads;
+    static __thread unsigned rank;
+    unsigned cpu, node = 0;
+
+    if (simulated)
+    {
+        if (rank == 0) rank = __atomic_add_fetch(&nthreads, 1, __ATOMIC_RELAXED);
+        return (rank - 1) % nnodes;
+    }
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) return 0;
+    return node % nnodes;
+}
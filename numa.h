@@ -0,0 +1,52 @@
+#ifndef _NUMA_H_
+#define _NUMA_H_
+
+/*!
+ * \file numa.h
+ *
+ * \brief Placement de la mémoire du cache sur les nœuds NUMA.
+ *
+ * En mode NUMA, les blocs du cache sont répartis en tranches contiguës
+ * (par ibcache), une par nœud ; les données de chaque tranche sont dans une
+ * zone (arena) allouée par mmap() et liée à son nœud par mbind(). Un bloc
+ * libre est pris en priorité dans la tranche du nœud du thread qui le
+ * demande : un bloc chargé par un thread est ainsi, en général, proche de
+ * lui.
+ *
+ * Sur une machine à un seul nœud, les nœuds peuvent être simulés : les
+ * threads leur sont affectés à tour de rôle, dans l'ordre de leur premier
+ * accès, et la mémoire n'est pas liée. Le placement et l'instrumentation par
+ * nœud (voir Cache_Get_Node_Instrument()) se comportent alors comme sur une
+ * machine à plusieurs nœuds, sans l'effet sur les temps d'accès.
+ */
+
+#include <stddef.h>
+
+/*!
+ * \defgroup numa_interface Placement NUMA
+ *
+ * \ingroup low_cache_interface
+ *
+ * @{
+ */
+
+//! Nombre maximal de nœuds gérés
+#define NUMA_MAX_NODES 64
+
+//! Nombre de nœuds de la machine (1 si le noyau ne l'indique pas).
+int Numa_Machine_Nodes(void);
+
+//! Réservation d'une zone de \a size octets, liée au nœud \a node si \a bind est vrai.
+void *Numa_Alloc(size_t size, int node, int bind);
+
+//! Libération d'une zone allouée par Numa_Alloc().
+void Numa_Free(void *p, size_t size);
+
+//! Nœud du thread appelant parmi \a nnodes : celui de son processeur, ou son rang si \a simulated.
+int Numa_Thread_Node(int nnodes, int simulated);
+
+/*
+ * @}
+ */
+
+#endif /* _NUMA_H_ */
@@ -17,32 +17,41 @@ if [ $# -le 7 ]
 then
     echo "Usage:" 2>&1
     echo "plot.sh -i \\" 2>&1
+    echo "        -d (données déjà calculées par bench_Cache) \\" 2>&1
     echo "        -o nom_base_fichier_sortie \\" 2>&1
     echo "        -T titre \\" 2>&1
     echo "        -x étiquette_axe_x \\" 2>&1
     echo "        -t numéro_test \\" 2>&1
     echo "        -L "x,y" (position du titre)\\" 2>&1
+    echo "        -s stratégie,... (défaut : NUR,LRU,FIFO,RAND) \\" 2>&1
+    echo "        -O \"options fixes de la simulation\" \\" 2>&1
     echo "        -- option_test valeur..." 2>&1  
     exit 1
 fi
 
 Interactive=""
+Precomputed=""
 Title=
 OutputFile=out_$$
 XTitle=
 LabelPos="20,70"
 SimulOpt=
 TestNum=5
+Strategies=NUR,LRU,FIFO,RAND
+FixedOpt=
 
 for arg in $*
 do
     case $1 in
     -i) Interactive="-"; shift;;
+    -d) Precomputed=1; shift;;
     -T) Title="$2"; shift 2;;
     -o) Out="$2"; shift 2;;
     -x) XTitle="$2"; shift 2;;
     -t) TestNum="$2"; shift 2;;
     -L) LabelPos="$2"; shift 2;; 
+    -s) Strategies="$2"; shift 2;;
+    -O) FixedOpt="$2"; shift 2;;
     --) shift; break;;
     esac
 done
@@ -55,19 +64,31 @@ echo Numéro de test : $TestNum
 echo Position du titre : $LabelPos
 echo Option de simulation : $SimulOpt
 echo Valeurs : $*
+echo Stratégies : $Strategies
 
-rm -f $Out.gp $Out 
-
-for n in $*
+# Une courbe par stratégie : colonne 2 pour la première, etc.
+Plot=
+Col=2
+for s in `echo $Strategies | tr , ' '`
 do
-    echo -n $n
-    for strategy in NUR LRU FIFO RAND
-    do 
-        ../tst_Cache_$strategy -t $TestNum $SimulOpt $n -S | \
+    Plot="$Plot${Plot:+, }\"$Out\" using 1:$Col t \"$s\""
+    Col=`expr $Col + 1`
+done
+
+rm -f $Out.gp
+
+if [ -z "$Precomputed" ] || [ ! -f $Out ]
+then
+    rm -f $Out
+    for n in $*
+    do
+        # Un seul passage : le même flux d'accès pour toutes les stratégies
+        echo -n $n
+        ../tst_Cache_MULTI -M $Strategies -t $TestNum $FixedOpt $SimulOpt $n -S | \
             awk '$1 ~ /hits/ {printf " %.2f ", $2}' 
-    done
-    echo
-done > $Out
+        echo
+    done > $Out
+fi
 
 ed - << EOF
 a
@@ -78,7 +99,7 @@ set label "$Title (test $TestNum)" font "Helvetica-Bold,18" at $LabelPos
 set encoding utf8
 set terminal postscript eps color
 set output "$Out.eps"
-plot "$Out" using 1:2 t "NUR", "$Out" using 1:3 t "LRU", "$Out" using 1:4 t "FIFO", "$Out" using 1:5 t "RAND"
+plot $Plot
 .
 w $Out.gp
 q
@@ -89,7 +110,7 @@ then
     ed - $Out.gp << EOF
 a
 set terminal x11
-plot "$Out" using 1:2 t "NUR", "$Out" using 1:3 t "LRU", "$Out" using 1:4 t "FIFO", "$Out" using 1:5 t "RAND"
+plot $Plot
 .
 w
 q
@@ -1,7 +1,7 @@
 #ifndef _RANDOM_H_
 #define _RANDOM_H_
 /*!
- * \file low_cache.h
+ * \file random.h
  *
  * \brief Tirage au hasard dans un intervalle
  * 
@@ -14,10 +14,19 @@
 #include <time.h>
 #include <assert.h>
 
-/*! RANDOM(m, n) tire un nombre au hasard dans l'intervalle [m,n[. */
-static inline unsigned int RANDOM(int m, int n)
+#include "rng.h"
+
+/*! RANDOM(m, n) tire un nombre au hasard dans l'intervalle [m,n[ (m si l'intervalle est vide).
+ *
+ * Le tirage utilise le générateur du thread courant (voir rng.h) : il est
+ * sans biais, reproductible (Rng_Set_Seed()) et sans état partagé entre
+ * threads. Les bornes sont sur 64 bits : m et n peuvent être des indices
+ * d'enregistrement d'un fichier de plus de 2^31 enregistrements.
+ */
+static inline int64_t RANDOM(int64_t m, int64_t n)
 {
-    return m + rand() % (n - m);
+    if (n <= m) return m;
+    return m + (int64_t)Rng_Below(Rng_Default(), (uint64_t)(n - m));
 }
 
 #endif /* _RANDOM_H_ */ 
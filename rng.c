@@ -0,0 +1,46 @@
+/*!
+ * \file rng.c
+ *
+ * \brief Générateurs par défaut, un par thread, dérivés d'un germe global.
+ */
+
+#include "rng.h"
+
+/* Germe global ; chaque changement invalide les générateurs déjà initialisés */
+static uint64_t Global_Seed = 1;
+static unsigned Seed_Generation = 1;
+
+/* Nombre de threads ayant déjà demandé leur générateur */
+static unsigned Thread_Count = 0;
+
+static __thread struct Rng Thread_Rng;
+static __thread unsigned Thread_Generation = 0;  /* 0 : jamais initialisé */
+static __thread unsigned Thread_Index;
+
+/*!
+ * Les générateurs par défaut sont réinitialisés à leur prochain usage. Le
+ * premier thread à tirer un nombre (en pratique le thread principal) utilise
+ * exactement ce germe : une même valeur redonne le même flux.
+ */
+void Rng_Set_Seed(uint64_t seed)
+{
+    Global_Seed = seed;
+    Seed_Generation++;
+}
+
+uint64_t Rng_Get_Seed()
+{
+    return Global_Seed;
+}
+
+struct Rng *Rng_Default()
+{
+    if (Thread_Generation != Seed_Generation)
+    {
+        if (Thread_Generation == 0)
+            Thread_Index = __sync_fetch_and_add(&Thread_Count, 1);
+        Rng_Seed(&Thread_Rng, Global_Seed + Thread_Index * 0x9E3779B97F4A7C15ULL);
+        Thread_Generation = Seed_Generation;
+    }
+    return &Thread_Rng;
+}
@@ -0,0 +1,111 @@
+#ifndef _RNG_H_
+#define _RNG_H_
+/*!
+ * \file rng.h
+ *
+ * \brief Générateur pseudo-aléatoire rapide à état explicite (xoshiro256**).
+ *
+ * Contrairement à rand(), l'état du générateur est une structure fournie par
+ * l'appelant : chaque thread, chaque cache ou chaque flux d'accès peut avoir
+ * le sien, initialisé par un germe reproductible. Les tirages dans un
+ * intervalle sont sans biais (méthode de Lemire).
+ */
+
+#include <stdint.h>
+
+/*! État d'un générateur */
+struct Rng
+{
+    uint64_t s[4];
+};
+
+/*! Étape de splitmix64, utilisée pour étaler un germe sur les 256 bits d'état */
+static inline uint64_t Rng_Splitmix64(uint64_t *px)
+{
+    uint64_t z = (*px += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*! Initialisation de \a prng à partir du germe \a seed */
+static inline void Rng_Seed(struct Rng *prng, uint64_t seed)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) prng->s[i] = Rng_Splitmix64(&seed);
+}
+
+static inline uint64_t Rng_Rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/*! Tirage de 64 bits */
+static inline uint64_t Rng_Next(struct Rng *prng)
+{
+    uint64_t *s = prng->s;
+    uint64_t result = Rng_Rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = Rng_Rotl(s[3], 45);
+
+    return result;
+}
+
+/*! Tirage sans biais dans [0, n[ (0 si n vaut 0) */
+static inline uint64_t Rng_Below(struct Rng *prng, uint64_t n)
+{
+    uint32_t x, range = (uint32_t)n;
+    uint64_t m;
+    uint32_t l;
+
+    if (n > UINT32_MAX)
+    {
+        /* Cas rare : rejet simple sur 64 bits */
+        uint64_t lim = UINT64_MAX - UINT64_MAX % n, r;
+
+        do r = Rng_Next(prng); while (r >= lim);
+        return r % n;
+    }
+    if (range == 0) return 0;
+
+    x = (uint32_t)(Rng_Next(prng) >> 32);
+    m = (uint64_t)x * range;
+    l = (uint32_t)m;
+    if (l < range)
+    {
+        uint32_t t = -range % range;
+
+        while (l < t)
+        {
+            x = (uint32_t)(Rng_Next(prng) >> 32);
+            m = (uint64_t)x * range;
+            l = (uint32_t)m;
+        }
+    }
+    return m >> 32;
+}
+
+/*! Tirage uniforme dans [0, 1[ */
+static inline double Rng_Double(struct Rng *prng)
+{
+    return (Rng_Next(prng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*! Germe global des générateurs par défaut (voir Rng_Default()) */
+void Rng_Set_Seed(uint64_t seed);
+
+/*! Germe global courant */
+uint64_t Rng_Get_Seed();
+
+/*! Générateur par défaut du thread courant */
+struct Rng *Rng_Default();
+
+#endif /* _RNG_H_ */
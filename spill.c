@@ -0,0 +1,249 @@
+/*!
+ * \file spill.c
+ *
+ * \brief Second niveau du cache dans un fichier local (voir spill.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "spill.h"
+
+//! Alignement des écritures dans le fichier
+#define SPILL_ALIGN 4096
+
+//! Taille visée d'un segment (une écriture)
+#define SPILL_SEGMENT (1 << 20)
+
+struct Spill
+{
+    int fd;                 /* fichier d'échange (-1 sans données) */
+    size_t blocksz;         /* taille d'un bloc (et d'une case) */
+    unsigned nslots;        /* nombre de cases (multiple de segslots) */
+    unsigned segslots;      /* nombre de cases d'un segment */
+    int *ifile;             /* fichier du bloc de chaque case */
+    Cache_Index *ibfile;    /* bloc de chaque case (-1 : case vide) */
+    int *hash;              /* index : première case de chaque classe */
+    int *hnext;             /* index : case suivante de la même classe */
+    unsigned hmask;         /* index : nombre de classes - 1 */
+    unsigned seg;           /* première case du segment en cours de remplissage */
+    unsigned head;          /* prochaine case du segment à remplir */
+    char *buf;              /* contenu du segment en cours de remplissage */
+};
+
+#define HASH(psp, ifile, ibfile) \
+    ((((unsigned)(ibfile) ^ (unsigned)((uint64_t)(ibfile) >> 32)) + (unsigned)(ifile) * 0x9E3779B9u) \
+     * 2654435761u & (psp)->hmask)
+
+/* Case contenant le bloc (ifile, ibfile) (-1 s'il est absent) */
+static int Spill_Find(struct Spill *psp, int ifile, Cache_Index ibfile)
+{
+    int slot;
+
+    for (slot = psp->hash[HASH(psp, ifile, ibfile)]; slot >= 0; slot = psp->hnext[slot])
+        if (psp->ibfile[slot] == ibfile && psp->ifile[slot] == ifile) return slot;
+    return -1;
+}
+
+/* Retrait du bloc de la case slot : la case devient vide */
+static void Spill_Remove(struct Spill *psp, int slot)
+{
+    int *link = &psp->hash[HASH(psp, psp->ifile[slot], psp->ibfile[slot])];
+
+    while (*link != slot) link = &psp->hnext[*link];
+    *link = psp->hnext[slot];
+    psp->ibfile[slot] = -1;
+}
+
+/* Écriture du segment en cours et passage au suivant */
+static Cache_Error Spill_Flush(struct Spill *psp)
+{
+    Cache_Error err = CACHE_OK;
+    size_t sz = (size_t)psp->segslots * psp->blocksz;
+    unsigned slot;
+
+    if (psp->fd >= 0 && pwrite(psp->fd, psp->buf, sz, (off_t)psp->seg * psp->blocksz) != (ssize_t)sz)
+    {
+        // Les blocs du segment ne sont pas sur disque : on les oublie
+        for (slot = psp->seg; slot < psp->seg + psp->segslots; slot++)
+            if (psp->ibfile[slot] >= 0) Spill_Remove(psp, slot);
+        err = CACHE_KO;
+    }
+
+    psp->seg = (psp->seg + psp->segslots) % psp->nslots;
+    psp->head = psp->seg;
+    return err;
+}
+
+/*!
+ * \ingroup spill_interface
+ *
+ * Les cases ont la taille d'un bloc ; un segment en compte assez pour que sa
+ * taille soit un multiple de SPILL_ALIGN, aussi proche que possible de
+ * SPILL_SEGMENT. Les segments sont donc écrits à des adresses alignées.
+ *
+ * \param file nom du fichier d'échange (ignoré si \a payload est faux)
+ * \param nblocks nombre de blocs du second niveau (arrondi à un nombre entier de segments)
+ * \param blocksz taille d'un bloc
+ * \param payload faux si les données ne sont pas conservées
+ * \return le second niveau ou NULL en cas d'erreur
+ */
+struct Spill *Spill_Open(const char *file, unsigned nblocks, size_t blocksz, int payload)
+{
+    struct Spill *psp = calloc(1, sizeof(struct Spill));
+    size_t unit = 1;
+
+    // Plus petit nombre de cases dont la taille totale est alignée
+    while ((unit * blocksz) % SPILL_ALIGN != 0) unit++;
+    psp->segslots = unit * (SPILL_SEGMENT / (unit * blocksz) > 0 ? SPILL_SEGMENT / (unit * blocksz) : 1);
+    // Au moins quatre segments, pour ne pas chasser tout le niveau d'un coup
+    if (psp->segslots > nblocks / 4)
+        psp->segslots = unit <= nblocks / 4 ? nblocks / 4 / unit * unit : nblocks;
+    psp->nslots = (nblocks + psp->segslots - 1) / psp->segslots * psp->segslots;
+    psp->blocksz = blocksz;
+    psp->fd = -1;
+
+    if (payload)
+    {
+        if ((psp->fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0
+            || posix_memalign((void **)&psp->buf, SPILL_ALIGN, psp->segslots * blocksz) != 0)
+        {
+            if (psp->fd >= 0) close(psp->fd);
+            free(psp);
+            return NULL;
+        }
+    }
+
+    for (psp->hmask = 1; psp->hmask < psp->nslots; psp->hmask <<= 1) {}
+    psp->ifile = malloc(psp->nslots * sizeof(int));
+    psp->ibfile = malloc(psp->nslots * sizeof(Cache_Index));
+    psp->hash = malloc(psp->hmask * sizeof(int));
+    psp->hnext = malloc(psp->nslots * sizeof(int));
+    psp->hmask--;
+    Spill_Clear(psp);
+
+    return psp;
+}
+
+/*!
+ * \ingroup spill_interface
+ */
+void Spill_Close(struct Spill *psp)
+{
+    if (psp->fd >= 0) close(psp->fd);
+    free(psp->buf);
+    free(psp->ifile);
+    free(psp->ibfile);
+    free(psp->hash);
+    free(psp->hnext);
+    free(psp);
+}
+
+/*!
+ * \ingroup spill_interface
+ */
+void Spill_Clear(struct Spill *psp)
+{
+    memset(psp->ibfile, -1, psp->nslots * sizeof(Cache_Index));
+    memset(psp->hash, -1, (psp->hmask + 1) * sizeof(int));
+    psp->seg = psp->head = 0;
+}
+
+/*!
+ * \ingroup spill_interface
+ *
+ * Les cases libérées restent dans la file : elles seront simplement
+ * réutilisées à leur tour.
+ */
+void Spill_Forget_File(struct Spill *psp, int ifile)
+{
+    unsigned slot;
+
+    for (slot = 0; slot < psp->nslots; slot++)
+        if (psp->ibfile[slot] >= 0 && psp->ifile[slot] == ifile) Spill_Remove(psp, slot);
+}
+
+/*!
+ * \ingroup spill_interface
+ */
+void Spill_Forget(struct Spill *psp, int ifile, Cache_Index ibfile)
+{
+    int slot = Spill_Find(psp, ifile, ibfile);
+
+    if (slot >= 0) Spill_Remove(psp, slot);
+}
+
+/*!
+ * \ingroup spill_interface
+ *
+ * Une petite plage est parcourue par l'index, une grande par les cases.
+ */
+void Spill_Forget_Range(struct Spill *psp, int ifile, Cache_Index firstb, Cache_Index lastb)
+{
+    Cache_Index b;
+    unsigned slot;
+
+    if (lastb - firstb < (Cache_Index)psp->nslots) {
+        for (b = firstb; b <= lastb; b++) Spill_Forget(psp, ifile, b);
+        return;
+    }
+    for (slot = 0; slot < psp->nslots; slot++)
+        if (psp->ibfile[slot] >= firstb && psp->ibfile[slot] <= lastb && psp->ifile[slot] == ifile)
+            Spill_Remove(psp, slot);
+}
+
+/*!
+ * \ingroup spill_interface
+ *
+ * Le bloc prend la prochaine case du segment en cours, en chassant
+ * l'éventuel bloc (le plus ancien) qui l'occupait. Le segment est écrit
+ * quand il est plein.
+ */
+Cache_Error Spill_Demote(struct Spill *psp, int ifile, Cache_Index ibfile, const void *data)
+{
+    unsigned slot = psp->head;
+    int old;
+
+    if ((old = Spill_Find(psp, ifile, ibfile)) >= 0) Spill_Remove(psp, old);
+    if (psp->ibfile[slot] >= 0) Spill_Remove(psp, slot);
+
+    if (psp->buf != NULL)
+        memcpy(psp->buf + (size_t)(slot - psp->seg) * psp->blocksz, data, psp->blocksz);
+    psp->ifile[slot] = ifile;
+    psp->ibfile[slot] = ibfile;
+    psp->hnext[slot] = psp->hash[HASH(psp, ifile, ibfile)];
+    psp->hash[HASH(psp, ifile, ibfile)] = slot;
+
+    if (++psp->head == psp->seg + psp->segslots)
+        return Spill_Flush(psp);
+    return CACHE_OK;
+}
+
+/*!
+ * \ingroup spill_interface
+ *
+ * Les blocs du segment en cours de remplissage sont copiés depuis son tampon ;
+ * les autres sont relus dans le fichier.
+ */
+int Spill_Promote(struct Spill *psp, int ifile, Cache_Index ibfile, void *data)
+{
+    int slot = Spill_Find(psp, ifile, ibfile);
+
+    if (slot < 0) return 0;
+
+    if (psp->fd >= 0)
+    {
+        if (slot >= psp->seg && slot < psp->head)
+            memcpy(data, psp->buf + (size_t)(slot - psp->seg) * psp->blocksz, psp->blocksz);
+        else if (pread(psp->fd, data, psp->blocksz, (off_t)slot * psp->blocksz) != (ssize_t)psp->blocksz)
+        {
+            Spill_Remove(psp, slot);
+            return 0;
+        }
+    }
+
+    Spill_Remove(psp, slot);
+    return 1;
+}
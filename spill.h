@@ -0,0 +1,67 @@
+#ifndef _SPILL_H_
+#define _SPILL_H_
+
+/*!
+ * \file spill.h
+ *
+ * \brief Second niveau du cache : un fichier local (SSD) de taille fixe.
+ *
+ * Les blocs remplacés dans le cache en mémoire, une fois propres, y sont
+ * rétrogradés plutôt que simplement oubliés ; un bloc absent de la mémoire
+ * mais présent dans ce second niveau y est relu (promu) sans accéder au
+ * fichier d'origine, souvent plus lent.
+ *
+ * Le second niveau a son propre index ((fichier, indice-fichier) -> case) et
+ * sa propre stratégie de remplacement : une file circulaire de cases, découpée en
+ * segments. Les blocs rétrogradés remplissent le segment courant dans un
+ * tampon en mémoire, qui est écrit d'un seul coup, à une adresse alignée,
+ * quand il est plein ; le segment suivant remplace alors les plus anciens
+ * blocs du second niveau (FIFO). Un bloc promu quitte le second niveau : il
+ * n'y a jamais deux copies d'un même bloc.
+ *
+ * Le contenu ne survit pas à la fermeture : le fichier n'est qu'une zone
+ * d'échange. Sans données (stockage nul), seules les méta-données sont
+ * gérées et aucun fichier n'est ouvert.
+ */
+
+#include "cache.h"
+
+/*!
+ * \defgroup spill_interface Interface du second niveau du cache
+ *
+ * \ingroup low_cache_interface
+ *
+ * @{
+ */
+
+struct Spill;
+
+//! Ouverture d'un second niveau de \a nblocks blocs de \a blocksz octets.
+struct Spill *Spill_Open(const char *file, unsigned nblocks, size_t blocksz, int payload);
+
+//! Fermeture (le fichier est conservé, son contenu n'a plus de sens).
+void Spill_Close(struct Spill *psp);
+
+//! Oubli de tous les blocs.
+void Spill_Clear(struct Spill *psp);
+
+//! Oubli des blocs du fichier \a ifile (fermé).
+void Spill_Forget_File(struct Spill *psp, int ifile);
+
+//! Oubli du bloc \a ibfile du fichier \a ifile (s'il est présent).
+void Spill_Forget(struct Spill *psp, int ifile, Cache_Index ibfile);
+
+//! Oubli des blocs \a firstb à \a lastb du fichier \a ifile présents.
+void Spill_Forget_Range(struct Spill *psp, int ifile, Cache_Index firstb, Cache_Index lastb);
+
+//! Rétrogradation du bloc propre \a ibfile du fichier \a ifile, de données \a data.
+Cache_Error Spill_Demote(struct Spill *psp, int ifile, Cache_Index ibfile, const void *data);
+
+//! Promotion : si le bloc est présent, copie dans \a data, retrait et retour vrai.
+int Spill_Promote(struct Spill *psp, int ifile, Cache_Index ibfile, void *data);
+
+/*
+ * @}
+ */
+
+#endif /* _SPILL_H_ */
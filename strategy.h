@@ -13,6 +13,28 @@
 
 struct Cache;
 struct Cache_Block_Header;
+struct Cache_Policy_Instrument;
+
+/*
+ * Quand STRATEGY_PREFIX est défini (par exemple -DSTRATEGY_PREFIX=LRU), les
+ * fonctions ci-dessous sont renommées LRU_Strategy_Create, etc. C'est ainsi
+ * que plusieurs stratégies sont compilées dans un même exécutable (voir
+ * MULTI_strategy.c) sans modifier leurs sources.
+ */
+#ifdef STRATEGY_PREFIX
+#define STRATEGY_CAT_(p, f) p ## _ ## f
+#define STRATEGY_CAT(p, f) STRATEGY_CAT_(p, f)
+#define Strategy_Create STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Create)
+#define Strategy_Close STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Close)
+#define Strategy_Invalidate STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Invalidate)
+#define Strategy_Replace_Block STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Replace_Block)
+#define Strategy_Read STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Read)
+#define Strategy_Write STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Write)
+#define Strategy_Order STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Order)
+#define Strategy_Get_Flags STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Get_Flags)
+#define Strategy_Set_Flags STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Set_Flags)
+#define Strategy_Name STRATEGY_CAT(STRATEGY_PREFIX, Strategy_Name)
+#endif
 
 /*!
  * \defgroup strategy_interface Interface de la stratégie de remplacement
@@ -42,9 +64,44 @@ void Strategy_Read(struct Cache *pcache, struct Cache_Block_Header *pb);
 //! Fonction "réflexe" lors de l'écriture.
 void Strategy_Write(struct Cache *pcache, struct Cache_Block_Header *pb);
 
+//! Blocs gérés par la stratégie, du prochain remplacé au dernier.
+int Strategy_Order(struct Cache *pcache, struct Cache_Block_Header **order);
+
+//! Flags propres à la stratégie du bloc pb, gardés hors de son entête (sauvés dans les instantanés).
+/*!
+ * Facultatif, comme Strategy_Set_Flags() : seule une stratégie qui garde de
+ * tels flags le définit. Le symbole est faible : son adresse est NULL dans
+ * un exécutable dont la stratégie ne le définit pas.
+ */
+unsigned Strategy_Get_Flags(struct Cache *pcache, struct Cache_Block_Header *pb) __attribute__((weak));
+
+//! Rétablissement des flags propres à la stratégie du bloc pb (rechargement d'un instantané).
+void Strategy_Set_Flags(struct Cache *pcache, struct Cache_Block_Header *pb, unsigned flags) __attribute__((weak));
+
 //! Identification de la stratégie.
 char *Strategy_Name();
 
+//! Table des fonctions d'une stratégie (choix de la stratégie à l'exécution).
+struct Strategy_Ops
+{
+    const char *name;
+    void *(*create)(struct Cache *pcache);
+    void (*close)(struct Cache *pcache);
+    void (*invalidate)(struct Cache *pcache);
+    struct Cache_Block_Header *(*replace_block)(struct Cache *pcache);
+    void (*read)(struct Cache *pcache, struct Cache_Block_Header *pb);
+    void (*write)(struct Cache *pcache, struct Cache_Block_Header *pb);
+    int (*order)(struct Cache *pcache, struct Cache_Block_Header **order);
+    //! Flags propres à la stratégie (NULL si elle n'en a pas)
+    unsigned (*get_flags)(struct Cache *pcache, struct Cache_Block_Header *pb);
+    void (*set_flags)(struct Cache *pcache, struct Cache_Block_Header *pb, unsigned flags);
+    //! Instrumentation des candidates d'une méta-stratégie (NULL pour les autres)
+    int (*instrument)(struct Cache *pcache, struct Cache_Policy_Instrument *ppi, int maxpolicies);
+};
+
+//! Recherche d'une stratégie par son nom (MULTI_strategy.c seulement).
+const struct Strategy_Ops *Strategy_Find(const char *name);
+
 /* 
  * @} 
  */
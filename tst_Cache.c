@@ -8,10 +8,17 @@
 
 
 #include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include "cache.h"
 #include "strategy.h"
 #include "random.h"
+#include "workload.h"
+#include "numa.h"
 #include "stdbool.h"
 
 /* ------------------------------------------------------------------------------------
@@ -29,6 +36,7 @@
 #define N_WORKING_SETS 100  /* Nombre de "working sets" */
 #define N_LOCAL_WINDOW 300  /* Largeur de la "fenêtre de localité" */
 #define N_DEREF 100     /* Période de déréférençage (stratégie NUR) */
+#define N_DURABLE_WRITES 2000 /* Nombre d'écritures synchronisées du test 12 */
 
 /* ------------------------------------------------------------------------------------
  * Variables globales 
@@ -46,7 +54,7 @@ char *File = DEF_FILE;
 unsigned int N_Records_per_Block = N_RECORDS_PER_BLOCK;
 
 /* Nombre total d'enregistrements dans le fichier */
-int N_Records_in_File = N_RECORDS_IN_FILE;
+Cache_Index N_Records_in_File = N_RECORDS_IN_FILE;
 
 /* Ratio taille fichier / taille cache */       
 int Ratio_File_Cache = RATIO_FILE_CACHE;
@@ -61,9 +69,11 @@ unsigned int N_Blocks_in_Cache;
  */
 
 /* Nombre total d'accès (lecture ou écriture) pour les tests 2, 3 et 4
- * En fait, le nombre d'accès sera N_Loops * N_Records_in_File
+ * En fait, le nombre d'accès sera N_Loops * N_Records_in_File (le facteur
+ * peut être inférieur à 1 pour un très grand fichier)
  */     
-int N_Loops = N_LOOPS;
+double Loops_per_Record = N_LOOPS;
+Cache_Index N_Loops;
 
 /* Rapport nombre de lectures / nombre d'écritures
  * Pour les tests 3 et 4
@@ -88,6 +98,52 @@ int N_Local_Window = N_LOCAL_WINDOW;
 /* Période de déréférençage pour la stratégie NUR seulement */
 int N_Deref = N_DEREF;
 
+/* Stockage sous-jacent du cache (fichier, mémoire, nul ou projection) */
+const char *Backend_Names[] = {"file", "mem", "null", "mmap"};
+#define NBACKENDS ((int)(sizeof(Backend_Names)/sizeof(Backend_Names[0])))
+Cache_Backend_Kind Backend = CACHE_BACKEND_FILE;
+
+/* Conseiller de taille de bloc (option -A, voir advisor.h) */
+const char *Advisor_Names[] = {"off", "show", "auto"};
+#define NADVISORS ((int)(sizeof(Advisor_Names)/sizeof(Advisor_Names[0])))
+Cache_Advisor_Mode Advisor = CACHE_ADVISOR_OFF;
+
+/* Allocation sur défaut en écriture (option -P) */
+const char *Write_Policy_Names[] = {"allocate", "stream", "around"};
+#define NWRITEPOLICIES ((int)(sizeof(Write_Policy_Names)/sizeof(Write_Policy_Names[0])))
+Cache_Write_Policy Write_Policy = CACHE_WRITE_ALLOCATE;
+
+/* Indications d'accès (Cache_Advise) dans les tests 3 et 7 (option -H) */
+int Use_Hints = 0;
+
+/* Écritures du test 6 par lots de N_Write_Batch enregistrements (option -m, 0 : une à une) */
+int N_Write_Batch = 0;
+
+/* Second niveau du cache (option -T) : nombre de blocs, dans le fichier <File>.spill */
+unsigned N_Spill_Blocks = 0;
+char *Spill_File = NULL;
+
+/* Générateur de flux synthétique pour le test 8 (voir workload.h) */
+const char *Workload_Spec = NULL;
+
+/* Taille du cache (en blocs) à partir du milieu de chaque test (option -Z) */
+unsigned N_Resize_Blocks = 0;
+
+/* Nombre de fichiers du test 9 (cache partagé) */
+int N_Files = 0;
+
+/* Nombre de threads du test 10 (accès concurrents, option -C) */
+int N_Test_Threads = 0;
+
+/* Nombre maximal de lectures en cours du test 11 (lectures sans attente, option -Y) */
+int N_Async_Depth = 0;
+
+/* Nombre de threads du test 12 (écritures durables, option -D) */
+int N_Sync_Threads = 0;
+
+/* Placement NUMA (option -U) : nœuds de la machine (0) ou nombre de nœuds simulés */
+int N_Numa_Nodes = -1;
+
 /* Format de sortie court */
 int Short_Output = 0;
 
@@ -108,6 +164,72 @@ int Record_Size = sizeof(struct Any);
  */
 struct Cache *The_Cache;
 
+/* Mesure des temps d'accès
+ * ------------------------
+ * Chaque accès est chronométré et sa durée (en ns) est rangée dans un
+ * histogramme logarithmique : 2^LAT_SUB_BITS sous-classes par puissance de 2,
+ * ce qui donne les percentiles à ~6 % près sans rien stocker par accès.
+ */
+#define LAT_SUB_BITS 4
+#define LAT_NBUCKETS (64 << LAT_SUB_BITS)
+
+static unsigned long Lat_Hist[LAT_NBUCKETS];   /* histogramme des durées */
+static unsigned long Lat_Count;                /* nombre d'accès mesurés */
+static unsigned long long Lat_Max;             /* durée maximale */
+
+/* Mêmes mesures par nœud NUMA (test 10 seulement : nœud de chaque thread) */
+struct Node_Lat
+{
+    unsigned long hist[LAT_NBUCKETS];
+    unsigned long count;
+    unsigned long long max;
+};
+static struct Node_Lat Node_Lats[NUMA_MAX_NODES];
+static struct timespec Test_Start;             /* début du test courant */
+
+/* Simulation multiple (option -M)
+ * -------------------------------
+ * Le flux d'accès de chaque test n'est plus appliqué à The_Cache : il est
+ * enregistré dans Trace, puis rejoué sur plusieurs caches (méta-données
+ * seulement), chacun avec sa stratégie et sa taille. Toutes les stratégies
+ * voient donc exactement le même flux. Le rejeu est fait en séquence ou par
+ * N_Threads threads, chaque cache n'étant manipulé que par un seul thread.
+ */
+#define MAX_INSTANCES 32
+#define MAX_POLICIES 16             /* candidates d'une méta-stratégie (ADAPT) */
+
+struct Instance
+{
+    const char *strategy;           /* nom de la stratégie */
+    int ratio;                      /* rapport taille fichier / taille cache */
+    struct Cache *pcache;
+    struct Cache_Instrument instr;  /* instrumentation du dernier rejeu */
+    double elapsed;                 /* durée du dernier rejeu (s) */
+};
+
+static struct Instance Instances[MAX_INSTANCES];
+static int N_Instances = 0;         /* 0 : pas de simulation multiple */
+static int N_Threads = 1;
+
+/* Un accès du flux */
+struct Access
+{
+    Cache_Index irfile;
+    int write;
+};
+
+static struct Access *Trace;        /* flux du test courant */
+static unsigned long Trace_Len, Trace_Cap;
+
+/* Enregistrement (option -o) et rejeu (option -i) du flux d'accès */
+static const char *Trace_Out_File = NULL;
+static const char *Trace_In_File = NULL;
+static FILE *Trace_Out;
+
+/* Instantané du cache (option -k) : le premier test part du cache rechargé */
+static const char *Snapshot_File = NULL;
+static int Warm_Start = 0;
+
 /* ------------------------------------------------------------------------------------
  * Prototypes de fonctions définies plus tard 
  * ------------------------------------------------------------------------------------
@@ -121,6 +243,22 @@ static void Usage(const char *execname);
 static void Print_Parameters();
 static void Print_Instrument(struct Cache *pcache, const char *msg);
 
+/* Accès chronométrés au cache */
+static Cache_Error Timed_Read(struct Cache *pcache, Cache_Index irfile, void *precord);
+static Cache_Error Timed_Write(struct Cache *pcache, Cache_Index irfile, const void *precord);
+static Cache_Error Timed_Write_Many(struct Cache *pcache, Cache_Index first, int count, const void *precords);
+static void Hint(struct Cache *pcache, Cache_Index first, Cache_Index count, Cache_Hint hint);
+
+/* Début d'un test : invalidation du cache */
+static Cache_Error Test_Invalidate(struct Cache *pcache);
+
+/* Simulation multiple et rejeu */
+static void Trace_Append(Cache_Index irfile, int write);
+static void Create_Instances();
+static void Close_Instances();
+static void Run_Instances(const char *msg);
+static void Replay_Trace_File(const char *file);
+
 /* Décodage des paramètres */
 static void Scan_Args(int argc, char *argv[]);
 
@@ -133,6 +271,18 @@ static void Test_5();
 
 static void Test_6();
 static void Test_7();
+static void Test_8();
+static void Test_9();
+static void Test_10();
+static void Test_11();
+static void Test_12();
+static void Test_13();
+static void Test_14();
+static void Test_15();
+static void Test_16();
+static void Test_17();
+static void Test_18();
+static void Test_19();
 
 static void (*Tests[])() = {
     Test_1,
@@ -142,6 +292,18 @@ static void (*Tests[])() = {
     Test_5,
     Test_6,
     Test_7,
+    Test_8,
+    Test_9,
+    Test_10,
+    Test_11,
+    Test_12,
+    Test_13,
+    Test_14,
+    Test_15,
+    Test_16,
+    Test_17,
+    Test_18,
+    Test_19,
 };
 #define NTESTS ((int)(sizeof(Tests)/sizeof(Tests[0])))
 
@@ -160,24 +322,48 @@ static int Do_Test[NTESTS] = {false, false, false, false, false};
 int main(int argc, char *argv[])
 {
     int i;
+    struct Cache_Options opts = {0};
 
     /* Décodage des arguments de la ligne de commande */
     Scan_Args(argc, argv);
 
-    /* Initialisation du cache */
-    if ((The_Cache = Cache_Create(File, N_Blocks_in_Cache, N_Records_per_Block,
-                                  Record_Size, N_Deref)) == NULL)
+    /* Initialisation du cache (ou des caches de la simulation multiple) */
+    opts.backend = Backend;
+    opts.snapshot = Snapshot_File;
+    opts.spill = Spill_File;
+    opts.spill_blocks = N_Spill_Blocks;
+    opts.advisor = Advisor;
+    opts.write_policy = Write_Policy;
+    opts.numa = N_Numa_Nodes < 0 ? CACHE_NUMA_OFF : N_Numa_Nodes == 0 ? CACHE_NUMA_ON : CACHE_NUMA_SIMULATED;
+    opts.numa_nodes = N_Numa_Nodes;
+    if (N_Instances > 0)
+        Create_Instances();
+    else if ((The_Cache = Cache_Create_Opt(File, N_Blocks_in_Cache, N_Records_per_Block,
+                                           Record_Size, N_Deref, &opts)) == NULL)
     Error("Cache_Init");
     Print_Parameters();
 
-    /* Exécution des tests */
-    for (i = 0; i < NTESTS; ++i)
+    if (Trace_Out_File != NULL && (Trace_Out = fopen(Trace_Out_File, "w")) == NULL)
+        Error(Trace_Out_File);
+
+    /* Exécution des tests, ou rejeu d'un flux enregistré */
+    if (Trace_In_File != NULL)
+        Replay_Trace_File(Trace_In_File);
+    else for (i = 0; i < NTESTS; ++i)
     {
-        if (Do_Test[i]) Tests[i]();
+        if (Do_Test[i])
+        {
+            clock_gettime(CLOCK_MONOTONIC, &Test_Start);
+            Tests[i]();
+        }
     }
 
+    if (Trace_Out != NULL) fclose(Trace_Out);
+
     /* Fermeture du cache */
-    if (!Cache_Close(The_Cache)) Error("Cache_Close");
+    if (N_Instances > 0)
+        Close_Instances();
+    else if (!Cache_Close(The_Cache)) Error("Cache_Close");
 
     return 0;
 }
@@ -202,18 +388,18 @@ int main(int argc, char *argv[])
 */
 static void Test_1()
 {
-    int ind;    /* indice-fichier de l'enregistrement à écrire */ 
+    Cache_Index ind;    /* indice-fichier de l'enregistrement à écrire */ 
     struct Any temp = {0, 0.0};
 
-    if (!Cache_Invalidate(The_Cache)) Error("Test_1 : Cache_Invalidate");
+    if (!Test_Invalidate(The_Cache)) Error("Test_1 : Cache_Invalidate");
 
-    if (!Cache_Write(The_Cache, 0, &temp)) Error("Test_1 : Cache_Write(0)");
+    if (!Timed_Write(The_Cache, 0, &temp)) Error("Test_1 : Cache_Write(0)");
     for (ind = 1; ind < N_Records_in_File; ind++)
     {
         temp.i = ind;
         temp.x = (double)ind;
-    if (!Cache_Write(The_Cache, ind, &temp)) Error("Test_1 : Cache_Write");
-    if (!Cache_Read(The_Cache, ind - 1, &temp)) Error("Test_1 : Cache_Read");
+    if (!Timed_Write(The_Cache, ind, &temp)) Error("Test_1 : Cache_Write");
+    if (!Timed_Read(The_Cache, ind - 1, &temp)) Error("Test_1 : Cache_Read");
     }
 
     Print_Instrument(The_Cache, "Test_1 : boucle de lecture séquentielle");
@@ -227,20 +413,20 @@ static void Test_1()
 */
 void Test_2()
 {
-    int ind;    /* indice-fichier de l'enregistrement à écrire */
+    Cache_Index ind;    /* indice-fichier de l'enregistrement à écrire */
 
     /* Invalidation du cache */
-    if (!Cache_Invalidate(The_Cache)) Error("Test_2 : Cache_Invalidate");
+    if (!Test_Invalidate(The_Cache)) Error("Test_2 : Cache_Invalidate");
 
     /* Accès (purement) aléatoire aux éléments en écriture */
     for (ind = 0; ind < N_Loops; ind++)
     {
-    int ind = RANDOM(0, N_Records_in_File);
+    Cache_Index ind = RANDOM(0, N_Records_in_File);
         struct Any temp;
 
         temp.i = ind;
         temp.x = (double)ind;
-    if (!Cache_Write(The_Cache, ind, &temp)) Error("Test_2 : Cache_Write");
+    if (!Timed_Write(The_Cache, ind, &temp)) Error("Test_2 : Cache_Write");
     }
 
     Print_Instrument(The_Cache, "Test_2 : boucle écriture aléatoire");
@@ -256,20 +442,26 @@ void Test_2()
 */
 void Test_3()
 {
-    int i;
+    Cache_Index i;
 
     /* Invalidation du cache */
-    if (!Cache_Invalidate(The_Cache)) Error("Test_3 : Cache_Invalidate");
+    if (!Test_Invalidate(The_Cache)) Error("Test_3 : Cache_Invalidate");
+
+    /* Accès aléatoires (option -H) */
+    Hint(The_Cache, 0, N_Records_in_File, CACHE_HINT_RANDOM);
 
     /* Boucle de lecture/écriture aléatoire */
     for (i = 0; i < N_Loops; )
     {
-    int ind = RANDOM(0, N_Records_in_File); /* indice-fichier de l'enregistrement */
+    Cache_Index ind = RANDOM(0, N_Records_in_File); /* indice-fichier de l'enregistrement */
         int nr = RANDOM(1, N_Seq_Access);   /* nombre d'enregistrements consécutifs */
         int j;
 
         if (nr <= 0) nr = 1;
 
+        /* La suite d'accès est annoncée avant d'être faite (option -H) */
+        Hint(The_Cache, ind, nr, CACHE_HINT_WILLNEED);
+
         /* On lit ou écrit nr blocs consécutifs à partir de ind */
         for (j = 0; j < nr; ++j)
         {
@@ -281,12 +473,12 @@ void Test_3()
             temp.x = (double)ind;  
             if (rd)
             {
-                if (!Cache_Read(The_Cache, ind + j, &temp)) 
+                if (!Timed_Read(The_Cache, ind + j, &temp)) 
                     Error("Test_3 : Cache_Read");
             }
             else
             {
-                if (!Cache_Write(The_Cache, ind + j, &temp)) 
+                if (!Timed_Write(The_Cache, ind + j, &temp)) 
                     Error("Test_3 : Cache_Write");
             }
     }
@@ -294,6 +486,7 @@ void Test_3()
         i += nr;
     }
 
+    Hint(The_Cache, 0, N_Records_in_File, CACHE_HINT_NORMAL);
     Print_Instrument(The_Cache, "Test_3 : boucle lecture/écriture aléatoire");
 }
 
@@ -311,19 +504,19 @@ void Test_3()
 */
 void Test_4()
 {
-    int nlocal = N_Loops / N_Working_Sets; /* nombre d'accès locaux pour un working set */
-    int i;
+    Cache_Index nlocal = N_Loops / N_Working_Sets; /* nombre d'accès locaux pour un working set */
+    Cache_Index i;
 
     /* Invalidation du cache */
-    if (!Cache_Invalidate(The_Cache)) Error("Test_4 : Cache_Invalidate");
+    if (!Test_Invalidate(The_Cache)) Error("Test_4 : Cache_Invalidate");
 
     /* Boucle mixte de lecture/écriture aléatoire */
 
     for (i = 0; i < N_Loops; i += nlocal)
     {
-    int ind = RANDOM(0, N_Records_in_File); /* indice-fichier de
-                                                 * l'enregistrement de base */
-        int j;
+    Cache_Index ind = RANDOM(0, N_Records_in_File); /* indice-fichier de
+                                                         * l'enregistrement de base */
+        Cache_Index j;
 
         /* On effectue naccess accès à partir de ind */
         for (j = 0; j < nlocal; ++j)
@@ -331,7 +524,7 @@ void Test_4()
             int incr = RANDOM(0, N_Local_Window);/* on tire au sort
                                                   * l'enregistrement dans la
                                                   * fenêtre locale */           
-            int ind1 = ind + incr;      /* indice de l'enregistrement à accéder */
+            Cache_Index ind1 = ind + incr;  /* indice de l'enregistrement à accéder */
             /* On fait une écriture tous les Ratio_Read_Write accès */
             int rd = (ind1 % Ratio_Read_Write != 0);
             struct Any temp;
@@ -341,12 +534,12 @@ void Test_4()
 
             if (rd)
             {
-                if (!Cache_Read(The_Cache, ind1, &temp)) 
+                if (!Timed_Read(The_Cache, ind1, &temp)) 
                     Error("Test_4 : Cache_Read(ind)");
             }
             else
             {
-                if (!Cache_Write(The_Cache, ind1, &temp)) 
+                if (!Timed_Write(The_Cache, ind1, &temp)) 
                     Error("Test_4 : Cache_Write(ind)");
             }
     }
@@ -369,12 +562,12 @@ void Test_4()
 void Test_5()
 {
     /* nombre d'accès locaux pour un working set */
-    int nlocal = N_Loops / N_Working_Sets; 
-    int i;
-    int k;
+    Cache_Index nlocal = N_Loops / N_Working_Sets; 
+    Cache_Index i;
+    Cache_Index k;
 
     /* Invalidation du cache */
-    if (!Cache_Invalidate(The_Cache)) Error("Test_5 : Cache_Invalidate");
+    if (!Test_Invalidate(The_Cache)) Error("Test_5 : Cache_Invalidate");
 
     /* Boucle mixte de lecture:écriture aléatoire */
 
@@ -383,8 +576,8 @@ void Test_5()
         if (i % N_Working_Sets == 0)
         {
             /* indice-fichier de l'enregistrement de base */
-            int ind = k * N_Records_in_File / N_Working_Sets;
-            int j;
+            Cache_Index ind = k * N_Records_in_File / N_Working_Sets;
+            Cache_Index j;
 
             /* On effectue nlocal accès à partir de ind */
             for (j = 0; j < nlocal; ++j)
@@ -392,7 +585,7 @@ void Test_5()
                 int incr = RANDOM(0, N_Local_Window);/* on tire au sort
                                                       * l'enregistrement dans la
                                                       * fenêtre locale */           
-                int ind1 = ind - incr;      /* indice de l'enregistrement à accéder */
+                Cache_Index ind1 = ind - incr;  /* indice de l'enregistrement à accéder */
                 /* On fait une écriture tous les Ratio_Read_Write accès */
                 int rd = (ind1 % Ratio_Read_Write != 0);
                 struct Any temp;
@@ -405,12 +598,12 @@ void Test_5()
 
                 if (rd)
                 {
-                    if (!Cache_Read(The_Cache, ind1, &temp)) 
+                    if (!Timed_Read(The_Cache, ind1, &temp)) 
                         Error("Test_5 : Cache_Read(ind)");
                 }
                 else
                 {
-                    if (!Cache_Write(The_Cache, ind1, &temp)) 
+                    if (!Timed_Write(The_Cache, ind1, &temp)) 
                         Error("Test_5 : Cache_Write(ind)");
                 }
             }
@@ -428,18 +621,32 @@ void Test_5()
  * l'enregistrement correspondant.
 */
 void Test_6() {
-    int ind;    /* indice-fichier de l'enregistrement à écrire */
+    Cache_Index ind;    /* indice-fichier de l'enregistrement à écrire */
 
     /* Invalidation du cache */
-    if (!Cache_Invalidate(The_Cache)) Error("Test_6 : Cache_Invalidate");
-
-    /* Accès aux éléments en écriture */
-    for (ind = 1; ind < N_Loops; ind++) {
+    if (!Test_Invalidate(The_Cache)) Error("Test_6 : Cache_Invalidate");
+
+    /* Accès aux éléments en écriture, un par un ou par lots (option -m) */
+    if (N_Write_Batch > 0) {
+        struct Any *batch = calloc(N_Write_Batch, sizeof(struct Any));
+        int k, n;
+
+        for (ind = 1; ind < N_Loops; ind += n) {
+            n = N_Loops - ind < N_Write_Batch ? (int)(N_Loops - ind) : N_Write_Batch;
+            for (k = 0; k < n; k++) {
+                batch[k].i = ind + k;
+                batch[k].x = (double)(ind + k);
+            }
+            if (!Timed_Write_Many(The_Cache, ind, n, batch)) Error("Test_6 : Cache_Write_Many");
+        }
+        free(batch);
+    }
+    else for (ind = 1; ind < N_Loops; ind++) {
         struct Any temp;//= {0, 0.0};
 
         temp.i = ind;
         temp.x = (double)ind;
-        if (!Cache_Write(The_Cache, ind, &temp)) Error("Test_6 : Cache_Write");
+        if (!Timed_Write(The_Cache, ind, &temp)) Error("Test_6 : Cache_Write");
     }
 
     Print_Instrument(The_Cache, "Test_6 : boucle écriture séquentielle");
@@ -453,12 +660,15 @@ void Test_6() {
 */
 void Test_7()
 {
-    int i;
-    int ind=N_Records_in_File/100;
+    Cache_Index i;
+    Cache_Index ind=N_Records_in_File/100;
     int nr = N_Seq_Access/100;
 
     /* Invalidation du cache */
-    if (!Cache_Invalidate(The_Cache)) Error("Test_7 : Cache_Invalidate");
+    if (!Test_Invalidate(The_Cache)) Error("Test_7 : Cache_Invalidate");
+
+    /* Parcours séquentiel (option -H) */
+    Hint(The_Cache, 0, N_Records_in_File, CACHE_HINT_SEQUENTIAL);
 
     /* Boucle de lecture/écriture aléatoire */
     for (i = 0; i < N_Loops; )
@@ -478,12 +688,12 @@ void Test_7()
             temp.x = (double)ind;  
             if (rd)
             {
-                if (!Cache_Read(The_Cache, ind + j, &temp)) 
+                if (!Timed_Read(The_Cache, ind + j, &temp)) 
                     Error("Test_7 : Cache_Read");
             }
             else
             {
-                if (!Cache_Write(The_Cache, ind + j, &temp)) 
+                if (!Timed_Write(The_Cache, ind + j, &temp)) 
                     Error("Test_7 : Cache_Write");
             }
     }
@@ -498,207 +708,2087 @@ void Test_7()
         
     }
 
+    Hint(The_Cache, 0, N_Records_in_File, CACHE_HINT_NORMAL);
     Print_Instrument(The_Cache, "Test_7 : boucle lecture/écriture séquentielle");
 }
 
-/* ------------------------------------------------------------------------------------
- * Fonctions locales (privées) à ce module
- * ------------------------------------------------------------------------------------
-*/
+/* Test 8 : flux synthétique
+ * -------------------------
 
-/* Fonction d'affichage d'erreur 
- * -----------------------------
- */
-static void Error(const char *msg)
+ * Les N_Loops indices sont tirés par le générateur décrit par l'option -g
+ * (zipf, hotspot, scan, phases... voir workload.h). Comme dans les tests
+ * précédents on effectue une écriture tous les Ratio_Read_Write accès, une
+ * lecture sinon.
+*/
+void Test_8()
 {
-    fprintf(stderr, "ERROR *** %s\n", msg);
-    exit(1);
+    struct Workload *pw = Workload_Create(Workload_Spec, N_Records_in_File);
+    struct Rng *prng = Rng_Default();
+    char msg[256];
+    Cache_Index i;
+
+    if (pw == NULL) Error("Test_8 : générateur incorrect (option -g)");
+
+    /* Invalidation du cache */
+    if (!Test_Invalidate(The_Cache)) Error("Test_8 : Cache_Invalidate");
+
+    for (i = 0; i < N_Loops; i++)
+    {
+        Cache_Index ind = Workload_Next(pw, prng);
+        struct Any temp;
+
+        temp.i = ind;
+        temp.x = (double)ind;
+        if (i % Ratio_Read_Write != 0)
+        {
+            if (!Timed_Read(The_Cache, ind, &temp)) Error("Test_8 : Cache_Read");
+        }
+        else
+        {
+            if (!Timed_Write(The_Cache, ind, &temp)) Error("Test_8 : Cache_Write");
+        }
+    }
+    Workload_Delete(pw);
+
+    snprintf(msg, sizeof(msg), "Test_8 : flux synthétique %s", Workload_Spec);
+    Print_Instrument(The_Cache, msg);
 }
 
-/* Fonction d'affichage des paramètres généraux du cache
- * -----------------------------------------------------
+/* Test 9 : plusieurs fichiers dans un cache partagé
+ * --------------------------------------------------
+
+ * N_Files fichiers (option -F) <File>.0, <File>.1... qui se partagent les
+ * N_Records_in_File enregistrements. Le fichier k reçoit deux fois moins
+ * d'accès que le fichier k-1 ; dans chaque fichier, les accès suivent le
+ * générateur de l'option -g (uniforme par défaut). Le même flux est joué
+ * sur un cache partagé de N_Blocks_in_Cache blocs, puis sur des caches privés
+ * de N_Blocks_in_Cache / N_Files blocs : la mémoire du premier suit la
+ * demande, celle des seconds est figée.
 */
-static void Print_Parameters()
+static void Test_9_Run(int shared, Cache_Count *phits, unsigned *pblocks)
 {
-    int recordsz = sizeof(struct Any);
-    int blocksz = N_Records_per_Block * recordsz;
-    int cachesz = N_Blocks_in_Cache * blocksz;
-    int filesz = N_Records_in_File * recordsz;
+    struct Cache_Options opts = {0};
+    struct Cache *pools[N_Files];
+    struct Cache_File *files[N_Files];
+    struct Workload *pw[N_Files];
+    Cache_Index nrecords = N_Records_in_File / N_Files;
+    struct Rng rng;
+    char name[FILENAME_MAX];
+    Cache_Index i;
+    int k;
 
-    if (Short_Output)
+    opts.backend = Backend;
+    for (k = 0; k < N_Files; k++)
     {
-        printf("%s\nrecsz %d\nnrec %d\nnblk %d\nnrecblk %d\n", Strategy_Name(),
-               recordsz, N_Records_in_File, N_Blocks_in_Cache, N_Records_per_Block);          
-        printf("file/cache %.2f\nnloop %d\nrw %d\n", 100 * (double)cachesz / filesz,
-               N_Loops, Ratio_Read_Write);
-        printf("nseq %d\nnws %d\nnloc %d\nnderef %d\n", N_Seq_Access, N_Working_Sets,
-               N_Local_Window, N_Deref);
+        if (k == 0 || !shared)
+        {
+            unsigned nblocks = shared ? N_Blocks_in_Cache : N_Blocks_in_Cache / N_Files;
+
+            pools[k] = Cache_Pool_Create(nblocks > 0 ? nblocks : 1, N_Records_per_Block,
+                                         Record_Size, N_Deref, &opts);
+            if (pools[k] == NULL) Error("Test_9 : Cache_Pool_Create");
+        }
+        else pools[k] = pools[0];
+        snprintf(name, sizeof(name), "%s.%d", File, k);
+        if ((files[k] = Cache_File_Open(pools[k], name, 0, 0)) == NULL) Error(name);
+        pw[k] = Workload_Create(Workload_Spec != NULL ? Workload_Spec : "uniform", nrecords);
+        if (pw[k] == NULL) Error("Test_9 : générateur incorrect (option -g)");
     }
-    else
+
+    /* Même flux pour les deux configurations */
+    Rng_Seed(&rng, Rng_Get_Seed());
+    for (i = 0; i < N_Loops; i++)
     {
-        printf("================ Configuration du cache ================\n");
-        printf("Paramètres du fichier :\n");
-        printf("\t%d enregistrements %d octets totaux\n", N_Records_in_File, filesz);
+        uint64_t r = Rng_Next(&rng);
+        struct Any temp;
+        Cache_Index ind;
 
-        printf("Paramètres du cache :\n");
-        printf("\t%d blocs %d enregistrements/bloc %d octets/enregistrement\n", 
-               N_Blocks_in_Cache, N_Records_per_Block, recordsz);
-        printf("\t%d octets/bloc %d octets totaux\n", blocksz, cachesz);
-        printf("\tRapport cache/fichier : %.2f %%\n", 100 * (double)cachesz / filesz);
-        printf("\tStratégie : %s\n", Strategy_Name());
+        for (k = 0; k < N_Files - 1 && (r & 1) == 0; k++) r >>= 1;
+        ind = Workload_Next(pw[k], &rng);
+        temp.i = ind;
+        temp.x = (double)ind;
+        if (i % Ratio_Read_Write != 0)
+        {
+            if (!Cache_File_Read(files[k], ind, &temp)) Error("Test_9 : Cache_File_Read");
+        }
+        else
+        {
+            if (!Cache_File_Write(files[k], ind, &temp)) Error("Test_9 : Cache_File_Write");
+        }
+    }
 
-        printf("Paramètres des tests :\n");
-        printf("\tNombre d'accès : %d\n", N_Loops);
-        printf("\tRapport lectures/écritures : %d\n", Ratio_Read_Write);
-        printf("\tNombre maximum accès séquentiels : %d\n", N_Seq_Access);
-        printf("\tNombre de Working Sets : %d\n", N_Working_Sets);  
-        printf("\tLargeur de la fenêtre de localité : %d\n", N_Local_Window);
-        printf("\tFréquence de déréférençage pour NUR : %d\n", N_Deref);
-        printf("========================================================\n");
+    *phits = 0;
+    for (k = 0; k < N_Files; k++)
+    {
+        pblocks[k] = Cache_File_Blocks(files[k]);
+        if (k == 0 || !shared) *phits += Cache_Get_Instrument(pools[k])->n_hits;
+    }
+    for (k = 0; k < N_Files; k++)
+    {
+        if (!Cache_File_Close(files[k])) Error("Test_9 : Cache_File_Close");
+        Workload_Delete(pw[k]);
     }
+    for (k = 0; k < N_Files; k++)
+        if (k == 0 || !shared) Cache_Close(pools[k]);
 }
 
-/* Recupération des données d'instrumentation
- *  ------------------------------------------
- */
-static void Print_Instrument(struct Cache *pcache, const char *msg)
+void Test_9()
 {
-    struct Cache_Instrument *pinstr = Cache_Get_Instrument(pcache);
+    Cache_Count hits_shared, hits_private;
+    unsigned blocks_shared[N_Files], blocks_private[N_Files];
+    int k;
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_9 : incompatible avec -M et -o");
+
+    Test_9_Run(1, &hits_shared, blocks_shared);
+    Test_9_Run(0, &hits_private, blocks_private);
 
     if (Short_Output)
     {
-        printf("hits %.1f\n", 
-               ((double)pinstr->n_hits)/(pinstr->n_reads + pinstr->n_writes)*100);
+        printf("hits %.1f\n", (double)hits_shared / N_Loops * 100);
+        printf("hits_private %.1f\n", (double)hits_private / N_Loops * 100);
     }
     else
     {
-        printf("\n%s : \n", msg == NULL ? "" : msg);
-        printf("\t%d lectures %d écritures %d succès (%.1f %%)\n",
-               pinstr->n_reads, pinstr->n_writes, pinstr->n_hits, 
-               ((double)pinstr->n_hits)/(pinstr->n_reads + pinstr->n_writes)*100);
-        printf("\t%d syncs %d déréférençages\n", pinstr->n_syncs, pinstr->n_deref);
+        printf("\nTest_9 : %d fichiers dans un cache partagé : \n", N_Files);
+        printf("\tpartagé : %llu succès (%.1f %%) ; privés : %llu succès (%.1f %%)\n",
+               hits_shared, (double)hits_shared / N_Loops * 100,
+               hits_private, (double)hits_private / N_Loops * 100);
+        printf("\tblocs par fichier (partagé / privés) :");
+        for (k = 0; k < N_Files; k++) printf(" %u/%u", blocks_shared[k], blocks_private[k]);
+        printf("\n");
     }
 }
 
-/* Information d'utilisation
- * -------------------------
+/* Test 10 : accès concurrents
+ * ---------------------------
+
+ * N_Test_Threads threads (option -C) font chacun N_Loops / N_Test_Threads
+ * accès du test 4 (working sets avec fenêtre de localité, une écriture tous
+ * les Ratio_Read_Write accès) sur un même cache du fichier <File>.mt. Le flux
+ * est joué une fois avec le verrou seul (CACHE_LOCKED) puis avec les lectures
+ * sans verrou (CACHE_CONCURRENT) : le débit des deux est comparé.
 */
-static void Usage(const char *execname)
-{
-    printf("\nUsage: %s [options]\n", execname);
-    printf("\nOptions générales\n"
-           "-----------------\n"
-           "-h\tce message\n"
-           "-p\taffiche les paramètres du cache sans exécuter de test\n"
-           "-S\tformat de sortie court");
-    printf("\nOptions de configuration du cache\n"
-           "---------------------------------\n"
-           "-f file\tnom du fichier\n"
-           "-N nr\tnombre d'enregistrements dans le fichier\n"
-           "-R nrb\tnombre d'enregistrements par bloc du cache\n" 
-           "-r rfc\trapport taille fichier / taille cache\n");
-    printf("\nOptions de configuration des tests\n"
-           "----------------------------------\n"
-           "-t nt\tactive le test nt ; il peut y avoir plusieurs options -t\n"
-           "\t(nt de 1 à %d)\n", NTESTS);
-    printf("-l nl\tle nombre d'accès dans les tests 2 à 4 sera 'nl * nr'\n"
-           "-w rwr\trapport nombre lectures / nombre écritures (tests 3 et 4)\n"
-           "-s ns\tnombre de blocs à lire séquentiellement (test 3)\n"
-           "-W nws\tnombre de working sets (tests 4 et 5)\n"
-           "-L nl\tlongueur de la fenêtre de localité (test 4 et 5)\n"
-           "-d dr\tpériode de déréférençage pour NUR\n");
-}
-    
-/* Analyse des arguments 
- * ----------------------
- */
-static void Scan_Args(int argc, char *argv[])
+struct Test_10_Thread
 {
-    int i;
-    int ntests = 0;
-    int just_print = 0;
-    int numtest;
+    struct Cache *pcache;
+    struct Rng rng;
+    Cache_Index nloops;
+    int node;                           /* nœud NUMA du thread (à son premier accès) */
+    unsigned long hist[LAT_NBUCKETS];   /* histogramme propre au thread */
+    unsigned long count;
+    unsigned long long max;
+};
 
-    for (i = 1; i < argc; i++)
-    {
-    if (argv[i][0] == '-')
-    {
-        switch (argv[i][1])
-        {
-                /* Options générales */
+static unsigned long long Now_ns();
+static int Lat_Bucket(unsigned long long ns);
+static void Lat_Record(unsigned long long ns);
 
-        case 'h':
-        Usage(argv[0]);
-        exit(1);
-            case 'p':
-                just_print = 1;
-                break;
-            case 'S':
-                Short_Output = 1;
-                break;
+static void *Test_10_Thread(void *arg)
+{
+    struct Test_10_Thread *pt = arg;
+    Cache_Index nlocal = N_Loops / N_Working_Sets > 0 ? N_Loops / N_Working_Sets : 1;
+    Cache_Index i, j;
 
-                /* Options de configuration du cache */
+    pt->node = Cache_Thread_Node(pt->pcache);
+    for (i = 0; i < pt->nloops; i += nlocal)
+    {
+        Cache_Index ind = Rng_Below(&pt->rng, N_Records_in_File);
 
-        case 'f':
-        File = argv[++i];
-        break;      
-        case 'N':
-        N_Records_in_File = atoi(argv[++i]);
-        break;
-        case 'R':
-        N_Records_per_Block = atoi(argv[++i]);
-        break;
-        case 'r':
-        Ratio_File_Cache = atoi(argv[++i]);
-        break;
+        for (j = 0; j < nlocal && i + j < pt->nloops; ++j)
+        {
+            Cache_Index ind1 = ind + Rng_Below(&pt->rng, N_Local_Window);
+            struct Any temp;
+            unsigned long long t0 = Now_ns(), ns;
+            Cache_Error err;
 
-                /* Options de configuration des tests */
+            temp.i = ind1;
+            temp.x = (double)ind1;
+            if (ind1 % Ratio_Read_Write != 0)
+                err = Cache_Read(pt->pcache, ind1, &temp);
+            else
+                err = Cache_Write(pt->pcache, ind1, &temp);
+            if (!err) Error("Test_10 : Cache_Read/Cache_Write");
 
-            case 't':
-        numtest = atoi(argv[++i]);
-                if (numtest >= 1 && numtest <= NTESTS) 
-                {
-                    Do_Test[numtest - 1] = 1;
-                    ++ntests;
-                }
-                else 
-                {
-                    Usage(argv[0]);
-                    exit(1);
-                }
-        break;
-        case 'l':
-        N_Loops = atoi(argv[++i]);
-        break;
-        case 'w':
-        Ratio_Read_Write = atoi(argv[++i]);
-        break;
-            case 's':
-                N_Seq_Access = atoi(argv[++i]);
-        break;          
-            case 'W':
-                N_Working_Sets = atoi(argv[++i]);
-        break;            
-            case 'L':
-                N_Local_Window = atoi(argv[++i]);
-        break;
-            case 'd':
-                N_Deref = atoi(argv[++i]);
-                break;
-        default:
-        fprintf(stderr, "Option inconnue : %s\n", argv[i]);
-        exit(1);
+            ns = Now_ns() - t0;
+            pt->hist[Lat_Bucket(ns)]++;
+            pt->count++;
+            if (ns > pt->max) pt->max = ns;
         }
     }
-    else
+    return NULL;
+}
+
+/* Flux de nthreads threads (fonction body, nloops accès en tout) sur un cache
+ * du fichier <File><ext> : les mesures des threads sont fusionnées */
+static void Threads_Run(const struct Cache_Options *popts, const char *ext, void *(*body)(void *),
+                        int nthreads, Cache_Index nloops, const char *msg)
+{
+    struct Test_10_Thread *threads = calloc(nthreads, sizeof(struct Test_10_Thread));
+    pthread_t tids[nthreads];
+    struct Cache *pcache;
+    char name[FILENAME_MAX];
+    int k, b;
+
+    snprintf(name, sizeof(name), "%s%s", File, ext);
+    if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, N_Records_per_Block,
+                                   Record_Size, N_Deref, popts)) == NULL)
+        Error("Threads_Run : Cache_Create");
+
+    clock_gettime(CLOCK_MONOTONIC, &Test_Start);
+    for (k = 0; k < nthreads; k++)
     {
-        Usage(argv[0]);
-        exit(1);
+        threads[k].pcache = pcache;
+        threads[k].nloops = nloops / nthreads;
+        Rng_Seed(&threads[k].rng, Rng_Get_Seed() + k);
+        if (pthread_create(&tids[k], NULL, body, &threads[k]) != 0)
+            Error("Threads_Run : pthread_create");
     }
+
+    /* Fusion des mesures des threads, au total et par nœud (le nœud d'un
+     * thread n'est connu qu'une fois le thread terminé) */
+    for (k = 0; k < nthreads; k++)
+    {
+        struct Node_Lat *pnl;
+
+        pthread_join(tids[k], NULL);
+        pnl = &Node_Lats[threads[k].node];
+        for (b = 0; b < LAT_NBUCKETS; b++)
+        {
+            Lat_Hist[b] += threads[k].hist[b];
+            pnl->hist[b] += threads[k].hist[b];
+        }
+        Lat_Count += threads[k].count;
+        pnl->count += threads[k].count;
+        if (threads[k].max > Lat_Max) Lat_Max = threads[k].max;
+        if (threads[k].max > pnl->max) pnl->max = threads[k].max;
     }
 
-    N_Loops = N_Loops * N_Records_in_File;
-    N_Blocks_in_Cache = N_Records_in_File / N_Records_per_Block / Ratio_File_Cache;
+    Print_Instrument(pcache, msg);
+    if (!Cache_Close(pcache)) Error("Threads_Run : Cache_Close");
+    free(threads);
+}
+
+static void Test_10_Run(Cache_Concurrency concurrency, const char *msg)
+{
+    struct Cache_Options opts = {0};
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    opts.concurrency = concurrency;
+    opts.numa = N_Numa_Nodes < 0 ? CACHE_NUMA_OFF : N_Numa_Nodes == 0 ? CACHE_NUMA_ON : CACHE_NUMA_SIMULATED;
+    opts.numa_nodes = N_Numa_Nodes;
+    Threads_Run(&opts, ".mt", Test_10_Thread, N_Test_Threads, N_Loops, msg);
+}
+
+void Test_10()
+{
+    char msg[128];
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_10 : incompatible avec -M et -o");
+
+    snprintf(msg, sizeof(msg), "Test_10 : %d threads, verrou du cache", N_Test_Threads);
+    Test_10_Run(CACHE_LOCKED, msg);
+    snprintf(msg, sizeof(msg), "Test_10 : %d threads, lectures sans verrou", N_Test_Threads);
+    Test_10_Run(CACHE_CONCURRENT, msg);
+}
+
+/* Test 11 : lectures sans attente
+ * -------------------------------
+
+ * Un seul thread, comme une boucle d'événements, fait les accès du test 4
+ * sur le fichier <File>.as : les lectures passent par Cache_Read_Async(),
+ * avec au plus N_Async_Depth lectures en cours (option -Y), les écritures
+ * restent synchrones. Le temps mesuré est celui de l'appel : il ne comprend
+ * pas l'attente des défauts. Les défauts simultanés sur un même bloc ne
+ * donnent qu'une lecture du fichier.
+*/
+struct Test_11_Slot
+{
+    struct Any rec;
+    int busy;                   /* lecture en cours dans cette case */
+};
+
+static unsigned long Test_11_Errors;
+
+static void Test_11_Done(void *arg, Cache_Index irfile, void *precord, Cache_Error err)
+{
+    struct Test_11_Slot *ps = arg;
+
+    /* Un enregistrement jamais écrit se lit comme des zéros */
+    if (err != CACHE_OK || (ps->rec.i != 0 && ps->rec.i != (int)irfile))
+        __atomic_add_fetch(&Test_11_Errors, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&ps->busy, 0, __ATOMIC_RELEASE);
+}
+
+void Test_11()
+{
+    struct Cache_Options opts = {0};
+    struct Test_11_Slot *slots = calloc(N_Async_Depth, sizeof(struct Test_11_Slot));
+    Cache_Index nlocal = N_Loops / N_Working_Sets > 0 ? N_Loops / N_Working_Sets : 1;
+    struct Rng *prng = Rng_Default();
+    unsigned long npending = 0;
+    struct Cache *pcache;
+    char name[FILENAME_MAX];
+    Cache_Index i, j;
+    int k;
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_11 : incompatible avec -M et -o");
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    opts.concurrency = CACHE_LOCKED;
+    snprintf(name, sizeof(name), "%s.as", File);
+    if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, N_Records_per_Block,
+                                   Record_Size, N_Deref, &opts)) == NULL)
+        Error("Test_11 : Cache_Create");
+
+    Test_11_Errors = 0;
+    clock_gettime(CLOCK_MONOTONIC, &Test_Start);
+    for (i = k = 0; i < N_Loops; i += nlocal)
+    {
+        Cache_Index ind = Rng_Below(prng, N_Records_in_File);
+
+        for (j = 0; j < nlocal && i + j < N_Loops; ++j)
+        {
+            Cache_Index ind1 = ind + Rng_Below(prng, N_Local_Window);
+            unsigned long long t0;
+            Cache_Error err;
+
+            if (ind1 % Ratio_Read_Write == 0)
+            {
+                struct Any temp;
+
+                temp.i = ind1;
+                temp.x = (double)ind1;
+                if (!Timed_Write(pcache, ind1, &temp)) Error("Test_11 : Cache_Write");
+                continue;
+            }
+
+            /* Case suivante, quand sa lecture précédente est terminée */
+            while (__atomic_load_n(&slots[k].busy, __ATOMIC_ACQUIRE)) sched_yield();
+            slots[k].busy = 1;
+            t0 = Now_ns();
+            err = Cache_Read_Async(pcache, ind1, &slots[k].rec, Test_11_Done, &slots[k]);
+            Lat_Record(Now_ns() - t0);
+            if (err == CACHE_PENDING) npending++;
+            else Test_11_Done(&slots[k], ind1, &slots[k].rec, err);
+            k = (k + 1) % N_Async_Depth;
+        }
+    }
+    for (k = 0; k < N_Async_Depth; k++)
+        while (__atomic_load_n(&slots[k].busy, __ATOMIC_ACQUIRE)) sched_yield();
+    if (Test_11_Errors > 0) Error("Test_11 : enregistrement lu incorrect");
+
+    snprintf(name, sizeof(name), "Test_11 : lectures sans attente, au plus %d en cours", N_Async_Depth);
+    Print_Instrument(pcache, name);
+    if (Short_Output)
+        printf("pending %lu\n", npending);
+    else
+        printf("\t%lu lectures mises en attente\n", npending);
+    if (!Cache_Close(pcache)) Error("Test_11 : Cache_Close");
+    free(slots);
+}
+
+/* Test 12 : écritures durables
+ * ----------------------------
+
+ * N_Sync_Threads threads (option -D) écrivent chacun un enregistrement puis
+ * appellent Cache_Sync(), comme une transaction qui doit être sur disque
+ * avant la suivante, N_DURABLE_WRITES fois en tout sur un même cache du
+ * fichier <File>.ds. La durée mesurée est celle de l'écriture et de la
+ * synchronisation. Le flux est joué en CACHE_SYNC_BUFFERED puis en
+ * CACHE_SYNC_DURABLE, où les fdatasync() des threads simultanés sont groupés.
+*/
+static void *Test_12_Thread(void *arg)
+{
+    struct Test_10_Thread *pt = arg;
+    Cache_Index i;
+
+    for (i = 0; i < pt->nloops; i++)
+    {
+        Cache_Index ind = Rng_Below(&pt->rng, N_Records_in_File);
+        struct Any temp;
+        unsigned long long t0 = Now_ns(), ns;
+
+        temp.i = ind;
+        temp.x = (double)ind;
+        if (!Cache_Write(pt->pcache, ind, &temp)) Error("Test_12 : Cache_Write");
+        if (!Cache_Sync(pt->pcache)) Error("Test_12 : Cache_Sync");
+
+        ns = Now_ns() - t0;
+        pt->hist[Lat_Bucket(ns)]++;
+        pt->count++;
+        if (ns > pt->max) pt->max = ns;
+    }
+    return NULL;
+}
+
+void Test_12()
+{
+    struct Cache_Options opts = {0};
+    char msg[128];
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_12 : incompatible avec -M et -o");
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    opts.concurrency = CACHE_LOCKED;
+    snprintf(msg, sizeof(msg), "Test_12 : %d threads, écritures transmises au système", N_Sync_Threads);
+    Threads_Run(&opts, ".ds", Test_12_Thread, N_Sync_Threads, N_DURABLE_WRITES, msg);
+    opts.sync_mode = CACHE_SYNC_DURABLE;
+    snprintf(msg, sizeof(msg), "Test_12 : %d threads, écritures durables groupées", N_Sync_Threads);
+    Threads_Run(&opts, ".ds", Test_12_Thread, N_Sync_Threads, N_DURABLE_WRITES, msg);
+}
+
+/* Contrôles du contenu (tests 13 et suivants)
+ * --------------------------------------------
+ * L'enregistrement ind écrit au passage pass vaut ind + pass * PASS_STEP
+ * (dans ses deux champs) : relu, il dit de quel passage il vient.
+ */
+#define PASS_STEP 1000000       /* écart entre les valeurs de deux passages */
+
+/* Écriture des enregistrements first à end - 1 avec la valeur du passage pass */
+static void Write_Pass(struct Cache *pcache, Cache_Index first, Cache_Index end, int pass, const char *test)
+{
+    char msg[128];
+    Cache_Index ind;
+
+    for (ind = first; ind < end; ind++)
+    {
+        struct Any temp;
+
+        temp.i = (int)(ind + pass * PASS_STEP);
+        temp.x = (double)temp.i;
+        if (!Cache_Write(pcache, ind, &temp))
+        {
+            snprintf(msg, sizeof(msg), "%s : Cache_Write", test);
+            Error(msg);
+        }
+    }
+}
+
+/* Relecture des enregistrements first à end - 1 : ils doivent avoir la valeur du passage pass */
+static void Check_Pass(struct Cache *pcache, Cache_Index first, Cache_Index end, int pass, const char *test)
+{
+    char msg[128];
+    Cache_Index ind;
+
+    for (ind = first; ind < end; ind++)
+    {
+        struct Any temp;
+
+        if (!Cache_Read(pcache, ind, &temp))
+        {
+            snprintf(msg, sizeof(msg), "%s : Cache_Read", test);
+            Error(msg);
+        }
+        if (temp.i != (int)(ind + pass * PASS_STEP) || temp.x != (double)temp.i)
+        {
+            snprintf(msg, sizeof(msg), "%s : enregistrement %lld relu incorrect", test, (long long)ind);
+            Error(msg);
+        }
+    }
+}
+
+/* Test 13 : invalidation de plages
+ * --------------------------------
+
+ * Sur un cache du fichier <File>.iv (avec son second niveau <File>.iv.spill
+ * si -T), les enregistrements de 4 fois plus de blocs que n'en tiennent les
+ * deux niveaux sont écrits puis synchronisés, puis tous réécrits. Deux
+ * plages, qui commencent et finissent au milieu d'un bloc (l'une dans les
+ * premiers blocs, sortis de la mémoire, l'autre dans les derniers, encore
+ * présents), sont invalidées sans abandon : tout est relu avec la deuxième
+ * valeur. Avec un fichier (-B file ou mmap), un autre cache y écrit ensuite
+ * une quatrième valeur dans les plages, comme le ferait un autre programme,
+ * quand les premiers blocs sont passés au second niveau : les plages
+ * invalidées sont relues avec cette valeur. Le cache est enfin vidé, les
+ * blocs des plages réécrits une troisième fois et les plages invalidées avec
+ * abandon : leurs enregistrements reviennent à leur valeur dans le fichier,
+ * leurs voisins des mêmes blocs gardent la troisième. En projection
+ * (-B mmap), l'abandon est refusé et rien ne change ; en écriture directe
+ * (-P around), les blocs réécrits après l'invalidation du cache ne sont pas
+ * chargés, et la troisième valeur est déjà dans le fichier, comme pour les
+ * enregistrements réécrits avant une synchronisation périodique.
+*/
+/* Relecture des n premiers enregistrements : ceux des plages doivent avoir la
+ * valeur pass_in (pass_block avant l'enregistrement synced), leurs voisins
+ * dans les blocs des plages pass_block, les autres pass_out */
+static void Test_13_Check(struct Cache *pcache, Cache_Index n, const Cache_Index range[][2], int nranges,
+                          int pass_in, int pass_block, int pass_out, Cache_Index synced)
+{
+    Cache_Index nr = N_Records_per_Block, ind;
+    int k;
+
+    for (ind = 0; ind < n; ind++)
+    {
+        struct Any temp;
+        int pass = pass_out;
+
+        for (k = 0; k < nranges; k++)
+        {
+            if (ind >= range[k][0] && ind < range[k][0] + range[k][1]) pass = ind < synced ? pass_block : pass_in;
+            else if (ind / nr >= range[k][0] / nr && ind / nr <= (range[k][0] + range[k][1] - 1) / nr)
+                pass = pass_block;
+        }
+        if (!Cache_Read(pcache, ind, &temp)) Error("Test_13 : Cache_Read");
+        if (temp.i != (int)(ind + pass * PASS_STEP) || temp.x != (double)temp.i)
+            Error("Test_13 : enregistrement relu incorrect");
+    }
+}
+
+void Test_13()
+{
+    struct Cache_Options opts = {0}, other_opts;
+    Cache_Index nr = N_Records_per_Block;
+    Cache_Index n = 4 * (N_Blocks_in_Cache + N_Spill_Blocks + (Cache_Index)1) * nr;
+    Cache_Index nfirst = (N_Blocks_in_Cache + N_Spill_Blocks / 2 + (Cache_Index)4) * nr;
+    Cache_Index range[2][2], ind, synced = 0;
+    struct Cache *pcache, *pother;
+    char name[FILENAME_MAX], spill[FILENAME_MAX + 6];
+    int k, mapped = (Backend == CACHE_BACKEND_MMAP), on_disk = 2;
+    int around = (Write_Policy == CACHE_WRITE_AROUND);
+    struct Cache_Instrument instr;
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_13 : incompatible avec -M et -o");
+    if (Backend == CACHE_BACKEND_NULL) Error("Test_13 : incompatible avec -B null");
+    /* Les blocs des deux plages doivent tenir ensemble dans le cache vidé */
+    if (N_Blocks_in_Cache < 8) Error("Test_13 : cache trop petit (au moins 8 blocs)");
+
+    if (n > N_Records_in_File) n = N_Records_in_File - N_Records_in_File % nr;
+    if (n < 8 * nr) Error("Test_13 : fichier trop petit");
+    range[0][0] = nr + nr / 2;
+    range[0][1] = 2 * nr;
+    range[1][0] = n - 3 * nr - nr / 3;
+    range[1][1] = 2 * nr + 1;
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    snprintf(name, sizeof(name), "%s.iv", File);
+    if (N_Spill_Blocks > 0)
+    {
+        snprintf(spill, sizeof(spill), "%s.spill", name);
+        opts.spill = spill;
+        opts.spill_blocks = N_Spill_Blocks;
+    }
+    if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &opts)) == NULL)
+        Error("Test_13 : Cache_Create");
+
+    Write_Pass(pcache, 0, n, 1, "Test_13");
+    if (!Cache_Sync(pcache)) Error("Test_13 : Cache_Sync");
+
+    /* Sans abandon : les modifications des plages sont écrites */
+    Write_Pass(pcache, 0, n, 2, "Test_13");
+    for (k = 0; k < 2; k++)
+        if (!Cache_Invalidate_Range(pcache, range[k][0], range[k][1], 0))
+            Error("Test_13 : Cache_Invalidate_Range");
+    Test_13_Check(pcache, n, range, 2, 2, 2, 2, 0);
+
+    /* Modification du fichier hors du cache : seules les plages invalidées
+     * sont relues dans le fichier, pas dans le second niveau */
+    if (Backend == CACHE_BACKEND_FILE || mapped)
+    {
+        if (!Cache_Sync(pcache)) Error("Test_13 : Cache_Sync");
+        Test_13_Check(pcache, nfirst < n ? nfirst : n, range, 2, 2, 2, 2, 0);
+
+        other_opts = opts;
+        other_opts.spill = NULL;
+        other_opts.spill_blocks = 0;
+        if ((pother = Cache_Create_Opt(name, 8, nr, Record_Size, N_Deref, &other_opts)) == NULL)
+            Error("Test_13 : Cache_Create (autre cache)");
+        for (k = 0; k < 2; k++)
+            Write_Pass(pother, range[k][0], range[k][0] + range[k][1], 4, "Test_13");
+        if (!Cache_Close(pother)) Error("Test_13 : Cache_Close (autre cache)");
+
+        for (k = 0; k < 2; k++)
+            if (!Cache_Invalidate_Range(pcache, range[k][0], range[k][1], 0))
+                Error("Test_13 : Cache_Invalidate_Range");
+        on_disk = 4;
+        Test_13_Check(pcache, n, range, 2, on_disk, 2, 2, 0);
+    }
+
+    /* Avec abandon : les blocs réécrits sont tous dans le cache (sauf en
+     * écriture directe) ; une synchronisation périodique (tous les NSYNC
+     * accès) a pu écrire dans le fichier les enregistrements avant synced */
+    if (!Cache_Invalidate(pcache)) Error("Test_13 : Cache_Invalidate");
+    Cache_Get_Instrument_R(pcache, &instr);
+    for (k = 0; k < 2; k++)
+    {
+        for (ind = range[k][0] / nr * nr; ind < ((range[k][0] + range[k][1] - 1) / nr + 1) * nr; ind++)
+        {
+            Write_Pass(pcache, ind, ind + 1, 3, "Test_13");
+            if (Cache_Get_Instrument_R(pcache, &instr)->n_syncs > 0) synced = ind + 1;
+        }
+    }
+    for (k = 0; k < 2; k++)
+    {
+        Cache_Error err = Cache_Invalidate_Range(pcache, range[k][0], range[k][1], 1);
+
+        if (err != (mapped ? CACHE_KO : CACHE_OK)) Error("Test_13 : Cache_Invalidate_Range (abandon)");
+    }
+    Test_13_Check(pcache, n, range, 2, mapped || around ? 3 : on_disk, 3, 2, synced);
+
+    Print_Instrument(pcache, "Test_13 : invalidation de plages");
+    if (!Cache_Close(pcache)) Error("Test_13 : Cache_Close");
+
+    /* Les fichiers ne servent qu'à ce test */
+    unlink(name);
+    if (N_Spill_Blocks > 0) unlink(spill);
+}
+
+/* Test 14 : instantanés
+ * ---------------------
+
+ * Sur un cache du fichier <File>.ws (avec son second niveau <File>.ws.spill
+ * si -T), les enregistrements de 2 fois plus de blocs que n'en tient le
+ * cache sont écrits et synchronisés ; l'instantané <File>.ws.snap est pris.
+ * La seconde moitié est réécrite sans synchronisation, puis l'instantané
+ * rechargé dans le même cache : les modifications ont été écrites avant, et
+ * tout est relu avec la bonne valeur. Avec un fichier (-B file ou mmap), le
+ * cache est fermé, un autre cache écrit une troisième valeur dans le dernier
+ * quart, et un troisième cache redémarre de l'instantané : ses blocs sont
+ * relus dans le fichier, pas restitués tels qu'à la sauvegarde.
+*/
+void Test_14()
+{
+    struct Cache_Options opts = {0}, other_opts;
+    Cache_Index nr = N_Records_per_Block;
+    Cache_Index n = 2 * (Cache_Index)N_Blocks_in_Cache * nr;
+    struct Cache *pcache, *pother;
+    char name[FILENAME_MAX], spill[FILENAME_MAX + 6], snap[FILENAME_MAX + 5];
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_14 : incompatible avec -M et -o");
+    if (Backend == CACHE_BACKEND_NULL) Error("Test_14 : incompatible avec -B null");
+
+    if (n > N_Records_in_File) n = N_Records_in_File - N_Records_in_File % nr;
+    if (n < 4 * nr) Error("Test_14 : fichier trop petit");
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    snprintf(name, sizeof(name), "%s.ws", File);
+    snprintf(snap, sizeof(snap), "%s.snap", name);
+    if (N_Spill_Blocks > 0)
+    {
+        snprintf(spill, sizeof(spill), "%s.spill", name);
+        opts.spill = spill;
+        opts.spill_blocks = N_Spill_Blocks;
+    }
+    if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &opts)) == NULL)
+        Error("Test_14 : Cache_Create");
+
+    Write_Pass(pcache, 0, n, 1, "Test_14");
+    if (!Cache_Sync(pcache)) Error("Test_14 : Cache_Sync");
+    if (!Cache_Save_Snapshot(pcache, snap)) Error("Test_14 : Cache_Save_Snapshot");
+
+    /* Rechargement dans le même cache : les blocs modifiés sont d'abord écrits */
+    Write_Pass(pcache, n / 2, n, 2, "Test_14");
+    if (!Cache_Load_Snapshot(pcache, snap)) Error("Test_14 : Cache_Load_Snapshot");
+    Check_Pass(pcache, n / 2, n, 2, "Test_14");
+    Check_Pass(pcache, 0, n / 2, 1, "Test_14");
+
+    if (Backend == CACHE_BACKEND_FILE || Backend == CACHE_BACKEND_MMAP)
+    {
+        /* Redémarrage après une modification du fichier hors du cache */
+        if (!Cache_Close(pcache)) Error("Test_14 : Cache_Close");
+
+        other_opts = opts;
+        other_opts.spill = NULL;
+        other_opts.spill_blocks = 0;
+        if ((pother = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &other_opts)) == NULL)
+            Error("Test_14 : Cache_Create (autre cache)");
+        Write_Pass(pother, n - n / 4, n, 3, "Test_14");
+        if (!Cache_Close(pother)) Error("Test_14 : Cache_Close (autre cache)");
+
+        opts.snapshot = snap;
+        if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &opts)) == NULL)
+            Error("Test_14 : Cache_Create (redémarrage)");
+        Check_Pass(pcache, n - n / 4, n, 3, "Test_14");
+        Check_Pass(pcache, n / 2, n - n / 4, 2, "Test_14");
+        Check_Pass(pcache, 0, n / 2, 1, "Test_14");
+    }
+
+    Print_Instrument(pcache, "Test_14 : instantanés");
+    if (!Cache_Close(pcache)) Error("Test_14 : Cache_Close");
+
+    /* Les fichiers ne servent qu'à ce test */
+    unlink(name);
+    unlink(snap);
+    if (N_Spill_Blocks > 0) unlink(spill);
+}
+
+/* Test 15 : second niveau
+ * -----------------------
+
+ * Sur un cache du fichier <File>.sp, avec un second niveau <File>.sp.spill
+ * de N_Spill_Blocks blocs (option -T, défaut : 4 fois le cache), les
+ * enregistrements d'autant de blocs que n'en tiennent les deux niveaux sont
+ * écrits et synchronisés, puis relus deux fois : la seconde lecture vient du
+ * second niveau. La première moitié est réécrite (ses blocs, promus puis
+ * modifiés, sont écrits avant d'être rétrogradés de nouveau), et tout est
+ * relu deux fois. Avec un fichier (-B file ou mmap), un autre cache écrit
+ * enfin une troisième valeur dans le premier quart : après Cache_Invalidate(),
+ * elle est relue, pas l'ancienne copie du second niveau.
+*/
+void Test_15()
+{
+    struct Cache_Options opts = {0}, other_opts;
+    struct Cache_Instrument instr;
+    Cache_Index nr = N_Records_per_Block;
+    unsigned nspill = N_Spill_Blocks > 0 ? (unsigned)N_Spill_Blocks : 4 * N_Blocks_in_Cache;
+    Cache_Index n = ((Cache_Index)N_Blocks_in_Cache + nspill) * nr;
+    struct Cache *pcache, *pother;
+    char name[FILENAME_MAX], spill[FILENAME_MAX + 6];
+    int k;
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_15 : incompatible avec -M et -o");
+    if (Backend == CACHE_BACKEND_NULL) Error("Test_15 : incompatible avec -B null");
+
+    if (n > N_Records_in_File) n = N_Records_in_File - N_Records_in_File % nr;
+    if (n < 4 * nr) Error("Test_15 : fichier trop petit");
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    snprintf(name, sizeof(name), "%s.sp", File);
+    snprintf(spill, sizeof(spill), "%s.spill", name);
+    opts.spill = spill;
+    opts.spill_blocks = nspill;
+    if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &opts)) == NULL)
+        Error("Test_15 : Cache_Create");
+
+    Write_Pass(pcache, 0, n, 1, "Test_15");
+    if (!Cache_Sync(pcache)) Error("Test_15 : Cache_Sync");
+    for (k = 0; k < 2; k++)
+        Check_Pass(pcache, 0, n, 1, "Test_15");
+
+    /* Blocs promus, modifiés puis rétrogradés de nouveau */
+    Write_Pass(pcache, 0, n / 2, 2, "Test_15");
+    for (k = 0; k < 2; k++)
+    {
+        Check_Pass(pcache, 0, n / 2, 2, "Test_15");
+        Check_Pass(pcache, n / 2, n, 1, "Test_15");
+    }
+    Cache_Get_Instrument_R(pcache, &instr);
+    if (instr.n_hits2 == 0) Error("Test_15 : second niveau inutilisé");
+
+    /* Modification du fichier hors du cache : l'invalidation vide aussi le second niveau */
+    if (Backend == CACHE_BACKEND_FILE || Backend == CACHE_BACKEND_MMAP)
+    {
+        if (!Cache_Sync(pcache)) Error("Test_15 : Cache_Sync");
+        other_opts = opts;
+        other_opts.spill = NULL;
+        other_opts.spill_blocks = 0;
+        if ((pother = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &other_opts)) == NULL)
+            Error("Test_15 : Cache_Create (autre cache)");
+        Write_Pass(pother, 0, n / 4, 3, "Test_15");
+        if (!Cache_Close(pother)) Error("Test_15 : Cache_Close (autre cache)");
+
+        if (!Cache_Invalidate(pcache)) Error("Test_15 : Cache_Invalidate");
+        Check_Pass(pcache, 0, n / 4, 3, "Test_15");
+        Check_Pass(pcache, n / 4, n / 2, 2, "Test_15");
+        Check_Pass(pcache, n / 2, n, 1, "Test_15");
+    }
+
+    Print_Instrument(pcache, "Test_15 : second niveau");
+    if (!Cache_Close(pcache)) Error("Test_15 : Cache_Close");
+
+    /* Les fichiers ne servent qu'à ce test */
+    unlink(name);
+    unlink(spill);
+}
+
+/* Test 16 : redimensionnement
+ * ---------------------------
+
+ * Sur un cache du fichier <File>.rs (avec son second niveau <File>.rs.spill
+ * si -T), les enregistrements de 3 fois plus de blocs que n'en tient le
+ * cache sont écrits et synchronisés, puis ceux du dernier tiers réécrits sans
+ * synchronisation. Le cache passe à la moitié de sa taille (les blocs
+ * modifiés évincés sont écrits), les enregistrements du premier tiers sont
+ * réécrits, puis le cache passe au double de sa taille initiale : tout est
+ * relu avec la bonne valeur après chaque changement. Avec un fichier (-B file
+ * ou mmap), le cache revient à sa taille et est fermé, et un autre cache
+ * relit tout dans le fichier.
+*/
+void Test_16()
+{
+    struct Cache_Options opts = {0}, other_opts;
+    Cache_Index nr = N_Records_per_Block;
+    Cache_Index n = 3 * (Cache_Index)N_Blocks_in_Cache * nr;
+    struct Cache *pcache;
+    char name[FILENAME_MAX], spill[FILENAME_MAX + 6];
+    Cache_Index third;
+    int k;
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_16 : incompatible avec -M et -o");
+    if (Backend == CACHE_BACKEND_NULL) Error("Test_16 : incompatible avec -B null");
+    if (N_Blocks_in_Cache < 2) Error("Test_16 : cache trop petit (au moins 2 blocs)");
+
+    if (n > N_Records_in_File) n = N_Records_in_File - N_Records_in_File % nr;
+    if (n < 3 * nr) Error("Test_16 : fichier trop petit");
+    third = n / 3;
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    snprintf(name, sizeof(name), "%s.rs", File);
+    if (N_Spill_Blocks > 0)
+    {
+        snprintf(spill, sizeof(spill), "%s.spill", name);
+        opts.spill = spill;
+        opts.spill_blocks = N_Spill_Blocks;
+    }
+    if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &opts)) == NULL)
+        Error("Test_16 : Cache_Create");
+
+    Write_Pass(pcache, 0, n, 1, "Test_16");
+    if (!Cache_Sync(pcache)) Error("Test_16 : Cache_Sync");
+    Write_Pass(pcache, n - third, n, 2, "Test_16");
+
+    /* Réduction : les blocs modifiés évincés sont écrits */
+    if (!Cache_Resize(pcache, N_Blocks_in_Cache / 2)) Error("Test_16 : Cache_Resize (réduction)");
+    Check_Pass(pcache, 0, n - third, 1, "Test_16");
+    Check_Pass(pcache, n - third, n, 2, "Test_16");
+
+    /* Agrandissement : les blocs conservés gardent leurs modifications */
+    Write_Pass(pcache, 0, third, 3, "Test_16");
+    if (!Cache_Resize(pcache, 2 * N_Blocks_in_Cache)) Error("Test_16 : Cache_Resize (agrandissement)");
+    for (k = 0; k < 2; k++)
+    {
+        Check_Pass(pcache, 0, third, 3, "Test_16");
+        Check_Pass(pcache, third, n - third, 1, "Test_16");
+        Check_Pass(pcache, n - third, n, 2, "Test_16");
+    }
+
+    if (!Cache_Resize(pcache, N_Blocks_in_Cache)) Error("Test_16 : Cache_Resize");
+    Print_Instrument(pcache, "Test_16 : redimensionnement");
+
+    /* Les modifications de chaque taille sont dans le fichier */
+    if (Backend == CACHE_BACKEND_FILE || Backend == CACHE_BACKEND_MMAP)
+    {
+        if (!Cache_Close(pcache)) Error("Test_16 : Cache_Close");
+        other_opts = opts;
+        other_opts.spill = NULL;
+        other_opts.spill_blocks = 0;
+        if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &other_opts)) == NULL)
+            Error("Test_16 : Cache_Create (autre cache)");
+        Check_Pass(pcache, 0, third, 3, "Test_16");
+        Check_Pass(pcache, third, n - third, 1, "Test_16");
+        Check_Pass(pcache, n - third, n, 2, "Test_16");
+    }
+    if (!Cache_Close(pcache)) Error("Test_16 : Cache_Close");
+
+    /* Les fichiers ne servent qu'à ce test */
+    unlink(name);
+    if (N_Spill_Blocks > 0) unlink(spill);
+}
+
+/* Test 17 : écriture des enregistrements modifiés
+ * -----------------------------------------------
+
+ * Sur un cache du fichier <File>.dr (avec son second niveau <File>.dr.spill
+ * si -T) dont les blocs font au moins 3 * TEST_17_MERGE octets, tous les
+ * enregistrements sont écrits, puis le cache est vidé. Dans chaque bloc,
+ * selon son rang, sont réécrits : un enregistrement sur 3 (une seule suite
+ * écrite, trous compris) ; le premier et le dernier ; trois enregistrements
+ * séparés par TEST_17_MERGE octets (fusionnés) puis par un enregistrement de
+ * plus (pas fusionnés) ; ou aucun. Après un nouveau vidage, chaque
+ * enregistrement relu dans le fichier doit avoir sa dernière valeur : les
+ * trous récrits avec une suite ne sont pas altérés. En défaut d'écriture
+ * sans lecture (-P stream), les blocs ne sont pas lus : rien n'est fusionné,
+ * et les trous ne doivent pas être écrits.
+*/
+#define TEST_17_MERGE 4096      /* écart de fusion de deux suites (DIRTY_MERGE de cache.c) */
+
+/* L'enregistrement ir du bloc ib est-il réécrit ? */
+static int Test_17_Written(Cache_Index ib, Cache_Index ir, Cache_Index nr)
+{
+    Cache_Index gap = TEST_17_MERGE / Record_Size;
+
+    switch (ib % 4)
+    {
+    case 0: return ir % 3 == 0;
+    case 1: return ir == 0 || ir == nr - 1;
+    case 2: return ir == 0 || ir == gap + 1 || ir == 2 * gap + 3;
+    default: return 0;
+    }
+}
+
+void Test_17()
+{
+    struct Cache_Options opts = {0};
+    Cache_Index nr = N_Records_per_Block, n, ind;
+    struct Cache *pcache;
+    char name[FILENAME_MAX], spill[FILENAME_MAX + 6];
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_17 : incompatible avec -M et -o");
+    if (Backend == CACHE_BACKEND_NULL) Error("Test_17 : incompatible avec -B null");
+
+    while (nr * Record_Size < 3 * TEST_17_MERGE) nr *= 2;
+    n = 2 * (Cache_Index)N_Blocks_in_Cache * nr;
+    if (n > N_Records_in_File) n = N_Records_in_File - N_Records_in_File % nr;
+    if (n < 4 * nr) Error("Test_17 : fichier trop petit");
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    snprintf(name, sizeof(name), "%s.dr", File);
+    if (N_Spill_Blocks > 0)
+    {
+        snprintf(spill, sizeof(spill), "%s.spill", name);
+        opts.spill = spill;
+        opts.spill_blocks = N_Spill_Blocks;
+    }
+    if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &opts)) == NULL)
+        Error("Test_17 : Cache_Create");
+
+    Write_Pass(pcache, 0, n, 1, "Test_17");
+    if (!Cache_Invalidate(pcache)) Error("Test_17 : Cache_Invalidate");
+
+    for (ind = 0; ind < n; ind++)
+        if (Test_17_Written(ind / nr, ind % nr, nr))
+            Write_Pass(pcache, ind, ind + 1, 2, "Test_17");
+    if (!Cache_Invalidate(pcache)) Error("Test_17 : Cache_Invalidate");
+
+    for (ind = 0; ind < n; ind++)
+        Check_Pass(pcache, ind, ind + 1, Test_17_Written(ind / nr, ind % nr, nr) ? 2 : 1, "Test_17");
+
+    Print_Instrument(pcache, "Test_17 : écriture des enregistrements modifiés");
+    if (!Cache_Close(pcache)) Error("Test_17 : Cache_Close");
+
+    /* Les fichiers ne servent qu'à ce test */
+    unlink(name);
+    if (N_Spill_Blocks > 0) unlink(spill);
+}
+
+/* Test 18 : écritures sans lecture des blocs
+ * ------------------------------------------
+
+ * Sur un cache du fichier <File>.na (avec son second niveau <File>.na.spill
+ * si -T), tous les enregistrements de 2 fois plus de blocs que n'en tient le
+ * cache sont écrits, puis le cache est vidé. Dans chaque bloc, le premier
+ * enregistrement et celui du milieu sont réécrits : en défaut d'écriture sans
+ * lecture (-P stream), le bloc est alloué sans être lu ; ses autres
+ * enregistrements, relus, doivent venir du fichier, et ne pas y être récrits.
+ * Cache_Write_Many() écrit ensuite une troisième valeur dans une plage qui
+ * commence et finit au milieu d'un bloc (les blocs entièrement couverts sont
+ * alloués sans être lus) ; tout est relu avant et après un vidage du cache. Enfin, dans un
+ * cache partagé, Cache_File_Write_Many() écrit des plages de même forme dans
+ * deux fichiers <File>.na0 et <File>.na1, relues avec Cache_File_Read().
+*/
+
+/* Valeur de l'enregistrement ind, la plage first à end - 1 écrite par Cache_Write_Many() */
+static int Test_18_Pass(Cache_Index ind, Cache_Index first, Cache_Index end)
+{
+    if (ind >= first && ind < end) return 3;
+    return ind % N_Records_per_Block == 0 || ind % N_Records_per_Block == N_Records_per_Block / 2 ? 2 : 1;
+}
+
+/* Relecture des enregistrements ind0 à ind1 - 1, la plage first à end - 1 écrite par Cache_Write_Many() */
+static void Test_18_Check(struct Cache *pcache, Cache_Index ind0, Cache_Index ind1, Cache_Index first,
+                          Cache_Index end)
+{
+    Cache_Index ind;
+
+    for (ind = ind0; ind < ind1; ind++)
+        Check_Pass(pcache, ind, ind + 1, Test_18_Pass(ind, first, end), "Test_18");
+}
+
+/* Écriture des enregistrements first à end - 1 d'un coup (dans pf, ou le fichier du cache) */
+static void Test_18_Write_Many(struct Cache *pcache, struct Cache_File *pf, Cache_Index first, Cache_Index end,
+                               int pass)
+{
+    struct Any *records = malloc((end - first) * sizeof(struct Any));
+    Cache_Index ind;
+    Cache_Error err;
+
+    for (ind = first; ind < end; ind++)
+    {
+        records[ind - first].i = (int)(ind + pass * PASS_STEP);
+        records[ind - first].x = (double)records[ind - first].i;
+    }
+    if (pf != NULL) err = Cache_File_Write_Many(pf, first, end - first, records);
+    else err = Cache_Write_Many(pcache, first, end - first, records);
+    if (!err) Error("Test_18 : Cache_Write_Many");
+    free(records);
+}
+
+/* Relecture des enregistrements first à end - 1 de pf : valeur du passage pass */
+static void Test_18_Check_File(struct Cache_File *pf, Cache_Index first, Cache_Index end, int pass)
+{
+    Cache_Index ind;
+
+    for (ind = first; ind < end; ind++)
+    {
+        struct Any temp;
+
+        if (!Cache_File_Read(pf, ind, &temp)) Error("Test_18 : Cache_File_Read");
+        if (temp.i != (int)(ind + pass * PASS_STEP) || temp.x != (double)temp.i)
+            Error("Test_18 : enregistrement relu incorrect (cache partagé)");
+    }
+}
+
+void Test_18()
+{
+    struct Cache_Options opts = {0}, pool_opts;
+    Cache_Index nr = N_Records_per_Block;
+    Cache_Index n = 2 * (Cache_Index)N_Blocks_in_Cache * nr, first, end, ind;
+    struct Cache *pcache;
+    struct Cache_File *files[2];
+    char name[FILENAME_MAX], spill[FILENAME_MAX + 6], names[2][FILENAME_MAX + 12];
+    int k;
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_18 : incompatible avec -M et -o");
+    if (Backend == CACHE_BACKEND_NULL) Error("Test_18 : incompatible avec -B null");
+    if (nr < 3) Error("Test_18 : blocs trop petits (au moins 3 enregistrements)");
+
+    if (n > N_Records_in_File) n = N_Records_in_File - N_Records_in_File % nr;
+    if (n < 4 * nr) Error("Test_18 : fichier trop petit");
+    first = nr / 3;
+    end = n - nr / 3;
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    snprintf(name, sizeof(name), "%s.na", File);
+    if (N_Spill_Blocks > 0)
+    {
+        snprintf(spill, sizeof(spill), "%s.spill", name);
+        opts.spill = spill;
+        opts.spill_blocks = N_Spill_Blocks;
+    }
+    if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &opts)) == NULL)
+        Error("Test_18 : Cache_Create");
+
+    Write_Pass(pcache, 0, n, 1, "Test_18");
+    if (!Cache_Invalidate(pcache)) Error("Test_18 : Cache_Invalidate");
+
+    /* Blocs partiellement écrits : un sur deux est relu aussitôt (complété
+     * depuis le fichier), les autres après leur remplacement (seuls les
+     * enregistrements écrits l'ont été dans le fichier) */
+    for (ind = 0; ind < n; ind += nr)
+    {
+        Write_Pass(pcache, ind, ind + 1, 2, "Test_18");
+        Write_Pass(pcache, ind + nr / 2, ind + nr / 2 + 1, 2, "Test_18");
+        if (ind / nr % 2 == 1) Test_18_Check(pcache, ind, ind + nr, 0, 0);
+    }
+    Test_18_Check(pcache, 0, n, 0, 0);
+
+    /* Écriture groupée, relue en commençant par les derniers blocs écrits,
+     * encore présents dans le cache */
+    Test_18_Write_Many(pcache, NULL, first, end, 3);
+    for (k = 0; k < 2; k++)
+    {
+        for (ind = n; ind > 0; ind -= nr)
+            Test_18_Check(pcache, ind - nr, ind, first, end);
+        if (!Cache_Invalidate(pcache)) Error("Test_18 : Cache_Invalidate");
+    }
+
+    Print_Instrument(pcache, "Test_18 : écritures sans lecture des blocs");
+    if (!Cache_Close(pcache)) Error("Test_18 : Cache_Close");
+
+    /* Écriture groupée dans les fichiers d'un cache partagé */
+    pool_opts = opts;
+    pool_opts.spill = NULL;
+    pool_opts.spill_blocks = 0;
+    if ((pcache = Cache_Pool_Create(N_Blocks_in_Cache, nr, Record_Size, N_Deref, &pool_opts)) == NULL)
+        Error("Test_18 : Cache_Pool_Create");
+    for (k = 0; k < 2; k++)
+    {
+        snprintf(names[k], sizeof(names[k]), "%s%d", name, k);
+        if ((files[k] = Cache_File_Open(pcache, names[k], 0, 0)) == NULL) Error(names[k]);
+        Test_18_Write_Many(pcache, files[k], 0, n, 1 + 3 * k);
+    }
+    for (k = 0; k < 2; k++)
+        Test_18_Write_Many(pcache, files[k], first, end, 2 + 3 * k);
+    if (!Cache_Invalidate(pcache)) Error("Test_18 : Cache_Invalidate");
+    for (k = 0; k < 2; k++)
+    {
+        Test_18_Check_File(files[k], 0, first, 1 + 3 * k);
+        Test_18_Check_File(files[k], first, end, 2 + 3 * k);
+        Test_18_Check_File(files[k], end, n, 1 + 3 * k);
+        if (!Cache_File_Close(files[k])) Error("Test_18 : Cache_File_Close");
+    }
+    if (!Cache_Close(pcache)) Error("Test_18 : Cache_Close");
+
+    /* Les fichiers ne servent qu'à ce test */
+    unlink(name);
+    for (k = 0; k < 2; k++) unlink(names[k]);
+    if (N_Spill_Blocks > 0) unlink(spill);
+}
+
+/* Test 19 : contenu des lectures sans attente
+ * -------------------------------------------
+
+ * Sur un cache du fichier <File>.ar (avec son second niveau <File>.ar.spill
+ * si -T), en CACHE_LOCKED puis en CACHE_CONCURRENT, tous les enregistrements
+ * de 2 fois plus de blocs que n'en tient le cache sont écrits, puis le cache
+ * est vidé. Ils sont ensuite relus par Cache_Read_Async(), bloc par bloc,
+ * avec au plus TEST_19_DEPTH blocs en cours de lecture : les défauts sur un
+ * même bloc partagent une lecture. Dans un bloc sur deux, le premier
+ * enregistrement est récrit aussitôt après ces demandes, pendant la lecture
+ * du bloc : celle-ci doit rendre les autres enregistrements, et ne pas
+ * effacer l'écriture (en écriture directe, -P around, le bloc lu est périmé).
+ * Tout est relu avant et après un vidage du cache. Enfin, dans un cache
+ * partagé, les mêmes enregistrements de deux fichiers <File>.ar0 et
+ * <File>.ar1 sont demandés ensemble par Cache_File_Read_Async().
+*/
+#define TEST_19_DEPTH 4
+
+struct Test_19_Slot
+{
+    struct Any rec;
+    int expected;               /* valeur attendue */
+    int busy;                   /* lecture en cours dans cette case */
+};
+
+static unsigned long Test_19_Errors;
+
+/* Valeur de l'enregistrement ind : le premier d'un bloc sur deux est récrit */
+static int Test_19_Pass(Cache_Index ind, int pass)
+{
+    Cache_Index nr = N_Records_per_Block;
+
+    return ind % nr == 0 && ind / nr % 2 == 1 ? pass + 1 : pass;
+}
+
+static void Test_19_Done(void *arg, Cache_Index irfile, void *precord, Cache_Error err)
+{
+    struct Test_19_Slot *ps = arg;
+
+    (void)irfile;
+    (void)precord;
+    if (err != CACHE_OK || ps->rec.i != ps->expected || ps->rec.x != (double)ps->expected)
+        __atomic_add_fetch(&Test_19_Errors, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&ps->busy, 0, __ATOMIC_RELEASE);
+}
+
+/* Lecture sans attente de l'enregistrement ind (dans pf, ou le fichier du cache) dans la case ps */
+static void Test_19_Read(struct Cache *pcache, struct Cache_File *pf, struct Test_19_Slot *ps, Cache_Index ind,
+                         int pass)
+{
+    Cache_Error err;
+
+    while (__atomic_load_n(&ps->busy, __ATOMIC_ACQUIRE)) sched_yield();
+    ps->busy = 1;
+    ps->expected = (int)(ind + pass * PASS_STEP);
+    if (pf != NULL) err = Cache_File_Read_Async(pf, ind, &ps->rec, Test_19_Done, ps);
+    else err = Cache_Read_Async(pcache, ind, &ps->rec, Test_19_Done, ps);
+    if (err != CACHE_PENDING) Test_19_Done(ps, ind, &ps->rec, err);
+}
+
+/* Attente de toutes les lectures en cours */
+static void Test_19_Wait(struct Test_19_Slot *slots, int nslots)
+{
+    int k;
+
+    for (k = 0; k < nslots; k++)
+        while (__atomic_load_n(&slots[k].busy, __ATOMIC_ACQUIRE)) sched_yield();
+    if (Test_19_Errors > 0) Error("Test_19 : enregistrement lu incorrect");
+}
+
+void Test_19()
+{
+    static const Cache_Concurrency modes[] = {CACHE_LOCKED, CACHE_CONCURRENT};
+    struct Cache_Options opts = {0}, pool_opts;
+    Cache_Index nr = N_Records_per_Block;
+    Cache_Index n = 2 * (Cache_Index)N_Blocks_in_Cache * nr, ib, ir, ind;
+    int nslots = TEST_19_DEPTH * (int)nr;
+    struct Test_19_Slot *slots = calloc(nslots, sizeof(struct Test_19_Slot));
+    struct Cache *pcache;
+    struct Cache_File *files[2];
+    char name[FILENAME_MAX], spill[FILENAME_MAX + 6], names[2][FILENAME_MAX + 12];
+    int m, k;
+
+    if (N_Instances > 0 || Trace_Out != NULL) Error("Test_19 : incompatible avec -M et -o");
+    if (Backend == CACHE_BACKEND_NULL) Error("Test_19 : incompatible avec -B null");
+
+    if (n > N_Records_in_File) n = N_Records_in_File - N_Records_in_File % nr;
+    if (n < 2 * nr) Error("Test_19 : fichier trop petit");
+
+    opts.backend = Backend;
+    opts.write_policy = Write_Policy;
+    snprintf(name, sizeof(name), "%s.ar", File);
+    if (N_Spill_Blocks > 0)
+    {
+        snprintf(spill, sizeof(spill), "%s.spill", name);
+        opts.spill = spill;
+        opts.spill_blocks = N_Spill_Blocks;
+    }
+
+    for (m = 0; m < 2; m++)
+    {
+        int pass = 1 + 2 * m;
+
+        opts.concurrency = modes[m];
+        if ((pcache = Cache_Create_Opt(name, N_Blocks_in_Cache, nr, Record_Size, N_Deref, &opts)) == NULL)
+            Error("Test_19 : Cache_Create");
+        Write_Pass(pcache, 0, n, pass, "Test_19");
+        if (!Cache_Invalidate(pcache)) Error("Test_19 : Cache_Invalidate");
+
+        /* Demandes d'un bloc, puis écriture pendant sa lecture */
+        Test_19_Errors = 0;
+        for (ib = 0; ib < n / nr; ib++)
+        {
+            for (ir = ib % 2; ir < nr; ir++)
+                Test_19_Read(pcache, NULL, &slots[ib % TEST_19_DEPTH * nr + ir], ib * nr + ir, pass);
+            if (ib % 2 == 1) Write_Pass(pcache, ib * nr, ib * nr + 1, pass + 1, "Test_19");
+        }
+        Test_19_Wait(slots, nslots);
+
+        for (k = 0; k < 2; k++)
+        {
+            for (ind = 0; ind < n; ind++)
+                Check_Pass(pcache, ind, ind + 1, Test_19_Pass(ind, pass), "Test_19");
+            if (!Cache_Invalidate(pcache)) Error("Test_19 : Cache_Invalidate");
+        }
+
+        Print_Instrument(pcache, modes[m] == CACHE_LOCKED ? "Test_19 : lectures sans attente, verrou"
+                                                          : "Test_19 : lectures sans attente, sans verrou");
+        if (!Cache_Close(pcache)) Error("Test_19 : Cache_Close");
+    }
+
+    /* Mêmes enregistrements de deux fichiers d'un cache partagé */
+    pool_opts = opts;
+    pool_opts.concurrency = CACHE_LOCKED;
+    pool_opts.spill = NULL;
+    pool_opts.spill_blocks = 0;
+    if ((pcache = Cache_Pool_Create(N_Blocks_in_Cache, nr, Record_Size, N_Deref, &pool_opts)) == NULL)
+        Error("Test_19 : Cache_Pool_Create");
+    for (k = 0; k < 2; k++)
+    {
+        snprintf(names[k], sizeof(names[k]), "%s%d", name, k);
+        if ((files[k] = Cache_File_Open(pcache, names[k], 0, 0)) == NULL) Error(names[k]);
+        for (ind = 0; ind < n; ind++)
+        {
+            struct Any temp;
+
+            temp.i = (int)(ind + (5 + k) * PASS_STEP);
+            temp.x = (double)temp.i;
+            if (!Cache_File_Write(files[k], ind, &temp)) Error("Test_19 : Cache_File_Write");
+        }
+    }
+    if (!Cache_Invalidate(pcache)) Error("Test_19 : Cache_Invalidate");
+    Test_19_Errors = 0;
+    for (ind = 0; ind < n; ind++)
+        for (k = 0; k < 2; k++)
+            Test_19_Read(NULL, files[k], &slots[(2 * ind + k) % nslots], ind, 5 + k);
+    Test_19_Wait(slots, nslots);
+    for (k = 0; k < 2; k++)
+        if (!Cache_File_Close(files[k])) Error("Test_19 : Cache_File_Close");
+    if (!Cache_Close(pcache)) Error("Test_19 : Cache_Close");
+    free(slots);
+
+    /* Les fichiers ne servent qu'à ce test */
+    unlink(name);
+    for (k = 0; k < 2; k++) unlink(names[k]);
+    if (N_Spill_Blocks > 0) unlink(spill);
+}
+
+/* ------------------------------------------------------------------------------------
+ * Fonctions locales (privées) à ce module
+ * ------------------------------------------------------------------------------------
+*/
+
+/* Fonction d'affichage d'erreur 
+ * -----------------------------
+ */
+static void Error(const char *msg)
+{
+    fprintf(stderr, "ERROR *** %s\n", msg);
+    exit(1);
+}
+
+/* Fonction d'affichage des paramètres généraux du cache
+ * -----------------------------------------------------
+*/
+static void Print_Parameters()
+{
+    int recordsz = sizeof(struct Any);
+    int blocksz = N_Records_per_Block * recordsz;
+    long long cachesz = (long long)N_Blocks_in_Cache * blocksz;
+    long long filesz = (long long)N_Records_in_File * recordsz;
+
+    if (Short_Output)
+    {
+        printf("%s\nrecsz %d\nnrec %lld\nnblk %d\nnrecblk %d\n", Strategy_Name(),
+               recordsz, (long long)N_Records_in_File, N_Blocks_in_Cache, N_Records_per_Block);          
+        printf("file/cache %.2f\nnloop %lld\nrw %d\n", 100 * (double)cachesz / filesz,
+               (long long)N_Loops, Ratio_Read_Write);
+        printf("nseq %d\nnws %d\nnloc %d\nnderef %d\n", N_Seq_Access, N_Working_Sets,
+               N_Local_Window, N_Deref);
+    }
+    else
+    {
+        printf("================ Configuration du cache ================\n");
+        printf("Paramètres du fichier :\n");
+        printf("\t%lld enregistrements %lld octets totaux\n", (long long)N_Records_in_File, filesz);
+
+        printf("Paramètres du cache :\n");
+        printf("\t%d blocs %d enregistrements/bloc %d octets/enregistrement\n", 
+               N_Blocks_in_Cache, N_Records_per_Block, recordsz);
+        printf("\t%d octets/bloc %lld octets totaux\n", blocksz, cachesz);
+        printf("\tRapport cache/fichier : %.2f %%\n", 100 * (double)cachesz / filesz);
+        printf("\tStratégie : %s\n", Strategy_Name());
+        printf("\tStockage : %s\n", Backend_Names[Backend]);
+        if (N_Spill_Blocks > 0)
+            printf("\tSecond niveau : %u blocs (%s)\n", N_Spill_Blocks, Spill_File);
+        if (Write_Policy != CACHE_WRITE_ALLOCATE)
+            printf("\tDéfaut en écriture : %s\n", Write_Policy_Names[Write_Policy]);
+        if (Advisor != CACHE_ADVISOR_OFF)
+            printf("\tConseiller de taille de bloc : %s\n", Advisor_Names[Advisor]);
+        if (N_Numa_Nodes == 0)
+            printf("\tPlacement NUMA : %d nœuds\n", Numa_Machine_Nodes());
+        else if (N_Numa_Nodes > 0)
+            printf("\tPlacement NUMA : %d nœuds simulés\n", N_Numa_Nodes);
+        if (N_Instances > 0)
+        {
+            int k;
+
+            printf("\tSimulation multiple (%d threads) :", N_Threads);
+            for (k = 0; k < N_Instances; k++)
+                printf(" %s:%d", Instances[k].strategy, Instances[k].ratio);
+            printf("\n");
+        }
+
+        printf("Paramètres des tests :\n");
+        printf("\tNombre d'accès : %lld\n", (long long)N_Loops);
+        printf("\tRapport lectures/écritures : %d\n", Ratio_Read_Write);
+        printf("\tNombre maximum accès séquentiels : %d\n", N_Seq_Access);
+        printf("\tNombre de Working Sets : %d\n", N_Working_Sets);  
+        printf("\tLargeur de la fenêtre de localité : %d\n", N_Local_Window);
+        printf("\tFréquence de déréférençage pour NUR : %d\n", N_Deref);
+        printf("\tGerme aléatoire : %llu\n", (unsigned long long)Rng_Get_Seed());
+        if (Workload_Spec != NULL)
+            printf("\tGénérateur du test 8 : %s\n", Workload_Spec);
+        if (N_Test_Threads > 0)
+            printf("\tThreads du test 10 : %d\n", N_Test_Threads);
+        if (N_Sync_Threads > 0)
+            printf("\tThreads du test 12 : %d\n", N_Sync_Threads);
+        printf("========================================================\n");
+    }
+}
+
+/* Chronométrage des accès
+ * -----------------------
+ */
+static unsigned long long Now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Indice de l'histogramme correspondant à une durée de ns nanosecondes */
+static int Lat_Bucket(unsigned long long ns)
+{
+    int e = 0;
+
+    if (ns < (1ULL << LAT_SUB_BITS)) return (int)ns;
+    while ((ns >> e) >= (2ULL << LAT_SUB_BITS)) e++;
+    return ((e + 1) << LAT_SUB_BITS) + (int)((ns >> e) - (1ULL << LAT_SUB_BITS));
+}
+
+/* Plus petite durée rangée dans la classe b (inverse de Lat_Bucket) */
+static double Lat_Value(int b)
+{
+    int e = (b >> LAT_SUB_BITS) - 1;
+
+    if (e < 0) return b;
+    return (double)(((1ULL << LAT_SUB_BITS) + (b & ((1 << LAT_SUB_BITS) - 1))) << e);
+}
+
+static void Lat_Record(unsigned long long ns)
+{
+    Lat_Hist[Lat_Bucket(ns)]++;
+    Lat_Count++;
+    if (ns > Lat_Max) Lat_Max = ns;
+}
+
+/* Percentile p (entre 0 et 1) des durées mesurées */
+static double Hist_Percentile(const unsigned long *hist, unsigned long count, unsigned long long max,
+                              double p)
+{
+    unsigned long rank = (unsigned long)(p * count);
+    unsigned long cum = 0;
+    int b;
+
+    for (b = 0; b < LAT_NBUCKETS; b++)
+    {
+        cum += hist[b];
+        if (cum > rank) return Lat_Value(b);
+    }
+    return (double)max;
+}
+
+static double Lat_Percentile(double p)
+{
+    return Hist_Percentile(Lat_Hist, Lat_Count, Lat_Max, p);
+}
+
+/* Enregistrement d'un accès dans le flux (fichier -o et/ou simulation multiple) */
+static void Record_Access(Cache_Index irfile, int write)
+{
+    if (Trace_Out != NULL) fprintf(Trace_Out, "%c %lld\n", write ? 'w' : 'r', (long long)irfile);
+    if (N_Instances > 0) Trace_Append(irfile, write);
+}
+
+static Cache_Error Test_Invalidate(struct Cache *pcache)
+{
+    if (Trace_Out != NULL) fprintf(Trace_Out, "i\n");
+    if (Warm_Start)
+    {
+        Warm_Start = 0;
+        return CACHE_OK;
+    }
+    if (N_Instances > 0)
+    {
+        Trace_Len = 0;
+        return CACHE_OK;
+    }
+    if (N_Resize_Blocks > 0 && !Cache_Resize(pcache, N_Blocks_in_Cache))
+        return CACHE_KO;
+    return Cache_Invalidate(pcache);
+}
+
+/* Redimensionnement du cache au milieu du test (option -Z) */
+static void Maybe_Resize(struct Cache *pcache)
+{
+    if (N_Resize_Blocks > 0 && Lat_Count == (unsigned long)N_Loops / 2
+        && !Cache_Resize(pcache, N_Resize_Blocks))
+        Error("Cache_Resize");
+}
+
+static Cache_Error Timed_Read(struct Cache *pcache, Cache_Index irfile, void *precord)
+{
+    unsigned long long t0;
+    Cache_Error err;
+
+    Record_Access(irfile, 0);
+    if (N_Instances > 0) return CACHE_OK;
+
+    Maybe_Resize(pcache);
+    t0 = Now_ns();
+    err = Cache_Read(pcache, irfile, precord);
+
+    Lat_Record(Now_ns() - t0);
+    return err;
+}
+
+static Cache_Error Timed_Write(struct Cache *pcache, Cache_Index irfile, const void *precord)
+{
+    unsigned long long t0;
+    Cache_Error err;
+
+    Record_Access(irfile, 1);
+    if (N_Instances > 0) return CACHE_OK;
+
+    Maybe_Resize(pcache);
+    t0 = Now_ns();
+    err = Cache_Write(pcache, irfile, precord);
+
+    Lat_Record(Now_ns() - t0);
+    return err;
+}
+
+/* Indication d'accès, seulement avec l'option -H (et sans simulation multiple) */
+static void Hint(struct Cache *pcache, Cache_Index first, Cache_Index count, Cache_Hint hint)
+{
+    if (Use_Hints && N_Instances == 0 && !Cache_Advise(pcache, first, count, hint))
+        Error("Cache_Advise");
+}
+
+/* Écriture d'un lot : chaque enregistrement compte pour une part égale de la durée */
+static Cache_Error Timed_Write_Many(struct Cache *pcache, Cache_Index first, int count, const void *precords)
+{
+    unsigned long long t0, ns;
+    Cache_Error err;
+    int k;
+
+    for (k = 0; k < count; k++) Record_Access(first + k, 1);
+    if (N_Instances > 0) return CACHE_OK;
+
+    Maybe_Resize(pcache);
+    t0 = Now_ns();
+    err = Cache_Write_Many(pcache, first, count, precords);
+
+    ns = (Now_ns() - t0) / count;
+    for (k = 0; k < count; k++) Lat_Record(ns);
+    return err;
+}
+
+/* Recupération des données d'instrumentation
+ *  ------------------------------------------
+ */
+static void Print_Instrument(struct Cache *pcache, const char *msg)
+{
+    struct Cache_Instrument instr, *pinstr;
+    struct Cache_Advice adv;
+    struct Cache_Node_Instrument nodes[NUMA_MAX_NODES];
+    struct timespec now;
+    double elapsed, touched;
+    int advice, c, nnodes;
+
+    if (N_Instances > 0)
+    {
+        Run_Instances(msg);
+        return;
+    }
+
+    pinstr = Cache_Get_Instrument_R(pcache, &instr);
+    touched = pinstr->n_loaded > 0 ? ((double)pinstr->n_touched)/pinstr->n_loaded*100 : 0.0;
+    advice = Advisor != CACHE_ADVISOR_OFF && Cache_Get_Advice(pcache, &adv) == CACHE_OK;
+    nnodes = Cache_Get_Node_Instrument(pcache, nodes, NUMA_MAX_NODES);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (now.tv_sec - Test_Start.tv_sec) + (now.tv_nsec - Test_Start.tv_nsec) * 1e-9;
+
+    if (Short_Output)
+    {
+        printf("hits %.1f\n", 
+               ((double)pinstr->n_hits)/(pinstr->n_reads + pinstr->n_writes)*100);
+        if (N_Spill_Blocks > 0)
+            printf("hits2 %.1f\n", pinstr->n_hits2 + pinstr->n_misses2 > 0 ?
+                   ((double)pinstr->n_hits2)/(pinstr->n_hits2 + pinstr->n_misses2)*100 : 0.0);
+        printf("touched %.1f\nread %llu\nwritten %llu\n", touched, pinstr->n_read, pinstr->n_written);
+        if (pinstr->n_commits > 0)
+            printf("syncs %llu\ncommits %llu\n", pinstr->n_syncs, pinstr->n_commits);
+        if (advice)
+            printf("records %u\nadvice %u\n", adv.current, adv.best);
+        printf("ops %lu\ntime %.6f\nops/s %.0f\n", Lat_Count, elapsed,
+               elapsed > 0 ? Lat_Count / elapsed : 0.0);
+        printf("lat50 %.0f\nlat90 %.0f\nlat99 %.0f\nlatmax %llu\n",
+               Lat_Percentile(0.50), Lat_Percentile(0.90), Lat_Percentile(0.99), Lat_Max);
+        for (c = 0; c < nnodes; c++)
+        {
+            struct Node_Lat *pnl = &Node_Lats[c];
+
+            printf("node%d_hits %.1f\nnode%d_local %.1f\n",
+                   c, nodes[c].n_access > 0 ? (double)nodes[c].n_hits / nodes[c].n_access * 100 : 0.0,
+                   c, nodes[c].n_hits > 0 ? (double)nodes[c].n_local / nodes[c].n_hits * 100 : 0.0);
+            if (pnl->count > 0)
+                printf("node%d_lat50 %.0f\nnode%d_lat99 %.0f\n",
+                       c, Hist_Percentile(pnl->hist, pnl->count, pnl->max, 0.50),
+                       c, Hist_Percentile(pnl->hist, pnl->count, pnl->max, 0.99));
+        }
+    }
+    else
+    {
+        printf("\n%s : \n", msg == NULL ? "" : msg);
+        printf("\t%llu lectures %llu écritures %llu succès (%.1f %%)\n",
+               pinstr->n_reads, pinstr->n_writes, pinstr->n_hits, 
+               ((double)pinstr->n_hits)/(pinstr->n_reads + pinstr->n_writes)*100);
+        if (N_Spill_Blocks > 0)
+            printf("\tsecond niveau : %llu succès %llu échecs (%.1f %%)\n",
+                   pinstr->n_hits2, pinstr->n_misses2,
+                   pinstr->n_hits2 + pinstr->n_misses2 > 0 ?
+                   ((double)pinstr->n_hits2)/(pinstr->n_hits2 + pinstr->n_misses2)*100 : 0.0);
+        printf("\t%llu enregistrements chargés, dont %.1f %% accédés\n", pinstr->n_loaded, touched);
+        printf("\t%llu enregistrements lus %llu écrits dans le fichier\n", pinstr->n_read, pinstr->n_written);
+        if (advice)
+        {
+            printf("\tconseil : %u enregistrements/bloc (actuellement %u)\n", adv.best, adv.current);
+            for (c = 0; c < adv.nclasses; c++)
+                printf("\t\t%6u enr/bloc %8u blocs %10llu défauts coût %.3f s\n",
+                       adv.nrecords[c], adv.nblocks[c], adv.n_misses[c], adv.cost[c] * 1e-9);
+        }
+        printf("\t%llu syncs %llu déréférençages\n", pinstr->n_syncs, pinstr->n_deref);
+        if (pinstr->n_commits > 0)
+            printf("\t%llu écritures durables (fdatasync groupés)\n", pinstr->n_commits);
+        printf("\t%.3f s %.0f accès/s latence p50 %.0f ns p99 %.0f ns max %llu ns\n",
+               elapsed, elapsed > 0 ? Lat_Count / elapsed : 0.0,
+               Lat_Percentile(0.50), Lat_Percentile(0.99), Lat_Max);
+        for (c = 0; c < nnodes; c++)
+        {
+            struct Node_Lat *pnl = &Node_Lats[c];
+
+            printf("\tnœud %d : %u blocs %llu accès %llu succès (%.1f %%) dont %.1f %% locaux",
+                   c, nodes[c].nblocks, nodes[c].n_access, nodes[c].n_hits,
+                   nodes[c].n_access > 0 ? (double)nodes[c].n_hits / nodes[c].n_access * 100 : 0.0,
+                   nodes[c].n_hits > 0 ? (double)nodes[c].n_local / nodes[c].n_hits * 100 : 0.0);
+            if (pnl->count > 0)
+                printf(" latence p50 %.0f ns p99 %.0f ns",
+                       Hist_Percentile(pnl->hist, pnl->count, pnl->max, 0.50),
+                       Hist_Percentile(pnl->hist, pnl->count, pnl->max, 0.99));
+            printf("\n");
+        }
+    }
+
+    /* Remise à zéro des mesures pour le test suivant */
+    memset(Node_Lats, 0, sizeof(Node_Lats));
+    memset(Lat_Hist, 0, sizeof(Lat_Hist));
+    Lat_Count = 0;
+    Lat_Max = 0;
+}
+
+/* Simulation multiple et rejeu
+ * ----------------------------
+ */
+
+/* Ajout d'un accès à la fin de Trace */
+static void Trace_Append(Cache_Index irfile, int write)
+{
+    if (Trace_Len == Trace_Cap)
+    {
+        Trace_Cap = Trace_Cap ? 2 * Trace_Cap : 65536;
+        if ((Trace = realloc(Trace, Trace_Cap * sizeof(struct Access))) == NULL)
+            Error("Trace_Append : realloc");
+    }
+    Trace[Trace_Len].irfile = irfile;
+    Trace[Trace_Len].write = write;
+    Trace_Len++;
+}
+
+/* Création des caches de la simulation multiple : méta-données seulement */
+static void Create_Instances()
+{
+    struct Cache_Options opts = {0};
+    int k;
+
+    opts.backend = CACHE_BACKEND_NULL;
+    for (k = 0; k < N_Instances; k++)
+    {
+        struct Instance *pinst = &Instances[k];
+        unsigned int nblocks = N_Records_in_File / N_Records_per_Block / pinst->ratio;
+
+        /* Hors de tst_Cache_MULTI, seule la stratégie de l'exécutable existe */
+        if (strcmp(Strategy_Name(), "MULTI") != 0
+            && strcmp(Strategy_Name(), pinst->strategy) != 0)
+            Error("-M : stratégie absente de cet exécutable (voir tst_Cache_MULTI)");
+
+        opts.strategy = pinst->strategy;
+        if ((pinst->pcache = Cache_Create_Opt(File, nblocks > 0 ? nblocks : 1,
+                                              N_Records_per_Block, Record_Size,
+                                              N_Deref, &opts)) == NULL)
+            Error("Cache_Init");
+    }
+}
+
+static void Close_Instances()
+{
+    int k;
+
+    for (k = 0; k < N_Instances; k++)
+        if (!Cache_Close(Instances[k].pcache)) Error("Cache_Close");
+}
+
+/* Rejeu de Trace sur un cache */
+static void Replay_Instance(struct Instance *pinst)
+{
+    struct Any temp = {0, 0.0};
+    struct timespec t0, t1;
+    unsigned long n;
+
+    if (!Cache_Invalidate(pinst->pcache)) Error("Rejeu : Cache_Invalidate");
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < Trace_Len; n++)
+    {
+        if (Trace[n].write)
+        {
+            if (!Cache_Write(pinst->pcache, Trace[n].irfile, &temp))
+                Error("Rejeu : Cache_Write");
+        }
+        else if (!Cache_Read(pinst->pcache, Trace[n].irfile, &temp))
+            Error("Rejeu : Cache_Read");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    pinst->elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+}
+
+/* Corps d'un thread de rejeu : les caches k, k + N_Threads, ... */
+static void *Replay_Thread(void *arg)
+{
+    int k;
+
+    for (k = (int)(long)arg; k < N_Instances; k += N_Threads)
+        Replay_Instance(&Instances[k]);
+    return NULL;
+}
+
+/* Rejeu du flux du test courant sur tous les caches, puis affichage */
+static void Run_Instances(const char *msg)
+{
+    pthread_t threads[MAX_INSTANCES];
+    int nthreads = N_Threads < N_Instances ? N_Threads : N_Instances;
+    int k;
+
+    if (nthreads <= 1)
+        Replay_Thread((void *)0L);
+    else
+    {
+        for (k = 0; k < nthreads; k++)
+            if (pthread_create(&threads[k], NULL, Replay_Thread, (void *)(long)k) != 0)
+                Error("pthread_create");
+        for (k = 0; k < nthreads; k++)
+            pthread_join(threads[k], NULL);
+    }
+
+    if (!Short_Output) printf("\n%s : \n", msg == NULL ? "" : msg);
+    for (k = 0; k < N_Instances; k++)
+    {
+        struct Instance *pinst = &Instances[k];
+        struct Cache_Policy_Instrument policies[MAX_POLICIES];
+        double hits;
+        int npolicies, c;
+
+        Cache_Get_Instrument_R(pinst->pcache, &pinst->instr);
+        hits = ((double)pinst->instr.n_hits) / (pinst->instr.n_reads + pinst->instr.n_writes) * 100;
+        npolicies = Cache_Get_Policy_Instrument(pinst->pcache, policies, MAX_POLICIES);
+
+        if (Short_Output)
+            printf("hits %.1f %s:%d\n", hits, pinst->strategy, pinst->ratio);
+        else
+            printf("\t%-5s r=%-5d %llu lectures %llu écritures %llu succès (%.1f %%) %.0f accès/s\n",
+                   pinst->strategy, pinst->ratio, pinst->instr.n_reads, pinst->instr.n_writes,
+                   pinst->instr.n_hits, hits, pinst->elapsed > 0 ? Trace_Len / pinst->elapsed : 0.0);
+
+        /* Méta-stratégie : changements de stratégie et succès des fantômes */
+        if (npolicies > 0 && Short_Output)
+            printf("switches %llu %s:%d\n", pinst->instr.n_switches, pinst->strategy, pinst->ratio);
+        else if (npolicies > 0)
+            printf("\t\t%llu changements de stratégie\n", pinst->instr.n_switches);
+        for (c = 0; c < npolicies && c < MAX_POLICIES; c++)
+        {
+            double shadow = policies[c].n_access > 0 ? (double)policies[c].n_hits / policies[c].n_access * 100 : 0.0;
+
+            if (Short_Output)
+                printf("shadow %.1f %s %s:%d\n", shadow, policies[c].name, pinst->strategy, pinst->ratio);
+            else
+                printf("\t\t%c %-5s fantôme %llu accès %llu succès (%.1f %%) choisie %llu fois\n",
+                       policies[c].live ? '*' : ' ', policies[c].name, policies[c].n_access,
+                       policies[c].n_hits, shadow, policies[c].n_switches_to);
+        }
+    }
+    Trace_Len = 0;
+}
+
+/* Rejeu d'un segment du flux (entre deux invalidations) lu dans un fichier */
+static void Replay_Segment(int iseg)
+{
+    char msg[64];
+    unsigned long n;
+
+    snprintf(msg, sizeof(msg), "Rejeu : segment %d", iseg);
+    if (N_Instances > 0)
+    {
+        Run_Instances(msg);
+        return;
+    }
+
+    if (!Cache_Invalidate(The_Cache)) Error("Rejeu : Cache_Invalidate");
+    clock_gettime(CLOCK_MONOTONIC, &Test_Start);
+    for (n = 0; n < Trace_Len; n++)
+    {
+        struct Any temp;
+
+        temp.i = Trace[n].irfile;
+        temp.x = (double)Trace[n].irfile;
+        if (Trace[n].write)
+        {
+            if (!Timed_Write(The_Cache, Trace[n].irfile, &temp)) Error("Rejeu : Cache_Write");
+        }
+        else if (!Timed_Read(The_Cache, Trace[n].irfile, &temp))
+            Error("Rejeu : Cache_Read");
+    }
+    Print_Instrument(The_Cache, msg);
+    Trace_Len = 0;
+}
+
+/* Rejeu d'un flux enregistré par -o : une ligne "r ind" ou "w ind" par accès,
+ * "i" à chaque invalidation (début de test)
+ */
+static void Replay_Trace_File(const char *file)
+{
+    FILE *fp = fopen(file, "r");
+    char line[64];
+    int started = 0, iseg = 1;
+
+    if (fp == NULL) Error(file);
+    Trace_Len = 0;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        long long ind;
+
+        if (line[0] == 'i')
+        {
+            if (started) Replay_Segment(iseg++);
+            started = 1;
+        }
+        else if ((line[0] == 'r' || line[0] == 'w') && sscanf(line + 1, "%lld", &ind) == 1)
+        {
+            Trace_Append(ind, line[0] == 'w');
+            started = 1;
+        }
+    }
+    if (started) Replay_Segment(iseg);
+    fclose(fp);
+}
+
+/* Information d'utilisation
+ * -------------------------
+*/
+static void Usage(const char *execname)
+{
+    printf("\nUsage: %s [options]\n", execname);
+    printf("\nOptions générales\n"
+           "-----------------\n"
+           "-h\tce message\n"
+           "-p\taffiche les paramètres du cache sans exécuter de test\n"
+           "-S\tformat de sortie court");
+    printf("\nOptions de configuration du cache\n"
+           "---------------------------------\n"
+           "-f file\tnom du fichier\n"
+           "-B be\tstockage : file (défaut), mem (en mémoire), null (méta-données seules)\n"
+           "\tou mmap (fichier projeté, les blocs ne gardent que ses pages)\n"
+           "-N nr\tnombre d'enregistrements dans le fichier\n"
+           "-R nrb\tnombre d'enregistrements par bloc du cache\n" 
+           "-r rfc\trapport taille fichier / taille cache\n"
+           "-T nb2\tsecond niveau de nb2 blocs dans le fichier <file>.spill\n"
+           "-A mode\tconseiller de taille de bloc : show (conseil seulement) ou auto\n"
+           "\t(changement automatique du nombre d'enregistrements par bloc)\n"
+           "-P pol\tdéfaut en écriture : allocate (lecture du bloc, défaut), stream\n"
+           "\t(bloc alloué sans lecture) ou around (écriture directe dans le fichier)\n"
+           "-Z nb\tle cache passe à nb blocs au milieu de chaque test\n"
+           "-U nn\tplacement NUMA des blocs : sur les nœuds de la machine (nn = 0)\n"
+           "\tou sur nn nœuds simulés (voir numa.h)\n"
+           "-k file\tinstantané : rechargé au démarrage (le premier test n'invalide\n"
+           "\tpas le cache), réécrit à la fermeture\n");
+    printf("\nOptions de configuration des tests\n"
+           "----------------------------------\n"
+           "-t nt\tactive le test nt ; il peut y avoir plusieurs options -t\n"
+           "\t(nt de 1 à %d)\n", NTESTS);
+    printf("-l nl\tle nombre d'accès dans les tests 2 à 4 sera 'nl * nr' (nl peut être\n"
+           "\tfractionnaire : -l 0.001 pour un fichier de plusieurs milliards d'enregistrements)\n"
+           "-w rwr\trapport nombre lectures / nombre écritures (tests 3 et 4)\n"
+           "-s ns\tnombre de blocs à lire séquentiellement (test 3)\n"
+           "-W nws\tnombre de working sets (tests 4 et 5)\n"
+           "-L nl\tlongueur de la fenêtre de localité (test 4 et 5)\n"
+           "-d dr\tpériode de déréférençage pour NUR (de vieillissement pour AGING)\n"
+           "-H\tindications d'accès (Cache_Advise) dans les tests 3 et 7\n"
+           "-m nw\tle test 6 écrit par lots de nw enregistrements (Cache_Write_Many)\n"
+           "-g gen\tgénérateur du test 8 : uniform, scan[:f], zipf[:theta],\n"
+           "\thotspot[:f[:p]], ou phases g1@n1,g2@n2,... (active le test 8)\n"
+           "-G seed\tgerme des tirages aléatoires (défaut : 1)\n"
+           "-F nf\tnombre de fichiers du test 9, cache partagé (active le test 9)\n"
+           "-C nt\tnombre de threads du test 10, accès concurrents (active le test 10)\n"
+           "-Y nd\tnombre maximal de lectures en cours du test 11, lectures sans\n"
+           "\tattente (active le test 11)\n"
+           "-D nt\tnombre de threads du test 12, écritures durables (active le test 12)\n"
+           "\t(les tests 13 et suivants, contrôles du contenu, ne sont faits qu'avec -t :\n"
+           "\t13 invalidation de plages, 14 instantanés, 15 second niveau,\n"
+           "\t16 redimensionnement, 17 écriture des enregistrements modifiés,\n"
+           "\t18 écritures sans lecture des blocs, 19 lectures sans attente)\n");
+    printf("\nSimulation multiple et flux d'accès\n"
+           "-----------------------------------\n"
+           "-M s[:r],...\trejoue le flux de chaque test sur plusieurs caches (méta-données\n"
+           "\t\tseulement) : stratégie s, rapport fichier / cache r (défaut : -r) ;\n"
+           "\t\tplusieurs stratégies différentes demandent tst_Cache_MULTI\n"
+           "\t\t(qui a aussi ADAPT, choix périodique de la meilleure stratégie)\n"
+           "-j nt\t\tnombre de threads pour le rejeu de -M\n"
+           "-o file\t\tenregistre le flux d'accès dans file\n"
+           "-i file\t\trejoue le flux enregistré dans file au lieu des tests\n");
+}
+    
+/* Analyse de la liste des caches de -M : "NUR,LRU:50,..." */
+static void Parse_Instances(char *spec)
+{
+    char *item;
+
+    for (item = strtok(spec, ","); item != NULL; item = strtok(NULL, ","))
+    {
+        char *colon = strchr(item, ':');
+
+        if (N_Instances == MAX_INSTANCES) Error("-M : trop de caches");
+        Instances[N_Instances].ratio = 0;
+        if (colon != NULL)
+        {
+            *colon = '\0';
+            Instances[N_Instances].ratio = atoi(colon + 1);
+        }
+        Instances[N_Instances].strategy = item;
+        N_Instances++;
+    }
+}
+
+/* Analyse des arguments 
+ * ----------------------
+ */
+static void Scan_Args(int argc, char *argv[])
+{
+    int i;
+    int ntests = 0;
+    int just_print = 0;
+    int numtest;
+
+    for (i = 1; i < argc; i++)
+    {
+    if (argv[i][0] == '-')
+    {
+        switch (argv[i][1])
+        {
+                /* Options générales */
+
+        case 'h':
+        Usage(argv[0]);
+        exit(1);
+            case 'p':
+                just_print = 1;
+                break;
+            case 'S':
+                Short_Output = 1;
+                break;
+
+                /* Options de configuration du cache */
+
+        case 'f':
+        File = argv[++i];
+        break;      
+        case 'B':
+        ++i;
+        for (Backend = 0; Backend < NBACKENDS && strcmp(argv[i], Backend_Names[Backend]) != 0; Backend++) {}
+        if (Backend == NBACKENDS)
+        {
+            Usage(argv[0]);
+            exit(1);
+        }
+        break;
+        case 'N':
+        N_Records_in_File = strtoll(argv[++i], NULL, 10);
+        break;
+        case 'R':
+        N_Records_per_Block = atoi(argv[++i]);
+        break;
+        case 'r':
+        Ratio_File_Cache = atoi(argv[++i]);
+        break;
+        case 'A':
+        ++i;
+        for (Advisor = 0; Advisor < NADVISORS && strcmp(argv[i], Advisor_Names[Advisor]) != 0; Advisor++) {}
+        if (Advisor == NADVISORS)
+        {
+            Usage(argv[0]);
+            exit(1);
+        }
+        break;
+        case 'P':
+        ++i;
+        for (Write_Policy = 0; Write_Policy < NWRITEPOLICIES
+                 && strcmp(argv[i], Write_Policy_Names[Write_Policy]) != 0; Write_Policy++) {}
+        if (Write_Policy == NWRITEPOLICIES)
+        {
+            Usage(argv[0]);
+            exit(1);
+        }
+        break;
+        case 'Z':
+        N_Resize_Blocks = atoi(argv[++i]);
+        break;
+        case 'U':
+        N_Numa_Nodes = atoi(argv[++i]);
+        break;
+        case 'T':
+        N_Spill_Blocks = atoi(argv[++i]);
+        break;
+        case 'k':
+        Snapshot_File = argv[++i];
+        Warm_Start = 1;
+        break;
+
+                /* Options de configuration des tests */
+
+            case 't':
+        numtest = atoi(argv[++i]);
+                if (numtest >= 1 && numtest <= NTESTS) 
+                {
+                    Do_Test[numtest - 1] = 1;
+                    ++ntests;
+                }
+                else 
+                {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+        break;
+        case 'l':
+        Loops_per_Record = atof(argv[++i]);
+        break;
+        case 'w':
+        Ratio_Read_Write = atoi(argv[++i]);
+        break;
+            case 's':
+                N_Seq_Access = atoi(argv[++i]);
+        break;          
+            case 'W':
+                N_Working_Sets = atoi(argv[++i]);
+        break;            
+            case 'L':
+                N_Local_Window = atoi(argv[++i]);
+        break;
+            case 'd':
+                N_Deref = atoi(argv[++i]);
+                break;
+            case 'H':
+                Use_Hints = 1;
+                break;
+            case 'm':
+                N_Write_Batch = atoi(argv[++i]);
+                break;
+            case 'g':
+                Workload_Spec = argv[++i];
+                break;
+            case 'F':
+                N_Files = atoi(argv[++i]);
+                break;
+            case 'C':
+                N_Test_Threads = atoi(argv[++i]);
+                break;
+            case 'Y':
+                N_Async_Depth = atoi(argv[++i]);
+                break;
+            case 'D':
+                N_Sync_Threads = atoi(argv[++i]);
+                break;
+            case 'G':
+                Rng_Set_Seed(strtoull(argv[++i], NULL, 0));
+                break;
+
+                /* Simulation multiple et flux d'accès */
+
+            case 'M':
+                Parse_Instances(argv[++i]);
+                break;
+            case 'j':
+                N_Threads = atoi(argv[++i]);
+                break;
+            case 'o':
+                Trace_Out_File = argv[++i];
+                break;
+            case 'i':
+                Trace_In_File = argv[++i];
+                break;
+        default:
+        fprintf(stderr, "Option inconnue : %s\n", argv[i]);
+        exit(1);
+        }
+    }
+    else
+    {
+        Usage(argv[0]);
+        exit(1);
+    }
+    }
+
+    N_Loops = (Cache_Index)(Loops_per_Record * N_Records_in_File);
+    N_Blocks_in_Cache = N_Records_in_File / N_Records_per_Block / Ratio_File_Cache;
+
+    if (N_Spill_Blocks > 0)
+    {
+        Spill_File = malloc(strlen(File) + 7);
+        sprintf(Spill_File, "%s.spill", File);
+    }
+
+    /* Les caches de -M sans rapport explicite prennent celui de -r */
+    for (i = 0; i < N_Instances; i++)
+        if (Instances[i].ratio <= 0) Instances[i].ratio = Ratio_File_Cache;
 
     if (just_print)
     {
@@ -708,9 +2798,35 @@ static void Scan_Args(int argc, char *argv[])
 
     if (ntests == 0)
     {
-        // Aucun test choisi : on les active tous
+        // Aucun test choisi : on les active tous (le test 8 seulement avec -g,
+        // le test 9 seulement avec -F, le test 10 seulement avec -C, le
+        // test 11 seulement avec -Y, le test 12 seulement avec -D, les tests
+        // 13 et suivants, contrôles du contenu, seulement avec -t)
         for (i = 0; i < NTESTS; ++i) 
             Do_Test[i] = true;
+        Do_Test[7] = (Workload_Spec != NULL);
+        Do_Test[8] = (N_Files > 0);
+        Do_Test[9] = (N_Test_Threads > 0);
+        Do_Test[10] = (N_Async_Depth > 0);
+        Do_Test[11] = (N_Sync_Threads > 0);
+        for (i = 12; i < NTESTS; ++i)
+            Do_Test[i] = false;
     }
+    else if (Do_Test[7] && Workload_Spec == NULL)
+        Workload_Spec = "uniform";
+    if (Do_Test[8] && N_Files <= 0)
+        N_Files = 4;
+    if (N_Files > N_Records_in_File)
+        N_Files = N_Records_in_File;
+    if (Do_Test[9] && N_Test_Threads <= 0)
+        N_Test_Threads = 4;
+    if (Do_Test[10] && N_Async_Depth <= 0)
+        N_Async_Depth = 16;
+    if (Do_Test[11] && N_Sync_Threads <= 0)
+        N_Sync_Threads = 4;
+
+    /* En mode NUMA, chaque nœud a sa tranche de blocs : pas de Cache_Resize() */
+    if (N_Resize_Blocks > 0 && N_Numa_Nodes >= 0)
+        Error("-Z : incompatible avec -U");
 }
 
@@ -0,0 +1,292 @@
+/*!
+ * \file workload.c
+ *
+ * \brief Générateurs de flux d'accès synthétiques (voir workload.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "workload.h"
+
+typedef enum {
+    WL_UNIFORM,
+    WL_SCAN,
+    WL_ZIPF,
+    WL_HOTSPOT,
+    WL_PHASES,
+} Workload_Kind;
+
+/* Une case de la table d'alias : seuil (sur 2^32) et alias, voisins en mémoire */
+struct Alias
+{
+    uint32_t thresh;
+    uint32_t alias;
+};
+
+struct Workload
+{
+    Workload_Kind kind;
+    unsigned long n;            /* nombre d'enregistrements */
+
+    unsigned long pos;          /* scan : position courante */
+    unsigned long nloop;        /* scan : longueur de la boucle */
+
+    struct Alias *table;        /* zipf : table d'alias */
+    uint32_t *perm;             /* zipf : rang -> enregistrement */
+
+    unsigned long nhot;         /* hotspot : taille de la zone chaude */
+    double phot;                /* hotspot : proportion d'accès à la zone chaude */
+
+    struct Workload **phases;   /* phases : générateurs successifs */
+    unsigned long *lens;        /* phases : nombre d'accès de chaque phase */
+    int nphases;
+    int cur;                    /* phases : phase courante */
+    unsigned long left;         /* phases : accès restants dans la phase courante */
+};
+
+/* ------------------------------------------------------------------------------------
+ * Loi de Zipf : table d'alias (méthode de Vose)
+ * ------------------------------------------------------------------------------------
+ */
+
+static int Zipf_Init(struct Workload *pw, double theta)
+{
+    unsigned long n = pw->n, i, nsmall = 0, nlarge = 0;
+    double *p = malloc(n * sizeof(double));
+    uint32_t *small = malloc(n * sizeof(uint32_t));
+    uint32_t *large = malloc(n * sizeof(uint32_t));
+    struct Rng *prng = Rng_Default();
+    double sum = 0.0;
+
+    pw->table = malloc(n * sizeof(struct Alias));
+    pw->perm = malloc(n * sizeof(uint32_t));
+    if (!p || !small || !large || !pw->table || !pw->perm)
+    {
+        free(p), free(small), free(large);
+        return 0;
+    }
+
+    /* Probabilités normalisées à une moyenne de 1 */
+    for (i = 0; i < n; i++) sum += p[i] = pow((double)(i + 1), -theta);
+    for (i = 0; i < n; i++)
+    {
+        p[i] *= n / sum;
+        if (p[i] < 1.0) small[nsmall++] = i;
+        else large[nlarge++] = i;
+    }
+
+    while (nsmall > 0 && nlarge > 0)
+    {
+        uint32_t s = small[--nsmall], l = large[nlarge - 1];
+
+        pw->table[s].thresh = (uint32_t)(p[s] * 4294967296.0);
+        pw->table[s].alias = l;
+        p[l] -= 1.0 - p[s];
+        if (p[l] < 1.0)
+        {
+            nlarge--;
+            small[nsmall++] = l;
+        }
+    }
+    /* Ce qui reste vaut 1 aux erreurs d'arrondi près */
+    while (nlarge > 0)
+    {
+        uint32_t l = large[--nlarge];
+
+        pw->table[l].thresh = UINT32_MAX;
+        pw->table[l].alias = l;
+    }
+    while (nsmall > 0)
+    {
+        uint32_t s = small[--nsmall];
+
+        pw->table[s].thresh = UINT32_MAX;
+        pw->table[s].alias = s;
+    }
+
+    /* Dispersion des rangs dans le fichier (Fisher-Yates) */
+    for (i = 0; i < n; i++) pw->perm[i] = i;
+    for (i = n - 1; i > 0; i--)
+    {
+        unsigned long j = Rng_Below(prng, i + 1);
+        uint32_t t = pw->perm[i];
+
+        pw->perm[i] = pw->perm[j];
+        pw->perm[j] = t;
+    }
+
+    free(p);
+    free(small);
+    free(large);
+    return 1;
+}
+
+static unsigned long Zipf_Next(struct Workload *pw, struct Rng *prng)
+{
+    unsigned long i = Rng_Below(prng, pw->n);
+    uint32_t coin = (uint32_t)Rng_Next(prng);
+
+    return pw->perm[coin < pw->table[i].thresh ? i : pw->table[i].alias];
+}
+
+/* ------------------------------------------------------------------------------------
+ * Analyse des descriptions
+ * ------------------------------------------------------------------------------------
+ */
+
+/* Paramètre numéro k (0 : celui qui suit le premier ':') ou valeur par défaut */
+static double Param(const char *spec, int k, double def)
+{
+    const char *p = spec;
+
+    for (;;)
+    {
+        if ((p = strchr(p, ':')) == NULL) return def;
+        p++;
+        if (k-- == 0) return atof(p);
+    }
+}
+
+static int Is_Kind(const char *spec, const char *name)
+{
+    size_t len = strlen(name);
+
+    return strncmp(spec, name, len) == 0 && (spec[len] == '\0' || spec[len] == ':');
+}
+
+/*!
+ * \param spec description du générateur (voir workload.h)
+ * \param nrecords nombre d'enregistrements du fichier
+ * \return le générateur ou NULL si la description est incorrecte
+ */
+struct Workload *Workload_Create(const char *spec, unsigned long nrecords)
+{
+    struct Workload *pw;
+
+    if (nrecords == 0 || nrecords > UINT32_MAX) return NULL;
+    pw = calloc(1, sizeof(struct Workload));
+    pw->n = nrecords;
+
+    /* Phases : "g1@n1,g2@n2,..." */
+    if (strchr(spec, '@') != NULL)
+    {
+        char *copy = strdup(spec), *item, *save = NULL;
+        unsigned long total;
+        int i;
+
+        pw->kind = WL_PHASES;
+        for (item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save))
+        {
+            char *at = strchr(item, '@');
+            struct Workload *sub;
+
+            if (at == NULL) break;
+            *at = '\0';
+            if ((sub = Workload_Create(item, nrecords)) == NULL) break;
+            pw->phases = realloc(pw->phases, (pw->nphases + 1) * sizeof(struct Workload *));
+            pw->lens = realloc(pw->lens, (pw->nphases + 1) * sizeof(unsigned long));
+            pw->phases[pw->nphases] = sub;
+            pw->lens[pw->nphases] = strtoul(at + 1, NULL, 10);
+            pw->nphases++;
+        }
+        free(copy);
+        for (total = 0, i = 0; i < pw->nphases; i++) total += pw->lens[i];
+        if (item != NULL || total == 0)
+        {
+            Workload_Delete(pw);
+            return NULL;
+        }
+        pw->cur = 0;
+        pw->left = pw->lens[0];
+        return pw;
+    }
+
+    if (Is_Kind(spec, "uniform"))
+        pw->kind = WL_UNIFORM;
+    else if (Is_Kind(spec, "scan"))
+    {
+        double f = Param(spec, 0, 1.0);
+
+        pw->kind = WL_SCAN;
+        pw->nloop = (unsigned long)(f * nrecords);
+        if (pw->nloop == 0) pw->nloop = 1;
+        if (f <= 0.0 || f > 1.0)
+        {
+            Workload_Delete(pw);
+            return NULL;
+        }
+    }
+    else if (Is_Kind(spec, "zipf"))
+    {
+        pw->kind = WL_ZIPF;
+        if (!Zipf_Init(pw, Param(spec, 0, 0.99)))
+        {
+            Workload_Delete(pw);
+            return NULL;
+        }
+    }
+    else if (Is_Kind(spec, "hotspot"))
+    {
+        double f = Param(spec, 0, 0.1);
+
+        pw->kind = WL_HOTSPOT;
+        pw->phot = Param(spec, 1, 0.9);
+        pw->nhot = (unsigned long)(f * nrecords);
+        if (pw->nhot == 0) pw->nhot = 1;
+        if (f <= 0.0 || f > 1.0 || pw->phot < 0.0 || pw->phot > 1.0)
+        {
+            Workload_Delete(pw);
+            return NULL;
+        }
+    }
+    else
+    {
+        free(pw);
+        return NULL;
+    }
+    return pw;
+}
+
+void Workload_Delete(struct Workload *pw)
+{
+    int i;
+
+    for (i = 0; i < pw->nphases; i++) Workload_Delete(pw->phases[i]);
+    free(pw->phases);
+    free(pw->lens);
+    free(pw->table);
+    free(pw->perm);
+    free(pw);
+}
+
+unsigned long Workload_Next(struct Workload *pw, struct Rng *prng)
+{
+    unsigned long ind;
+
+    switch (pw->kind)
+    {
+    case WL_SCAN:
+        ind = pw->pos;
+        if (++pw->pos == pw->nloop) pw->pos = 0;
+        return ind;
+    case WL_ZIPF:
+        return Zipf_Next(pw, prng);
+    case WL_HOTSPOT:
+        if (Rng_Double(prng) < pw->phot)
+            return Rng_Below(prng, pw->nhot);
+        return Rng_Below(prng, pw->n);
+    case WL_PHASES:
+        while (pw->left == 0)
+        {
+            pw->cur = (pw->cur + 1) % pw->nphases;
+            pw->left = pw->lens[pw->cur];
+        }
+        pw->left--;
+        return Workload_Next(pw->phases[pw->cur], prng);
+    case WL_UNIFORM:
+    default:
+        return Rng_Below(prng, pw->n);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef _WORKLOAD_H_
+#define _WORKLOAD_H_
+/*!
+ * \file workload.h
+ *
+ * \brief Générateurs de flux d'accès synthétiques.
+ *
+ * Un générateur produit une suite d'indices d'enregistrements dans
+ * [0, nrecords[. Il est décrit par une chaîne :
+ *
+ * - \c uniform : tirage uniforme ;
+ * - \c scan[:f] : parcours séquentiel de la fraction f du fichier (1 par
+ *   défaut) située à son début, qui reprend au début à la fin de la fraction.
+ *   Une boucle un peu plus grande que le cache est le pire cas de LRU ;
+ * - \c zipf[:theta] : loi de Zipf de paramètre theta (0.99 par défaut),
+ *   tirée en temps constant grâce à une table d'alias précalculée. Les
+ *   enregistrements les plus populaires sont dispersés dans le fichier ;
+ * - \c hotspot[:f[:p]] : une proportion p des accès (0.9) porte sur la
+ *   fraction f du fichier (0.1) située à son début, le reste est uniforme ;
+ * - \c g1@n1,g2@n2,... : phases successives, n1 accès selon g1, puis n2
+ *   selon g2, etc. ; on recommence à la première phase après la dernière.
+ *
+ * Les tirages utilisent un générateur fourni par l'appelant (voir rng.h).
+ */
+
+#include "rng.h"
+
+struct Workload;
+
+//! Création d'un générateur (NULL si la description est incorrecte).
+struct Workload *Workload_Create(const char *spec, unsigned long nrecords);
+
+//! Destruction d'un générateur.
+void Workload_Delete(struct Workload *pw);
+
+//! Indice du prochain enregistrement accédé.
+unsigned long Workload_Next(struct Workload *pw, struct Rng *prng);
+
+#endif /* _WORKLOAD_H_ */